@@ -20,6 +20,14 @@
 #include "hardware/gpio.h"
 #include "hardware/pwm.h"
 
+#include "board.h"
+#include "debounce.h"
+#include "idle.h"
+#include "io_record.h"
+#include "isr_trace.h"
+#include "ram_func.h"
+#include "soft_timer.h"
+
 #define D1 22
 #define D2 21
 #define D3 20
@@ -43,15 +51,20 @@ void pwmInit();
 void allLedsOn();
 void allLedsOff();
 void rotInit();
-bool repeatingTimerCallback(struct repeating_timer *t);
+void buttonTimerCallback(soft_timer_t *timer, void *context);
 void encoderAInterruptHandler(uint gpio, uint32_t events);
 
 volatile bool buttonEvent = false;
 volatile int brightness = MAX_BRIGHTNESS / 2;
 volatile bool ledState = true;
 
+static const uint leds[] = {D1, D2, D3};
+
+ISR_TRACE_SITE(encoder_trace, "encoder");
+
 int main(void) {
 
+    idle_init();
     stdio_init_all();
 
     rotInit();
@@ -61,8 +74,9 @@ int main(void) {
 
     pwmInit();
 
-    struct repeating_timer timer;
-    add_repeating_timer_ms(BUTTON_PERIOD, repeatingTimerCallback, NULL, &timer);
+    soft_timer_init();
+    static soft_timer_t button_timer;
+    soft_timer_start(&button_timer, BUTTON_PERIOD, BUTTON_PERIOD, buttonTimerCallback, NULL);
 
     while (true){
 
@@ -85,16 +99,13 @@ int main(void) {
         } else {
             allLedsOff();
         }
+
+        idle_wait();
     }
 }
 
 void ledsInit() {
-    gpio_init(D3);
-    gpio_set_dir(D3, GPIO_OUT);
-    gpio_init(D2);
-    gpio_set_dir(D2, GPIO_OUT);
-    gpio_init(D1);
-    gpio_set_dir(D1, GPIO_OUT);
+    board_outputs_init(leds, sizeof(leds) / sizeof(leds[0]));
 }
 
 void rotInit() {
@@ -111,41 +122,7 @@ void rotInit() {
 }
 
 void pwmInit() {
-
-    pwm_config config = pwm_get_default_config();
-
-    // D1:             (2A)
-    uint d1_slice = pwm_gpio_to_slice_num(D1);
-    uint d1_chanel = pwm_gpio_to_channel(D1);
-    pwm_set_enabled(d1_slice, false);
-    pwm_config_set_clkdiv_int(&config, DIVIDER);
-    pwm_config_set_wrap(&config, PWM_FREQ - 1);
-    pwm_init(d1_slice, &config, false);
-    pwm_set_chan_level(d1_slice, d1_chanel, LEVEL + 1);
-    gpio_set_function(D1, GPIO_FUNC_PWM);
-    pwm_set_enabled(d1_slice, true);
-
-    // D2:             (2B)
-    uint d2_slice = pwm_gpio_to_slice_num(D2);
-    uint d2_chanel = pwm_gpio_to_channel(D2);
-    pwm_set_enabled(d2_slice, false);
-    pwm_config_set_clkdiv_int(&config, DIVIDER);
-    pwm_config_set_wrap(&config, PWM_FREQ - 1);
-    pwm_init(d2_slice, &config, false);
-    pwm_set_chan_level(d2_slice, d2_chanel, LEVEL + 1);
-    gpio_set_function(D2, GPIO_FUNC_PWM);
-    pwm_set_enabled(d2_slice, true);
-
-    //D3:              (3A)
-    uint d3_slice = pwm_gpio_to_slice_num(D3);
-    uint d3_chanel = pwm_gpio_to_channel(D3);
-    pwm_set_enabled(d3_slice, false);
-    pwm_config_set_clkdiv_int(&config, DIVIDER);
-    pwm_config_set_wrap(&config, PWM_FREQ - 1);
-    pwm_init(d3_slice, &config, false);
-    pwm_set_chan_level(d3_slice, d3_chanel, LEVEL + 1);
-    gpio_set_function(D3, GPIO_FUNC_PWM);
-    pwm_set_enabled(d3_slice, true);
+    board_pwm_init(leds, sizeof(leds) / sizeof(leds[0]), DIVIDER, PWM_FREQ - 1, LEVEL + 1);
 }
 
 void allLedsOn() {
@@ -160,31 +137,22 @@ void allLedsOff() {
     pwm_set_gpio_level(D3, MIN_BRIGHTNESS);
 }
 
-bool repeatingTimerCallback(struct repeating_timer *t) {
-
+void RAM_FUNC(buttonTimerCallback)(soft_timer_t *timer, void *context) {
     // For SW_1: ON-OFF
-    static uint button_state = 0, filter_counter = 0;
-    uint new_state = 1;
-
-    new_state = gpio_get(ROT_SW);
-    if (button_state != new_state) {
-        if (++filter_counter >= BUTTON_FILTER) {
-            button_state = new_state;
-            filter_counter = 0;
-            if (new_state != RELEASED) {
-                buttonEvent = true;
-            }
-        }
-    } else {
-        filter_counter = 0;
+    static debounce_t button_filter;
+    bool level = gpio_get(ROT_SW);
+    IO_RECORD_LEVEL(ROT_SW, level);
+    if (true == debounce_sample(&button_filter, level, BUTTON_FILTER) && button_filter.level != RELEASED) {
+        buttonEvent = true;
     }
-
-    return true;
 }
 
-void encoderAInterruptHandler(uint gpio, uint32_t events) {
+void RAM_FUNC(encoderAInterruptHandler)(uint gpio, uint32_t events) {
+    ISR_TRACE_ENTER(encoder_trace);
 
     int rotB_state = gpio_get(ROT_B);
+    IO_RECORD_LEVEL(ROT_B, rotB_state);
+    IO_RECORD_EDGE(ROT_A, true);
 
     if (true == ledState) {
         if (rotB_state == 0) {
@@ -203,4 +171,5 @@ void encoderAInterruptHandler(uint gpio, uint32_t events) {
             }
        }
     }
+    ISR_TRACE_EXIT(encoder_trace);
 }
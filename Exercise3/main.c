@@ -49,7 +49,6 @@ switch(state) {
 
 #include <stdio.h>
 #include <string.h>
-#include <ctype.h>
 #include "pico/stdlib.h"
 #include "pico/time.h"
 #include "hardware/irq.h"
@@ -57,6 +56,14 @@ switch(state) {
 #include "uart.h"
 #include "hardware/pwm.h"
 
+#include "at_response.h"
+#include "board.h"
+#include "debounce.h"
+#include "idle.h"
+#include "io_record.h"
+#include "ram_func.h"
+#include "soft_timer.h"
+
 #define SW_0 9
 #define BUTTON_PERIOD 10
 #define BUTTON_FILTER 5
@@ -88,17 +95,21 @@ switch(state) {
 #define STRLEN 80
 
 void buttonInit();
-bool repeatingTimerCallback(struct repeating_timer *t);
+void buttonTimerCallback(soft_timer_t *timer, void *context);
 void ledsInit();
 void pwmInit();
 void allLedsOn();
 void allLedsOff();
-void removeColonsAndLowercase(const char *input, char *output);
+const at_response_t *readResponse(at_parser_t *parser, uint32_t timeout_ms);
 
 volatile bool buttonEvent = false;
 
+static const uint leds[] = {D1, D2, D3};
+static const uint buttons[] = {SW_0};
+
 int main(void) {
 
+    idle_init();
     stdio_init_all();
 
     buttonInit();
@@ -113,11 +124,14 @@ int main(void) {
     const char AT_command[] = "AT\r\n";
     const char AT_VER_command[] = "AT+VER\r\n";
     const char DevEui_command[] = "AT+ID=DevEui\r\n";
-    char str[STRLEN];
-    int pos = 0;
+    at_parser_t parser;
+    const at_response_t *response;
+
+    at_parser_init(&parser);
 
-    struct repeating_timer timer;
-    add_repeating_timer_ms(BUTTON_PERIOD, repeatingTimerCallback, NULL, &timer);
+    soft_timer_init();
+    static soft_timer_t button_timer;
+    soft_timer_start(&button_timer, BUTTON_PERIOD, BUTTON_PERIOD, buttonTimerCallback, NULL);
 
     while (true) {
 
@@ -136,20 +150,13 @@ int main(void) {
 
             uint count = 0;
 
-            // Using uart_is_readable_within_us:
+            // Using readResponse:
 
             while (MAX_COUNT > count++) {
-                const int uart_nr = UART_NR;
-                const int us_waiting_time = WAITING_TIME * 1000;
-                uart_send(uart_nr, AT_command);
-                sleep_ms(100);
-                if(uart_is_readable_within_us((uart_inst_t *) &uart_nr, (uint32_t) us_waiting_time)) {
+                uart_send(UART_NR, AT_command);
+                if (NULL != readResponse(&parser, WAITING_TIME)) {
                     printf("Connected to LoRa module.\n");
                     firmware_version_read = true;
-                    pos = uart_read(UART_NR, (uint8_t *) str, STRLEN - 1);
-                    str[pos] = '\0';
-                    //printf("%d, %d received: %s", time_us_32() / 1000, pos, str);
-                    pos = 0;
                     break;
                 }
             }
@@ -169,7 +176,7 @@ int main(void) {
             }
 */
 
-            if (MAX_COUNT == count) {
+            if (MAX_COUNT < count) { // count++ in the loop test runs once more when all attempts fail
                 printf("Module not responding.\n");
                 lo_ra_comm = false;
                 allLedsOff();
@@ -177,12 +184,9 @@ int main(void) {
 
             if (true == firmware_version_read) {
                 uart_send(UART_NR, AT_VER_command);
-                sleep_ms(WAITING_TIME);
-                pos = uart_read(UART_NR, (uint8_t *) str, STRLEN - 1);
-                if (pos > 0) {
-                    str[pos] = '\0';
-                    printf("%d, received: %s", time_us_32() / 1000, str);
-                    pos = 0;
+                response = readResponse(&parser, WAITING_TIME);
+                if (NULL != response) {
+                    printf("%d, received: %s\n", time_us_32() / 1000, response->line);
                     DevEui_read = true;
                     firmware_version_read = false;
                 } else {
@@ -194,16 +198,15 @@ int main(void) {
 
             if (true == DevEui_read) {
                 uart_send(UART_NR, DevEui_command);
-                sleep_ms(WAITING_TIME);
-                pos = uart_read(UART_NR, (uint8_t *) str, STRLEN - 1);
-                if (pos > 0) {
-                    str[pos] = '\0';
-                    char modified_str[STRLEN];
-                    char *devEui = strstr(str, "DevEui,");
-                    devEui += strlen("DevEui,");
-                    removeColonsAndLowercase(devEui, modified_str);
-                    printf("%s\n", modified_str);
-                    pos = 0;
+                response = readResponse(&parser, WAITING_TIME);
+                if (NULL != response) {
+                    if (AT_ID_DEV_EUI == response->id && AT_MAX_ID == response->id_length) {
+                        char dev_eui[2 * AT_MAX_ID + 1];
+                        at_hex_string(response->id_bytes, response->id_length, dev_eui);
+                        printf("%s\n", dev_eui);
+                    } else {
+                        printf("Unexpected response: %s\n", response->line);
+                    }
                     DevEui_read = false;
                 } else {
                     printf("Module stopped responding.\n");
@@ -212,60 +215,21 @@ int main(void) {
                 allLedsOff();
             }
         }
+
+        idle_wait();
     }
 }
 
 void buttonInit() {
-    gpio_init(SW_0);
-    gpio_set_dir(SW_0, GPIO_IN);
-    gpio_pull_up(SW_0);
+    board_buttons_init(buttons, sizeof(buttons) / sizeof(buttons[0]));
 }
 
 void ledsInit() {
-    gpio_init(D3);
-    gpio_set_dir(D3, GPIO_OUT);
-    gpio_init(D2);
-    gpio_set_dir(D2, GPIO_OUT);
-    gpio_init(D1);
-    gpio_set_dir(D1, GPIO_OUT);
+    board_outputs_init(leds, sizeof(leds) / sizeof(leds[0]));
 }
 
 void pwmInit() {
-
-    pwm_config config = pwm_get_default_config();
-
-    // D1:             (2A)
-    uint d1_slice = pwm_gpio_to_slice_num(D1);
-    uint d1_chanel = pwm_gpio_to_channel(D1);
-    pwm_set_enabled(d1_slice, false);
-    pwm_config_set_clkdiv_int(&config, DIVIDER);
-    pwm_config_set_wrap(&config, PWM_FREQ - 1);
-    pwm_init(d1_slice, &config, false);
-    pwm_set_chan_level(d1_slice, d1_chanel, LEVEL + 1);
-    gpio_set_function(D1, GPIO_FUNC_PWM);
-    pwm_set_enabled(d1_slice, true);
-
-    // D2:             (2B)
-    uint d2_slice = pwm_gpio_to_slice_num(D2);
-    uint d2_chanel = pwm_gpio_to_channel(D2);
-    pwm_set_enabled(d2_slice, false);
-    pwm_config_set_clkdiv_int(&config, DIVIDER);
-    pwm_config_set_wrap(&config, PWM_FREQ - 1);
-    pwm_init(d2_slice, &config, false);
-    pwm_set_chan_level(d2_slice, d2_chanel, LEVEL + 1);
-    gpio_set_function(D2, GPIO_FUNC_PWM);
-    pwm_set_enabled(d2_slice, true);
-
-    //D3:              (3A)
-    uint d3_slice = pwm_gpio_to_slice_num(D3);
-    uint d3_chanel = pwm_gpio_to_channel(D3);
-    pwm_set_enabled(d3_slice, false);
-    pwm_config_set_clkdiv_int(&config, DIVIDER);
-    pwm_config_set_wrap(&config, PWM_FREQ - 1);
-    pwm_init(d3_slice, &config, false);
-    pwm_set_chan_level(d3_slice, d3_chanel, LEVEL + 1);
-    gpio_set_function(D3, GPIO_FUNC_PWM);
-    pwm_set_enabled(d3_slice, true);
+    board_pwm_init(leds, sizeof(leds) / sizeof(leds[0]), DIVIDER, PWM_FREQ - 1, LEVEL + 1);
 
     allLedsOff();
 }
@@ -282,38 +246,32 @@ void allLedsOff() {
     pwm_set_gpio_level(D3, MIN_BRIGHTNESS);
 }
 
-bool repeatingTimerCallback(struct repeating_timer *t) {
-
+void RAM_FUNC(buttonTimerCallback)(soft_timer_t *timer, void *context) {
     // For SW_1: ON-OFF
-    static uint button_state = 0, filter_counter = 0;
-    uint new_state = 1;
-
-    new_state = gpio_get(SW_0);
-    if (button_state != new_state) {
-        if (++filter_counter >= BUTTON_FILTER) {
-            button_state = new_state;
-            filter_counter = 0;
-            if (new_state != RELEASED) {
-                buttonEvent = true;
-            }
-        }
-    } else {
-        filter_counter = 0;
+    static debounce_t button_filter;
+    bool level = gpio_get(SW_0);
+    IO_RECORD_LEVEL(SW_0, level);
+    if (true == debounce_sample(&button_filter, level, BUTTON_FILTER) && button_filter.level != RELEASED) {
+        buttonEvent = true;
     }
-
-    return true;
 }
 
-void removeColonsAndLowercase(const char *input, char *output) {
-    int inputLength = strlen(input);
-    int outputIndex = 0;
-
-    for (int i = 0; i < inputLength; i++) {
-        if (isxdigit((unsigned char) input[i])) {
-            output[outputIndex] = tolower(input[i]);
-            outputIndex++;
+/* Feeds the bytes from the LoRa module to the parser as they come until a response line is complete or timeout_ms has
+ * passed. Returns the response, NULL if none was received in time; a line cut off by the timeout is finished by the
+ * next call. */
+const at_response_t *readResponse(at_parser_t *parser, uint32_t timeout_ms) {
+    soft_timer_t timeout = {0};
+    const at_response_t *response = NULL;
+    uint8_t c;
+
+    soft_timer_start(&timeout, timeout_ms, 0, NULL, NULL);
+    while (NULL == response && true == soft_timer_pending(&timeout)) {
+        if (uart_read(UART_NR, &c, 1) > 0) {
+            response = at_parser_feed(parser, c);
+        } else {
+            idle_wait();
         }
     }
-
-    output[outputIndex] = '\0';
+    soft_timer_cancel(&timeout);
+    return response;
 }
@@ -28,6 +28,12 @@ where both bytes are identical, a typical case with erased/out of the box memory
 #include "hardware/gpio.h"
 #include "hardware/pwm.h"
 
+#include "board.h"
+#include "debounce.h"
+#include "idle.h"
+#include "ram_func.h"
+#include "soft_timer.h"
+
 /*  LEDs  */
 #define D1 22
 #define D2 21
@@ -66,7 +72,7 @@ void ledOn(uint led_pin);
 void ledOff(uint led_pin);
 void ledsInitState();
 void printState();
-bool repeatingTimerCallback(struct repeating_timer *t);
+void buttonTimerCallback(soft_timer_t *timer, void *context);
 void i2c_write_byte(uint16_t address, uint8_t data);
 uint8_t i2c_read_byte(uint16_t address);
 
@@ -79,6 +85,9 @@ volatile bool d1State = false;
 volatile bool d2State = false;
 volatile bool d3State = false;
 
+static const uint leds[] = {D1, D2, D3};
+static const uint buttons[] = {SW_0, SW_1, SW_2};
+
 const uint8_t d1_address = I2C_MEMORY_SIZE - 1;
 const uint8_t d2_address = I2C_MEMORY_SIZE - 2;
 const uint8_t d3_address = I2C_MEMORY_SIZE - 3;
@@ -86,6 +95,7 @@ const uint8_t d3_address = I2C_MEMORY_SIZE - 3;
 /*   MAIN   */
 int main() {
 
+    idle_init();
     stdio_init_all();
     printf("\nBoot\n");
 
@@ -114,8 +124,9 @@ int main() {
 
     printState();
 
-    struct repeating_timer timer;
-    add_repeating_timer_ms(BUTTON_PERIOD, repeatingTimerCallback, NULL, &timer);
+    soft_timer_init();
+    static soft_timer_t button_timer;
+    soft_timer_start(&button_timer, BUTTON_PERIOD, BUTTON_PERIOD, buttonTimerCallback, NULL);
 
     while (true) {
 
@@ -172,67 +183,23 @@ int main() {
         } else {
             ledOff(D1);
         }
+
+        idle_wait();
     }
 
     return 0;
 }
 
 void ledsInit() {
-    gpio_init(D3);
-    gpio_set_dir(D3, GPIO_OUT);
-    gpio_init(D2);
-    gpio_set_dir(D2, GPIO_OUT);
-    gpio_init(D1);
-    gpio_set_dir(D1, GPIO_OUT);
+    board_outputs_init(leds, sizeof(leds) / sizeof(leds[0]));
 }
 
 void buttonsInit() {
-    gpio_init(SW_0);
-    gpio_set_dir(SW_0, GPIO_IN);
-    gpio_pull_up(SW_0);
-    gpio_init(SW_1);
-    gpio_set_dir(SW_1, GPIO_IN);
-    gpio_pull_up(SW_1);
-    gpio_init(SW_2);
-    gpio_set_dir(SW_2, GPIO_IN);
-    gpio_pull_up(SW_2);
+    board_buttons_init(buttons, sizeof(buttons) / sizeof(buttons[0]));
 }
 
 void pwmInit() {
-    pwm_config config = pwm_get_default_config();
-
-    // D1:             (2A)
-    uint d1_slice = pwm_gpio_to_slice_num(D1);
-    uint d1_chanel = pwm_gpio_to_channel(D1);
-    pwm_set_enabled(d1_slice, false);
-    pwm_config_set_clkdiv_int(&config, DIVIDER);
-    pwm_config_set_wrap(&config, PWM_FREQ - 1);
-    pwm_init(d1_slice, &config, false);
-    pwm_set_chan_level(d1_slice, d1_chanel, LEVEL + 1);
-    gpio_set_function(D1, GPIO_FUNC_PWM);
-    pwm_set_enabled(d1_slice, true);
-
-    // D2:             (2B)
-    uint d2_slice = pwm_gpio_to_slice_num(D2);
-    uint d2_chanel = pwm_gpio_to_channel(D2);
-    pwm_set_enabled(d2_slice, false);
-    pwm_config_set_clkdiv_int(&config, DIVIDER);
-    pwm_config_set_wrap(&config, PWM_FREQ - 1);
-    pwm_init(d2_slice, &config, false);
-    pwm_set_chan_level(d2_slice, d2_chanel, LEVEL + 1);
-    gpio_set_function(D2, GPIO_FUNC_PWM);
-    pwm_set_enabled(d2_slice, true);
-
-    //D3:              (3A)
-    uint d3_slice = pwm_gpio_to_slice_num(D3);
-    uint d3_chanel = pwm_gpio_to_channel(D3);
-    pwm_set_enabled(d3_slice, false);
-    pwm_config_set_clkdiv_int(&config, DIVIDER);
-    pwm_config_set_wrap(&config, PWM_FREQ - 1);
-    pwm_init(d3_slice, &config, false);
-    pwm_set_chan_level(d3_slice, d3_chanel, LEVEL + 1);
-    gpio_set_function(D3, GPIO_FUNC_PWM);
-    pwm_set_enabled(d3_slice, true);
+    board_pwm_init(leds, sizeof(leds) / sizeof(leds[0]), DIVIDER, PWM_FREQ - 1, LEVEL + 1);
 
     pwm_set_gpio_level(D1, MIN_BRIGHTNESS);
     pwm_set_gpio_level(D2, MIN_BRIGHTNESS);
@@ -266,7 +233,7 @@ void ledsInitState() {
 }
 
 void printState() {
-    printf("%llus since power up.\n", time_us_64() / 1000000);
+    printf("%llus since power up.\n", (unsigned long long) (time_us_64() / 1000000));
     if (true == d1State) {
         printf("D1: on\n");
     } else {
@@ -284,59 +251,24 @@ void printState() {
     }
 }
 
-bool repeatingTimerCallback(struct repeating_timer *t) {
+void RAM_FUNC(buttonTimerCallback)(soft_timer_t *timer, void *context) {
     /* SW0 */
-    static uint sw0_button_state = 0, sw0_filter_counter = 0;
-    uint sw0_new_state = 1;
-
-    sw0_new_state = gpio_get(SW_0);
-    if (sw0_button_state != sw0_new_state) {
-        if (++sw0_filter_counter >= BUTTON_FILTER) {
-            sw0_button_state = sw0_new_state;
-            sw0_filter_counter = 0;
-            if (sw0_new_state != SW0_RELEASED) {
-                sw0_buttonEvent = true;
-            }
-        }
-    } else {
-        sw0_filter_counter = 0;
+    static debounce_t sw0_filter;
+    if (true == debounce_sample(&sw0_filter, gpio_get(SW_0), BUTTON_FILTER) && sw0_filter.level != SW0_RELEASED) {
+        sw0_buttonEvent = true;
     }
 
     /* SW1 */
-    static uint sw1_button_state = 0, sw1_filter_counter = 0;
-    uint sw1_new_state = 1;
-
-    sw1_new_state = gpio_get(SW_1);
-    if (sw1_button_state != sw1_new_state) {
-        if (++sw1_filter_counter >= BUTTON_FILTER) {
-            sw1_button_state = sw1_new_state;
-            sw1_filter_counter = 0;
-            if (sw1_new_state != SW1_RELEASED) {
-                sw1_buttonEvent = true;
-            }
-        }
-    } else {
-        sw1_filter_counter = 0;
+    static debounce_t sw1_filter;
+    if (true == debounce_sample(&sw1_filter, gpio_get(SW_1), BUTTON_FILTER) && sw1_filter.level != SW1_RELEASED) {
+        sw1_buttonEvent = true;
     }
 
     /* SW2 */
-    static uint sw2_button_state = 0, sw2_filter_counter = 0;
-    uint sw2_new_state = 1;
-
-    sw2_new_state = gpio_get(SW_2);
-    if (sw2_button_state != sw2_new_state) {
-        if (++sw2_filter_counter >= BUTTON_FILTER) {
-            sw2_button_state = sw2_new_state;
-            sw2_filter_counter = 0;
-            if (sw2_new_state != SW2_RELEASED) {
-                sw2_buttonEvent = true;
-            }
-        }
-    } else {
-        sw2_filter_counter = 0;
+    static debounce_t sw2_filter;
+    if (true == debounce_sample(&sw2_filter, gpio_get(SW_2), BUTTON_FILTER) && sw2_filter.level != SW2_RELEASED) {
+        sw2_buttonEvent = true;
     }
-
-    return true;
 }
 
 void i2c_write_byte(uint16_t address, uint8_t data) {
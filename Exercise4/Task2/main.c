@@ -23,9 +23,36 @@ The log must have the following properties:
             o Printing stops when an invalid string is encountered or the end log are is reached.
     • User can erase the log by typing erase and pressing enter.
             o Erasing is done by writing a zero at the first byte of every log entry.
+
+The fixed 64-byte text slots have since been replaced by the binary records of common/log_record.h, packed back to
+back from address 0. A state change takes 5-7 bytes instead of a slot, and the text is only produced by read. The
+append point is found by scanning the log at boot; a zero byte is written after the last record so stale data is never
+mistaken for a record. Erase writes a single zero at address 0.
+
+Log time is the sum of the record deltas: milliseconds of operation since the log was last erased, it stops while the
+board is off. read takes optional filters, read [since=<s>] [type=boot|state|text] [last=<n>], and prints the log time
+of every record. A summary of each 64-byte block (common/log_index.h) is built at boot and kept up to date, so blocks
+that cannot match are never read over I2C.
+
+EEPROM access goes through common/eeprom.h. Its page cache of EEPROM_CACHE_PAGES lines serves the reads of a record
+spread over a page and the state bytes, and cache prints its hit and miss counters; the log is not mirrored in RAM, the
+block summary keeps read to the pages it needs. The bus runs at the fastest speed the EEPROM passes a probe at, and i2c prints
+the speed and the transaction statistics.
+
+The main loop sleeps in common/idle.h whenever it has nothing left to do; idle prints the share of time it was busy
+and how often it woke up since the last idle. trace prints the latency and duration of the soft timer interrupt in a
+build with ISR_TRACE=1 (common/isr_trace.h). profile prints, and then clears, the time the main loop spent in each of
+its stages since the last profile in a build with PROFILE=1 (common/profile.h); PROTO_PROFILE_READ returns the same.
+
+In a build with LORAWAN=1 (common/lorawan.h) the board joins the LoRaWAN network through the LoRa-E5 on UART1 and
+sends the state changes as uplinks, collected into batches of bit-packed states and time deltas (common/uplink.h) that
+go out when full or when the oldest change is UPLINK_DEADLINE_MS old. The batches wait in the transmit scheduler
+(common/lora_tx.h) until the sub-band of the default channels has room for them in its duty cycle at LORA_SF. lora
+prints the join and uplink counters, the queue and the airtime used.
 */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "pico/stdlib.h"
 #include "pico/time.h"
@@ -34,6 +61,25 @@ The log must have the following properties:
 #include "hardware/gpio.h"
 #include "hardware/pwm.h"
 
+#include "board.h"
+#include "cli.h"
+#include "debounce.h"
+#include "dlog.h"
+#include "eeprom.h"
+#include "i2c_bus.h"
+#include "idle.h"
+#include "io_record.h"
+#include "isr_trace.h"
+#include "log_index.h"
+#include "log_record.h"
+#include "lora_tx.h"
+#include "lorawan.h"
+#include "profile.h"
+#include "proto.h"
+#include "ram_func.h"
+#include "soft_timer.h"
+#include "uplink.h"
+
 /////////////////////////////////////////////////////
 //                      MACROS                     //
 /////////////////////////////////////////////////////
@@ -65,13 +111,24 @@ The log must have the following properties:
 #define I2C0_SCL_PIN 17
 #define DEVADDR 0x50
 #define BAUDRATE 100000
+#define I2C_MAX_BAUDRATE 1000000 // probed down to 400 kHz or 100 kHz if the EEPROM does not keep up
 #define I2C_MEMORY_SIZE 32768
-#define MAX_LOG_SIZE 64
-#define MAX_LOG_ENTRY 32
+#define LOG_AREA_SIZE 2048
+#define MAX_LOG_TEXT 64
 #define DEBUG_LOG_SIZE 6
-
-/* USER INPUT */
-#define MAX_STR_INPUT_LENGTH 8
+#define DLOG_DRAIN_PER_LOOP 2
+
+/*  LoRa   */
+#define LORA_UART_NR 1
+#define LORA_TX_PIN 4
+#define LORA_RX_PIN 5
+#define LORA_APP_KEY "00000000000000000000000000000000" // AppKey of the DevEui registered for the module (Exercise 3)
+#define LORA_PORT 8
+#define UPLINK_STATE_BITS 3
+#define UPLINK_MAX_PAYLOAD 51 // DR0-DR2 in EU868
+#define UPLINK_DEADLINE_MS (5 * 60 * 1000)
+#define LORA_SF 12            // DR0, where the module starts and ADR may leave it
+#define LORA_DUTY_PERMILLE 10 // g1 of EU868, 868.0-868.6 MHz, 1%: the three default channels
 
 /////////////////////////////////////////////////////
 //             FUNCTION DECLARATIONS               //
@@ -85,15 +142,34 @@ void ledOn(uint led_pin);
 void ledOff(uint led_pin);
 void ledsInitState();
 void printState();
-bool repeatingTimerCallback(struct repeating_timer *t);
-void i2cWriteByte(uint16_t address, uint8_t data);
-uint8_t i2cReadByte(uint16_t address);
-uint16_t crc16(const uint8_t *data_p, size_t length);
-void writeLogEntry(const char *message);
-void printLog();
+void buttonTimerCallback(soft_timer_t *timer, void *context);
+void scanLog();
+void writeLogRecord(uint8_t type, const uint8_t *payload, uint8_t length);
+uint16_t readLogRecord(uint16_t address, log_record_t *record);
+uint32_t logTimeNow();
+uint queryLog(size_t block, uint32_t since_ms, int type, uint skip, bool print);
+void printLog(uint32_t since_ms, int type, uint32_t last);
 void eraseLog();
 void printAllMemory();
 void eraseAll();
+void uplinkInit();
+void uplinkPoll();
+void uplinkState(uint8_t state);
+bool queueUplink(void *context, const uint8_t *payload, size_t length);
+bool sendUplink(void *context, uint8_t band, const uint8_t *payload, size_t length);
+void uplinkRefused(void *context);
+void commandCache(const cli_args_t *args);
+void commandErase(const cli_args_t *args);
+void commandI2c(const cli_args_t *args);
+void commandIdle(const cli_args_t *args);
+void commandLora(const cli_args_t *args);
+void commandProfile(const cli_args_t *args);
+void commandRead(const cli_args_t *args);
+void commandTrace(const cli_args_t *args);
+uint8_t frameLedGet(const uint8_t *payload, size_t length, uint8_t *reply, size_t *reply_length);
+uint8_t frameLedSet(const uint8_t *payload, size_t length, uint8_t *reply, size_t *reply_length);
+uint8_t frameLogRead(const uint8_t *payload, size_t length, uint8_t *reply, size_t *reply_length);
+uint8_t frameEepromRead(const uint8_t *payload, size_t length, uint8_t *reply, size_t *reply_length);
 
 /////////////////////////////////////////////////////
 //                GLOBAL VARIABLES                 //
@@ -112,6 +188,51 @@ const uint16_t d2_address = I2C_MEMORY_SIZE - 2;
 const uint16_t d3_address = I2C_MEMORY_SIZE - 3;
 
 volatile uint log_counter = 0;
+uint16_t log_end = 0;       // address of the terminating zero after the last record
+uint32_t log_time_ms = 0;   // log time of the last record, the sum of all deltas
+uint32_t log_boot_ms = 0;   // log time at power up; log time now is log_boot_ms + ms since boot
+uint32_t log_session_ms = 0; // log time of the boot record in effect
+log_index_t log_index;
+i2c_bus_t i2c_bus;
+eeprom_t eeprom;
+eeprom_line_t eeprom_lines[EEPROM_CACHE_PAGES];
+#if LORAWAN
+lorawan_t lorawan;
+uplink_t uplink;
+lora_tx_t lora_tx;
+#endif
+
+static const uint leds[] = {D1, D2, D3};
+static const uint buttons[] = {SW_0, SW_1, SW_2};
+
+/* Main loop stages (common/profile.h) */
+PROFILE_ZONE(loop_zone, "loop");
+PROFILE_ZONE(cli_zone, "cli");
+PROFILE_ZONE(dlog_zone, "dlog");
+PROFILE_ZONE(button_zone, "button");
+PROFILE_ZONE(state_zone, "state write");
+PROFILE_ZONE(log_zone, "log write");
+PROFILE_ZONE(leds_zone, "leds");
+
+/* Sorted by name */
+static const cli_command_t commands[] = {
+        {"cache",   "",       commandCache},
+        {"erase",   "",       commandErase},
+        {"i2c",     "",       commandI2c},
+        {"idle",    "",       commandIdle},
+        {"lora",    "",       commandLora},
+        {"profile", "",       commandProfile},
+        {"read",    "s?s?s?", commandRead},
+        {"trace",   "",       commandTrace},
+};
+
+static const proto_command_t frame_commands[] = {
+        {PROTO_LED_GET,      frameLedGet},
+        {PROTO_LED_SET,      frameLedSet},
+        {PROTO_LOG_READ,     frameLogRead},
+        {PROTO_EEPROM_READ,  frameEepromRead},
+        {PROTO_PROFILE_READ, profile_frame_read},
+};
 
 /////////////////////////////////////////////////////
 //                     MAIN                        //
@@ -119,19 +240,22 @@ volatile uint log_counter = 0;
 
 int main() {
 
+    idle_init();
     stdio_init_all();
 
     ledsInit();
     pwmInit();
     buttonsInit();
     i2cInit();
+    uplinkInit();
 
     printf("\nBoot\n\n");
-    writeLogEntry("Boot\n");
+    scanLog();
+    writeLogRecord(LOG_TYPE_BOOT, NULL, 0);
 
-    d1State = i2cReadByte(d1_address);
-    d2State = i2cReadByte(d2_address);
-    d3State = i2cReadByte(d3_address);
+    d1State = eeprom_read_byte(&eeprom, d1_address);
+    d2State = eeprom_read_byte(&eeprom, d2_address);
+    d3State = eeprom_read_byte(&eeprom, d3_address);
 
     //eraseAll();
     //printAllMemory();
@@ -152,98 +276,110 @@ int main() {
 
     printState();
 
-    struct repeating_timer timer;
-    add_repeating_timer_ms(BUTTON_PERIOD, repeatingTimerCallback, NULL, &timer);
+    soft_timer_init();
+    static soft_timer_t button_timer;
+    soft_timer_start(&button_timer, BUTTON_PERIOD, BUTTON_PERIOD, buttonTimerCallback, NULL);
 
-    char user_string1[MAX_STR_INPUT_LENGTH];
-    char user_string2[MAX_STR_INPUT_LENGTH];
-    char character;
-    int index = 0;
+    cli_t cli;
+    cli_init(&cli, commands, sizeof(commands) / sizeof(commands[0]));
+    proto_t proto;
+    proto_init(&proto, frame_commands, sizeof(frame_commands) / sizeof(frame_commands[0]));
+    cli_set_frame_sink(&cli, proto_feed, &proto);
 
     while (true) {
+        PROFILE_BEGIN(loop_zone);
 
-        /* stdin inputs for "read" and "erase" */
-        character = getchar_timeout_us(0);
-        while (character != 255 && index < 8) {
-            user_string1[index] = character;
-            user_string2[index] = character;
-
-            if(index == 4) {
-                user_string1[index] = '\0';
-                if (0 == strcmp("read", user_string1)) {
-                    printLog();
-                    index = 0;
-                    break;
-                }
-            }
-
-            if(index == 5)
-            {
-                user_string2[index] = '\0';
-                if (0 == strcmp("erase", user_string2)) {
-                    eraseLog();
-                    index = 0;
-                    break;
-                }
-            }
-
-            index++;
-            character = getchar_timeout_us(0);
-        }
+        /* stdin commands "read" and "erase", and binary frames */
+        PROFILE_BEGIN(cli_zone);
+        cli_poll(&cli);
+        PROFILE_END(cli_zone);
+        PROFILE_BEGIN(dlog_zone);
+        int drained = dlog_drain(DLOG_DRAIN_PER_LOOP);
+        PROFILE_END(dlog_zone);
+        uplinkPoll();
 
         /* SW0 - D3 */
         if (sw0_buttonEvent) {
+            PROFILE_BEGIN(button_zone);
             sw0_buttonEvent = false;
             if(true == d3State) {
                 d3State = false;
             } else {
                 d3State = true;
             }
-            i2cWriteByte(d3_address,d3State);
+            PROFILE_BEGIN(state_zone);
+            eeprom_write_byte(&eeprom, d3_address,d3State);
+            PROFILE_END(state_zone);
+            PROFILE_BEGIN(log_zone);
             printState();
+            PROFILE_END(log_zone);
+            PROFILE_END(button_zone);
         }
 
+        PROFILE_BEGIN(leds_zone);
         if (true == d3State) {
             ledOn(D3);
         } else {
             ledOff(D3);
         }
+        PROFILE_END(leds_zone);
 
         /* SW1 - D2 */
         if (sw1_buttonEvent) {
+            PROFILE_BEGIN(button_zone);
             sw1_buttonEvent = false;
             if(true == d2State) {
                 d2State = false;
             } else {
                 d2State = true;
             }
-            i2cWriteByte(d2_address,d2State);
+            PROFILE_BEGIN(state_zone);
+            eeprom_write_byte(&eeprom, d2_address,d2State);
+            PROFILE_END(state_zone);
+            PROFILE_BEGIN(log_zone);
             printState();
+            PROFILE_END(log_zone);
+            PROFILE_END(button_zone);
         }
 
+        PROFILE_BEGIN(leds_zone);
         if (true == d2State) {
             ledOn(D2);
         } else {
             ledOff(D2);
         }
+        PROFILE_END(leds_zone);
 
         /* SW2 - D1 */
         if (sw2_buttonEvent) {
+            PROFILE_BEGIN(button_zone);
             sw2_buttonEvent = false;
             if(true == d1State) {
                 d1State = false;
             } else {
                 d1State = true;
             }
-            i2cWriteByte(d1_address,d1State);
+            PROFILE_BEGIN(state_zone);
+            eeprom_write_byte(&eeprom, d1_address,d1State);
+            PROFILE_END(state_zone);
+            PROFILE_BEGIN(log_zone);
             printState();
+            PROFILE_END(log_zone);
+            PROFILE_END(button_zone);
         }
 
+        PROFILE_BEGIN(leds_zone);
         if (true == d1State) {
             ledOn(D1);
         } else {
             ledOff(D1);
         }
+        PROFILE_END(leds_zone);
+
+        PROFILE_END(loop_zone);
+        if (drained < DLOG_DRAIN_PER_LOOP) {
+            idle_wait();
+        }
     }
 
     return 0;
@@ -254,61 +390,15 @@ int main() {
 /////////////////////////////////////////////////////
 
 void ledsInit() {
-    gpio_init(D3);
-    gpio_set_dir(D3, GPIO_OUT);
-    gpio_init(D2);
-    gpio_set_dir(D2, GPIO_OUT);
-    gpio_init(D1);
-    gpio_set_dir(D1, GPIO_OUT);
+    board_outputs_init(leds, sizeof(leds) / sizeof(leds[0]));
 }
 
 void buttonsInit() {
-    gpio_init(SW_0);
-    gpio_set_dir(SW_0, GPIO_IN);
-    gpio_pull_up(SW_0);
-    gpio_init(SW_1);
-    gpio_set_dir(SW_1, GPIO_IN);
-    gpio_pull_up(SW_1);
-    gpio_init(SW_2);
-    gpio_set_dir(SW_2, GPIO_IN);
-    gpio_pull_up(SW_2);
+    board_buttons_init(buttons, sizeof(buttons) / sizeof(buttons[0]));
 }
 
 void pwmInit() {
-    pwm_config config = pwm_get_default_config();
-
-    // D1:             (2A)
-    uint d1_slice = pwm_gpio_to_slice_num(D1);
-    uint d1_chanel = pwm_gpio_to_channel(D1);
-    pwm_set_enabled(d1_slice, false);
-    pwm_config_set_clkdiv_int(&config, DIVIDER);
-    pwm_config_set_wrap(&config, PWM_FREQ - 1);
-    pwm_init(d1_slice, &config, false);
-    pwm_set_chan_level(d1_slice, d1_chanel, LEVEL + 1);
-    gpio_set_function(D1, GPIO_FUNC_PWM);
-    pwm_set_enabled(d1_slice, true);
-
-    // D2:             (2B)
-    uint d2_slice = pwm_gpio_to_slice_num(D2);
-    uint d2_chanel = pwm_gpio_to_channel(D2);
-    pwm_set_enabled(d2_slice, false);
-    pwm_config_set_clkdiv_int(&config, DIVIDER);
-    pwm_config_set_wrap(&config, PWM_FREQ - 1);
-    pwm_init(d2_slice, &config, false);
-    pwm_set_chan_level(d2_slice, d2_chanel, LEVEL + 1);
-    gpio_set_function(D2, GPIO_FUNC_PWM);
-    pwm_set_enabled(d2_slice, true);
-
-    //D3:              (3A)
-    uint d3_slice = pwm_gpio_to_slice_num(D3);
-    uint d3_chanel = pwm_gpio_to_channel(D3);
-    pwm_set_enabled(d3_slice, false);
-    pwm_config_set_clkdiv_int(&config, DIVIDER);
-    pwm_config_set_wrap(&config, PWM_FREQ - 1);
-    pwm_init(d3_slice, &config, false);
-    pwm_set_chan_level(d3_slice, d3_chanel, LEVEL + 1);
-    gpio_set_function(D3, GPIO_FUNC_PWM);
-    pwm_set_enabled(d3_slice, true);
+    board_pwm_init(leds, sizeof(leds) / sizeof(leds[0]), DIVIDER, PWM_FREQ - 1, LEVEL + 1);
 
     pwm_set_gpio_level(D1, MIN_BRIGHTNESS);
     pwm_set_gpio_level(D2, MIN_BRIGHTNESS);
@@ -319,6 +409,10 @@ void i2cInit() {
     i2c_init(i2c0, BAUDRATE);
     gpio_set_function(I2C0_SDA_PIN, GPIO_FUNC_I2C);
     gpio_set_function(I2C0_SCL_PIN, GPIO_FUNC_I2C);
+    i2c_bus_init(&i2c_bus, i2c0);
+    eeprom_init(&eeprom, i2c0, DEVADDR, eeprom_lines, EEPROM_CACHE_PAGES);
+    eeprom_use_bus(&eeprom, &i2c_bus);
+    eeprom_probe(&eeprom, I2C_MAX_BAUDRATE);
 }
 
 void ledOn(uint led_pin) {
@@ -331,171 +425,179 @@ void ledOff(uint led_pin) {
 
 void ledsInitState() {
     pwm_set_gpio_level(D1, MIN_BRIGHTNESS);
-    i2cWriteByte(d1_address,d1State);
+    eeprom_write_byte(&eeprom, d1_address,d1State);
 
     pwm_set_gpio_level(D2, BRIGHTNESS);
     d2State = true;
-    i2cWriteByte(d2_address,d2State);
+    eeprom_write_byte(&eeprom, d2_address,d2State);
 
     pwm_set_gpio_level(D3, MIN_BRIGHTNESS);
-    i2cWriteByte(d3_address,d3State);
+    eeprom_write_byte(&eeprom, d3_address,d3State);
 }
 
 void printState() {
-    printf("%llus since power up.\n", time_us_64() / 1000000);
-    printf("D1: %d\nD2: %d\nD3: %d\n\n", d1State, d2State, d3State);
+    DLOG("%us since power up.\n", (uint32_t) (time_us_64() / 1000000));
+    DLOG("D1: %d\nD2: %d\nD3: %d\n\n", d1State, d2State, d3State);
 
-    char log_message[MAX_LOG_SIZE - 3];
-    snprintf(log_message, MAX_LOG_SIZE - 3, "%llus since power up.\nD1: %d\nD2: %d\nD3: %d\n", time_us_64() / 1000000, d1State, d2State, d3State);
-    writeLogEntry(log_message);
+    uint8_t state = d1State | (d2State << 1) | (d3State << 2);
+    writeLogRecord(LOG_TYPE_STATE, &state, 1);
+    uplinkState(state);
 }
 
-bool repeatingTimerCallback(struct repeating_timer *t) {
+void RAM_FUNC(buttonTimerCallback)(soft_timer_t *timer, void *context) {
     /* SW0 */
-    static uint sw0_button_state = 0, sw0_filter_counter = 0;
-    uint sw0_new_state = 1;
-
-    sw0_new_state = gpio_get(SW_0);
-    if (sw0_button_state != sw0_new_state) {
-        if (++sw0_filter_counter >= BUTTON_FILTER) {
-            sw0_button_state = sw0_new_state;
-            sw0_filter_counter = 0;
-            if (sw0_new_state != SW0_RELEASED) {
-                sw0_buttonEvent = true;
-            }
-        }
-    } else {
-        sw0_filter_counter = 0;
+    static debounce_t sw0_filter;
+    bool sw0_level = gpio_get(SW_0);
+    IO_RECORD_LEVEL(SW_0, sw0_level);
+    if (true == debounce_sample(&sw0_filter, sw0_level, BUTTON_FILTER) && sw0_filter.level != SW0_RELEASED) {
+        sw0_buttonEvent = true;
     }
 
     /* SW1 */
-    static uint sw1_button_state = 0, sw1_filter_counter = 0;
-    uint sw1_new_state = 1;
-
-    sw1_new_state = gpio_get(SW_1);
-    if (sw1_button_state != sw1_new_state) {
-        if (++sw1_filter_counter >= BUTTON_FILTER) {
-            sw1_button_state = sw1_new_state;
-            sw1_filter_counter = 0;
-            if (sw1_new_state != SW1_RELEASED) {
-                sw1_buttonEvent = true;
-            }
-        }
-    } else {
-        sw1_filter_counter = 0;
+    static debounce_t sw1_filter;
+    bool sw1_level = gpio_get(SW_1);
+    IO_RECORD_LEVEL(SW_1, sw1_level);
+    if (true == debounce_sample(&sw1_filter, sw1_level, BUTTON_FILTER) && sw1_filter.level != SW1_RELEASED) {
+        sw1_buttonEvent = true;
     }
 
     /* SW2 */
-    static uint sw2_button_state = 0, sw2_filter_counter = 0;
-    uint sw2_new_state = 1;
-
-    sw2_new_state = gpio_get(SW_2);
-    if (sw2_button_state != sw2_new_state) {
-        if (++sw2_filter_counter >= BUTTON_FILTER) {
-            sw2_button_state = sw2_new_state;
-            sw2_filter_counter = 0;
-            if (sw2_new_state != SW2_RELEASED) {
-                sw2_buttonEvent = true;
-            }
-        }
-    } else {
-        sw2_filter_counter = 0;
+    static debounce_t sw2_filter;
+    bool sw2_level = gpio_get(SW_2);
+    IO_RECORD_LEVEL(SW_2, sw2_level);
+    if (true == debounce_sample(&sw2_filter, sw2_level, BUTTON_FILTER) && sw2_filter.level != SW2_RELEASED) {
+        sw2_buttonEvent = true;
     }
-
-    return true;
 }
 
-void i2cWriteByte(uint16_t address, uint8_t data) {
-    uint8_t buffer[3];
-    buffer[0] = address >> 8; buffer[1] = address; buffer[2] = data;
-    //printf("wr %x: %x\n", address, data);
-    i2c_write_blocking(i2c0, DEVADDR, buffer, sizeof(buffer), false);
-    sleep_ms(10);
+/* Walks the records from address 0 to find the append point and the log time of the last record, and builds the
+ * block summary on the way. */
+void scanLog() {
+    log_record_t record;
+    uint16_t size;
+
+    log_end = 0;
+    log_counter = 0;
+    log_time_ms = 0;
+    log_session_ms = 0;
+    log_index_reset(&log_index);
+    while ((size = readLogRecord(log_end, &record)) > 0) {
+        log_time_ms += record.delta_ms;
+        if (LOG_TYPE_BOOT == record.type) {
+            log_session_ms = log_time_ms;
+        }
+        log_index_add(&log_index, log_end, log_counter, log_time_ms, log_session_ms, record.type);
+        log_end += size;
+        log_counter++;
+    }
+    log_boot_ms = log_time_ms;
 }
 
-uint8_t i2cReadByte(uint16_t address) {
-    uint8_t buffer[2];
-    buffer[0] = address >> 8; buffer[1] = address;
-    i2c_write_blocking(i2c0, DEVADDR, buffer, 2, true);
-    i2c_read_blocking(i2c0, DEVADDR, buffer, 1, false);
-    return buffer[0];
+uint32_t logTimeNow() {
+    return log_boot_ms + to_ms_since_boot(get_absolute_time());
 }
 
-uint16_t crc16(const uint8_t *data_p, size_t length) {
-    uint8_t x;
-    uint16_t crc = 0xFFFF;
+/* Appends a record and the terminating zero. When the record does not fit the log is erased first, which restarts log
+ * time from zero at power up. */
+void writeLogRecord(uint8_t type, const uint8_t *payload, uint8_t length) {
+    uint8_t buffer[LOG_RECORD_MAX_SIZE + 1];
+    uint32_t now = logTimeNow();
+    log_record_t record = {.type = type, .length = length, .delta_ms = now - log_time_ms};
+    if (length > 0) {
+        memcpy(record.payload, payload, length);
+    }
 
-    while (length--) {
-        x = crc >> 8 ^ *data_p++;
-        x ^= x >> 4;
-        crc = (crc << 8) ^ ((uint16_t) (x << 12)) ^ ((uint16_t) (x << 5)) ^ ((uint16_t) (x));
+    size_t size = log_record_encode(&record, buffer);
+    if (log_end + size + 1 > LOG_AREA_SIZE) {
+        printf("Log area full. ");
+        eraseLog();
+        now = logTimeNow();
+        record.delta_ms = now - log_time_ms;
+        size = log_record_encode(&record, buffer);
     }
-    return crc;
+    buffer[size] = LOG_RECORD_END;
+    eeprom_write(&eeprom, log_end, buffer, size + 1);
+    if (LOG_TYPE_BOOT == type) {
+        log_session_ms = now;
+    }
+    log_index_add(&log_index, log_end, log_counter, now, log_session_ms, type);
+    log_end += size;
+    log_time_ms = now;
+    log_counter++;
 }
 
-void writeLogEntry(const char *message) {
-    if (log_counter >= MAX_LOG_ENTRY) {
-        printf("Maximum allowed log number reached. ");
-        eraseLog();
+/* Decodes the record at address; returns its size, or 0 at the end of the log. */
+uint16_t readLogRecord(uint16_t address, log_record_t *record) {
+    if (address >= LOG_AREA_SIZE) {
+        return 0;
     }
+    size_t available = LOG_AREA_SIZE - address;
+    if (available > LOG_RECORD_MAX_SIZE) {
+        available = LOG_RECORD_MAX_SIZE;
+    }
+    uint8_t buffer[LOG_RECORD_MAX_SIZE];
+    eeprom_read(&eeprom, address, buffer, available);
+    return log_record_decode(buffer, available, record);
+}
 
-    size_t message_length = strlen(message);
-    if (message_length >= 1) {
-        if (message_length > 61) {
-            message_length = 61;
+/* Visits the records of the blocks from block on that may match, and prints the matching ones after skipping the first
+ * skip of them. Returns the number of matching records. */
+uint queryLog(size_t block, uint32_t since_ms, int type, uint skip, bool print) {
+    log_record_t record;
+    char text[MAX_LOG_TEXT];
+    uint matches = 0;
+
+    for (; block < log_index.block_count; block++) {
+        const log_block_t *summary = &log_index.blocks[block];
+        if (true == log_index_skip(summary, since_ms, type)) {
+            continue;
         }
-
-        uint8_t buffer[message_length + 3];
-        memcpy(buffer, message, message_length);
-        buffer[message_length] = '\0';
-
-        uint16_t crc = crc16(buffer, message_length + 1);
-        buffer[message_length + 1] = (uint8_t) (crc >> 8);
-        buffer[message_length + 2] = (uint8_t) crc;
-
-        uint16_t log_address = MAX_LOG_SIZE * log_counter++;
-        for(int i = 0; i < (message_length + 3); i++) {
-            i2cWriteByte(log_address++, buffer[i]);
+        uint16_t address = summary->address, size;
+        uint number = summary->index;
+        uint32_t time = summary->first_ms, boot = summary->boot_ms;
+
+        while (address < log_end && address / LOG_INDEX_BLOCK_SIZE == block) {
+            if (0 == (size = readLogRecord(address, &record))) {
+                printf("Log message #%d invalid. Exit printing.\n", number + 1);
+                return matches;
+            }
+            if (address != summary->address) {
+                time += record.delta_ms;
+                if (LOG_TYPE_BOOT == record.type) {
+                    boot = time;
+                }
+            }
+            if (time >= since_ms && (type < 0 || type == record.type)) {
+                if (skip > 0) {
+                    skip--;
+                } else if (true == print) {
+                    log_record_render(&record, time - boot, text, sizeof(text));
+                    printf("Log #%d (%lus)\n", number + 1, (unsigned long) (time / 1000));
+                    printf("%s\n", text);
+                }
+                matches++;
+            }
+            address += size;
+            number++;
         }
-        //printLog();
-    } else {
-        printf("Invalid input. Log message must contain at least one character.\n");
     }
+    return matches;
 }
 
-void printLog() {
+/* last > 0 prints only the last matching records: the summary gives the block to start from, one pass over the blocks
+ * after it counts the matches and a second one prints. */
+void printLog(uint32_t since_ms, int type, uint32_t last) {
     if (0 != log_counter) {
-        uint16_t log_address = 0;
-        uint8_t buffer[MAX_LOG_SIZE];
+        size_t start = log_index_start(&log_index, since_ms, type, last);
+        uint skip = 0;
+        if (last > 0) {
+            uint total = queryLog(start, since_ms, type, 0, false);
+            skip = (total > last) ? total - last : 0;
+        }
 
         printf("Printing log messages from memory:\n");
-        for (int i = 0; i < log_counter; i++) {
-            log_address = i * MAX_LOG_SIZE;
-            for (int j = 0; j < MAX_LOG_SIZE; j++) {
-                buffer[j] = i2cReadByte(log_address++);
-            }
-            /*
-            for(int k = 0; k < MAX_LOG_SIZE/2; k += 4)
-            {
-                printf("%x %x %x %x\n", buffer[k+0], buffer[k+1], buffer[k+2], buffer[k+3]);
-            }
-            */
-            int term_zero_index = 0;
-            while (buffer[term_zero_index] != '\0') {
-                term_zero_index++;
-            }
-
-            if(0 == crc16(buffer, (term_zero_index + 3)) && buffer[0] != 0 && (term_zero_index < (MAX_LOG_SIZE - 2))) {
-                printf("Log #%d\n", i + 1);
-                int index = 0;
-                while (buffer[index]) {
-                    printf("%c", buffer[index++]);
-                }
-                printf("\n");
-            } else {
-                printf("Log message #%d invalid. Exit printing.\n", i + 1);
-                break;
-            }
+        if (0 == queryLog(start, since_ms, type, skip, true)) {
+            printf("No matching log message.\n");
         }
     } else {
         printf("No log message in memory yet.\n\n");
@@ -504,31 +606,237 @@ void printLog() {
 
 void eraseLog() {
     printf("Erasing log messages from memory... ");
-    uint16_t log_address = 0;
-    for(int i = 0; i < MAX_LOG_ENTRY; i++) {
-        i2cWriteByte(log_address, 0);
-        log_address += MAX_LOG_SIZE;
-    }
+    uint8_t end = LOG_RECORD_END;
+    eeprom_write(&eeprom, 0, &end, 1);
+    log_end = 0;
     log_counter = 0;
+    log_time_ms = 0;
+    log_boot_ms = 0;
+    log_session_ms = 0;
+    log_index_reset(&log_index);
     printf(" done.\n\n");
 }
 
+void commandCache(const cli_args_t *args) {
+    uint32_t total = eeprom.hits + eeprom.misses;
+    printf("EEPROM cache: %lu hits, %lu misses (%lu%% hit rate)\n", (unsigned long) eeprom.hits,
+           (unsigned long) eeprom.misses, (unsigned long) (total ? 100ull * eeprom.hits / total : 0));
+}
+
+void commandErase(const cli_args_t *args) {
+    eraseLog();
+}
+
+void commandI2c(const cli_args_t *args) {
+    eeprom_print_stats(&eeprom);
+    i2c_bus_print_stats(&i2c_bus);
+}
+
+void commandIdle(const cli_args_t *args) {
+    idle_print_stats();
+    idle_reset_stats();
+}
+
+void commandLora(const cli_args_t *args) {
+#if LORAWAN
+    lorawan_print_stats(&lorawan);
+    lora_tx_print_stats(&lora_tx, to_ms_since_boot(get_absolute_time()));
+    printf("Uplink batches: %lu state changes, %lu waiting, %lu dropped; %lu uplinks of %lu bytes\n",
+           (unsigned long) uplink.events, (unsigned long) uplink.count, (unsigned long) uplink.dropped,
+           (unsigned long) uplink.uplinks, (unsigned long) uplink.bytes);
+#else
+    printf("No LoRaWAN in this build (LORAWAN=1).\n");
+#endif
+}
+
+void commandProfile(const cli_args_t *args) {
+    profile_print();
+    profile_reset();
+}
+
+void commandRead(const cli_args_t *args) {
+    static const char *const type_names[] = {NULL, "boot", "state", "text"};
+    uint32_t since_s = 0, last = 0, number = 0;
+    int type = LOG_INDEX_ANY_TYPE;
+
+    for (int i = 0; i < args->argc; i++) {
+        const char *arg = args->argv[i].s;
+        const char *value = strchr(arg, '=');
+        bool valid = false;
+        if (NULL == value) {
+            // not an option
+        } else if (0 == strncmp("since=", arg, 6)) {
+            // seconds; the records are timed in ms
+            valid = cli_parse_unsigned(value + 1, &since_s) && since_s <= UINT32_MAX / 1000;
+        } else if (0 == strncmp("last=", arg, 5)) {
+            valid = cli_parse_unsigned(value + 1, &last);
+        } else if (0 == strncmp("type=", arg, 5)) {
+            value++;
+            for (type = LOG_TYPE_TEXT; type > 0 && 0 != strcmp(type_names[type], value); type--) {
+            }
+            if (0 == type) {
+                valid = cli_parse_unsigned(value, &number) && number <= INT32_MAX;
+                type = (int) number;
+            } else {
+                valid = true;
+            }
+        }
+        if (false == valid) {
+            printf("Usage: read [since=<s>] [type=boot|state|text] [last=<n>]\n");
+            return;
+        }
+    }
+    printLog(since_s * 1000, type, last);
+}
+
+void commandTrace(const cli_args_t *args) {
+    isr_trace_print();
+}
+
+uint8_t frameLedGet(const uint8_t *payload, size_t length, uint8_t *reply, size_t *reply_length) {
+    reply[0] = d1State | (d2State << 1) | (d3State << 2);
+    *reply_length = 1;
+    return PROTO_OK;
+}
+
+/* Same as pressing the buttons of the LEDs that change; the main loop updates the PWM levels. */
+uint8_t frameLedSet(const uint8_t *payload, size_t length, uint8_t *reply, size_t *reply_length) {
+    if (1 != length || payload[0] > 7) {
+        return PROTO_ERR_ARGS;
+    }
+    bool d1 = payload[0] & 1, d2 = payload[0] & 2, d3 = payload[0] & 4;
+    if (d1 != d1State) {
+        d1State = d1;
+        eeprom_write_byte(&eeprom, d1_address, d1State);
+    }
+    if (d2 != d2State) {
+        d2State = d2;
+        eeprom_write_byte(&eeprom, d2_address, d2State);
+    }
+    if (d3 != d3State) {
+        d3State = d3;
+        eeprom_write_byte(&eeprom, d3_address, d3State);
+    }
+    printState();
+    return PROTO_OK;
+}
+
+/* Renders record number index (u8 or u16) like read does, starting from the block that holds it. */
+uint8_t frameLogRead(const uint8_t *payload, size_t length, uint8_t *reply, size_t *reply_length) {
+    log_record_t record;
+    char text[MAX_LOG_TEXT];
+    uint number = (2 == length) ? (payload[0] << 8) | payload[1] : payload[0];
+
+    if ((1 != length && 2 != length) || number >= log_counter) {
+        return PROTO_ERR_ARGS;
+    }
+    size_t block = log_index_find(&log_index, number);
+    if (block >= log_index.block_count) {
+        return PROTO_ERR_FAILED;
+    }
+    const log_block_t *summary = &log_index.blocks[block];
+    uint16_t address = summary->address, size;
+    uint32_t time = summary->first_ms, boot = summary->boot_ms;
+    for (uint index = summary->index; ; index++) {
+        if (0 == (size = readLogRecord(address, &record))) {
+            return PROTO_ERR_FAILED;
+        }
+        if (address != summary->address) {
+            time += record.delta_ms;
+            if (LOG_TYPE_BOOT == record.type) {
+                boot = time;
+            }
+        }
+        if (index == number) {
+            break;
+        }
+        address += size;
+    }
+    int text_length = log_record_render(&record, time - boot, text, sizeof(text));
+    *reply_length = (text_length < (int) sizeof(text)) ? text_length : sizeof(text) - 1;
+    memcpy(reply, text, *reply_length);
+    return PROTO_OK;
+}
+
+uint8_t frameEepromRead(const uint8_t *payload, size_t length, uint8_t *reply, size_t *reply_length) {
+    if (3 != length || payload[2] > PROTO_MAX_PAYLOAD) {
+        return PROTO_ERR_ARGS;
+    }
+    uint16_t address = (payload[0] << 8) | payload[1];
+    if (address + payload[2] > I2C_MEMORY_SIZE) {
+        return PROTO_ERR_ARGS;
+    }
+    eeprom_read(&eeprom, address, reply, payload[2]);
+    *reply_length = payload[2];
+    return PROTO_OK;
+}
+
+/* State changes go out as uplinks in a build with LORAWAN=1, the functions below do nothing otherwise. */
+void uplinkInit() {
+#if LORAWAN
+    lorawan_init(&lorawan, LORA_UART_NR, LORA_TX_PIN, LORA_RX_PIN, LORA_APP_KEY, LORA_PORT);
+    lorawan_on_refused(&lorawan, uplinkRefused, &lora_tx);
+    lora_tx_init(&lora_tx, LORA_SF, sendUplink, &lorawan);
+    lora_tx_add_band(&lora_tx, LORA_DUTY_PERMILLE, to_ms_since_boot(get_absolute_time()));
+    uplink_init(&uplink, UPLINK_STATE_BITS, UPLINK_MAX_PAYLOAD, UPLINK_DEADLINE_MS, queueUplink, &lora_tx);
+#endif
+}
+
+void uplinkPoll() {
+#if LORAWAN
+    uint32_t now_ms = to_ms_since_boot(get_absolute_time());
+    lorawan_poll(&lorawan);
+    lora_tx_poll(&lora_tx, now_ms);
+    uplink_poll(&uplink, now_ms);
+#endif
+}
+
+void uplinkState(uint8_t state) {
+#if LORAWAN
+    uplink_add(&uplink, to_ms_since_boot(get_absolute_time()), state);
+#endif
+}
+
+bool queueUplink(void *context, const uint8_t *payload, size_t length) {
+#if LORAWAN
+    return lora_tx_enqueue(context, to_ms_since_boot(get_absolute_time()), LORA_TX_NORMAL, 0, payload, length);
+#else
+    return false;
+#endif
+}
+
+/* All channels of the module are in the one band. */
+bool sendUplink(void *context, uint8_t band, const uint8_t *payload, size_t length) {
+#if LORAWAN
+    return lorawan_send(context, payload, length);
+#else
+    return false;
+#endif
+}
+
+/* A batch the module did not send goes back into the queue in its place. */
+void uplinkRefused(void *context) {
+#if LORAWAN
+    lora_tx_refused(context);
+#endif
+}
+
 void eraseAll(){
     printf("Erasing all from memory... ");
     uint16_t log_address = 0;
-    for(int i = 0; i < MAX_LOG_SIZE * MAX_LOG_ENTRY; i++) {
-        i2cWriteByte(log_address, 0xFF);
+    for(int i = 0; i < LOG_AREA_SIZE; i++) {
+        eeprom_write_byte(&eeprom, log_address, 0xFF);
         log_address++;
     }
-    log_counter = 0;
+    scanLog();
     printf(" done.\n");
 }
 
 void printAllMemory() {
     printf("\n");
-    for (int i = 0; i < MAX_LOG_ENTRY; i++) {
-        for (int j = 0; j < MAX_LOG_SIZE; j++) {
-            uint8_t printed = i2cReadByte(i * MAX_LOG_SIZE + j);
+    for (int i = 0; i < LOG_AREA_SIZE / EEPROM_PAGE_SIZE; i++) {
+        for (int j = 0; j < EEPROM_PAGE_SIZE; j++) {
+            uint8_t printed = eeprom_read_byte(&eeprom, i * EEPROM_PAGE_SIZE + j);
             printf("%x ", printed);
         }
         printf("\n");
@@ -13,112 +13,196 @@ Implement a program that reads commands from standard input. The commands to imp
               per revolution three times and take the average of the values.
     • run N – N is an integer that may be omitted. Runs the motor N times 1/8th of a revolution. If N is omitted run one
       full revolution. “Run 8” should also run one full revolution.
+    • goto N – N is 0-7. Runs the motor forward to absolute position N/8 of a revolution from the opto fork.
+    • stop – stops the current move.
+    • i2c – prints the EEPROM bus speed and transaction statistics.
+    • idle – prints how busy core 0 has been and how often it woke up since the last idle.
+    • trace – prints the latency and duration of the interrupt handlers in a build with ISR_TRACE=1 (common/isr_trace.h):
+      the soft timer on core 0, the step timer and the opto fork edge on core 1.
+    • profile – prints, and then clears, the time the core 0 loop spent in each of its stages in a build with PROFILE=1
+      (common/profile.h). PROTO_PROFILE_READ returns the same over the binary protocol.
+
+Move targets are kept in 1/8 revolutions and converted to steps from the absolute target, so the fraction lost by
+one move is carried into the next and any sequence of moves lands exactly on calibrated step positions.
+
+The motor runs on core 1 (see motor.c): step generation, opto fork handling and stall detection. Core 0 only runs this
+command line and the EEPROM, and talks to core 1 through the SIO FIFO, so a slow USB or I2C transfer never delays a
+step. Commands return immediately; the state is written to the EEPROM once the move or the calibration has finished.
+Between commands and motor status polls core 0 sleeps in common/idle.h.
+
+Once calibrated, the opto fork falling edge is expected after exactly the calibrated number of steps. An edge more than
+STALL_TOLERANCE steps early, or no edge by STALL_TOLERANCE steps late, means the motor skipped or stalled: the error
+counter shown by status is incremented and the motor is re-homed to the opto fork before it returns to the target
+position.
+
+Calibration and position are stored in the EEPROM after every move that changed them. The record (steps per revolution,
+current phase row and position since the opto fork) is validated with the same CRC as the Exercise 4 log and written to
+the last eight pages in turn, the newest found by its sequence number. When a valid record is found at boot the position
+is restored and calibration is skipped; otherwise a calibration is run before the prompt is ready. In the host twin
+(host/scripts/exercise5_boot_*.sim) the boot is ready in 7 ms with a record and in 24602 ms without one.
 */
 
 #include <stdio.h>
 #include <string.h>
 #include "pico/stdlib.h"
 #include "pico/time.h"
-#include "hardware/irq.h"
+#include "hardware/i2c.h"
 #include "hardware/gpio.h"
 
+#include "cli.h"
+#include "crc16.h"
+#include "dlog.h"
+#include "eeprom.h"
+#include "i2c_bus.h"
+#include "idle.h"
+#include "isr_trace.h"
+#include "motor.h"
+#include "position.h"
+#include "profile.h"
+#include "proto.h"
+#include "ram_func.h"
+#include "soft_timer.h"
+
 /////////////////////////////////////////////////////
 //                      MACROS                     //
 /////////////////////////////////////////////////////
 /*  STEP MOTOR  */
-#define IN1 13
-#define IN2 6
-#define IN3 3
-#define IN4 2
-#define OPTOFORK 28
-#define STEPS_PER_REVOLUTION 4096
+#define VERIFY_MAX_STEPS (4096 / 8) // boot verification only if the opto fork is this close
+#define STATUS_POLL_MS 20
+#define DLOG_DRAIN_PER_LOOP 2
+
+/*   I2C   */
+#define I2C0_SDA_PIN 16
+#define I2C0_SCL_PIN 17
+#define DEVADDR 0x50
+#define BAUDRATE 100000
+#define I2C_MAX_BAUDRATE 1000000 // probed down to 400 kHz or 100 kHz if the EEPROM does not keep up
+#define STEPPER_RECORD_SLOTS 8 // a page each at the end of the EEPROM, written in turn
+#define STEPPER_RECORD_ADDRESS (EEPROM_SIZE - STEPPER_RECORD_SLOTS * EEPROM_PAGE_SIZE)
+#define STEPPER_RECORD_SIZE 9
 
 /////////////////////////////////////////////////////
 //             FUNCTION DECLARATIONS               //
 /////////////////////////////////////////////////////
-void stepperMotorInit();
-void optoforkInit();
-void optoFallingEdge();
-void runMotor(const uint times);
+void commandCalib(const cli_args_t *args);
+void commandGoto(const cli_args_t *args);
+void commandI2c(const cli_args_t *args);
+void commandIdle(const cli_args_t *args);
+void commandProfile(const cli_args_t *args);
+void commandRun(const cli_args_t *args);
+void commandStatus(const cli_args_t *args);
+void commandStop(const cli_args_t *args);
+void commandTrace(const cli_args_t *args);
+uint8_t frameMotorMove(const uint8_t *payload, size_t length, uint8_t *reply, size_t *reply_length);
+uint8_t frameMotorGoto(const uint8_t *payload, size_t length, uint8_t *reply, size_t *reply_length);
+uint8_t frameMotorStatus(const uint8_t *payload, size_t length, uint8_t *reply, size_t *reply_length);
+uint32_t maxEighths();
+uint8_t moveEighths(uint32_t eighths);
+uint8_t gotoEighth(uint eighth);
+void i2cInit();
+void saveStepperState();
+bool validStepperRecord(const uint8_t *record);
+bool loadStepperState();
+void verifyPosition();
+void startPolling();
+void pollMotor();
+void pollTimerCallback(soft_timer_t *timer, void *context);
 
 /////////////////////////////////////////////////////
 //                GLOBAL VARIABLES                 //
 /////////////////////////////////////////////////////
-static const uint turning_sequence[8][4] = {{1, 0, 0, 0},
-                                            {1, 1, 0, 0},
-                                            {0, 1, 0, 0},
-                                            {0, 1, 1, 0},
-                                            {0, 0, 1, 0},
-                                            {0, 0, 1, 1},
-                                            {0, 0, 0, 1},
-                                            {1, 0, 0, 1}};
-static volatile bool fallingEdge = false;
-static volatile bool calibrated = false;
-static volatile uint revolution_counter = 0;
-static uint calibration_count = 0;
-static volatile uint row = 0;
+/* Sorted by name */
+static const cli_command_t commands[] = {
+        {"calib",   "",   commandCalib},
+        {"goto",    "u",  commandGoto},
+        {"i2c",     "",   commandI2c},
+        {"idle",    "",   commandIdle},
+        {"profile", "",   commandProfile},
+        {"run",     "u?", commandRun},
+        {"status",  "",   commandStatus},
+        {"stop",    "",   commandStop},
+        {"trace",   "",   commandTrace},
+};
+
+static const proto_command_t frame_commands[] = {
+        {PROTO_MOTOR_MOVE,   frameMotorMove},
+        {PROTO_MOTOR_GOTO,   frameMotorGoto},
+        {PROTO_MOTOR_STATUS, frameMotorStatus},
+        {PROTO_PROFILE_READ, profile_frame_read},
+};
+
+static motor_status_t status;
+static uint target_eighths = 0; // target position in 1/8 revolutions from the opto fork, 0-7
+static bool save_pending = false;
+static bool calibration_pending = false;
+static uint reported_errors = 0;
+static uint8_t stored_record[STEPPER_RECORD_SIZE]; // the newest in the EEPROM
+static bool record_stored = false;
+static uint record_slot = STEPPER_RECORD_SLOTS - 1;
+static volatile bool poll_due = false;
+static soft_timer_t poll_timer; // runs while a move is in progress
+static i2c_bus_t i2c_bus;
+static eeprom_t eeprom;
+static eeprom_line_t eeprom_lines[EEPROM_CACHE_PAGES];
+
+/* Main loop stages (common/profile.h) */
+PROFILE_ZONE(loop_zone, "loop");
+PROFILE_ZONE(poll_zone, "motor poll");
+PROFILE_ZONE(cli_zone, "cli");
+PROFILE_ZONE(dlog_zone, "dlog");
+PROFILE_ZONE(state_zone, "state write");
 
 /////////////////////////////////////////////////////
 //                     MAIN                        //
 /////////////////////////////////////////////////////
 int main() {
 
+    idle_init();
     stdio_init_all();
 
-    stepperMotorInit();
-    optoforkInit();
+    soft_timer_init();
 
-    gpio_set_irq_enabled_with_callback(OPTOFORK, GPIO_IRQ_EDGE_FALL, true, optoFallingEdge);
+    i2cInit();
 
-    char command[8];
-    memset(command, 0, sizeof(command));
-    char character;
-    int index = 0;
+    motor_start();
+
+    if (true == loadStepperState()) {
+        verifyPosition();
+        printf("Restored position %u / %u from EEPROM.\n", status.position, status.steps_per_revolution);
+    } else {
+        // before the prompt: nothing else to do while core 1 calibrates
+        commandCalib(NULL);
+        motor_wait_idle(&status);
+        pollMotor();
+    }
+    printf("Ready in %llu ms.\n", (unsigned long long) (time_us_64() / 1000));
+
+    cli_t cli;
+    cli_init(&cli, commands, sizeof(commands) / sizeof(commands[0]));
+    proto_t proto;
+    proto_init(&proto, frame_commands, sizeof(frame_commands) / sizeof(frame_commands[0]));
+    cli_set_frame_sink(&cli, proto_feed, &proto);
 
     while (true) {
+        PROFILE_BEGIN(loop_zone);
 
-        character = getchar_timeout_us(0);
-        while (character != 255) {
-            command[index++] = character;
-
-            if (index == 7 || character == '\n') {
-                command[index - 1] = '\0';
-
-                if (0 == strncmp("run", command, strlen("run"))) {
-                    uint N_times = 8;
-                    if (strlen(command) >= 5) {
-                        sscanf(&command[strlen("run")], "%u", &N_times);
-                    }
-                    if (true == calibrated) {
-                        runMotor(N_times * calibration_count / 8);
-                    } else {
-                        runMotor(N_times * STEPS_PER_REVOLUTION / 8);
-                    }
-                } else if (0 == strcmp("status", command)) {
-                    if (true == calibrated) {
-                        printf("Position: %u / %u \n", revolution_counter, calibration_count);
-                    } else {
-                        printf("Not available.\n");
-                    }
-                } else if (0 == strcmp("calib", command)) {
-                    calibrated = false;
-                    fallingEdge = false;
-                    while (false == fallingEdge) {
-                        runMotor(1);
-                    }
-                    fallingEdge = false;
-                    while (false == fallingEdge) {
-                        runMotor(1);
-                    }
-                    calibrated = true;
-                    printf("Number of steps per revolution: %u\n", calibration_count);
-                }
-
-                memset(command, 0, sizeof(command));
-                index = 0;
-                break;
-            }
-            character = getchar_timeout_us(0);
+        if (true == poll_due) {
+            poll_due = false;
+            PROFILE_BEGIN(poll_zone);
+            pollMotor();
+            PROFILE_END(poll_zone);
+        }
+
+        PROFILE_BEGIN(cli_zone);
+        cli_poll(&cli);
+        PROFILE_END(cli_zone);
+        PROFILE_BEGIN(dlog_zone);
+        int drained = dlog_drain(DLOG_DRAIN_PER_LOOP);
+        PROFILE_END(dlog_zone);
+
+        PROFILE_END(loop_zone);
+        if (drained < DLOG_DRAIN_PER_LOOP) {
+            idle_wait();
         }
     }
     return 0;
@@ -127,41 +211,266 @@ int main() {
 /////////////////////////////////////////////////////
 //                   FUNCTIONS                     //
 /////////////////////////////////////////////////////
-void stepperMotorInit() {
-    gpio_init(IN1);
-    gpio_set_dir(IN1, GPIO_OUT);
-    gpio_init(IN2);
-    gpio_set_dir(IN2, GPIO_OUT);
-    gpio_init(IN3);
-    gpio_set_dir(IN3, GPIO_OUT);
-    gpio_init(IN4);
-    gpio_set_dir(IN4, GPIO_OUT);
-}
-
-void optoforkInit() {
-    gpio_init(OPTOFORK);
-    gpio_set_dir(OPTOFORK, GPIO_IN);
-    gpio_pull_up(OPTOFORK);
-}
-
-void optoFallingEdge() {
-    fallingEdge = true;
-    if (false == calibrated) {
-        calibration_count = revolution_counter;
-    }
-    revolution_counter = 0;
-}
-
-void runMotor(const uint times) {
-    for(int i  = 0; i < times; i++) {
-        gpio_put(IN1, turning_sequence[row][0]);
-        gpio_put(IN2, turning_sequence[row][1]);
-        gpio_put(IN3, turning_sequence[row][2]);
-        gpio_put(IN4, turning_sequence[row++][3]);
-        revolution_counter++;
-        if (row >= 8) {
-            row = 0;
+
+/* Finished by pollMotor, like a move. */
+void commandCalib(const cli_args_t *args) {
+    motor_calibrate();
+    calibration_pending = true;
+    startPolling();
+}
+
+void commandGoto(const cli_args_t *args) {
+    uint eighth = args->argv[0].u;
+    motor_query(&status);
+    if (eighth >= POSITIONS_PER_REVOLUTION) {
+        printf("Position must be 0-%d.\n", POSITIONS_PER_REVOLUTION - 1);
+    } else if (false == status.calibrated) {
+        printf("Not available.\n");
+    } else if (PROTO_OK != gotoEighth(eighth)) {
+        printf("Motor busy.\n");
+    }
+}
+
+void commandI2c(const cli_args_t *args) {
+    eeprom_print_stats(&eeprom);
+    i2c_bus_print_stats(&i2c_bus);
+}
+
+void commandIdle(const cli_args_t *args) {
+    idle_print_stats();
+    idle_reset_stats();
+}
+
+void commandProfile(const cli_args_t *args) {
+    profile_print();
+    profile_reset();
+}
+
+void commandRun(const cli_args_t *args) {
+    uint N_times = (args->argc > 0) ? args->argv[0].u : POSITIONS_PER_REVOLUTION;
+    uint8_t result = moveEighths(N_times);
+    if (PROTO_ERR_ARGS == result) {
+        printf("N must be 0-%lu.\n", (unsigned long) maxEighths());
+    } else if (PROTO_ERR_BUSY == result) {
+        printf("Motor busy.\n");
+    }
+}
+
+void commandStatus(const cli_args_t *args) {
+    motor_query(&status);
+    if (true == status.calibrated) {
+        printf("Position: %u / %u (%u/8)\n", status.position, status.steps_per_revolution, target_eighths);
+    } else {
+        printf("Not available.\n");
+    }
+    printf("Errors: %u\n", status.errors);
+    printf("Step jitter: avg %u us, max %u us\n", status.avg_jitter_us, status.max_jitter_us);
+}
+
+/* Core 1 stops as it takes the command, so the query behind it in the FIFO already sees the motor idle. A calibration
+ * stopped half way leaves the motor not calibrated, and then nothing is saved. */
+void commandStop(const cli_args_t *args) {
+    motor_stop();
+    motor_query(&status);
+    save_pending = false;
+    calibration_pending = false;
+    soft_timer_cancel(&poll_timer);
+    target_eighths = status.position * POSITIONS_PER_REVOLUTION / status.steps_per_revolution;
+    saveStepperState();
+}
+
+void commandTrace(const cli_args_t *args) {
+    isr_trace_print();
+}
+
+uint8_t frameMotorMove(const uint8_t *payload, size_t length, uint8_t *reply, size_t *reply_length) {
+    if (4 != length) {
+        return PROTO_ERR_ARGS;
+    }
+    uint32_t eighths = ((uint32_t) payload[0] << 24) | (payload[1] << 16) | (payload[2] << 8) | payload[3];
+    return moveEighths(eighths);
+}
+
+uint8_t frameMotorGoto(const uint8_t *payload, size_t length, uint8_t *reply, size_t *reply_length) {
+    if (1 != length || payload[0] >= POSITIONS_PER_REVOLUTION) {
+        return PROTO_ERR_ARGS;
+    }
+    motor_query(&status);
+    if (false == status.calibrated) {
+        return PROTO_ERR_FAILED;
+    }
+    return gotoEighth(payload[0]);
+}
+
+static size_t putU32(uint8_t *buffer, uint32_t value) {
+    buffer[0] = value >> 24; buffer[1] = value >> 16; buffer[2] = value >> 8; buffer[3] = value;
+    return 4;
+}
+
+uint8_t frameMotorStatus(const uint8_t *payload, size_t length, uint8_t *reply, size_t *reply_length) {
+    motor_query(&status);
+    reply[0] = status.calibrated;
+    reply[1] = status.busy;
+    size_t index = 2;
+    index += putU32(&reply[index], status.position);
+    index += putU32(&reply[index], status.steps_per_revolution);
+    index += putU32(&reply[index], status.errors);
+    *reply_length = index;
+    return PROTO_OK;
+}
+
+/* The longest move: its steps, the fraction of a revolution to the target included, must fit the MOTOR_ARG_MASK bits a
+ * move command to core 1 takes. This also keeps target_eighths + eighths from wrapping. */
+uint32_t maxEighths() {
+    return (MOTOR_ARG_MASK / status.steps_per_revolution - 1) * POSITIONS_PER_REVOLUTION;
+}
+
+/* Counted from where the motor actually is (position.h). Returns PROTO_ERR_BUSY if the motor is still busy and
+ * PROTO_ERR_ARGS for a move longer than maxEighths(). */
+uint8_t moveEighths(uint32_t eighths) {
+    motor_query(&status);
+    if (eighths > maxEighths()) {
+        return PROTO_ERR_ARGS;
+    }
+    if (true == status.busy) {
+        return PROTO_ERR_BUSY;
+    }
+    uint32_t steps = position_steps_to(status.steps_per_revolution, status.position, target_eighths + eighths);
+
+    target_eighths = (target_eighths + eighths) % POSITIONS_PER_REVOLUTION;
+    motor_move(steps);
+    startPolling();
+    return PROTO_OK;
+}
+
+// The caller checks that the motor is calibrated.
+uint8_t gotoEighth(uint eighth) {
+    return moveEighths((eighth + POSITIONS_PER_REVOLUTION - target_eighths) % POSITIONS_PER_REVOLUTION);
+}
+
+void startPolling() {
+    save_pending = true;
+    soft_timer_start(&poll_timer, STATUS_POLL_MS, STATUS_POLL_MS, pollTimerCallback, NULL);
+}
+
+/* Saves the state once a move or the calibration has finished and reports re-homing done by core 1. */
+void pollMotor() {
+    if (false == save_pending) {
+        return;
+    }
+    motor_query(&status);
+    if (status.errors != reported_errors) {
+        DLOG("Missed steps detected, re-homed (%u errors).\n", status.errors);
+        reported_errors = status.errors;
+    }
+    if (false == status.busy) {
+        if (true == calibration_pending) {
+            calibration_pending = false;
+            target_eighths = 0;
+            printf("Number of steps per revolution: %u\n", status.steps_per_revolution);
+        } else if (false == status.calibrated) {
+            DLOG("Motor stalled. Run calib.\n");
+        }
+        saveStepperState();
+        save_pending = false;
+        soft_timer_cancel(&poll_timer);
+    }
+}
+
+void RAM_FUNC(pollTimerCallback)(soft_timer_t *timer, void *context) {
+    poll_due = true;
+}
+
+void i2cInit() {
+    i2c_init(i2c0, BAUDRATE);
+    gpio_set_function(I2C0_SDA_PIN, GPIO_FUNC_I2C);
+    gpio_set_function(I2C0_SCL_PIN, GPIO_FUNC_I2C);
+    i2c_bus_init(&i2c_bus, i2c0);
+    eeprom_init(&eeprom, i2c0, DEVADDR, eeprom_lines, EEPROM_CACHE_PAGES);
+    eeprom_use_bus(&eeprom, &i2c_bus);
+    eeprom_probe(&eeprom, I2C_MAX_BAUDRATE);
+}
+
+/* Record layout: sequence number (2), steps per revolution (2), row (1), position (2), CRC (2). Multibyte values MSB
+ * first. A record that changed goes to the next of the STEPPER_RECORD_SLOTS pages with the next sequence number, so the
+ * writes after every move spread over the pages instead of wearing out one; an unchanged one is not written. */
+void saveStepperState() {
+    motor_query(&status);
+    if (false == status.calibrated) {
+        return;
+    }
+    uint8_t buffer[STEPPER_RECORD_SIZE];
+    buffer[2] = (uint8_t) (status.steps_per_revolution >> 8);
+    buffer[3] = (uint8_t) status.steps_per_revolution;
+    buffer[4] = (uint8_t) status.row;
+    buffer[5] = (uint8_t) (status.position >> 8);
+    buffer[6] = (uint8_t) status.position;
+    if (true == record_stored && 0 == memcmp(&buffer[2], &stored_record[2], 5)) {
+        return;
+    }
+
+    uint16_t sequence = (uint16_t) (((stored_record[0] << 8) | stored_record[1]) + 1);
+    buffer[0] = (uint8_t) (sequence >> 8);
+    buffer[1] = (uint8_t) sequence;
+    uint16_t crc = crc16(buffer, STEPPER_RECORD_SIZE - 2);
+    buffer[7] = (uint8_t) (crc >> 8);
+    buffer[8] = (uint8_t) crc;
+
+    record_slot = (record_slot + 1) % STEPPER_RECORD_SLOTS;
+    PROFILE_BEGIN(state_zone);
+    eeprom_write(&eeprom, STEPPER_RECORD_ADDRESS + record_slot * EEPROM_PAGE_SIZE, buffer, STEPPER_RECORD_SIZE);
+    PROFILE_END(state_zone);
+    memcpy(stored_record, buffer, STEPPER_RECORD_SIZE);
+    record_stored = true;
+}
+
+bool validStepperRecord(const uint8_t *record) {
+    uint count = (record[2] << 8) | record[3];
+    uint position = (record[5] << 8) | record[6];
+    return 0 == crc16(record, STEPPER_RECORD_SIZE) && 0 != count && record[4] < 8 && position <= count;
+}
+
+/* The valid record with the highest sequence number; they are never more than STEPPER_RECORD_SLOTS apart, so the
+ * comparison survives the wrap of the number. */
+bool loadStepperState() {
+    for (uint slot = 0; slot < STEPPER_RECORD_SLOTS; slot++) {
+        uint8_t buffer[STEPPER_RECORD_SIZE];
+        eeprom_read(&eeprom, STEPPER_RECORD_ADDRESS + slot * EEPROM_PAGE_SIZE, buffer, STEPPER_RECORD_SIZE);
+        int16_t newer = (int16_t) (((buffer[0] << 8) | buffer[1]) - ((stored_record[0] << 8) | stored_record[1]));
+        if (true == validStepperRecord(buffer) && (false == record_stored || newer > 0)) {
+            memcpy(stored_record, buffer, STEPPER_RECORD_SIZE);
+            record_stored = true;
+            record_slot = slot;
         }
-        sleep_ms(4);
     }
+    if (false == record_stored) {
+        return false;
+    }
+
+    uint count = (stored_record[2] << 8) | stored_record[3];
+    uint position = (stored_record[5] << 8) | stored_record[6];
+    motor_restore(count, stored_record[4], position);
+    motor_query(&status);
+    target_eighths = (position * POSITIONS_PER_REVOLUTION + count - 1) / count % POSITIONS_PER_REVOLUTION;
+    reported_errors = status.errors;
+    return true;
+}
+
+/* If the opto fork is only a short move away, run to it. Core 1 checks that the falling edge comes where the restored
+ * position predicts and re-homes if it does not. Further away the record is trusted as is, so boot never costs more
+ * than 1/8 revolution. */
+void verifyPosition() {
+    uint remaining = status.steps_per_revolution - status.position;
+    if (remaining > VERIFY_MAX_STEPS) {
+        return;
+    }
+
+    motor_move(remaining);
+    motor_wait_idle(&status);
+    if (status.errors != reported_errors) {
+        printf("Stored position was off, re-homed.\n");
+        reported_errors = status.errors;
+    }
+    target_eighths = 0;
+    saveStepperState();
 }
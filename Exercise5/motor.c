@@ -0,0 +1,283 @@
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "hardware/gpio.h"
+#include "hardware/sync.h"
+
+#include "isr_trace.h"
+#include "motor.h"
+#include "ram_func.h"
+#include "stepper.h"
+#include "planner.h"
+
+/*  STEP MOTOR  */
+#define IN1 13
+#define IN2 6
+#define IN3 3
+#define IN4 2
+#define OPTOFORK 28
+#define STEPS_PER_REVOLUTION 4096
+#define STEP_PERIOD_US 4000
+#define STALL_TOLERANCE 16
+#define STEP_ALARM_NUM 2 // the default alarm pool on core 0 uses alarm 3
+#define QUERY_REPLY_WORDS 6
+
+enum motor_state {
+    MOTOR_IDLE,
+    MOTOR_MOVING,
+    MOTOR_HOMING,
+    MOTOR_CALIB_SEEK,
+    MOTOR_CALIB_COUNT
+};
+
+static void optoforkInit();
+static void optoFallingEdge(uint gpio, uint32_t events);
+static bool stepTimerCallback(struct repeating_timer *t);
+static int handleCommand(uint32_t word, uint32_t second, uint32_t reply[QUERY_REPLY_WORDS]);
+static void startMove(uint32_t steps);
+static uint32_t stepsFromEdge(int64_t left);
+static void afterStep();
+
+/* Owned by core 1: the command loop (with interrupts disabled while it changes the state), the step timer and the opto
+ * fork interrupt. */
+static stepper_t motor;
+static planner_t planner;
+static enum motor_state state = MOTOR_IDLE;
+static volatile bool calibrated = false;
+static volatile bool edge_seen = false;
+static volatile uint32_t edge_position = 0;
+static uint32_t steps_per_revolution = STEPS_PER_REVOLUTION;
+static uint32_t goal = 0;
+static int64_t homing_left = 0; // steps of the move a stall interrupted, counted from the edge the homing run finds
+static uint64_t next_tick = 0;
+static uint32_t errors = 0;
+static uint32_t max_jitter_us = 0;
+static uint64_t jitter_sum_us = 0;
+static uint32_t jitter_samples = 0;
+
+ISR_TRACE_SITE(step_trace, "step_timer");
+ISR_TRACE_SITE(opto_trace, "opto_fork");
+
+/////////////////////////////////////////////////////
+//                    CORE 1                       //
+/////////////////////////////////////////////////////
+
+/* Steps come from a repeating timer whose alarm pool is created here, so its interrupt runs on core 1. The timer
+ * repeats on absolute deadlines; the lateness of each step is kept as the jitter statistic. The loop only waits for
+ * commands from core 0. The FIFO calls block until core 0 sends or drains, so they run with interrupts enabled and only
+ * the command itself does not. */
+void motor_core1_entry(void) {
+    isr_trace_init();
+    stepper_init(&motor, IN1, IN2, IN3, IN4);
+    planner_init(&planner);
+    planner_add_axis(&planner, &motor);
+    optoforkInit();
+    gpio_set_irq_enabled_with_callback(OPTOFORK, GPIO_IRQ_EDGE_FALL, true, optoFallingEdge);
+
+    struct repeating_timer timer;
+    alarm_pool_t *pool = alarm_pool_create(STEP_ALARM_NUM, 1);
+    next_tick = time_us_64() + STEP_PERIOD_US;
+    alarm_pool_add_repeating_timer_us(pool, -STEP_PERIOD_US, stepTimerCallback, NULL, &timer);
+
+    while (true) {
+        if (!multicore_fifo_rvalid()) {
+            isr_trace_poll();
+            __wfe();
+            continue;
+        }
+        uint32_t word = multicore_fifo_pop_blocking();
+        uint32_t second = (MOTOR_CMD_RESTORE == word >> MOTOR_CMD_SHIFT) ? multicore_fifo_pop_blocking() : 0;
+        uint32_t reply[QUERY_REPLY_WORDS];
+        uint32_t irq_state = save_and_disable_interrupts();
+        int reply_words = handleCommand(word, second, reply);
+        restore_interrupts(irq_state);
+        for (int i = 0; i < reply_words; i++) {
+            multicore_fifo_push_blocking(reply[i]);
+        }
+    }
+}
+
+static bool RAM_FUNC(stepTimerCallback)(struct repeating_timer *t) {
+    ISR_TRACE_ENTER_DUE(step_trace, next_tick);
+    uint64_t now = time_us_64();
+    uint32_t jitter = (now > next_tick) ? (uint32_t) (now - next_tick) : 0;
+    next_tick += STEP_PERIOD_US;
+
+    if (MOTOR_IDLE != state) {
+        if (jitter > max_jitter_us) {
+            max_jitter_us = jitter;
+        }
+        jitter_sum_us += jitter;
+        jitter_samples++;
+
+        planner_tick(&planner);
+        afterStep();
+    }
+    ISR_TRACE_EXIT(step_trace);
+    return true;
+}
+
+static void optoforkInit() {
+    gpio_init(OPTOFORK);
+    gpio_set_dir(OPTOFORK, GPIO_IN);
+    gpio_pull_up(OPTOFORK);
+}
+
+/* The edge is the reference of the position. A recovery move starts here rather than at the next tick, which would
+ * already have taken one more step counted from the edge: an early edge while moving (the shaft skipped ahead) and the
+ * edge a homing run looks for both continue to the goal of the interrupted move at once, whole revolutions still left
+ * included. After an early edge the shaft is steps_per_revolution - edge_position steps further than counted. */
+static void RAM_FUNC(optoFallingEdge)(uint gpio, uint32_t events) {
+    ISR_TRACE_ENTER(opto_trace);
+    edge_position = motor.position;
+    bool early = true == calibrated && MOTOR_MOVING == state && motor.position + STALL_TOLERANCE < steps_per_revolution;
+    motor.position = 0;
+    edge_seen = true;
+    if (true == early) {
+        errors++;
+        startMove(stepsFromEdge((int64_t) planner.ticks_left + edge_position - steps_per_revolution));
+    } else if (MOTOR_HOMING == state) {
+        startMove(stepsFromEdge(homing_left));
+    }
+    ISR_TRACE_EXIT(opto_trace);
+}
+
+/* second is the word that follows MOTOR_CMD_RESTORE. Returns the number of words in reply for core 0. */
+static int handleCommand(uint32_t word, uint32_t second, uint32_t reply[QUERY_REPLY_WORDS]) {
+    uint32_t arg = word & MOTOR_ARG_MASK;
+
+    switch (word >> MOTOR_CMD_SHIFT) {
+        case MOTOR_CMD_MOVE:
+            goal = (motor.position + arg) % steps_per_revolution;
+            startMove(arg);
+            break;
+        case MOTOR_CMD_STOP:
+            planner_stop(&planner);
+            state = MOTOR_IDLE;
+            break;
+        case MOTOR_CMD_CALIB:
+            calibrated = false;
+            edge_seen = false;
+            planner_move(&planner, (uint32_t[]) {PLANNER_MAX_STEPS});
+            state = MOTOR_CALIB_SEEK;
+            break;
+        case MOTOR_CMD_RESTORE:
+            steps_per_revolution = arg;
+            motor.row = (second >> 16) & 7;
+            motor.position = second & 0xFFFF;
+            calibrated = true;
+            break;
+        case MOTOR_CMD_QUERY:
+            reply[0] = (calibrated ? 1 : 0) | ((MOTOR_IDLE != state) ? 2 : 0) | (motor.row << 8);
+            reply[1] = motor.position;
+            reply[2] = steps_per_revolution;
+            reply[3] = errors;
+            reply[4] = max_jitter_us;
+            reply[5] = jitter_samples ? (uint32_t) (jitter_sum_us / jitter_samples) : 0;
+            return QUERY_REPLY_WORDS;
+        default:
+            break;
+    }
+    return 0;
+}
+
+static void RAM_FUNC(startMove)(uint32_t steps) {
+    planner_move(&planner, &steps);
+    state = (steps > 0) ? MOTOR_MOVING : MOTOR_IDLE;
+}
+
+/* From the edge to the goal, and the whole revolutions of the left steps beyond it. With nothing left the goal has been
+ * passed: it is reached again within a revolution. */
+static uint32_t RAM_FUNC(stepsFromEdge)(int64_t left) {
+    return (left > goal) ? goal + (uint32_t) ((left - goal) / steps_per_revolution) * steps_per_revolution : goal;
+}
+
+/* Advances the state machine after a planner tick. A stall seen while moving re-homes to the opto fork, whose edge
+ * then continues to the goal of the interrupted move (optoFallingEdge), as an early edge does without a homing run. */
+static void RAM_FUNC(afterStep)() {
+    switch (state) {
+        case MOTOR_MOVING:
+            if (true == calibrated && motor.position == steps_per_revolution + STALL_TOLERANCE + 1) {
+                errors++;
+                edge_seen = false;
+                // as if the edge had been where the count put it: the steps lost before it are not known
+                homing_left = (int64_t) planner.ticks_left + STALL_TOLERANCE + 1;
+                planner_move(&planner, (uint32_t[]) {2 * steps_per_revolution});
+                state = MOTOR_HOMING;
+            } else if (false == planner_busy(&planner)) {
+                state = MOTOR_IDLE;
+            }
+            break;
+        case MOTOR_HOMING:
+            if (false == planner_busy(&planner)) {
+                calibrated = false;
+                state = MOTOR_IDLE;
+            }
+            break;
+        case MOTOR_CALIB_SEEK:
+            if (true == edge_seen) {
+                edge_seen = false;
+                state = MOTOR_CALIB_COUNT;
+            }
+            break;
+        case MOTOR_CALIB_COUNT:
+            if (true == edge_seen) {
+                edge_seen = false;
+                planner_stop(&planner);
+                steps_per_revolution = edge_position;
+                calibrated = true;
+                state = MOTOR_IDLE;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/////////////////////////////////////////////////////
+//                    CORE 0                       //
+/////////////////////////////////////////////////////
+
+void motor_start(void) {
+    multicore_launch_core1(motor_core1_entry);
+}
+
+void motor_move(uint32_t steps) {
+    multicore_fifo_push_blocking((MOTOR_CMD_MOVE << MOTOR_CMD_SHIFT) | (steps & MOTOR_ARG_MASK));
+}
+
+void motor_stop(void) {
+    multicore_fifo_push_blocking(MOTOR_CMD_STOP << MOTOR_CMD_SHIFT);
+}
+
+void motor_calibrate(void) {
+    multicore_fifo_push_blocking(MOTOR_CMD_CALIB << MOTOR_CMD_SHIFT);
+}
+
+void motor_restore(uint32_t steps_per_revolution, uint32_t row, uint32_t position) {
+    multicore_fifo_push_blocking((MOTOR_CMD_RESTORE << MOTOR_CMD_SHIFT) | (steps_per_revolution & MOTOR_ARG_MASK));
+    multicore_fifo_push_blocking((row << 16) | (position & 0xFFFF));
+}
+
+void motor_query(motor_status_t *status) {
+    uint32_t reply[QUERY_REPLY_WORDS];
+
+    multicore_fifo_push_blocking(MOTOR_CMD_QUERY << MOTOR_CMD_SHIFT);
+    for (int i = 0; i < QUERY_REPLY_WORDS; i++) {
+        reply[i] = multicore_fifo_pop_blocking();
+    }
+    status->calibrated = reply[0] & 1;
+    status->busy = reply[0] & 2;
+    status->row = (reply[0] >> 8) & 0xFF;
+    status->position = reply[1];
+    status->steps_per_revolution = reply[2];
+    status->errors = reply[3];
+    status->max_jitter_us = reply[4];
+    status->avg_jitter_us = reply[5];
+}
+
+void motor_wait_idle(motor_status_t *status) {
+    do {
+        sleep_ms(10);
+        motor_query(status);
+    } while (true == status->busy);
+}
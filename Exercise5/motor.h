@@ -0,0 +1,43 @@
+#ifndef EXERCISE5_MOTOR_H
+#define EXERCISE5_MOTOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Commands are sent from core 0 to core 1 through the SIO FIFO. The command is in the top four bits of the word and
+ * the argument in the rest. MOTOR_CMD_RESTORE is followed by a second word: row << 16 | position. */
+#define MOTOR_CMD_SHIFT 28
+#define MOTOR_ARG_MASK ((1u << MOTOR_CMD_SHIFT) - 1)
+
+enum motor_command {
+    MOTOR_CMD_MOVE = 1,
+    MOTOR_CMD_STOP,
+    MOTOR_CMD_QUERY,
+    MOTOR_CMD_CALIB,
+    MOTOR_CMD_RESTORE
+};
+
+typedef struct {
+    bool calibrated;
+    bool busy;
+    uint32_t row;
+    uint32_t position;
+    uint32_t steps_per_revolution;
+    uint32_t errors;
+    uint32_t max_jitter_us;
+    uint32_t avg_jitter_us;
+} motor_status_t;
+
+/* Core 1 */
+void motor_core1_entry(void);
+
+/* Core 0 */
+void motor_start(void);
+void motor_move(uint32_t steps);
+void motor_stop(void);
+void motor_calibrate(void);
+void motor_restore(uint32_t steps_per_revolution, uint32_t row, uint32_t position);
+void motor_query(motor_status_t *status);
+void motor_wait_idle(motor_status_t *status);
+
+#endif //EXERCISE5_MOTOR_H
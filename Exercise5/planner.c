@@ -0,0 +1,63 @@
+#include <string.h>
+#include "pico/stdlib.h"
+
+#include "planner.h"
+#include "ram_func.h"
+
+void planner_init(planner_t *p) {
+    memset(p, 0, sizeof(planner_t));
+}
+
+// Returns the index of the new axis or -1 if all axes are in use.
+int planner_add_axis(planner_t *p, stepper_t *motor) {
+    if (p->axis_count >= PLANNER_MAX_AXES) {
+        return -1;
+    }
+    p->axes[p->axis_count].motor = motor;
+    return p->axis_count++;
+}
+
+/* steps[] has one entry per axis. Must not be called while planner_tick can run (stop the timer or disable
+ * interrupts around it). */
+void RAM_FUNC(planner_move)(planner_t *p, const uint32_t steps[]) {
+    uint32_t major = 0;
+
+    for (int i = 0; i < p->axis_count; i++) {
+        uint32_t delta = steps[i] < PLANNER_MAX_STEPS ? steps[i] : PLANNER_MAX_STEPS - 1;
+        p->axes[i].delta = delta;
+        if (delta > major) {
+            major = delta;
+        }
+    }
+    // starting from half way rounds each axis to the nearest tick and still gives exactly delta steps
+    for (int i = 0; i < p->axis_count; i++) {
+        p->axes[i].error = major / 2;
+    }
+    p->major = major;
+    p->ticks_left = major;
+}
+
+void RAM_FUNC(planner_stop)(planner_t *p) {
+    p->ticks_left = 0;
+}
+
+bool RAM_FUNC(planner_busy)(const planner_t *p) {
+    return p->ticks_left > 0;
+}
+
+/* Called once per step period from the timer interrupt. Returns true while a move is in progress. */
+bool RAM_FUNC(planner_tick)(planner_t *p) {
+    if (0 == p->ticks_left) {
+        return false;
+    }
+    for (int i = 0; i < p->axis_count; i++) {
+        planner_axis_t *axis = &p->axes[i];
+        axis->error += axis->delta;
+        if (axis->error >= p->major) {
+            axis->error -= p->major;
+            stepper_step(axis->motor);
+        }
+    }
+    p->ticks_left--;
+    return true;
+}
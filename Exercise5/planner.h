@@ -0,0 +1,33 @@
+#ifndef EXERCISE5_PLANNER_H
+#define EXERCISE5_PLANNER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "stepper.h"
+
+#define PLANNER_MAX_AXES 4
+#define PLANNER_MAX_STEPS (1u << 31) // keeps the DDA accumulators within 32 bits
+
+/* Coordinated moves for up to PLANNER_MAX_AXES motors. The axis with the most steps (major axis) steps on every tick
+ * and the others are spread evenly over the same ticks with a DDA, so all axes start and finish together. */
+typedef struct {
+    stepper_t *motor;
+    uint32_t delta;
+    uint32_t error;
+} planner_axis_t;
+
+typedef struct {
+    planner_axis_t axes[PLANNER_MAX_AXES];
+    uint8_t axis_count;
+    uint32_t major;
+    volatile uint32_t ticks_left;
+} planner_t;
+
+void planner_init(planner_t *p);
+int planner_add_axis(planner_t *p, stepper_t *motor);
+void planner_move(planner_t *p, const uint32_t steps[]);
+void planner_stop(planner_t *p);
+bool planner_busy(const planner_t *p);
+bool planner_tick(planner_t *p);
+
+#endif //EXERCISE5_PLANNER_H
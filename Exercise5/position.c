@@ -0,0 +1,10 @@
+#include "position.h"
+
+uint32_t position_steps_to(uint32_t steps_per_revolution, uint32_t position, uint32_t target) {
+    int64_t count = steps_per_revolution;
+    int64_t steps = (int64_t) target * count / POSITIONS_PER_REVOLUTION - position;
+    while (steps < 0) {
+        steps += count;
+    }
+    return (uint32_t) steps;
+}
@@ -0,0 +1,13 @@
+#ifndef EXERCISE5_POSITION_H
+#define EXERCISE5_POSITION_H
+
+#include <stdint.h>
+
+#define POSITIONS_PER_REVOLUTION 8
+
+/* Steps forward from position (steps since the opto fork) to the target in 1/8 revolutions from the fork; a target of
+ * 8 or more includes whole revolutions. The move ends at the rounded-down step of the absolute target, so the remainder
+ * of one move is never lost (Bresenham style) and any sequence of moves lands on the same steps as one long move. */
+uint32_t position_steps_to(uint32_t steps_per_revolution, uint32_t position, uint32_t target);
+
+#endif //EXERCISE5_POSITION_H
@@ -0,0 +1,38 @@
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+
+#include "ram_func.h"
+#include "stepper.h"
+
+/* Each row is packed as IN4..IN1 in bits 3..0. */
+static const uint8_t turning_sequence[8] = {0x1, 0x3, 0x2, 0x6, 0x4, 0xC, 0x8, 0x9};
+
+void stepper_init(stepper_t *s, uint8_t in1, uint8_t in2, uint8_t in3, uint8_t in4) {
+    s->pins[0] = in1;
+    s->pins[1] = in2;
+    s->pins[2] = in3;
+    s->pins[3] = in4;
+    s->row = 0;
+    s->position = 0;
+
+    for (int i = 0; i < 4; i++) {
+        gpio_init(s->pins[i]);
+        gpio_set_dir(s->pins[i], GPIO_OUT);
+    }
+}
+
+void RAM_FUNC(stepper_step)(stepper_t *s) {
+    uint8_t bits = turning_sequence[s->row];
+
+    for (int i = 0; i < 4; i++) {
+        gpio_put(s->pins[i], (bits >> i) & 1);
+    }
+    s->row = (s->row + 1) & 7;
+    s->position++;
+}
+
+void stepper_release(stepper_t *s) {
+    for (int i = 0; i < 4; i++) {
+        gpio_put(s->pins[i], 0);
+    }
+}
@@ -0,0 +1,18 @@
+#ifndef EXERCISE5_STEPPER_H
+#define EXERCISE5_STEPPER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* One 28BYJ-48 style motor driven in half steps through four GPIOs. */
+typedef struct {
+    uint8_t pins[4];
+    uint8_t row;
+    volatile uint32_t position; // steps since the last reference (opto fork), reset by the owner
+} stepper_t;
+
+void stepper_init(stepper_t *s, uint8_t in1, uint8_t in2, uint8_t in3, uint8_t in4);
+void stepper_step(stepper_t *s);
+void stepper_release(stepper_t *s);
+
+#endif //EXERCISE5_STEPPER_H
@@ -5,6 +5,12 @@
 #include "hardware/gpio.h"
 #include "hardware/pwm.h"
 
+#include "board.h"
+#include "debounce.h"
+#include "idle.h"
+#include "ram_func.h"
+#include "soft_timer.h"
+
 /*  LEDs  */
 #define D2 21
 
@@ -26,6 +32,16 @@
 #define IN2 6
 #define IN3 3
 #define IN4 2
+#define STEP_PERIOD 10 // ms per half step
+
+static const uint turning_sequence[8][4] = {{1, 0, 0, 0},
+                                            {1, 1, 0, 0},
+                                            {0, 1, 0, 0},
+                                            {0, 1, 1, 0},
+                                            {0, 0, 1, 0},
+                                            {0, 0, 1, 1},
+                                            {0, 0, 0, 1},
+                                            {1, 0, 0, 1}};
 
 /* FUNCTIONS */
 void ledInit();
@@ -34,15 +50,20 @@ void pwmInit();
 void ledOn(uint led_pin);
 void ledOff(uint led_pin);
 void stepperMotorInit();
-bool repeatingTimerCallback(struct repeating_timer *t);
+void buttonTimerCallback(soft_timer_t *timer, void *context);
+void stepTimerCallback(soft_timer_t *timer, void *context);
 
 /*  GLOBALS  */
 volatile bool sw1_buttonEvent = false;
 volatile bool d2State = false;
 
+static const uint leds[] = {D2};
+static const uint buttons[] = {SW_1};
+
 /*   MAIN   */
 int main() {
 
+    idle_init();
     stdio_init_all();
 
     ledInit();
@@ -50,17 +71,11 @@ int main() {
     buttonInit();
     stepperMotorInit();
 
-    struct repeating_timer timer;
-    add_repeating_timer_ms(BUTTON_PERIOD, repeatingTimerCallback, NULL, &timer);
+    soft_timer_init();
+    static soft_timer_t button_timer;
+    soft_timer_start(&button_timer, BUTTON_PERIOD, BUTTON_PERIOD, buttonTimerCallback, NULL);
 
-    const uint turning_sequence[8][4] = {{1, 0, 0, 0},
-                                         {1, 1, 0, 0},
-                                         {0, 1, 0, 0},
-                                         {0, 1, 1, 0},
-                                         {0, 0, 1, 0},
-                                         {0, 0, 1, 1},
-                                         {0, 0, 0, 1},
-                                         {1, 0, 0, 1}};
+    static soft_timer_t step_timer;
 
     while (true) {
 
@@ -69,53 +84,31 @@ int main() {
             sw1_buttonEvent = false;
             if(true == d2State) {
                 d2State = false;
+                soft_timer_cancel(&step_timer);
+                ledOff(D2);
             } else {
                 d2State = true;
+                soft_timer_start(&step_timer, STEP_PERIOD, STEP_PERIOD, stepTimerCallback, NULL);
+                ledOn(D2);
             }
         }
 
-        if (true == d2State) {
-            ledOn(D2);
-            for (int i = 7; i >= 0; i--) {
-                gpio_put(IN1, turning_sequence[i][0]);
-                gpio_put(IN2, turning_sequence[i][1]);
-                gpio_put(IN3, turning_sequence[i][2]);
-                gpio_put(IN4, turning_sequence[i][3]);
-                sleep_ms(10);
-            }
-        } else {
-            ledOff(D2);
-        }
-
+        idle_wait();
     }
 
     return 0;
 }
 
 void ledInit() {
-    gpio_init(D2);
-    gpio_set_dir(D2, GPIO_OUT);
+    board_outputs_init(leds, sizeof(leds) / sizeof(leds[0]));
 }
 
 void buttonInit() {
-    gpio_init(SW_1);
-    gpio_set_dir(SW_1, GPIO_IN);
-    gpio_pull_up(SW_1);
+    board_buttons_init(buttons, sizeof(buttons) / sizeof(buttons[0]));
 }
 
 void pwmInit() {
-    pwm_config config = pwm_get_default_config();
-
-    // D2:             (2B)
-    uint d2_slice = pwm_gpio_to_slice_num(D2);
-    uint d2_chanel = pwm_gpio_to_channel(D2);
-    pwm_set_enabled(d2_slice, false);
-    pwm_config_set_clkdiv_int(&config, DIVIDER);
-    pwm_config_set_wrap(&config, PWM_FREQ - 1);
-    pwm_init(d2_slice, &config, false);
-    pwm_set_chan_level(d2_slice, d2_chanel, LEVEL + 1);
-    gpio_set_function(D2, GPIO_FUNC_PWM);
-    pwm_set_enabled(d2_slice, true);
+    board_pwm_init(leds, sizeof(leds) / sizeof(leds[0]), DIVIDER, PWM_FREQ - 1, LEVEL + 1);
 
     pwm_set_gpio_level(D2, MIN_BRIGHTNESS);
 }
@@ -139,24 +132,22 @@ void stepperMotorInit() {
     gpio_set_dir(IN4, GPIO_OUT);
 }
 
-bool repeatingTimerCallback(struct repeating_timer *t) {
+void RAM_FUNC(buttonTimerCallback)(soft_timer_t *timer, void *context) {
 
     /* SW1 */
-    static uint sw1_button_state = 0, sw1_filter_counter = 0;
-    uint sw1_new_state = 1;
-
-    sw1_new_state = gpio_get(SW_1);
-    if (sw1_button_state != sw1_new_state) {
-        if (++sw1_filter_counter >= BUTTON_FILTER) {
-            sw1_button_state = sw1_new_state;
-            sw1_filter_counter = 0;
-            if (sw1_new_state != SW1_RELEASED) {
-                sw1_buttonEvent = true;
-            }
-        }
-    } else {
-        sw1_filter_counter = 0;
+    static debounce_t sw1_filter;
+    if (true == debounce_sample(&sw1_filter, gpio_get(SW_1), BUTTON_FILTER) && sw1_filter.level != SW1_RELEASED) {
+        sw1_buttonEvent = true;
     }
+}
+
+/* Runs the half step sequence backwards, one half step per call. */
+void RAM_FUNC(stepTimerCallback)(soft_timer_t *timer, void *context) {
+    static int step = 0;
 
-    return true;
+    step = (step + 7) % 8;
+    gpio_put(IN1, turning_sequence[step][0]);
+    gpio_put(IN2, turning_sequence[step][1]);
+    gpio_put(IN3, turning_sequence[step][2]);
+    gpio_put(IN4, turning_sequence[step][3]);
 }
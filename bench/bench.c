@@ -0,0 +1,655 @@
+/*
+Host benchmarks of the reusable pieces of the projects: the same sources the firmware builds, compiled for the host.
+
+    cmake -S bench -B build-bench && cmake --build build-bench
+    build-bench/bench [--format json|csv] [--baseline <file>] [--threshold <percent>] [--save <file>] [<case>...]
+
+Every case is run in batches sized to take about BATCH_MS, RUNS times; the fastest batch gives ns/op, so a busy
+machine makes a case look slower only if it disturbs every run. The result goes to stdout as JSON (default) or CSV:
+name, ns per operation, operations per second and, for the cases that process a buffer, MB/s.
+
+--save writes the results as a baseline (CSV: name,ns_per_op). --baseline compares against one: a case more than
+--threshold percent (default 20) slower than its baseline fails the run with exit code 1. The baseline in this
+directory was taken on a development PC; take a new one on the machine that runs the comparison:
+    cmake --build build-bench --target bench_baseline   # rewrites bench/baseline.csv
+    cmake --build build-bench --target bench_check      # compares against it
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "at_response.h"
+#include "cli.h"
+#include "crc16.h"
+#include "debounce.h"
+#include "dlog.h"
+#include "log_record.h"
+#include "proto.h"
+#include "planner.h"
+#include "ring_buffer.h"
+#include "stepper.h"
+#include "timer_wheel.h"
+
+#define BATCH_MS 50
+#define RUNS 5
+#define DEFAULT_THRESHOLD 20.0
+#define MAX_CASES 32
+#define MAX_NAME 32
+#define TIMER_SPAN 10000 // ticks over which the timers of the timer wheel cases are spread
+#define MAX_TIMERS 1000
+
+typedef struct {
+    const char *name;
+    size_t bytes;                          // processed per operation, 0 if not a buffer
+    void (*run)(uint64_t iterations);
+} bench_case_t;
+
+typedef struct {
+    const bench_case_t *c;
+    double ns_per_op;
+} result_t;
+
+/* Keeps the compiler from dropping a computation whose result is not used otherwise. */
+#define KEEP(value) __asm__ volatile("" : : "r"(value) : "memory")
+
+static void benchRingBuffer(uint64_t iterations);
+static void benchRingBufferBurst(uint64_t iterations);
+static void benchCrc16Record(uint64_t iterations);
+static void benchCrc16Block(uint64_t iterations);
+static void benchRemoveColons(uint64_t iterations);
+static void benchParseDevEui(uint64_t iterations);
+static void benchParserDevEui(uint64_t iterations);
+static void benchParserChunkDevEui(uint64_t iterations);
+static void benchCorpusLines(uint64_t iterations);
+static void benchCorpusParser(uint64_t iterations);
+static void benchLogEncode(uint64_t iterations);
+static void benchLogDecode(uint64_t iterations);
+static void benchDebounce(uint64_t iterations);
+static void plannerTicks(uint64_t iterations, uint8_t axis_count);
+static void benchPlannerTick1(uint64_t iterations);
+static void benchPlannerTick2(uint64_t iterations);
+static void benchPlannerTick3(uint64_t iterations);
+static void benchPlannerTick4(uint64_t iterations);
+static void benchCliDispatch(uint64_t iterations);
+static void benchCliPollStall(uint64_t iterations);
+static void benchDlogState(uint64_t iterations);
+static void benchDlogFrame(uint64_t iterations);
+static void benchSnprintfState(uint64_t iterations);
+static void timerWheelRounds(uint64_t iterations, int timer_count, bool expire);
+static void benchTimerInsert10(uint64_t iterations);
+static void benchTimerInsert100(uint64_t iterations);
+static void benchTimerInsert1000(uint64_t iterations);
+static void benchTimerExpire10(uint64_t iterations);
+static void benchTimerExpire100(uint64_t iterations);
+static void benchTimerExpire1000(uint64_t iterations);
+static double measure(const bench_case_t *c);
+static double nowNs(void);
+static bool selected(const char *name, char **names, int count);
+static void printResults(const result_t *results, int count, bool csv);
+static bool saveBaseline(const char *path, const result_t *results, int count);
+static int compareBaseline(const char *path, const result_t *results, int count, double threshold);
+
+void bench_stdin_set(const char *data, size_t length); // stdio_stub.c
+
+static const char dev_eui_line[] = "+ID: DevEui, 2C:F7:F1:20:32:30:A5:70\r\n";
+
+/* Responses of a LoRa-E5 captured on the UART: the exchange of Exercise 3, the IDs, a join and an uplink. */
+static const char at_corpus[] =
+        "+AT: OK\r\n"
+        "+VER: 4.0.11\r\n"
+        "+ID: DevEui, 2C:F7:F1:20:32:30:A5:70\r\n"
+        "+ID: DevAddr, 26:0B:D9:5A\r\n"
+        "+ID: DevEui, 2C:F7:F1:20:32:30:A5:70\r\n"
+        "+ID: AppEui, 80:00:00:00:00:00:00:06\r\n"
+        "+MODE: LWOTAA\r\n"
+        "+KEY: APPKEY 2B7E151628AED2A6ABF7158809CF4F3C\r\n"
+        "+CLASS: A\r\n"
+        "+PORT: 8\r\n"
+        "+JOIN: Start\r\n"
+        "+JOIN: NORMAL\r\n"
+        "+JOIN: Network joined\r\n"
+        "+JOIN: NetID 000013 DevAddr 26:0B:D9:5A\r\n"
+        "+JOIN: Done\r\n"
+        "+MSGHEX: Start\r\n"
+        "+MSGHEX: Done\r\n";
+
+static const bench_case_t cases[] = {
+        {"ring_buffer_put_get",    1,                     benchRingBuffer},
+        {"ring_buffer_burst",      255,                   benchRingBufferBurst},
+        {"crc16_record",           23,                    benchCrc16Record},
+        {"crc16_block",            2048,                  benchCrc16Block},
+        {"remove_colons",          23,                    benchRemoveColons},
+        {"parse_dev_eui",          38,                    benchParseDevEui},
+        {"at_parser_dev_eui",      38,                    benchParserDevEui},
+        {"at_parser_chunk_dev_eui", 38,                   benchParserChunkDevEui},
+        {"at_corpus_lines",        sizeof(at_corpus) - 1, benchCorpusLines},
+        {"at_corpus_parser",       sizeof(at_corpus) - 1, benchCorpusParser},
+        {"log_record_encode",      0,                     benchLogEncode},
+        {"log_record_decode",      0,                     benchLogDecode},
+        {"debounce_sample",        0,                     benchDebounce},
+        {"planner_tick_1_axis",    0,                     benchPlannerTick1},
+        {"planner_tick_2_axes",    0,                     benchPlannerTick2},
+        {"planner_tick_3_axes",    0,                     benchPlannerTick3},
+        {"planner_tick_4_axes",    0,                     benchPlannerTick4},
+        {"cli_dispatch",           0,                     benchCliDispatch},
+        {"cli_poll_stall",         CLI_MAX_LINE,          benchCliPollStall},
+        {"dlog_state",             0,                     benchDlogState},
+        {"dlog_frame",             8 + 4 * 3,             benchDlogFrame},
+        {"snprintf_state",         0,                     benchSnprintfState},
+        {"timer_insert_10",        0,                     benchTimerInsert10},
+        {"timer_insert_100",       0,                     benchTimerInsert100},
+        {"timer_insert_1000",      0,                     benchTimerInsert1000},
+        {"timer_expire_10",        0,                     benchTimerExpire10},
+        {"timer_expire_100",       0,                     benchTimerExpire100},
+        {"timer_expire_1000",      0,                     benchTimerExpire1000},
+};
+
+int main(int argc, char *argv[]) {
+    bool csv = false;
+    const char *baseline = NULL;
+    const char *save = NULL;
+    double threshold = DEFAULT_THRESHOLD;
+    char *names[MAX_CASES];
+    int name_count = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (0 == strcmp("--format", argv[i]) && i + 1 < argc) {
+            csv = (0 == strcmp("csv", argv[++i]));
+        } else if (0 == strcmp("--baseline", argv[i]) && i + 1 < argc) {
+            baseline = argv[++i];
+        } else if (0 == strcmp("--threshold", argv[i]) && i + 1 < argc) {
+            threshold = atof(argv[++i]);
+        } else if (0 == strcmp("--save", argv[i]) && i + 1 < argc) {
+            save = argv[++i];
+        } else if ('-' != argv[i][0] && name_count < MAX_CASES) {
+            names[name_count++] = argv[i];
+        } else {
+            fprintf(stderr, "usage: %s [--format json|csv] [--baseline <file>] [--threshold <percent>] "
+                            "[--save <file>] [<case>...]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    result_t results[MAX_CASES];
+    int count = 0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        if (selected(cases[i].name, names, name_count)) {
+            results[count].c = &cases[i];
+            results[count].ns_per_op = measure(&cases[i]);
+            count++;
+        }
+    }
+    printResults(results, count, csv);
+
+    if (NULL != save && false == saveBaseline(save, results, count)) {
+        return 2;
+    }
+    if (NULL != baseline) {
+        return compareBaseline(baseline, results, count, threshold);
+    }
+    return 0;
+}
+
+/////////////////////////////////////////////////////
+//                       CASES                     //
+/////////////////////////////////////////////////////
+
+/* One byte through the buffer the UART driver of Exercise 3 uses for its FIFOs. */
+static void benchRingBuffer(uint64_t iterations) {
+    static uint8_t storage[256];
+    ring_buffer rb;
+    rb_init(&rb, storage, sizeof(storage));
+    for (uint64_t i = 0; i < iterations; i++) {
+        rb_put(&rb, (uint8_t) i);
+        KEEP(rb_get(&rb));
+    }
+}
+
+/* Fill the buffer up and drain it, as a burst of received characters does. */
+static void benchRingBufferBurst(uint64_t iterations) {
+    static uint8_t storage[256];
+    ring_buffer rb;
+    rb_init(&rb, storage, sizeof(storage));
+    for (uint64_t i = 0; i < iterations; i++) {
+        for (int n = 0; rb_put(&rb, (uint8_t) n); n++) {
+        }
+        while (false == rb_empty(&rb)) {
+            KEEP(rb_get(&rb));
+        }
+    }
+}
+
+/* A longest log record (common/log_record.h) */
+static void benchCrc16Record(uint64_t iterations) {
+    static uint8_t data[LOG_RECORD_MAX_SIZE];
+    for (uint64_t i = 0; i < iterations; i++) {
+        data[0] = (uint8_t) i;
+        KEEP(crc16(data, sizeof(data)));
+    }
+}
+
+/* The whole 2 KB log area of Exercise 4 */
+static void benchCrc16Block(uint64_t iterations) {
+    static uint8_t data[2048];
+    for (uint64_t i = 0; i < iterations; i++) {
+        data[0] = (uint8_t) i;
+        KEEP(crc16(data, sizeof(data)));
+    }
+}
+
+static void benchRemoveColons(uint64_t iterations) {
+    char output[sizeof(dev_eui_line)];
+    for (uint64_t i = 0; i < iterations; i++) {
+        removeColonsAndLowercase("2C:F7:F1:20:32:30:A5:70", output);
+        KEEP(output[0]);
+    }
+}
+
+/* The DevEui response line of the LoRa-E5 from tag search to the 16 digits */
+static void benchParseDevEui(uint64_t iterations) {
+    char output[sizeof(dev_eui_line)];
+    for (uint64_t i = 0; i < iterations; i++) {
+        KEEP(parseDevEui(dev_eui_line, output));
+        KEEP(output[0]);
+    }
+}
+
+/* The same line byte by byte through the parser Exercise 3 runs on the UART input, to the 16 digits */
+static void benchParserDevEui(uint64_t iterations) {
+    at_parser_t parser;
+    char output[2 * AT_MAX_ID + 1];
+    at_parser_init(&parser);
+    for (uint64_t i = 0; i < iterations; i++) {
+        const at_response_t *response = NULL;
+        for (const char *c = dev_eui_line; '\0' != *c; c++) {
+            response = at_parser_feed(&parser, (uint8_t) *c);
+        }
+        at_hex_string(response->id_bytes, response->id_length, output);
+        KEEP(output[0]);
+    }
+}
+
+/* And in the chunk uart_read() gives the LoRaWAN client */
+static void benchParserChunkDevEui(uint64_t iterations) {
+    at_parser_t parser;
+    char output[2 * AT_MAX_ID + 1];
+    at_parser_init(&parser);
+    for (uint64_t i = 0; i < iterations; i++) {
+        const at_response_t *response;
+        at_parser_feed_bytes(&parser, (const uint8_t *) dev_eui_line, sizeof(dev_eui_line) - 1, &response);
+        at_hex_string(response->id_bytes, response->id_length, output);
+        KEEP(output[0]);
+    }
+}
+
+/* The corpus the way Exercise 3 used to read it: each line collected up to its line feed, then searched for a DevEui. */
+static void benchCorpusLines(uint64_t iterations) {
+    char line[AT_MAX_LINE];
+    char output[AT_MAX_LINE];
+    for (uint64_t i = 0; i < iterations; i++) {
+        size_t length = 0;
+        for (const char *c = at_corpus; '\0' != *c; c++) {
+            if (length < sizeof(line) - 1) {
+                line[length++] = *c;
+            }
+            if ('\n' == *c) {
+                line[length] = '\0';
+                KEEP(parseDevEui(line, output));
+                length = 0;
+            }
+        }
+        KEEP(output[0]);
+    }
+}
+
+static void benchCorpusParser(uint64_t iterations) {
+    at_parser_t parser;
+    char output[2 * AT_MAX_ID + 1];
+    at_parser_init(&parser);
+    for (uint64_t i = 0; i < iterations; i++) {
+        const uint8_t *data = (const uint8_t *) at_corpus;
+        size_t length = sizeof(at_corpus) - 1;
+        while (length > 0) {
+            const at_response_t *response;
+            size_t taken = at_parser_feed_bytes(&parser, data, length, &response);
+            if (NULL != response && AT_ID_DEV_EUI == response->id) {
+                at_hex_string(response->id_bytes, response->id_length, output);
+            }
+            data += taken;
+            length -= taken;
+        }
+        KEEP(output[0]);
+    }
+}
+
+/* A state change record, the one the button presses of Exercise 4 write */
+static void benchLogEncode(uint64_t iterations) {
+    log_record_t record = {.type = LOG_TYPE_STATE, .length = 1, .payload = {5}};
+    uint8_t output[LOG_RECORD_MAX_SIZE];
+    for (uint64_t i = 0; i < iterations; i++) {
+        record.delta_ms = (uint32_t) i;
+        KEEP(log_record_encode(&record, output));
+    }
+}
+
+static void benchLogDecode(uint64_t iterations) {
+    log_record_t record = {.type = LOG_TYPE_TEXT, .length = 15, .delta_ms = 123456, .payload = "fifteen chars.."};
+    uint8_t input[LOG_RECORD_MAX_SIZE];
+    size_t length = log_record_encode(&record, input);
+    for (uint64_t i = 0; i < iterations; i++) {
+        KEEP(log_record_decode(input, length, &record));
+    }
+}
+
+/* A press with contact bounce: the sampled level follows a pseudo random pattern that settles every 16 samples. */
+static void benchDebounce(uint64_t iterations) {
+    debounce_t filter = {0};
+    uint32_t noise = 0x12345678;
+    for (uint64_t i = 0; i < iterations; i++) {
+        noise = noise * 1664525 + 1013904223;
+        bool level = (i & 16) ? ((i & 15) > 4 || (noise >> 31)) : ((i & 15) < 4 && (noise >> 31));
+        KEEP(debounce_sample(&filter, level, 5));
+    }
+}
+
+/* A coordinated move of 1 to PLANNER_MAX_AXES axes (Exercise5/planner.h): one tick decides which motors step and
+ * steps them, the cost of the step interrupt by the number of axes. The minor axes take fractions of the major one so
+ * that their DDA steps fall on different ticks. */
+static void plannerTicks(uint64_t iterations, uint8_t axis_count) {
+    static const uint8_t pins[PLANNER_MAX_AXES][4] = {
+            {13, 6, 3, 2}, {21, 20, 19, 18}, {17, 16, 15, 14}, {12, 11, 10, 9}
+    };
+    static const uint32_t steps[PLANNER_MAX_AXES] = {4096, 1365, 2731, 3413};
+    stepper_t motors[PLANNER_MAX_AXES];
+    planner_t planner;
+    planner_init(&planner);
+    for (uint8_t i = 0; i < axis_count; i++) {
+        stepper_init(&motors[i], pins[i][0], pins[i][1], pins[i][2], pins[i][3]);
+        planner_add_axis(&planner, &motors[i]);
+    }
+    for (uint64_t i = 0; i < iterations; i++) {
+        if (false == planner_busy(&planner)) {
+            planner_move(&planner, steps);
+        }
+        KEEP(planner_tick(&planner));
+    }
+}
+
+static void benchPlannerTick1(uint64_t iterations) {
+    plannerTicks(iterations, 1);
+}
+
+static void benchPlannerTick2(uint64_t iterations) {
+    plannerTicks(iterations, 2);
+}
+
+static void benchPlannerTick3(uint64_t iterations) {
+    plannerTicks(iterations, 3);
+}
+
+static void benchPlannerTick4(uint64_t iterations) {
+    plannerTicks(iterations, 4);
+}
+
+static void cliCommand(const cli_args_t *args) {
+    KEEP(args->argc);
+}
+
+/* The size of the command table of Exercise 5, with one command that takes the most arguments there can be. */
+static const cli_command_t cli_commands[] = {
+        {"calib",   "",       cliCommand},
+        {"goto",    "u",      cliCommand},
+        {"i2c",     "",       cliCommand},
+        {"idle",    "",       cliCommand},
+        {"profile", "",       cliCommand},
+        {"run",     "uuuuuu", cliCommand},
+        {"status",  "",       cliCommand},
+        {"stop",    "",       cliCommand},
+        {"trace",   "",       cliCommand},
+};
+
+/* A typed command from the end of its line to its handler: tokenizing, table search and argument conversion. */
+static void benchCliDispatch(uint64_t iterations) {
+    cli_t cli;
+    char line[CLI_MAX_LINE];
+    cli_init(&cli, cli_commands, sizeof(cli_commands) / sizeof(cli_commands[0]));
+    for (uint64_t i = 0; i < iterations; i++) {
+        memcpy(line, "goto 5", sizeof("goto 5"));
+        KEEP(cli_execute(&cli, line));
+    }
+}
+
+/* The longest the CLI holds up the main loop: a line of CLI_MAX_LINE - 1 characters with six numbers, all waiting at
+ * once. It takes the two polls of CLI_MAX_POLL_CHARS it is read in; the one with the end of the line is the stall, and
+ * it takes less than both. */
+static void benchCliPollStall(uint64_t iterations) {
+    static const char input[CLI_MAX_LINE + 1] =
+            "run 4294967295 4294967295 4294967295 4294967295 4294967295 1234\r";
+    cli_t cli;
+    cli_init(&cli, cli_commands, sizeof(cli_commands) / sizeof(cli_commands[0]));
+    for (uint64_t i = 0; i < iterations; i++) {
+        bench_stdin_set(input, CLI_MAX_LINE);
+        cli_poll(&cli);
+        cli_poll(&cli);
+    }
+}
+
+/* The LED states Exercise 4 Task 2 logs on every change, with DLOG (common/dlog.h). The ring is drained whenever it is
+ * full, so the time includes the frame each record becomes in the main loop, not only the stores of DLOG itself. */
+static void benchDlogState(uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; i++) {
+        DLOG("D1: %d\nD2: %d\nD3: %d\n\n", (uint32_t) i & 1, (uint32_t) (i >> 1) & 1, (uint32_t) (i >> 2) & 1);
+        if (DLOG_RING_SIZE - 1 == i % DLOG_RING_SIZE) {
+            dlog_drain(DLOG_RING_SIZE);
+        }
+    }
+}
+
+/* The main loop half of dlog_state alone: the frame dlog_drain() sends for one of its records. What is left of
+ * dlog_state is the cost of DLOG where it is called, in an interrupt handler too. */
+static void benchDlogFrame(uint64_t iterations) {
+    uint8_t payload[8 + 4 * 3] = {0, 0, 1, 2, 0x10, 0, 0x2A, 0x40, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 1};
+    for (uint64_t i = 0; i < iterations; i++) {
+        payload[3] = (uint8_t) i;
+        proto_send(0, PROTO_LOG_EVENT, PROTO_OK, payload, sizeof(payload));
+    }
+}
+
+/* The same message formatted on the board, as DLOG_DEFERRED 0 would before printf writes it out. */
+static void benchSnprintfState(uint64_t iterations) {
+    char text[64];
+    for (uint64_t i = 0; i < iterations; i++) {
+        KEEP(snprintf(text, sizeof(text), "D1: %d\nD2: %d\nD3: %d\n\n", (int) (i & 1), (int) (i >> 1) & 1,
+                      (int) (i >> 2) & 1));
+    }
+}
+
+static void timerFired(soft_timer_t *timer, void *context) {
+    (*(uint64_t *) context)++;
+}
+
+/* One-shot timers at random ticks over TIMER_SPAN (common/timer_wheel.h), timer_count of them pending at once. An
+ * operation is one timer: its insert and then its removal before it is due (insert cases), or its insert and then its
+ * expiry as soft_timer advances the wheel (expire cases). Only added timers can expire, so the expiry alone is the
+ * difference of the two. */
+static void timerWheelRounds(uint64_t iterations, int timer_count, bool expire) {
+    static timer_wheel_t wheel;
+    static soft_timer_t timers[MAX_TIMERS];
+    static uint32_t delays[MAX_TIMERS];
+    uint32_t seed = 1;
+    uint64_t fired = 0;
+    for (int i = 0; i < MAX_TIMERS; i++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        delays[i] = 1 + seed % TIMER_SPAN;
+        timers[i] = (soft_timer_t) {.callback = timerFired, .context = &fired};
+    }
+    timer_wheel_init(&wheel, 0);
+    for (uint64_t done = 0; done < iterations; done += timer_count) {
+        uint64_t base = wheel.now;
+        for (int i = 0; i < timer_count; i++) {
+            timers[i].expires = base + delays[i];
+            timer_wheel_add(&wheel, &timers[i]);
+        }
+        if (expire) {
+            timer_wheel_advance(&wheel, base + TIMER_SPAN);
+        } else {
+            for (int i = 0; i < timer_count; i++) {
+                timer_wheel_remove(&wheel, &timers[i]);
+            }
+        }
+    }
+    KEEP(fired);
+}
+
+static void benchTimerInsert10(uint64_t iterations) {
+    timerWheelRounds(iterations, 10, false);
+}
+
+static void benchTimerInsert100(uint64_t iterations) {
+    timerWheelRounds(iterations, 100, false);
+}
+
+static void benchTimerInsert1000(uint64_t iterations) {
+    timerWheelRounds(iterations, 1000, false);
+}
+
+static void benchTimerExpire10(uint64_t iterations) {
+    timerWheelRounds(iterations, 10, true);
+}
+
+static void benchTimerExpire100(uint64_t iterations) {
+    timerWheelRounds(iterations, 100, true);
+}
+
+static void benchTimerExpire1000(uint64_t iterations) {
+    timerWheelRounds(iterations, 1000, true);
+}
+
+/////////////////////////////////////////////////////
+//                      HARNESS                    //
+/////////////////////////////////////////////////////
+
+/* The batch size doubles until a batch takes BATCH_MS; the fastest of RUNS such batches counts. */
+static double measure(const bench_case_t *c) {
+    uint64_t iterations = 1;
+    double elapsed;
+    while (true) {
+        double start = nowNs();
+        c->run(iterations);
+        elapsed = nowNs() - start;
+        if (elapsed >= BATCH_MS * 1e6) {
+            break;
+        }
+        iterations *= (elapsed < BATCH_MS * 1e5) ? 10 : 2;
+    }
+    double best = elapsed / iterations;
+    for (int run = 1; run < RUNS; run++) {
+        double start = nowNs();
+        c->run(iterations);
+        double ns = (nowNs() - start) / iterations;
+        if (ns < best) {
+            best = ns;
+        }
+    }
+    return best;
+}
+
+static double nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static bool selected(const char *name, char **names, int count) {
+    if (0 == count) {
+        return true;
+    }
+    for (int i = 0; i < count; i++) {
+        if (0 == strcmp(name, names[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void printResults(const result_t *results, int count, bool csv) {
+    if (true == csv) {
+        printf("name,ns_per_op,ops_per_s,mb_per_s\n");
+    } else {
+        printf("[\n");
+    }
+    for (int i = 0; i < count; i++) {
+        const result_t *r = &results[i];
+        double ops = 1e9 / r->ns_per_op;
+        double mb = r->c->bytes * ops / 1e6;
+        if (true == csv) {
+            printf("%s,%.3f,%.0f,%.1f\n", r->c->name, r->ns_per_op, ops, mb);
+        } else {
+            printf("  {\"name\": \"%s\", \"ns_per_op\": %.3f, \"ops_per_s\": %.0f, \"mb_per_s\": %.1f}%s\n",
+                   r->c->name, r->ns_per_op, ops, mb, (i + 1 < count) ? "," : "");
+        }
+    }
+    if (false == csv) {
+        printf("]\n");
+    }
+}
+
+static bool saveBaseline(const char *path, const result_t *results, int count) {
+    FILE *file = fopen(path, "w");
+    if (NULL == file) {
+        perror(path);
+        return false;
+    }
+    fprintf(file, "name,ns_per_op\n");
+    for (int i = 0; i < count; i++) {
+        fprintf(file, "%s,%.3f\n", results[i].c->name, results[i].ns_per_op);
+    }
+    fclose(file);
+    return true;
+}
+
+/* Cases missing from the baseline are reported but do not fail the run. */
+static int compareBaseline(const char *path, const result_t *results, int count, double threshold) {
+    FILE *file = fopen(path, "r");
+    if (NULL == file) {
+        perror(path);
+        return 2;
+    }
+    char line[128];
+    char names[MAX_CASES][MAX_NAME];
+    double ns[MAX_CASES];
+    int known = 0;
+    while (known < MAX_CASES && NULL != fgets(line, sizeof(line), file)) {
+        if (2 == sscanf(line, "%31[^,],%lf", names[known], &ns[known])) {
+            known++;
+        }
+    }
+    fclose(file);
+
+    int failed = 0;
+    for (int i = 0; i < count; i++) {
+        const result_t *r = &results[i];
+        int b = 0;
+        while (b < known && 0 != strcmp(names[b], r->c->name)) {
+            b++;
+        }
+        if (b == known) {
+            fprintf(stderr, "%-24s no baseline\n", r->c->name);
+            continue;
+        }
+        double change = (r->ns_per_op - ns[b]) * 100.0 / ns[b];
+        bool regressed = change > threshold;
+        fprintf(stderr, "%-24s %10.3f ns, baseline %10.3f ns, %+6.1f%%%s\n", r->c->name, r->ns_per_op, ns[b], change,
+                regressed ? "  REGRESSION" : "");
+        failed += regressed;
+    }
+    if (failed > 0) {
+        fprintf(stderr, "%d of %d cases more than %.0f%% slower than %s\n", failed, count, threshold, path);
+        return 1;
+    }
+    return 0;
+}
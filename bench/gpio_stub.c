@@ -0,0 +1,20 @@
+#include "hardware/gpio.h"
+
+/* The planner case steps real stepper_t motors; on the host their pins go nowhere, so the benchmark measures the step
+ * generation and not a GPIO model. */
+
+static volatile uint32_t outputs;
+
+void gpio_init(uint gpio) {
+}
+
+void gpio_set_dir(uint gpio, bool out) {
+}
+
+void gpio_put(uint gpio, bool value) {
+    if (value) {
+        outputs |= 1u << gpio;
+    } else {
+        outputs &= ~(1u << gpio);
+    }
+}
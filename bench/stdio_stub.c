@@ -0,0 +1,27 @@
+#include <stddef.h>
+#include "pico/stdio.h"
+
+/* The console of the CLI and DLOG cases: bench_stdin_set() makes input bytes wait as if they had arrived on the UART,
+ * output bytes are counted. */
+
+static const char *input;
+static size_t input_left;
+static volatile size_t output_count;
+
+void bench_stdin_set(const char *data, size_t length) {
+    input = data;
+    input_left = length;
+}
+
+int getchar_timeout_us(uint32_t timeout_us) {
+    if (0 == input_left) {
+        return -1;
+    }
+    input_left--;
+    return (unsigned char) *input++;
+}
+
+int putchar_raw(int c) {
+    output_count++;
+    return c;
+}
@@ -0,0 +1,322 @@
+#include <string.h>
+#include <ctype.h>
+
+#include "at_response.h"
+
+#define DEV_EUI_TAG "DevEui,"
+
+typedef enum {
+    STATE_START,  // nothing of the line yet
+    STATE_PREFIX, // after the '+', up to the ':'
+    STATE_SPACE,  // between the ':' and the value
+    STATE_ID,     // the value of an ID line, its digits converted as they come
+    STATE_VALUE,  // the value of other lines, only kept
+    STATE_TEXT    // a line without a prefix, only kept
+} state_t;
+
+/* A string constant and its length, for the tables below */
+#define TEXT(s) s, sizeof(s) - 1
+
+typedef struct {
+    const char *name;
+    uint8_t length;
+    at_response_type_t type;
+} prefix_t;
+
+typedef struct {
+    const char *value;
+    uint8_t length;
+    int kind; // at_id_t or at_join_t
+} keyword_t;
+
+#define PREFIX_COUNT (sizeof(prefixes) / sizeof(prefixes[0]))
+#define NO_PREFIX 0xFF
+
+static const prefix_t prefixes[] = {
+        {TEXT("AT"),     AT_RESPONSE_AT},
+        {TEXT("ID"),     AT_RESPONSE_ID},
+        {TEXT("VER"),    AT_RESPONSE_VER},
+        {TEXT("JOIN"),   AT_RESPONSE_JOIN},
+        {TEXT("MSGHEX"), AT_RESPONSE_MSGHEX},
+};
+
+static const keyword_t ids[] = {
+        {TEXT("DevAddr,"), AT_ID_DEV_ADDR},
+        {TEXT("DevEui,"),  AT_ID_DEV_EUI},
+        {TEXT("AppEui,"),  AT_ID_APP_EUI},
+};
+
+static const keyword_t joins[] = {
+        {TEXT("Network joined"), AT_JOIN_JOINED},
+        {TEXT("Joined already"), AT_JOIN_ALREADY},
+        {TEXT("Join failed"),    AT_JOIN_FAILED},
+        {TEXT("Done"),           AT_JOIN_DONE},
+};
+
+/* The value of a hexadecimal digit by its character, -1 for all other characters: one load per character instead of
+ * isxdigit() and tolower(), which go through the locale of the C library. */
+static const int8_t hex_values[256] = {
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, // 0x00
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, // 0x10
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, // 0x20
+         0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1, // 0x30
+        -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, // 0x40
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, // 0x50
+        -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, // 0x60
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, // 0x70
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, // 0x80
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, // 0x90
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, // 0xa0
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, // 0xb0
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, // 0xc0
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, // 0xd0
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, // 0xe0
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, // 0xf0
+};
+
+static const char hex_digits[] = "0123456789abcdef";
+
+static bool startsWith(const char *text, const char *start, size_t length);
+static const at_response_t *feedByte(at_parser_t *parser, uint8_t c);
+static uint8_t matchPrefix(const char *matched, uint8_t length, uint8_t from, uint8_t c);
+static inline void idDigit(at_response_t *response, uint8_t *nibbles, bool *separator_seen, uint8_t c);
+static size_t idDigits(at_parser_t *parser, const uint8_t *data, size_t i, size_t length);
+static int keyword(const keyword_t *keywords, size_t count, const char *value, int other);
+static const at_response_t *endLine(at_parser_t *parser);
+
+void at_parser_init(at_parser_t *parser) {
+    memset(parser, 0, sizeof(at_parser_t));
+    parser->state = STATE_START;
+}
+
+const at_response_t *at_parser_feed(at_parser_t *parser, uint8_t c) {
+    return feedByte(parser, c);
+}
+
+/* The prefix is taken byte by byte as in at_parser_feed(), the digits of an ID in one loop; the rest of a line, which
+ * is only kept, goes into it as one block up to the line feed. */
+size_t at_parser_feed_bytes(at_parser_t *parser, const uint8_t *data, size_t length, const at_response_t **response) {
+    at_response_t *line = &parser->response;
+    size_t i = 0;
+
+    *response = NULL;
+    while (i < length) {
+        if (STATE_ID == parser->state) {
+            i = idDigits(parser, data, i, length);
+            if (i < length) {
+                *response = endLine(parser);
+                return i + 1;
+            }
+            break;
+        }
+        if (STATE_VALUE != parser->state && STATE_TEXT != parser->state) {
+            *response = feedByte(parser, data[i++]);
+            if (NULL != *response) {
+                return i;
+            }
+            continue;
+        }
+        const uint8_t *line_feed = memchr(&data[i], '\n', length - i);
+        size_t end = (NULL != line_feed) ? (size_t) (line_feed - data) : length;
+        size_t count = end - i;
+        if (count > (size_t) (AT_MAX_LINE - 1 - line->length)) {
+            count = AT_MAX_LINE - 1 - line->length;
+        }
+        memcpy(&line->line[line->length], &data[i], count);
+        line->length += count;
+        i = end;
+        if (NULL != line_feed) {
+            *response = endLine(parser);
+            return i + 1;
+        }
+    }
+    return i;
+}
+
+void at_hex_string(const uint8_t *bytes, size_t length, char *output) {
+    for (size_t i = 0; i < length; i++) {
+        *output++ = hex_digits[bytes[i] >> 4];
+        *output++ = hex_digits[bytes[i] & 0x0F];
+    }
+    *output = '\0';
+}
+
+void removeColonsAndLowercase(const char *input, char *output) {
+    int inputLength = strlen(input);
+    int outputIndex = 0;
+
+    for (int i = 0; i < inputLength; i++) {
+        if (isxdigit((unsigned char) input[i])) {
+            output[outputIndex] = tolower(input[i]);
+            outputIndex++;
+        }
+    }
+
+    output[outputIndex] = '\0';
+}
+
+bool parseDevEui(const char *line, char *dev_eui) {
+    const char *tag = strstr(line, DEV_EUI_TAG);
+    if (NULL == tag) {
+        return false;
+    }
+    removeColonsAndLowercase(tag + strlen(DEV_EUI_TAG), dev_eui);
+    return true;
+}
+
+/* A loop the compiler keeps inline: the strings here are a few characters long, and most differ in the first one. The
+ * zero at the end of text stops it like any other mismatch. */
+static bool startsWith(const char *text, const char *start, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        if (text[i] != start[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* One byte into the line and through the state machine; a carriage return is kept like any other byte until the line
+ * feed, where it is dropped from the end of the line. */
+static const at_response_t *feedByte(at_parser_t *parser, uint8_t c) {
+    at_response_t *response = &parser->response;
+    state_t state = parser->state;
+
+    if (STATE_START == state) {
+        // the line ends of the previous line and empty lines
+        if ('\n' == c || '\r' == c) {
+            return NULL;
+        }
+        // the previous response is handed over until here
+        response->type = AT_RESPONSE_OTHER;
+        response->length = 0;
+        parser->prefix_length = 0;
+        parser->prefix = 0;
+        parser->value_start = AT_MAX_LINE - 1;
+        parser->id_separator_seen = false;
+        parser->nibbles = 0;
+    } else if ('\n' == c) {
+        return endLine(parser);
+    } else if (STATE_ID == state) {
+        if (response->length < AT_MAX_LINE - 1) {
+            response->line[response->length++] = (char) c;
+        }
+        idDigit(response, &parser->nibbles, &parser->id_separator_seen, c);
+        return NULL;
+    }
+    if (response->length < AT_MAX_LINE - 1) {
+        response->line[response->length++] = (char) c;
+    }
+
+    switch (state) {
+        case STATE_START:
+            parser->state = ('+' == c) ? STATE_PREFIX : STATE_TEXT;
+            break;
+        case STATE_PREFIX:
+            if (':' == c) {
+                // the prefix so far may be the start of a longer one
+                uint8_t prefix = parser->prefix;
+                if (NO_PREFIX != prefix && prefixes[prefix].length != parser->prefix_length) {
+                    prefix = matchPrefix(&response->line[1], parser->prefix_length, prefix + 1, '\0');
+                }
+                response->type = (NO_PREFIX != prefix) ? prefixes[prefix].type : AT_RESPONSE_OTHER;
+                parser->state = STATE_SPACE;
+            } else if (parser->prefix_length < AT_MAX_PREFIX) {
+                uint8_t prefix = parser->prefix;
+                uint8_t position = parser->prefix_length++;
+                if (NO_PREFIX != prefix && (uint8_t) prefixes[prefix].name[position] != c) {
+                    parser->prefix = matchPrefix(&response->line[1], position, prefix + 1, c);
+                }
+            } else {
+                parser->state = STATE_TEXT;
+            }
+            break;
+        case STATE_SPACE:
+            if (' ' == c) {
+                break;
+            }
+            parser->value_start = response->length - 1;
+            parser->state = (AT_RESPONSE_ID == response->type) ? STATE_ID : STATE_VALUE;
+            parser->id_separator_seen = (',' == c);
+            break;
+        default:
+            break;
+    }
+    return NULL;
+}
+
+/* The first prefix from the table index from on that starts with the length characters matched so far and then c, or
+ * with c = '\0' the one that has just them; NO_PREFIX if none. The prefix of the parser is the first one its
+ * characters match, so this only runs when the next character rules it out. */
+static uint8_t matchPrefix(const char *matched, uint8_t length, uint8_t from, uint8_t c) {
+    for (uint8_t i = from; i < PREFIX_COUNT; i++) {
+        if (prefixes[i].length >= length && (uint8_t) prefixes[i].name[length] == c &&
+            startsWith(prefixes[i].name, matched, length)) {
+            return i;
+        }
+    }
+    return NO_PREFIX;
+}
+
+/* "DevEui, 2C:F7:F1:20:32:30:A5:70": the digits after the ',' two by two into bytes, the ':' in between skipped. */
+static inline void idDigit(at_response_t *response, uint8_t *nibbles, bool *separator_seen, uint8_t c) {
+    int8_t value = hex_values[c];
+    if (false == *separator_seen) {
+        *separator_seen = (',' == c);
+    } else if (value >= 0 && *nibbles < 2 * AT_MAX_ID) {
+        uint8_t *byte = &response->id_bytes[*nibbles / 2];
+        *byte = (0 == *nibbles % 2) ? (uint8_t) (value << 4) : (uint8_t) (*byte | value);
+        (*nibbles)++;
+    }
+}
+
+/* idDigit() for the bytes from i up to the line feed; returns where it stopped. The counts are kept in locals, as the
+ * stores into the line could otherwise change them for the compiler. */
+static size_t idDigits(at_parser_t *parser, const uint8_t *data, size_t i, size_t length) {
+    at_response_t *response = &parser->response;
+    uint8_t stored = response->length;
+    uint8_t nibbles = parser->nibbles;
+    bool separator_seen = parser->id_separator_seen;
+    for (; i < length && '\n' != data[i]; i++) {
+        if (stored < AT_MAX_LINE - 1) {
+            response->line[stored++] = (char) data[i];
+        }
+        idDigit(response, &nibbles, &separator_seen, data[i]);
+    }
+    response->length = stored;
+    parser->nibbles = nibbles;
+    parser->id_separator_seen = separator_seen;
+    return i;
+}
+
+static int keyword(const keyword_t *keywords, size_t count, const char *value, int other) {
+    for (size_t i = 0; i < count; i++) {
+        if (startsWith(value, keywords[i].value, keywords[i].length)) {
+            return keywords[i].kind;
+        }
+    }
+    return other;
+}
+
+/* The line is complete: the value and the keyword of a join are looked up once, the rest is known by now. A line
+ * ending in "\r\n" loses its '\r'. */
+static const at_response_t *endLine(at_parser_t *parser) {
+    at_response_t *response = &parser->response;
+    size_t length = response->length;
+    if (length > 0 && '\r' == response->line[length - 1]) {
+        length--;
+    }
+    response->line[length] = '\0';
+    response->length = (uint8_t) length;
+    response->value = &response->line[(parser->value_start < length) ? parser->value_start : length];
+    response->id = AT_ID_OTHER;
+    response->id_length = 0;
+    response->join = AT_JOIN_PROGRESS;
+    if (AT_RESPONSE_ID == response->type) {
+        response->id = keyword(ids, sizeof(ids) / sizeof(ids[0]), response->value, AT_ID_OTHER);
+        response->id_length = parser->nibbles / 2;
+    } else if (AT_RESPONSE_JOIN == response->type) {
+        response->join = keyword(joins, sizeof(joins) / sizeof(joins[0]), response->value, AT_JOIN_PROGRESS);
+    }
+    parser->state = STATE_START;
+    return response;
+}
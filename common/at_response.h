@@ -0,0 +1,86 @@
+#ifndef COMMON_AT_RESPONSE_H
+#define COMMON_AT_RESPONSE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Processing of the LoRa-E5 response lines, for Exercise 3 and the LoRaWAN client (lorawan.h). */
+
+#define AT_MAX_LINE 80
+#define AT_MAX_PREFIX 8
+#define AT_MAX_ID 8 // DevEui and AppEui; DevAddr has 4 bytes
+
+typedef enum {
+    AT_RESPONSE_OTHER, // a line without one of the prefixes below, e.g. "+MODE: LWOTAA"
+    AT_RESPONSE_AT,    // "+AT: OK"
+    AT_RESPONSE_ID,    // "+ID: DevEui, 2C:F7:F1:20:32:30:A5:70"
+    AT_RESPONSE_VER,   // "+VER: 4.0.11"
+    AT_RESPONSE_JOIN,  // "+JOIN: Network joined"
+    AT_RESPONSE_MSGHEX // "+MSGHEX: Done"
+} at_response_type_t;
+
+typedef enum {
+    AT_ID_OTHER,
+    AT_ID_DEV_ADDR,
+    AT_ID_DEV_EUI,
+    AT_ID_APP_EUI
+} at_id_t;
+
+typedef enum {
+    AT_JOIN_PROGRESS, // "Start", "NORMAL", "NetID ..." and the like
+    AT_JOIN_JOINED,   // "Network joined"
+    AT_JOIN_ALREADY,  // "Joined already": no "Done" follows
+    AT_JOIN_FAILED,   // "Join failed"
+    AT_JOIN_DONE      // "Done": the last line of a join, whatever its outcome
+} at_join_t;
+
+/* A complete response line. line is the whole line without its line end, value the text after "<prefix>: " in it. */
+typedef struct {
+    at_response_type_t type;
+    char line[AT_MAX_LINE];
+    uint8_t length;
+    const char *value;
+    at_id_t id;                  // AT_RESPONSE_ID: which one
+    uint8_t id_bytes[AT_MAX_ID]; // AT_RESPONSE_ID: its hex digits as binary, first byte first
+    uint8_t id_length;
+    at_join_t join;              // AT_RESPONSE_JOIN
+} at_response_t;
+
+/* Parses the responses as the bytes arrive from the UART: the prefix is matched as its characters come in, so that the
+ * type is known at the ':', and the hex digits of an ID are converted one at a time; a line is complete at its line
+ * feed with little left to look up. */
+typedef struct {
+    uint8_t state;
+    uint8_t prefix_length;
+    uint8_t prefix;      // the first prefix the characters so far match
+    uint8_t value_start;
+    bool id_separator_seen;
+    uint8_t nibbles;
+    at_response_t response;
+} at_parser_t;
+
+void at_parser_init(at_parser_t *parser);
+
+/* Takes one received byte. Returns the response when the byte ends a non-empty line, NULL otherwise; it stays valid
+ * until the next call. Lines longer than AT_MAX_LINE are cut, bytes of an ID beyond AT_MAX_ID are dropped. */
+const at_response_t *at_parser_feed(at_parser_t *parser, uint8_t c);
+
+/* Takes up to length received bytes at once, as they were read from the UART, and stops after the first one that ends a
+ * non-empty line. Returns the number of bytes taken; *response is set as at_parser_feed() returns it for the last of
+ * them. */
+size_t at_parser_feed_bytes(at_parser_t *parser, const uint8_t *data, size_t length, const at_response_t **response);
+
+/* Writes length bytes as 2 * length lower case hex digits and a terminating zero, e.g. the DevEui as the network server
+ * wants it. */
+void at_hex_string(const uint8_t *bytes, size_t length, char *output);
+
+/* Copies the hexadecimal digits of input in lower case, e.g. "2C:F7:F1" -> "2cf7f1". output needs room for all of
+ * input. */
+void removeColonsAndLowercase(const char *input, char *output);
+
+/* "+ID: DevEui, 2C:F7:F1:20:32:30:A5:70" -> "2cf7f1203230a570". Returns false if the line has no DevEui. The whole
+ * line has to be there; main.c uses at_parser_t, bench/ compares the two. */
+bool parseDevEui(const char *line, char *dev_eui);
+
+#endif //COMMON_AT_RESPONSE_H
@@ -0,0 +1,34 @@
+#include "hardware/gpio.h"
+#include "hardware/pwm.h"
+
+#include "board.h"
+
+void board_outputs_init(const uint *pins, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        gpio_init(pins[i]);
+        gpio_set_dir(pins[i], GPIO_OUT);
+    }
+}
+
+void board_buttons_init(const uint *pins, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        gpio_init(pins[i]);
+        gpio_set_dir(pins[i], GPIO_IN);
+        gpio_pull_up(pins[i]);
+    }
+}
+
+/* The slice is stopped while it is configured; both channels of a slice share divider and wrap. */
+void board_pwm_init(const uint *pins, size_t count, uint divider, uint wrap, uint level) {
+    pwm_config config = pwm_get_default_config();
+    pwm_config_set_clkdiv_int(&config, divider);
+    pwm_config_set_wrap(&config, wrap);
+    for (size_t i = 0; i < count; i++) {
+        uint slice = pwm_gpio_to_slice_num(pins[i]);
+        pwm_set_enabled(slice, false);
+        pwm_init(slice, &config, false);
+        pwm_set_chan_level(slice, pwm_gpio_to_channel(pins[i]), level);
+        gpio_set_function(pins[i], GPIO_FUNC_PWM);
+        pwm_set_enabled(slice, true);
+    }
+}
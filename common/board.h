@@ -0,0 +1,15 @@
+#ifndef COMMON_BOARD_H
+#define COMMON_BOARD_H
+
+#include <stddef.h>
+#include "pico.h"
+
+/* Set-up of the LEDs and buttons of the board that every project does the same way. The buttons are active low with
+ * the internal pull-ups; a PWM output starts at the given level and is enabled, with divider and wrap of its slice set
+ * (the projects run at 125 MHz / 125 = 1 MHz and wrap at 999 for 1 kHz). */
+
+void board_outputs_init(const uint *pins, size_t count);
+void board_buttons_init(const uint *pins, size_t count);
+void board_pwm_init(const uint *pins, size_t count, uint divider, uint wrap, uint level);
+
+#endif //COMMON_BOARD_H
@@ -0,0 +1,212 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+
+#include "cli.h"
+#include "io_record.h"
+
+#define BACKSPACE 0x08
+#define DELETE 0x7F
+
+static const cli_command_t *findCommand(const cli_t *cli, const char *name);
+static int tokenize(char *line, char *tokens[], int max_tokens);
+static bool parseArgs(const char *spec, char *tokens[], int count, cli_args_t *args);
+
+void cli_init(cli_t *cli, const cli_command_t *commands, size_t command_count) {
+    cli->commands = commands;
+    cli->command_count = command_count;
+    cli->length = 0;
+    cli->overflow = false;
+    cli->frame_sink = NULL;
+    cli->frame_context = NULL;
+    cli->in_frame = false;
+
+    for (size_t i = 1; i < command_count; i++) {
+        if (strcmp(commands[i - 1].name, commands[i].name) >= 0) {
+            printf("CLI: command table not sorted at \"%s\".\n", commands[i].name);
+        }
+    }
+}
+
+/* Binary frames (see proto.h) start with a zero byte, which never appears in text. */
+void cli_set_frame_sink(cli_t *cli, cli_frame_sink_t sink, void *context) {
+    cli->frame_sink = sink;
+    cli->frame_context = context;
+}
+
+/* Takes whatever input is already waiting, never blocks. */
+void cli_poll(cli_t *cli) {
+    for (int i = 0; i < CLI_MAX_POLL_CHARS; i++) {
+        int c = getchar_timeout_us(0);
+        if (c < 0) {
+            break;
+        }
+        IO_RECORD_STDIN((uint8_t) c);
+        cli_feed(cli, (char) c);
+    }
+}
+
+void cli_feed(cli_t *cli, char c) {
+    if (NULL != cli->frame_sink && (true == cli->in_frame || '\0' == c)) {
+        cli->in_frame = cli->frame_sink(cli->frame_context, (uint8_t) c);
+    } else if ('\r' == c || '\n' == c) {
+#if CLI_ECHO
+        printf("\n");
+#endif
+        if (true == cli->overflow) {
+            printf("Line too long.\n");
+        } else if (cli->length > 0) {
+            cli->line[cli->length] = '\0';
+            cli_execute(cli, cli->line);
+        }
+        cli->length = 0;
+        cli->overflow = false;
+    } else if (BACKSPACE == c || DELETE == c) {
+        if (cli->length > 0 && false == cli->overflow) {
+            cli->length--;
+#if CLI_ECHO
+            printf("\b \b");
+#endif
+        }
+    } else if (cli->length < CLI_MAX_LINE - 1) {
+        cli->line[cli->length++] = c;
+#if CLI_ECHO
+        putchar(c);
+#endif
+    } else {
+        // rest of the line is dropped and the line is rejected at the end
+        cli->overflow = true;
+    }
+}
+
+/* Tokenizes line in place and runs the matching command. Returns false if the command is unknown or the arguments
+ * do not match. */
+bool cli_execute(cli_t *cli, char *line) {
+    char *tokens[CLI_MAX_ARGS + 1];
+    int count = tokenize(line, tokens, CLI_MAX_ARGS + 1);
+    if (0 == count) {
+        return true;
+    }
+
+    const cli_command_t *command = findCommand(cli, tokens[0]);
+    if (NULL == command) {
+        printf("Unknown command: %s\n", tokens[0]);
+        return false;
+    }
+
+    cli_args_t args;
+    if (false == parseArgs(command->args, &tokens[1], count - 1, &args)) {
+        printf("Usage: %s %s\n", command->name, command->args);
+        return false;
+    }
+    command->handler(&args);
+    return true;
+}
+
+static const cli_command_t *findCommand(const cli_t *cli, const char *name) {
+    size_t low = 0;
+    size_t high = cli->command_count;
+
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        int order = strcmp(name, cli->commands[mid].name);
+        if (0 == order) {
+            return &cli->commands[mid];
+        } else if (order < 0) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+    return NULL;
+}
+
+/* Returns the number of tokens, or max_tokens + 1 if there were more. */
+static int tokenize(char *line, char *tokens[], int max_tokens) {
+    int count = 0;
+
+    while (count < max_tokens) {
+        while (' ' == *line || '\t' == *line) {
+            line++;
+        }
+        if ('\0' == *line) {
+            break;
+        }
+        tokens[count++] = line;
+        while (*line && ' ' != *line && '\t' != *line) {
+            line++;
+        }
+        if (*line) {
+            *line++ = '\0';
+        }
+    }
+    while (' ' == *line || '\t' == *line) {
+        line++;
+    }
+    return *line ? max_tokens + 1 : count;
+}
+
+static bool parseArgs(const char *spec, char *tokens[], int count, cli_args_t *args) {
+    bool optional = false;
+    int index = 0;
+
+    args->argc = 0;
+    if (count > CLI_MAX_ARGS) {
+        return false;
+    }
+
+    for (const char *type = spec; *type; type++) {
+        if ('?' == type[1]) {
+            optional = true;
+        }
+        if (index >= count) {
+            return optional;
+        }
+
+        const char *token = tokens[index];
+        bool valid;
+        switch (*type) {
+            case 'u':
+                valid = cli_parse_unsigned(token, &args->argv[index].u);
+                break;
+            case 'i':
+                valid = cli_parse_signed(token, &args->argv[index].i);
+                break;
+            case 's':
+                args->argv[index].s = token;
+                valid = true;
+                break;
+            default:
+                return false;
+        }
+        if (false == valid) {
+            return false;
+        }
+        args->argc = ++index;
+        if ('?' == type[1]) {
+            type++;
+        }
+    }
+    return index == count;
+}
+
+bool cli_parse_unsigned(const char *text, uint32_t *value) {
+    char *end;
+    if ('-' == text[0] || '\0' == text[0]) {
+        return false;
+    }
+    errno = 0;
+    unsigned long number = strtoul(text, &end, 10);
+    *value = (uint32_t) number;
+    return '\0' == *end && 0 == errno && number <= UINT32_MAX;
+}
+
+bool cli_parse_signed(const char *text, int32_t *value) {
+    char *end;
+    errno = 0;
+    long number = strtol(text, &end, 10);
+    *value = (int32_t) number;
+    return '\0' != text[0] && '\0' == *end && 0 == errno && number >= INT32_MIN && number <= INT32_MAX;
+}
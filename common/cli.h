@@ -0,0 +1,64 @@
+#ifndef COMMON_CLI_H
+#define COMMON_CLI_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define CLI_MAX_LINE 64
+#define CLI_MAX_ARGS 6
+#define CLI_MAX_POLL_CHARS 32 // bounds the time one cli_poll() can take from the main loop
+
+#ifndef CLI_ECHO
+#define CLI_ECHO 0
+#endif
+
+typedef union {
+    uint32_t u;
+    int32_t i;
+    const char *s;
+} cli_value_t;
+
+typedef struct {
+    int argc;
+    cli_value_t argv[CLI_MAX_ARGS];
+} cli_args_t;
+
+typedef void (*cli_handler_t)(const cli_args_t *args);
+
+/* One command. args describes the arguments: 'u' unsigned, 'i' signed (both decimal, so 010 is ten, and within 32
+ * bits), 's' string. A '?' after a letter makes that argument and all following ones optional, e.g. "u?" is one
+ * optional unsigned number. */
+typedef struct {
+    const char *name;
+    const char *args;
+    cli_handler_t handler;
+} cli_command_t;
+
+/* Receives raw bytes while the line is in frame mode: from a zero byte until the sink returns false. */
+typedef bool (*cli_frame_sink_t)(void *context, uint8_t byte);
+
+/* The command table must be sorted by name (strcmp order); it is searched with binary search. */
+typedef struct {
+    const cli_command_t *commands;
+    size_t command_count;
+    char line[CLI_MAX_LINE];
+    size_t length;
+    bool overflow;
+    cli_frame_sink_t frame_sink;
+    void *frame_context;
+    bool in_frame;
+} cli_t;
+
+void cli_init(cli_t *cli, const cli_command_t *commands, size_t command_count);
+void cli_set_frame_sink(cli_t *cli, cli_frame_sink_t sink, void *context);
+void cli_poll(cli_t *cli);
+void cli_feed(cli_t *cli, char c);
+bool cli_execute(cli_t *cli, char *line);
+
+/* The number parsing of the 'u' and 'i' arguments, for handlers that take their own apart: false unless the whole of
+ * text is a decimal number within 32 bits. */
+bool cli_parse_unsigned(const char *text, uint32_t *value);
+bool cli_parse_signed(const char *text, int32_t *value);
+
+#endif //COMMON_CLI_H
@@ -0,0 +1,44 @@
+#include "cobs.h"
+
+size_t cobs_encode(const uint8_t *input, size_t length, uint8_t *output) {
+    size_t code_index = 0;
+    size_t out = 1;
+    uint8_t code = 1;
+
+    for (size_t i = 0; i < length; i++) {
+        if (0 == input[i]) {
+            output[code_index] = code;
+            code_index = out++;
+            code = 1;
+        } else {
+            output[out++] = input[i];
+            if (0xFF == ++code) {
+                output[code_index] = code;
+                code_index = out++;
+                code = 1;
+            }
+        }
+    }
+    output[code_index] = code;
+    return out;
+}
+
+// Returns the decoded length, or 0 if the input is malformed.
+size_t cobs_decode(const uint8_t *input, size_t length, uint8_t *output) {
+    size_t in = 0;
+    size_t out = 0;
+
+    while (in < length) {
+        uint8_t code = input[in++];
+        if (0 == code || in + code - 1 > length) {
+            return 0;
+        }
+        for (uint8_t i = 1; i < code; i++) {
+            output[out++] = input[in++];
+        }
+        if (0xFF != code && in < length) {
+            output[out++] = 0;
+        }
+    }
+    return out;
+}
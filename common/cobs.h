@@ -0,0 +1,12 @@
+#ifndef COMMON_COBS_H
+#define COMMON_COBS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Consistent Overhead Byte Stuffing: the output contains no zero bytes and is at most length / 254 + 1 bytes longer
+ * than the input. */
+size_t cobs_encode(const uint8_t *input, size_t length, uint8_t *output);
+size_t cobs_decode(const uint8_t *input, size_t length, uint8_t *output);
+
+#endif //COMMON_COBS_H
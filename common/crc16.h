@@ -0,0 +1,10 @@
+#ifndef COMMON_CRC16_H
+#define COMMON_CRC16_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* CRC-16/CCITT-FALSE. Running it over data followed by its CRC (MSB first) gives zero. */
+uint16_t crc16(const uint8_t *data_p, size_t length);
+
+#endif //COMMON_CRC16_H
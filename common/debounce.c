@@ -0,0 +1,16 @@
+#include "debounce.h"
+#include "ram_func.h"
+
+/* Returns true when the filtered level changes; button->level is the new level. */
+bool RAM_FUNC(debounce_sample)(debounce_t *button, bool level, uint8_t filter) {
+    if (button->level == level) {
+        button->count = 0;
+        return false;
+    }
+    if (++button->count < filter) {
+        return false;
+    }
+    button->level = level;
+    button->count = 0;
+    return true;
+}
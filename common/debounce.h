@@ -0,0 +1,18 @@
+#ifndef COMMON_DEBOUNCE_H
+#define COMMON_DEBOUNCE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Button filter for periodic sampling: the level is taken over after it has been read the same filter times in a row.
+ * A zero initialised filter starts at level 0 (pressed for the active low buttons on the board), so the first stable
+ * released reading changes it without an event from the caller. */
+
+typedef struct {
+    bool level;
+    uint8_t count;
+} debounce_t;
+
+bool debounce_sample(debounce_t *button, bool level, uint8_t filter);
+
+#endif //COMMON_DEBOUNCE_H
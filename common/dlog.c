@@ -0,0 +1,69 @@
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+
+#include "dlog.h"
+#include "proto.h"
+
+typedef struct {
+    uint32_t timestamp;
+    const char *format;
+    uint32_t argc;
+    uint32_t args[DLOG_MAX_ARGS];
+} dlog_record_t;
+
+// start of the format strings of DLOG(); weak, as a program without a DLOG() has no such section
+extern const char __start_dlog_formats[] __attribute__((weak));
+
+static dlog_record_t ring[DLOG_RING_SIZE];
+static volatile uint32_t head = 0;
+static volatile uint32_t tail = 0;
+static volatile uint32_t dropped = 0;
+
+/* Safe from interrupts: the slot is claimed and filled with interrupts disabled, which is a handful of stores. A full
+ * ring drops the new record and counts it. */
+void dlog_write(const char *format, uint32_t argc, const uint32_t *args) {
+    uint32_t irq_state = save_and_disable_interrupts();
+
+    if (head - tail >= DLOG_RING_SIZE) {
+        dropped++;
+    } else {
+        dlog_record_t *record = &ring[head % DLOG_RING_SIZE];
+        record->timestamp = time_us_32();
+        record->format = format;
+        record->argc = argc;
+        for (uint32_t i = 0; i < argc; i++) {
+            record->args[i] = args[i];
+        }
+        head++;
+    }
+    restore_interrupts(irq_state);
+}
+
+static size_t putU32(uint8_t *buffer, uint32_t value) {
+    buffer[0] = value >> 24; buffer[1] = value >> 16; buffer[2] = value >> 8; buffer[3] = value;
+    return 4;
+}
+
+/* Sends up to max_records and returns how many were sent. Only call from the main loop. */
+int dlog_drain(int max_records) {
+    int count = 0;
+
+    while (count < max_records && tail != head) {
+        dlog_record_t record = ring[tail % DLOG_RING_SIZE];
+        tail++;
+
+        uint8_t payload[8 + 4 * DLOG_MAX_ARGS];
+        size_t length = putU32(payload, record.timestamp);
+        length += putU32(&payload[length], (uint32_t) (record.format - __start_dlog_formats));
+        for (uint32_t i = 0; i < record.argc; i++) {
+            length += putU32(&payload[length], record.args[i]);
+        }
+        proto_send(0, PROTO_LOG_EVENT, PROTO_OK, payload, length);
+        count++;
+    }
+    return count;
+}
+
+uint32_t dlog_dropped(void) {
+    return dropped;
+}
@@ -0,0 +1,44 @@
+#ifndef COMMON_DLOG_H
+#define COMMON_DLOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Deferred logging. DLOG() only stores the format string, a timestamp and up to DLOG_MAX_ARGS raw 32-bit arguments in
+ * a RAM ring; no formatting happens on the board. The format strings are collected in the dlog_formats section, and a
+ * record refers to its format by the offset in there, which is 32 bits wherever the section is loaded, on the board
+ * or in a 64-bit host twin. dlog_drain() is called from the main loop and sends the records as PROTO_LOG_EVENT frames
+ * (see proto.h):
+ *
+ *     u32 timestamp (us), u32 offset of the format in dlog_formats, u32 arguments...
+ *
+ * tools/dlog_decode.c looks the format (and %s arguments, by their address on the board) up in the ELF file and
+ * prints the text. Arguments are always 32 bits, so use %d/%u/%x/%c and %s for string constants only.
+ *
+ * Build option:
+ *  DLOG_DEFERRED  1 for the binary records above, which need the decoder on the other end. Off by default: DLOG() is
+ *                 then a plain printf for a human at a terminal. */
+
+#ifndef DLOG_DEFERRED
+#define DLOG_DEFERRED 0
+#endif
+
+#define DLOG_MAX_ARGS 4
+#define DLOG_RING_SIZE 32 // records, power of two
+
+#if DLOG_DEFERRED
+#define DLOG_COUNT(...) DLOG_COUNT_(0, ##__VA_ARGS__, 4, 3, 2, 1, 0)
+#define DLOG_COUNT_(_0, _1, _2, _3, _4, N, ...) N
+#define DLOG(format, ...) do { \
+        static const char dlog_format[] __attribute__((section("dlog_formats"), used)) = format; \
+        dlog_write(dlog_format, DLOG_COUNT(__VA_ARGS__), (const uint32_t[DLOG_MAX_ARGS + 1]) {0, ##__VA_ARGS__} + 1); \
+    } while (0)
+#else
+#define DLOG(format, ...) printf(format, ##__VA_ARGS__)
+#endif
+
+void dlog_write(const char *format, uint32_t argc, const uint32_t *args);
+int dlog_drain(int max_records);
+uint32_t dlog_dropped(void);
+
+#endif //COMMON_DLOG_H
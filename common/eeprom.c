@@ -0,0 +1,250 @@
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+
+#include "eeprom.h"
+#include "io_record.h"
+
+static eeprom_line_t *lookup(eeprom_t *eeprom, uint16_t page);
+static bool transfer(eeprom_t *eeprom, const uint8_t *out, size_t out_length, uint8_t *in, size_t in_length,
+                     int attempts);
+static void waitWriteCycle(eeprom_t *eeprom, const uint8_t *address);
+static int exchange(eeprom_t *eeprom, const uint8_t *out, size_t out_length, uint8_t *in, size_t in_length);
+static uint timeoutFor(const eeprom_t *eeprom, size_t length);
+
+/* The bus itself (pins and initial speed) is set up by the caller, and so are the line_count lines of the cache. */
+void eeprom_init(eeprom_t *eeprom, i2c_inst_t *i2c, uint8_t device, eeprom_line_t *lines, uint line_count) {
+    eeprom->i2c = i2c;
+    eeprom->device = device;
+    eeprom->lines = lines;
+    eeprom->line_count = line_count;
+    eeprom->bus = NULL;
+    eeprom->baudrate = 0;
+    eeprom->clock = 0;
+    eeprom->hits = 0;
+    eeprom->misses = 0;
+    memset(&eeprom->stats, 0, sizeof(eeprom->stats));
+    eeprom_invalidate(eeprom);
+}
+
+/* Returns the speed in use. If the device does not answer at any speed the bus is left at 100 kHz. */
+uint eeprom_probe(eeprom_t *eeprom, uint max_baudrate) {
+    static const uint speeds[] = {1000000, 400000, 100000};
+    static const uint8_t address[2] = {0, 0};
+    uint8_t first[EEPROM_PAGE_SIZE], second[EEPROM_PAGE_SIZE];
+
+    for (int i = 0; i < sizeof(speeds) / sizeof(speeds[0]); i++) {
+        if (speeds[i] > max_baudrate) {
+            continue;
+        }
+        eeprom->baudrate = i2c_set_baudrate(eeprom->i2c, speeds[i]);
+        if (transfer(eeprom, address, 2, first, sizeof(first), 1) &&
+            transfer(eeprom, address, 2, second, sizeof(second), 1) && 0 == memcmp(first, second, sizeof(first))) {
+            break;
+        }
+    }
+    return eeprom->baudrate;
+}
+
+/* Returns false if a page could not be read; its bytes read as 0xFF (blank) and it is not cached. */
+bool eeprom_read(eeprom_t *eeprom, uint16_t address, uint8_t *data, size_t length) {
+    bool ok = true;
+    while (length > 0) {
+        uint16_t page = address / EEPROM_PAGE_SIZE;
+        size_t offset = address % EEPROM_PAGE_SIZE;
+        size_t chunk = EEPROM_PAGE_SIZE - offset;
+        if (chunk > length) {
+            chunk = length;
+        }
+        eeprom_line_t *line = lookup(eeprom, page);
+        if (NULL != line) {
+            memcpy(data, &line->data[offset], chunk);
+        } else {
+            memset(data, 0xFF, chunk);
+            ok = false;
+        }
+        address += chunk; data += chunk; length -= chunk;
+    }
+    return ok;
+}
+
+uint8_t eeprom_read_byte(eeprom_t *eeprom, uint16_t address) {
+    uint8_t data;
+    eeprom_read(eeprom, address, &data, 1);
+    return data;
+}
+
+/* One transaction and one write cycle per page touched. */
+bool eeprom_write(eeprom_t *eeprom, uint16_t address, const uint8_t *data, size_t length) {
+    uint8_t buffer[EEPROM_PAGE_SIZE + 2];
+    bool ok = true;
+    while (length > 0) {
+        uint16_t page = address / EEPROM_PAGE_SIZE;
+        size_t chunk = EEPROM_PAGE_SIZE - (address % EEPROM_PAGE_SIZE);
+        if (chunk > length) {
+            chunk = length;
+        }
+        for (uint i = 0; i < eeprom->line_count; i++) {
+            if (page == eeprom->lines[i].page) {
+                eeprom->lines[i].page = EEPROM_NO_PAGE;
+                eeprom->lines[i].used = 0;
+            }
+        }
+        buffer[0] = address >> 8; buffer[1] = address;
+        memcpy(&buffer[2], data, chunk);
+        if (transfer(eeprom, buffer, chunk + 2, NULL, 0, EEPROM_ATTEMPTS)) {
+            waitWriteCycle(eeprom, buffer);
+        } else {
+            ok = false;
+        }
+        address += chunk; data += chunk; length -= chunk;
+    }
+    return ok;
+}
+
+bool eeprom_write_byte(eeprom_t *eeprom, uint16_t address, uint8_t data) {
+    return eeprom_write(eeprom, address, &data, 1);
+}
+
+/* Routes all transfers through a bus scheduler shared with other drivers (see i2c_bus.h). */
+void eeprom_use_bus(eeprom_t *eeprom, i2c_bus_t *bus) {
+    eeprom->bus = bus;
+}
+
+void eeprom_invalidate(eeprom_t *eeprom) {
+    for (uint i = 0; i < eeprom->line_count; i++) {
+        eeprom->lines[i].page = EEPROM_NO_PAGE;
+        eeprom->lines[i].used = 0;
+    }
+}
+
+void eeprom_print_stats(const eeprom_t *eeprom) {
+    const eeprom_stats_t *stats = &eeprom->stats;
+    printf("I2C %u kHz: %lu transactions, %lu bytes, %lu NACKs, %lu timeouts, %lu retries, %lu failed\n",
+           eeprom->baudrate / 1000, (unsigned long) stats->transactions, (unsigned long) stats->bytes,
+           (unsigned long) stats->nacks, (unsigned long) stats->timeouts, (unsigned long) stats->retries,
+           (unsigned long) stats->failures);
+    printf("Write cycle polls: %lu, max latency: %lu us\n", (unsigned long) stats->busy_polls,
+           (unsigned long) stats->max_latency_us);
+}
+
+static eeprom_line_t *lookup(eeprom_t *eeprom, uint16_t page) {
+    eeprom_line_t *victim = &eeprom->lines[0];
+    eeprom->clock++;
+    for (uint i = 0; i < eeprom->line_count; i++) {
+        eeprom_line_t *line = &eeprom->lines[i];
+        if (page == line->page) {
+            line->used = eeprom->clock;
+            eeprom->hits++;
+            return line;
+        }
+        if (line->used < victim->used) {
+            victim = line;
+        }
+    }
+    eeprom->misses++;
+
+    uint8_t address[2];
+    address[0] = (page * EEPROM_PAGE_SIZE) >> 8; address[1] = (uint8_t) (page * EEPROM_PAGE_SIZE);
+    victim->page = EEPROM_NO_PAGE;
+    if (false == transfer(eeprom, address, 2, victim->data, EEPROM_PAGE_SIZE, EEPROM_ATTEMPTS)) {
+        victim->used = 0;
+        return NULL;
+    }
+    victim->page = page;
+    victim->used = eeprom->clock;
+    return victim;
+}
+
+/* A write, optionally followed by a read after a repeated start. A transaction that is not acknowledged is retried
+ * after EEPROM_RETRY_US, up to attempts times in all. */
+static bool transfer(eeprom_t *eeprom, const uint8_t *out, size_t out_length, uint8_t *in, size_t in_length,
+                     int attempts) {
+    for (int attempt = 0; attempt < attempts; attempt++) {
+        if (attempt > 0) {
+            eeprom->stats.retries++;
+            sleep_us(EEPROM_RETRY_US);
+        }
+        uint32_t start = time_us_32();
+        int result = exchange(eeprom, out, out_length, in, in_length);
+        bool ok = (0 == result);
+        uint32_t latency = time_us_32() - start;
+
+        eeprom->stats.transactions++;
+        if (latency > eeprom->stats.max_latency_us) {
+            eeprom->stats.max_latency_us = latency;
+        }
+        if (true == ok) {
+            eeprom->stats.bytes += out_length + in_length;
+            return true;
+        }
+        if (PICO_ERROR_TIMEOUT == result) {
+            eeprom->stats.timeouts++;
+        } else {
+            eeprom->stats.nacks++;
+        }
+    }
+    eeprom->stats.failures++;
+    return false;
+}
+
+/* The device does not acknowledge its address until the write cycle is over; a dummy write of the address bytes
+ * is used as the poll. */
+static void waitWriteCycle(eeprom_t *eeprom, const uint8_t *address) {
+    uint32_t start = time_us_32();
+    do {
+        sleep_us(EEPROM_POLL_US);
+        if (0 == exchange(eeprom, address, 2, NULL, 0)) {
+            return;
+        }
+        eeprom->stats.busy_polls++;
+    } while (time_us_32() - start < EEPROM_WRITE_CYCLE_MS * 1000);
+}
+
+/* Returns 0, PICO_ERROR_GENERIC when not acknowledged or PICO_ERROR_TIMEOUT. Goes through the bus scheduler when
+ * one is attached, so other devices on the bus are not locked out; otherwise the SDK calls are used directly. The
+ * traffic recorder (io_record.h) gets the transactions that the device answered. */
+static int exchange(eeprom_t *eeprom, const uint8_t *out, size_t out_length, uint8_t *in, size_t in_length) {
+    int result;
+    if (NULL != eeprom->bus) {
+        i2c_txn_t txn = {.device = eeprom->device, .priority = I2C_PRIORITY_NORMAL, .write = out,
+                         .write_length = out_length, .read = in, .read_length = in_length};
+        switch (i2c_bus_transfer(eeprom->bus, &txn, timeoutFor(eeprom, out_length + in_length))) {
+            case I2C_STATUS_OK:
+                result = 0;
+                break;
+            case I2C_STATUS_NACK:
+                result = PICO_ERROR_GENERIC;
+                break;
+            default:
+                result = PICO_ERROR_TIMEOUT;
+                break;
+        }
+    } else {
+        result = i2c_write_timeout_us(eeprom->i2c, eeprom->device, out, out_length, in_length > 0,
+                                      timeoutFor(eeprom, out_length));
+        if (result == (int) out_length && in_length > 0) {
+            result = i2c_read_timeout_us(eeprom->i2c, eeprom->device, in, in_length, false,
+                                         timeoutFor(eeprom, in_length));
+            result = (result == (int) in_length) ? 0 : result;
+        } else {
+            result = (result == (int) out_length) ? 0 : result;
+        }
+    }
+
+    if (0 == result) {
+        IO_RECORD_I2C(IO_KIND_I2C_WRITE, i2c_hw_index(eeprom->i2c), eeprom->device, out, out_length);
+        if (in_length > 0) {
+            IO_RECORD_I2C(IO_KIND_I2C_READ, i2c_hw_index(eeprom->i2c), eeprom->device, in, in_length);
+        }
+    } else if (PICO_ERROR_GENERIC == result) {
+        IO_RECORD_I2C(IO_KIND_I2C_NACK, i2c_hw_index(eeprom->i2c), eeprom->device, NULL, 0);
+    }
+    return result;
+}
+
+/* Twice the time the bytes take on the bus (nine clocks each, plus address and start/stop) and a fixed margin. */
+static uint timeoutFor(const eeprom_t *eeprom, size_t length) {
+    uint baudrate = eeprom->baudrate ? eeprom->baudrate : 100000;
+    return (uint) ((length + 2) * 9 * 2000000ull / baudrate) + 1000;
+}
@@ -0,0 +1,73 @@
+#ifndef COMMON_EEPROM_H
+#define COMMON_EEPROM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "hardware/i2c.h"
+#include "i2c_bus.h"
+
+/* 24-series I2C EEPROM (32 KB, 64-byte pages, two address bytes MSB first) with a small read cache. A miss reads the
+ * whole page into the least recently used line; writes go straight to the device and invalidate the pages they touch.
+ * Reads that are served from the cache never touch the bus.
+ *
+ * eeprom_probe() picks the fastest bus speed up to a limit (1 MHz Fast-mode Plus, 400 kHz Fast-mode, 100 kHz) at which
+ * two reads of page 0 agree. Transactions that are not acknowledged are retried, and the end of a write cycle is found
+ * by acknowledge polling instead of a fixed delay. With eeprom_use_bus() the transfers are queued on a shared bus
+ * scheduler and the caller waits for their completion.
+ *
+ * The cache lines belong to the caller, so each project sizes its cache (EEPROM_CACHE_PAGES lines are the usual choice)
+ * while the driver is compiled once for all of them. */
+
+#define EEPROM_SIZE 32768
+#define EEPROM_PAGE_SIZE 64
+#define EEPROM_WRITE_CYCLE_MS 10 // longest write cycle; polling usually ends it after about 5 ms
+#define EEPROM_POLL_US 200
+#define EEPROM_ATTEMPTS 3
+#define EEPROM_RETRY_US 500
+
+#define EEPROM_CACHE_PAGES 4
+
+#define EEPROM_NO_PAGE 0xFFFF
+
+typedef struct {
+    uint16_t page;
+    uint32_t used;
+    uint8_t data[EEPROM_PAGE_SIZE];
+} eeprom_line_t;
+
+typedef struct {
+    uint32_t transactions;
+    uint32_t bytes;
+    uint32_t nacks;
+    uint32_t timeouts;
+    uint32_t retries;
+    uint32_t failures;     // given up after EEPROM_ATTEMPTS
+    uint32_t busy_polls;   // not acknowledged while a write cycle was running
+    uint32_t max_latency_us;
+} eeprom_stats_t;
+
+typedef struct {
+    i2c_inst_t *i2c;
+    i2c_bus_t *bus; // NULL: blocking SDK calls
+    uint8_t device;
+    uint baudrate;
+    eeprom_line_t *lines;
+    uint line_count;
+    uint32_t clock;
+    uint32_t hits;
+    uint32_t misses;
+    eeprom_stats_t stats;
+} eeprom_t;
+
+void eeprom_init(eeprom_t *eeprom, i2c_inst_t *i2c, uint8_t device, eeprom_line_t *lines, uint line_count);
+uint eeprom_probe(eeprom_t *eeprom, uint max_baudrate);
+bool eeprom_read(eeprom_t *eeprom, uint16_t address, uint8_t *data, size_t length);
+uint8_t eeprom_read_byte(eeprom_t *eeprom, uint16_t address);
+bool eeprom_write(eeprom_t *eeprom, uint16_t address, const uint8_t *data, size_t length);
+bool eeprom_write_byte(eeprom_t *eeprom, uint16_t address, uint8_t data);
+void eeprom_use_bus(eeprom_t *eeprom, i2c_bus_t *bus);
+void eeprom_invalidate(eeprom_t *eeprom);
+void eeprom_print_stats(const eeprom_t *eeprom);
+
+#endif //COMMON_EEPROM_H
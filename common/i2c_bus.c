@@ -0,0 +1,352 @@
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+
+#include "i2c_bus.h"
+#include "ram_func.h"
+
+#define I2C_FIFO_DEPTH 16
+
+static void startNext(i2c_bus_t *bus);
+static i2c_device_stats_t *deviceStats(i2c_bus_t *bus, uint8_t device);
+static void abandon(i2c_bus_t *bus, i2c_txn_t *txn);
+#if PICO_ON_DEVICE
+static void startTransfer(i2c_bus_t *bus, i2c_txn_t *txn);
+static void resetController(i2c_bus_t *bus);
+static void fillTxFifo(i2c_bus_t *bus, i2c_hw_t *hw);
+static void handleInterrupt(i2c_bus_t *bus);
+static void i2c0Handler(void);
+static void i2c1Handler(void);
+
+static i2c_bus_t *irq_buses[2];
+
+/* The controller must already be initialised (i2c_init) and its pins set up. Interrupts are enabled on the calling
+ * core. */
+void i2c_bus_init(i2c_bus_t *bus, i2c_inst_t *i2c) {
+    i2c_bus_init_backend(bus, startTransfer);
+    bus->i2c = i2c;
+
+    uint index = i2c_hw_index(i2c);
+    i2c_hw_t *hw = i2c_get_hw(i2c);
+    hw->intr_mask = 0;
+    hw->rx_tl = 0;
+    hw->tx_tl = 0;
+    irq_buses[index] = bus;
+    irq_set_exclusive_handler(index ? I2C1_IRQ : I2C0_IRQ, index ? i2c1Handler : i2c0Handler);
+    irq_set_enabled(index ? I2C1_IRQ : I2C0_IRQ, true);
+}
+#endif
+
+void i2c_bus_init_backend(i2c_bus_t *bus, i2c_bus_start_t start) {
+    memset(bus, 0, sizeof(*bus));
+    bus->start = start;
+}
+
+void i2c_bus_submit(i2c_bus_t *bus, i2c_txn_t *txn) {
+    uint8_t priority = (txn->priority < I2C_BUS_PRIORITIES) ? txn->priority : I2C_PRIORITY_LOW;
+    txn->status = I2C_STATUS_PENDING;
+    txn->next = NULL;
+    txn->submitted_us = time_us_32();
+
+    uint32_t irq_state = save_and_disable_interrupts();
+    if (NULL == bus->tail[priority]) {
+        bus->head[priority] = txn;
+    } else {
+        bus->tail[priority]->next = txn;
+    }
+    bus->tail[priority] = txn;
+    if (NULL == bus->active) {
+        startNext(bus);
+    }
+    restore_interrupts(irq_state);
+}
+
+/* Removes a transaction that has not started yet. An active transaction is aborted instead and completes with an
+ * error; false is returned in that case. */
+bool i2c_bus_cancel(i2c_bus_t *bus, i2c_txn_t *txn) {
+    bool removed = false;
+    uint32_t irq_state = save_and_disable_interrupts();
+    if (I2C_STATUS_PENDING == txn->status) {
+        for (int priority = 0; priority < I2C_BUS_PRIORITIES && false == removed; priority++) {
+            i2c_txn_t *previous = NULL;
+            for (i2c_txn_t *queued = bus->head[priority]; NULL != queued; previous = queued, queued = queued->next) {
+                if (queued == txn) {
+                    if (NULL == previous) {
+                        bus->head[priority] = txn->next;
+                    } else {
+                        previous->next = txn->next;
+                    }
+                    if (bus->tail[priority] == txn) {
+                        bus->tail[priority] = previous;
+                    }
+                    txn->status = I2C_STATUS_CANCELLED;
+                    removed = true;
+                    break;
+                }
+            }
+        }
+#if PICO_ON_DEVICE
+    } else if (I2C_STATUS_ACTIVE == txn->status && startTransfer == bus->start) {
+        i2c_get_hw(bus->i2c)->enable |= I2C_IC_ENABLE_ABORT_BITS;
+#endif
+    }
+    restore_interrupts(irq_state);
+    return removed;
+}
+
+bool i2c_bus_done(const i2c_txn_t *txn) {
+    return txn->status >= I2C_STATUS_OK;
+}
+
+/* Submits and waits, for drivers that need the result before they can go on. Returns the final status; a
+ * transaction still queued after timeout_us is cancelled, an active one is aborted. An abort that has not ended the
+ * transfer I2C_BUS_ABORT_US later resets the controller and fails the transaction with I2C_STATUS_TIMEOUT. */
+uint8_t i2c_bus_transfer(i2c_bus_t *bus, i2c_txn_t *txn, uint32_t timeout_us) {
+    i2c_bus_submit(bus, txn);
+    uint32_t start = time_us_32();
+    bool cancelled = false;
+    while (false == i2c_bus_done(txn)) {
+        uint32_t elapsed = time_us_32() - start;
+        if (false == cancelled && elapsed > timeout_us) {
+            i2c_bus_cancel(bus, txn);
+            cancelled = true;
+        } else if (true == cancelled && elapsed - timeout_us > I2C_BUS_ABORT_US) {
+            abandon(bus, txn);
+        }
+    }
+    return txn->status;
+}
+
+/* Ends the active transaction: called by the backend, from the interrupt on the board. The next transaction is
+ * started before the callback runs, so the bus is not idle while the callback works. */
+void RAM_FUNC(i2c_bus_complete)(i2c_bus_t *bus, uint8_t status) {
+    i2c_txn_t *txn = bus->active;
+    if (NULL == txn) {
+        return;
+    }
+    bus->active = NULL;
+
+    i2c_device_stats_t *stats = deviceStats(bus, txn->device);
+    if (NULL != stats) {
+        uint32_t latency = time_us_32() - txn->submitted_us;
+        uint32_t scaled = latency / (2 * I2C_BUS_HIST_MIN_US);
+        int bucket = 0;
+        while (scaled > 0 && bucket < I2C_BUS_HIST_BUCKETS - 1) {
+            scaled >>= 1;
+            bucket++;
+        }
+        stats->histogram[bucket]++;
+        stats->count++;
+        if (I2C_STATUS_NACK == status) {
+            stats->nacks++;
+        } else if (I2C_STATUS_OK != status) {
+            stats->errors++;
+        }
+        if (latency > stats->max_us) {
+            stats->max_us = latency;
+        }
+    }
+
+    txn->status = status;
+    startNext(bus);
+    if (NULL != txn->callback) {
+        txn->callback(txn, txn->context);
+    }
+}
+
+void i2c_bus_print_stats(const i2c_bus_t *bus) {
+    for (int i = 0; i < I2C_BUS_MAX_DEVICES; i++) {
+        const i2c_device_stats_t *stats = &bus->devices[i];
+        if (0 == stats->device) {
+            continue;
+        }
+        printf("Device 0x%02x: %lu transactions, %lu NACKs, %lu errors, max latency %lu us\n", stats->device,
+               (unsigned long) stats->count, (unsigned long) stats->nacks, (unsigned long) stats->errors,
+               (unsigned long) stats->max_us);
+        for (int bucket = 0; bucket < I2C_BUS_HIST_BUCKETS; bucket++) {
+            if (0 == stats->histogram[bucket]) {
+                continue;
+            }
+            uint32_t low = bucket ? I2C_BUS_HIST_MIN_US << bucket : 0;
+            if (bucket < I2C_BUS_HIST_BUCKETS - 1) {
+                printf("  %6lu - %6lu us: %lu\n", (unsigned long) low, (unsigned long) (I2C_BUS_HIST_MIN_US << (bucket + 1)),
+                       (unsigned long) stats->histogram[bucket]);
+            } else {
+                printf("  %6lu us and more: %lu\n", (unsigned long) low, (unsigned long) stats->histogram[bucket]);
+            }
+        }
+    }
+}
+
+/* Ends the active transaction whose abort never completed (a device holding the bus, say): the controller is reset
+ * and the transaction fails. */
+static void abandon(i2c_bus_t *bus, i2c_txn_t *txn) {
+    uint32_t irq_state = save_and_disable_interrupts();
+    if (bus->active == txn) {
+#if PICO_ON_DEVICE
+        if (startTransfer == bus->start) {
+            resetController(bus);
+        }
+#endif
+        i2c_bus_complete(bus, I2C_STATUS_TIMEOUT);
+    }
+    restore_interrupts(irq_state);
+}
+
+/* Called with interrupts disabled or from the interrupt. */
+static void RAM_FUNC(startNext)(i2c_bus_t *bus) {
+    for (int priority = 0; priority < I2C_BUS_PRIORITIES; priority++) {
+        i2c_txn_t *txn = bus->head[priority];
+        if (NULL != txn) {
+            bus->head[priority] = txn->next;
+            if (NULL == txn->next) {
+                bus->tail[priority] = NULL;
+            }
+            bus->active = txn;
+            txn->status = I2C_STATUS_ACTIVE;
+            bus->start(bus, txn);
+            return;
+        }
+    }
+}
+
+static i2c_device_stats_t *RAM_FUNC(deviceStats)(i2c_bus_t *bus, uint8_t device) {
+    for (int i = 0; i < I2C_BUS_MAX_DEVICES; i++) {
+        if (device == bus->devices[i].device) {
+            return &bus->devices[i];
+        }
+        if (0 == bus->devices[i].device) {
+            bus->devices[i].device = device;
+            return &bus->devices[i];
+        }
+    }
+    return NULL;
+}
+
+#if PICO_ON_DEVICE
+/////////////////////////////////////////////////////
+//             INTERRUPT DRIVEN BACKEND            //
+/////////////////////////////////////////////////////
+
+/* The commands for the whole transaction go through the TX FIFO: the data bytes to write, then one read command per
+ * byte to read (the first one with a repeated start) and a stop on the last command. The controller holds the clock
+ * low while the FIFO is empty, so refilling from the TX_EMPTY interrupt never ends a transaction early. */
+static void RAM_FUNC(startTransfer)(i2c_bus_t *bus, i2c_txn_t *txn) {
+    if (0 == txn->write_length + txn->read_length) {
+        i2c_bus_complete(bus, I2C_STATUS_ERROR);
+        return;
+    }
+    i2c_hw_t *hw = i2c_get_hw(bus->i2c);
+    hw->enable = 0;
+    hw->tar = txn->device;
+    hw->enable = I2C_IC_ENABLE_ENABLE_BITS;
+
+    bus->commands_sent = 0;
+    bus->bytes_received = 0;
+    bus->aborted = false;
+    bus->abort_source = 0;
+    hw->intr_mask = I2C_IC_INTR_MASK_M_TX_EMPTY_BITS | I2C_IC_INTR_MASK_M_RX_FULL_BITS |
+                    I2C_IC_INTR_MASK_M_TX_ABRT_BITS | I2C_IC_INTR_MASK_M_STOP_DET_BITS;
+}
+
+/* A block reset through i2c_init(), keeping the speed the drivers set (eeprom_probe) and the interrupt setup of
+ * i2c_bus_init(). The next transaction sets up the rest. */
+static void resetController(i2c_bus_t *bus) {
+    i2c_hw_t *hw = i2c_get_hw(bus->i2c);
+    uint32_t hcnt = hw->fs_scl_hcnt;
+    uint32_t lcnt = hw->fs_scl_lcnt;
+    uint32_t spklen = hw->fs_spklen;
+    uint32_t sda_hold = hw->sda_hold;
+
+    i2c_init(bus->i2c, 100000);
+    hw->enable = 0;
+    hw->fs_scl_hcnt = hcnt;
+    hw->fs_scl_lcnt = lcnt;
+    hw->fs_spklen = spklen;
+    hw->sda_hold = sda_hold;
+    hw->intr_mask = 0;
+    hw->rx_tl = 0;
+    hw->tx_tl = 0;
+}
+
+static void RAM_FUNC(fillTxFifo)(i2c_bus_t *bus, i2c_hw_t *hw) {
+    const i2c_txn_t *txn = bus->active;
+    size_t total = txn->write_length + txn->read_length;
+
+    while (bus->commands_sent < total && hw->txflr < I2C_FIFO_DEPTH) {
+        size_t index = bus->commands_sent;
+        uint32_t command;
+        if (index < txn->write_length) {
+            command = txn->write[index];
+        } else {
+            // a read command may only be queued if the RX FIFO has room for its byte
+            size_t reads_sent = index - txn->write_length;
+            if (reads_sent - bus->bytes_received + hw->rxflr >= I2C_FIFO_DEPTH) {
+                break;
+            }
+            command = I2C_IC_DATA_CMD_CMD_BITS;
+            if (index == txn->write_length && txn->write_length > 0) {
+                command |= I2C_IC_DATA_CMD_RESTART_BITS;
+            }
+        }
+        if (index + 1 == total) {
+            command |= I2C_IC_DATA_CMD_STOP_BITS;
+        }
+        hw->data_cmd = command;
+        bus->commands_sent++;
+    }
+    if (bus->commands_sent == total) {
+        hw->intr_mask &= ~I2C_IC_INTR_MASK_M_TX_EMPTY_BITS;
+    }
+}
+
+static void RAM_FUNC(handleInterrupt)(i2c_bus_t *bus) {
+    i2c_hw_t *hw = i2c_get_hw(bus->i2c);
+    i2c_txn_t *txn = bus->active;
+    uint32_t status = hw->intr_stat;
+
+    if (NULL == txn) {
+        hw->intr_mask = 0;
+        return;
+    }
+    if (status & I2C_IC_INTR_STAT_R_TX_ABRT_BITS) {
+        bus->abort_source = hw->tx_abrt_source;
+        (void) hw->clr_tx_abrt;
+        bus->aborted = true;
+        hw->intr_mask &= ~I2C_IC_INTR_MASK_M_TX_EMPTY_BITS;
+    }
+    while (hw->rxflr > 0) {
+        uint8_t byte = (uint8_t) hw->data_cmd;
+        if (bus->bytes_received < txn->read_length) {
+            txn->read[bus->bytes_received++] = byte;
+        }
+    }
+    if (false == bus->aborted && (status & I2C_IC_INTR_STAT_R_TX_EMPTY_BITS)) {
+        fillTxFifo(bus, hw);
+    }
+    if (status & I2C_IC_INTR_STAT_R_STOP_DET_BITS) {
+        (void) hw->clr_stop_det;
+        hw->intr_mask = 0;
+
+        uint8_t result = I2C_STATUS_OK;
+        if (true == bus->aborted) {
+            bool nack = bus->abort_source & (I2C_IC_TX_ABRT_SOURCE_ABRT_7B_ADDR_NOACK_BITS |
+                                             I2C_IC_TX_ABRT_SOURCE_ABRT_TXDATA_NOACK_BITS);
+            result = nack ? I2C_STATUS_NACK : I2C_STATUS_ERROR;
+        } else if (bus->bytes_received != txn->read_length) {
+            result = I2C_STATUS_ERROR;
+        }
+        i2c_bus_complete(bus, result);
+    }
+}
+
+static void RAM_FUNC(i2c0Handler)(void) {
+    handleInterrupt(irq_buses[0]);
+}
+
+static void RAM_FUNC(i2c1Handler)(void) {
+    handleInterrupt(irq_buses[1]);
+}
+#endif
@@ -0,0 +1,96 @@
+#ifndef COMMON_I2C_BUS_H
+#define COMMON_I2C_BUS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "hardware/i2c.h"
+
+/* Transaction scheduler for an I2C bus shared by several drivers. A transaction is a write, a read, or a write followed
+ * by a read after a repeated start. i2c_bus_submit() only queues it and returns; the transfer runs from the I2C
+ * interrupt, one transaction at a time, highest priority first and in submission order within a priority. The
+ * callback is called from the interrupt when the transaction is done.
+ *
+ * Transactions are owned by the caller and must stay in place until completed. Latency from submission to completion
+ * is kept per device in a histogram with power-of-two buckets from I2C_BUS_HIST_MIN_US up. */
+
+#define I2C_BUS_PRIORITIES 3
+#define I2C_BUS_MAX_DEVICES 4
+#define I2C_BUS_HIST_BUCKETS 12
+#define I2C_BUS_HIST_MIN_US 16 // bucket 0: below 32 us, last bucket: 32 ms and more
+#define I2C_BUS_ABORT_US 2000  // an abort ends the transfer within a byte; after this the controller is reset
+
+enum i2c_priority {
+    I2C_PRIORITY_HIGH,
+    I2C_PRIORITY_NORMAL,
+    I2C_PRIORITY_LOW
+};
+
+enum i2c_status {
+    I2C_STATUS_PENDING,
+    I2C_STATUS_ACTIVE,
+    I2C_STATUS_OK,
+    I2C_STATUS_NACK,     // address or data not acknowledged
+    I2C_STATUS_ERROR,    // lost arbitration or short read
+    I2C_STATUS_CANCELLED,
+    I2C_STATUS_TIMEOUT   // the abort of i2c_bus_transfer() did not end it, the controller was reset
+};
+
+typedef struct i2c_txn i2c_txn_t;
+typedef struct i2c_bus i2c_bus_t;
+typedef void (*i2c_callback_t)(i2c_txn_t *txn, void *context);
+
+struct i2c_txn {
+    uint8_t device;
+    uint8_t priority;
+    const uint8_t *write;
+    size_t write_length;
+    uint8_t *read;
+    size_t read_length;
+    i2c_callback_t callback; // may be NULL
+    void *context;
+    volatile uint8_t status;
+    /* Owned by the scheduler */
+    i2c_txn_t *next;
+    uint32_t submitted_us;
+};
+
+typedef struct {
+    uint8_t device;      // 0: unused entry
+    uint32_t count;
+    uint32_t errors;     // completed with neither OK nor NACK
+    uint32_t nacks;      // not acknowledged: a missing device, or an EEPROM in its write cycle being polled
+    uint32_t max_us;
+    uint32_t histogram[I2C_BUS_HIST_BUCKETS];
+} i2c_device_stats_t;
+
+/* The transfer backend. i2c_bus_init() installs the interrupt driven one on the board (the host twins in host/ provide
+ * their own i2c_bus_init); a host test can install its own and report the end of each transfer with
+ * i2c_bus_complete(). A transfer that i2c_bus_transfer() gave up on has been completed already: a backend must not
+ * report it again. */
+typedef void (*i2c_bus_start_t)(i2c_bus_t *bus, i2c_txn_t *txn);
+
+struct i2c_bus {
+    i2c_inst_t *i2c;
+    i2c_bus_start_t start;
+    i2c_txn_t *head[I2C_BUS_PRIORITIES];
+    i2c_txn_t *tail[I2C_BUS_PRIORITIES];
+    i2c_txn_t *active;
+    /* Progress of the active transaction, used by the interrupt handler */
+    size_t commands_sent;
+    size_t bytes_received;
+    bool aborted;
+    uint32_t abort_source;
+    i2c_device_stats_t devices[I2C_BUS_MAX_DEVICES];
+};
+
+void i2c_bus_init(i2c_bus_t *bus, i2c_inst_t *i2c);
+void i2c_bus_init_backend(i2c_bus_t *bus, i2c_bus_start_t start);
+void i2c_bus_submit(i2c_bus_t *bus, i2c_txn_t *txn);
+bool i2c_bus_cancel(i2c_bus_t *bus, i2c_txn_t *txn);
+bool i2c_bus_done(const i2c_txn_t *txn);
+uint8_t i2c_bus_transfer(i2c_bus_t *bus, i2c_txn_t *txn, uint32_t timeout_us);
+void i2c_bus_complete(i2c_bus_t *bus, uint8_t status);
+void i2c_bus_print_stats(const i2c_bus_t *bus);
+
+#endif //COMMON_I2C_BUS_H
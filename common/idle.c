@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "hardware/sync.h"
+#include "hardware/structs/scb.h"
+
+#include "idle.h"
+#include "io_record.h"
+#include "isr_trace.h"
+
+#define UNUSED_CLOCKS0 (CLOCKS_SLEEP_EN0_CLK_ADC_ADC_BITS | CLOCKS_SLEEP_EN0_CLK_SYS_ADC_BITS | \
+                        CLOCKS_SLEEP_EN0_CLK_RTC_RTC_BITS | CLOCKS_SLEEP_EN0_CLK_SYS_RTC_BITS | \
+                        CLOCKS_SLEEP_EN0_CLK_SYS_PIO0_BITS | CLOCKS_SLEEP_EN0_CLK_SYS_PIO1_BITS | \
+                        CLOCKS_SLEEP_EN0_CLK_SYS_JTAG_BITS)
+#define UNUSED_CLOCKS1 (CLOCKS_SLEEP_EN1_CLK_PERI_SPI0_BITS | CLOCKS_SLEEP_EN1_CLK_SYS_SPI0_BITS | \
+                        CLOCKS_SLEEP_EN1_CLK_PERI_SPI1_BITS | CLOCKS_SLEEP_EN1_CLK_SYS_SPI1_BITS)
+
+#if IDLE_SLOW_CLOCK
+static void selectSystemClock(uint32_t auxsrc);
+#endif
+static void charsAvailable(void *context);
+
+static idle_stats_t stats;
+
+void idle_init(void) {
+#if IDLE_GATE_CLOCKS
+    clocks_hw->sleep_en0 &= ~UNUSED_CLOCKS0;
+    clocks_hw->sleep_en1 &= ~UNUSED_CLOCKS1;
+    scb_hw->scr |= M0PLUS_SCR_SLEEPDEEP_BITS;
+#endif
+#if IDLE_SLOW_CLOCK
+    clock_configure(clk_peri, 0, CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB, 48 * MHZ, 48 * MHZ);
+#endif
+    // without a callback stdio over UART does not enable the receive interrupt, and a waiting character would not end
+    // the sleep
+    stdio_set_chars_available_callback(charsAvailable, NULL);
+    idle_reset_stats();
+    isr_trace_init();
+    io_record_init();
+}
+
+void idle_wait(void) {
+    isr_trace_poll();
+    io_record_poll();
+    uint64_t start = time_us_64();
+#if IDLE_SLOW_CLOCK
+    selectSystemClock(CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB);
+    __wfe();
+    selectSystemClock(CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_CLKSRC_PLL_SYS);
+#else
+    __wfe();
+#endif
+    uint64_t end = time_us_64();
+
+    uint32_t irq_state = save_and_disable_interrupts();
+    stats.idle_us += end - start;
+    stats.wakeups++;
+    restore_interrupts(irq_state);
+
+#if IDLE_REPORT_MS
+    if (end - stats.start_us >= IDLE_REPORT_MS * 1000ull) {
+        idle_print_stats();
+        idle_reset_stats();
+    }
+#endif
+}
+
+void idle_get_stats(idle_stats_t *copy) {
+    uint32_t irq_state = save_and_disable_interrupts();
+    *copy = stats;
+    restore_interrupts(irq_state);
+}
+
+void idle_reset_stats(void) {
+    uint32_t irq_state = save_and_disable_interrupts();
+    stats.start_us = time_us_64();
+    stats.idle_us = 0;
+    stats.wakeups = 0;
+    restore_interrupts(irq_state);
+}
+
+/* Share of the time since the start of the measurement that the core was not in idle_wait(). */
+uint32_t idle_busy_permille(const idle_stats_t *copy, uint64_t now_us) {
+    uint64_t elapsed = now_us - copy->start_us;
+    if (0 == elapsed || copy->idle_us >= elapsed) {
+        return 0;
+    }
+    return (uint32_t) ((elapsed - copy->idle_us) * 1000 / elapsed);
+}
+
+void idle_print_stats(void) {
+    idle_stats_t copy;
+    idle_get_stats(&copy);
+    uint64_t now = time_us_64();
+    uint32_t busy = idle_busy_permille(&copy, now);
+    uint64_t elapsed_ms = (now - copy.start_us) / 1000;
+    uint32_t rate = elapsed_ms ? (uint32_t) (copy.wakeups * 1000ull / elapsed_ms) : 0;
+    printf("idle: busy %lu.%lu%%, %lu wakeups/s\n", (unsigned long) (busy / 10), (unsigned long) (busy % 10),
+           (unsigned long) rate);
+}
+
+#if IDLE_SLOW_CLOCK
+/* The glitchless mux of clk_sys only switches between clk_ref and the auxiliary source, so clk_sys goes through
+ * clk_ref while the auxiliary source changes. */
+static void selectSystemClock(uint32_t auxsrc) {
+    clock_hw_t *clock = &clocks_hw->clk[clk_sys];
+    hw_clear_bits(&clock->ctrl, CLOCKS_CLK_SYS_CTRL_SRC_BITS);
+    while (0 == (clock->selected & (1u << CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLK_REF))) {
+    }
+    hw_write_masked(&clock->ctrl, auxsrc << CLOCKS_CLK_SYS_CTRL_AUXSRC_LSB, CLOCKS_CLK_SYS_CTRL_AUXSRC_BITS);
+    hw_set_bits(&clock->ctrl, CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLKSRC_CLK_SYS_AUX << CLOCKS_CLK_SYS_CTRL_SRC_LSB);
+    while (0 == (clock->selected & (1u << CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLKSRC_CLK_SYS_AUX))) {
+    }
+}
+#endif
+
+static void charsAvailable(void *context) {
+}
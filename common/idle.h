@@ -0,0 +1,50 @@
+#ifndef COMMON_IDLE_H
+#define COMMON_IDLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Idle manager for the main loops. A loop that found nothing to do calls idle_wait(), which sleeps the core with WFE
+ * until the next interrupt: the soft timer alarm (soft_timer.h, programmed only for the next deadline), a GPIO, UART
+ * or USB interrupt, or incoming stdio characters. Returning from an interrupt handler sets the event register, so an
+ * event flag that an interrupt sets after the loop has checked it ends the wait at once instead of being lost.
+ * Before sleeping it folds the records of the interrupt handler tracer into its statistics (isr_trace.h) and prints
+ * the traffic recorder's buffer when it is due (io_record.h).
+ *
+ * Build options:
+ *  IDLE_GATE_CLOCKS    stop the clocks of the blocks no project uses (ADC, RTC, SPI, PIO, JTAG) while both cores
+ *                      sleep. On by default.
+ *  IDLE_SLOW_CLOCK     run the system clock from the 48 MHz USB PLL while sleeping, so that the interrupt that ends
+ *                      the wait also runs slower. The peripheral clock is moved to the USB PLL at init, so UART baud
+ *                      rates do not change; PWM and I2C timing follow the system clock. Off by default.
+ *  IDLE_REPORT_MS      print "idle: busy <percent>%, <n> wakeups/s" with this period for tools/duty_cycle.c. 0 (the
+ *                      default) turns the report off.
+ *
+ * idle_init() must be called first in main(), before stdio and the peripherals are set up. */
+
+#ifndef IDLE_GATE_CLOCKS
+#define IDLE_GATE_CLOCKS 1
+#endif
+
+#ifndef IDLE_SLOW_CLOCK
+#define IDLE_SLOW_CLOCK 0
+#endif
+
+#ifndef IDLE_REPORT_MS
+#define IDLE_REPORT_MS 0
+#endif
+
+typedef struct {
+    uint64_t start_us;   // start of the measurement
+    uint64_t idle_us;    // time spent in idle_wait()
+    uint32_t wakeups;
+} idle_stats_t;
+
+void idle_init(void);
+void idle_wait(void);
+void idle_get_stats(idle_stats_t *stats);
+void idle_reset_stats(void);
+uint32_t idle_busy_permille(const idle_stats_t *stats, uint64_t now_us);
+void idle_print_stats(void);
+
+#endif //COMMON_IDLE_H
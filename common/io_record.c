@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "io_record.h"
+#include "ram_func.h"
+
+static size_t putHeader(uint8_t *output, uint8_t kind, uint32_t delta_us, size_t length);
+static size_t putVarint(uint8_t *output, uint32_t value);
+static size_t getVarint(const uint8_t *input, size_t available, uint32_t *value);
+
+// Returns the encoded size, at most IO_RECORD_MAX_HEADER + length.
+size_t io_record_encode(uint8_t *output, uint8_t kind, uint32_t delta_us, const uint8_t *data, size_t length) {
+    size_t index = putHeader(output, kind, delta_us, length);
+    memcpy(&output[index], data, length);
+    return index + length;
+}
+
+/* Returns the number of bytes the record takes, or 0 if it is cut off. */
+size_t io_record_decode(const uint8_t *input, size_t available, io_record_t *record) {
+    if (available < 3) {
+        return 0;
+    }
+    size_t index = 1;
+    uint32_t length;
+    size_t used = getVarint(&input[index], available - index, &record->delta_us);
+    if (0 == used) {
+        return 0;
+    }
+    index += used;
+    used = getVarint(&input[index], available - index, &length);
+    if (0 == used || index + used + length > available) {
+        return 0;
+    }
+    index += used;
+    record->kind = input[0];
+    record->data = &input[index];
+    record->length = length;
+    return index + length;
+}
+
+static size_t putHeader(uint8_t *output, uint8_t kind, uint32_t delta_us, size_t length) {
+    size_t index = 0;
+    output[index++] = kind;
+    index += putVarint(&output[index], delta_us);
+    index += putVarint(&output[index], (uint32_t) length);
+    return index;
+}
+
+static size_t putVarint(uint8_t *output, uint32_t value) {
+    size_t index = 0;
+    do {
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        output[index++] = byte | (value ? 0x80 : 0);
+    } while (value);
+    return index;
+}
+
+/* Returns the bytes used, 0 if the varint is cut off or longer than 32 bits. */
+static size_t getVarint(const uint8_t *input, size_t available, uint32_t *value) {
+    *value = 0;
+    for (size_t index = 0; index < available && index < 5; index++) {
+        *value |= (uint32_t) (input[index] & 0x7F) << (7 * index);
+        if (0 == (input[index] & 0x80)) {
+            return index + 1;
+        }
+    }
+    return 0;
+}
+
+#if IO_RECORD
+
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+
+#define HEX_PER_LINE 32
+
+typedef struct {
+    uint8_t data[IO_RECORD_SIZE];
+    volatile size_t used;
+    volatile uint32_t records;
+    uint64_t first_us;
+} io_buffer_t;
+
+static void append(uint8_t kind, const uint8_t *head, size_t head_length, const uint8_t *data, size_t length);
+static void printBuffer(const io_buffer_t *buffer);
+
+static io_buffer_t buffers[2];
+static volatile uint active;
+static uint64_t last_us;
+static volatile uint32_t dropped;
+/* The last UART or console record of the active buffer, which following bytes may join */
+static uint8_t stream_kind;
+static size_t stream_length_at;
+static uint64_t stream_us;
+/* Levels last recorded by IO_RECORD_LEVEL(), one bit per GPIO */
+static uint32_t known_levels;
+static uint32_t levels;
+
+/* The first buffer starts with the magic, so the "ior:" lines of a session put together are a trace file. */
+void io_record_init(void) {
+    memcpy(buffers[0].data, IO_RECORD_MAGIC, 4);
+    buffers[0].used = 4;
+}
+
+/* Prints the active buffer if it is due and lets the handlers go on in the other one meanwhile. */
+void io_record_poll(void) {
+    io_buffer_t *buffer = &buffers[active];
+    if (0 == buffer->records && 0 == dropped) {
+        return;
+    }
+    if (buffer->used < IO_RECORD_SIZE / 2 && time_us_64() - buffer->first_us < IO_RECORD_FLUSH_MS * 1000ull) {
+        return;
+    }
+
+    uint32_t irq_state = save_and_disable_interrupts();
+    active ^= 1;
+    stream_kind = 0;
+    uint32_t lost = dropped;
+    dropped = 0;
+    restore_interrupts(irq_state);
+
+    printBuffer(buffer);
+    buffer->used = 0;
+    buffer->records = 0;
+    if (lost > 0) {
+        printf("io_record: %lu records dropped\n", (unsigned long) lost);
+    }
+}
+
+/* A received byte, UART or console */
+void RAM_FUNC(io_record_byte)(uint8_t kind, uint8_t byte) {
+    append(kind, NULL, 0, &byte, 1);
+}
+
+void RAM_FUNC(io_record_gpio)(uint gpio, bool level, bool edge) {
+    uint32_t bit = 1u << gpio;
+    if (false == edge) {
+        if ((known_levels & bit) && level == (0 != (levels & bit))) {
+            return;
+        }
+        known_levels |= bit;
+        levels = level ? (levels | bit) : (levels & ~bit);
+    }
+    uint8_t data = (uint8_t) (gpio | (level ? 0x80 : 0));
+    append(IO_KIND_GPIO, NULL, 0, &data, 1);
+}
+
+void RAM_FUNC(io_record_i2c)(uint8_t kind, uint index, uint8_t addr, const uint8_t *data, size_t length) {
+    append(kind | index, &addr, 1, data, length);
+}
+
+static void RAM_FUNC(append)(uint8_t kind, const uint8_t *head, size_t head_length, const uint8_t *data,
+                            size_t length) {
+    uint32_t irq_state = save_and_disable_interrupts();
+    uint64_t now = time_us_64();
+    io_buffer_t *buffer = &buffers[active];
+
+    // a byte right after the previous one of the same stream joins its record, up to the longest single byte length
+    if (kind == stream_kind && now - stream_us <= IO_RECORD_COALESCE_US && buffer->data[stream_length_at] < 0x7F &&
+        buffer->used < IO_RECORD_SIZE) {
+        buffer->data[buffer->used++] = data[0];
+        buffer->data[stream_length_at]++;
+        stream_us = now;
+        restore_interrupts(irq_state);
+        return;
+    }
+
+    if (buffer->used + IO_RECORD_MAX_HEADER + head_length + length > IO_RECORD_SIZE) {
+        dropped++;
+        restore_interrupts(irq_state);
+        return;
+    }
+    uint64_t delta = now - last_us;
+    uint8_t *output = &buffer->data[buffer->used];
+    size_t size = putHeader(output, kind, (delta < UINT32_MAX) ? (uint32_t) delta : UINT32_MAX, head_length + length);
+    memcpy(&output[size], head, head_length);
+    memcpy(&output[size + head_length], data, length);
+
+    if (0 == buffer->records) {
+        buffer->first_us = now;
+    }
+    bool stream = IO_KIND_UART_RX == IO_KIND_TYPE(kind) || IO_KIND_STDIN == kind;
+    stream_kind = stream ? kind : 0;
+    stream_length_at = buffer->used + size - 1; // a single byte length, as the record has one byte
+    stream_us = now;
+    buffer->used += size + head_length + length;
+    buffer->records++;
+    last_us = now;
+    restore_interrupts(irq_state);
+}
+
+static void printBuffer(const io_buffer_t *buffer) {
+    static const char digits[] = "0123456789abcdef";
+    char line[2 * HEX_PER_LINE + 1];
+    for (size_t offset = 0; offset < buffer->used; offset += HEX_PER_LINE) {
+        size_t n = 0;
+        for (size_t i = offset; i < buffer->used && i < offset + HEX_PER_LINE; i++) {
+            line[n++] = digits[buffer->data[i] >> 4];
+            line[n++] = digits[buffer->data[i] & 0xF];
+        }
+        line[n] = '\0';
+        printf("ior: %s\n", line);
+    }
+}
+
+#endif
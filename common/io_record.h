@@ -0,0 +1,108 @@
+#ifndef COMMON_IO_RECORD_H
+#define COMMON_IO_RECORD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Recorder of the traffic that comes into the device from outside: UART RX bytes, console input, GPIO edges and I2C
+ * transactions with their times, so that a session in the field can be replayed into a host twin (host/sim_record.c) and its
+ * latencies measured again and again.
+ *
+ * A trace is "IOR1" followed by records packed back to back:
+ *
+ *     kind:   IO_KIND_* | instance (UART or I2C number)
+ *     delta:  microseconds since the previous record, unsigned LEB128 varint
+ *     length: of the data, unsigned LEB128 varint
+ *     data:   UART   the bytes received
+ *             STDIN  the characters read from the console (cli.h)
+ *             GPIO   gpio | level << 7, one byte
+ *             I2C    the 7 bit address, then the bytes written or read (none for a NACK)
+ *
+ * On the board the records go into one of two RAM buffers; io_record_poll(), called by idle_wait() before every sleep,
+ * prints the buffer as "ior: <hex>" lines when it is half full or IO_RECORD_FLUSH_MS after its first record and
+ * switches to the other one, so a console capture of the whole session is the trace (SIM_REPLAY takes the capture as it
+ * is). Records that find the buffer full are counted and reported on the console; the times of the next ones are
+ * still right.
+ *
+ * UART bytes are recorded in the receive handler, so up to the FIFO interrupt level of characters after they arrived,
+ * console input when the command line reads it; bytes within IO_RECORD_COALESCE_US of each other share a record. Buttons that are sampled record the level changes
+ * the sampling sees (IO_RECORD_LEVEL), an edge interrupt every edge (IO_RECORD_EDGE). Core 0 only.
+ *
+ * Build options:
+ *  IO_RECORD            1 compiles the recorder in. Off by default: the macros are then empty and io_record_init() and
+ *                       io_record_poll() empty inline functions.
+ *  IO_RECORD_SIZE       bytes per buffer (default 4096)
+ *  IO_RECORD_FLUSH_MS   longest time a record waits in the buffer (default 1000) */
+
+#ifndef IO_RECORD
+#define IO_RECORD 0
+#endif
+
+#ifndef IO_RECORD_SIZE
+#define IO_RECORD_SIZE 4096
+#endif
+
+#ifndef IO_RECORD_FLUSH_MS
+#define IO_RECORD_FLUSH_MS 1000
+#endif
+
+#define IO_RECORD_MAGIC "IOR1"
+#define IO_RECORD_COALESCE_US 20
+#define IO_RECORD_MAX_HEADER 11 // kind, delta and length
+
+enum io_kind {
+    IO_KIND_UART_RX = 0x10,
+    IO_KIND_GPIO = 0x20,
+    IO_KIND_I2C_WRITE = 0x30,
+    IO_KIND_I2C_READ = 0x40,
+    IO_KIND_I2C_NACK = 0x50,
+    IO_KIND_STDIN = 0x60
+};
+
+#define IO_KIND_TYPE(kind) ((kind) & 0xF0)
+#define IO_KIND_INSTANCE(kind) ((kind) & 0x0F)
+
+typedef struct {
+    uint8_t kind;
+    uint32_t delta_us;
+    const uint8_t *data; // points into the trace
+    size_t length;
+} io_record_t;
+
+size_t io_record_encode(uint8_t *output, uint8_t kind, uint32_t delta_us, const uint8_t *data, size_t length);
+size_t io_record_decode(const uint8_t *input, size_t available, io_record_t *record);
+
+#if IO_RECORD
+
+#include "pico.h"
+
+#define IO_RECORD_UART(index, byte) io_record_byte(IO_KIND_UART_RX | (index), (byte))
+#define IO_RECORD_STDIN(byte) io_record_byte(IO_KIND_STDIN, (byte))
+#define IO_RECORD_EDGE(gpio, level) io_record_gpio((gpio), (level), true)
+#define IO_RECORD_LEVEL(gpio, level) io_record_gpio((gpio), (level), false)
+#define IO_RECORD_I2C(kind, index, addr, data, length) io_record_i2c((kind), (index), (addr), (data), (length))
+
+void io_record_init(void);
+void io_record_poll(void);
+void io_record_byte(uint8_t kind, uint8_t byte);
+void io_record_gpio(uint gpio, bool level, bool edge);
+void io_record_i2c(uint8_t kind, uint index, uint8_t addr, const uint8_t *data, size_t length);
+
+#else
+
+#define IO_RECORD_UART(index, byte) ((void) 0)
+#define IO_RECORD_STDIN(byte) ((void) 0)
+#define IO_RECORD_EDGE(gpio, level) ((void) 0)
+#define IO_RECORD_LEVEL(gpio, level) ((void) 0)
+#define IO_RECORD_I2C(kind, index, addr, data, length) ((void) 0)
+
+static inline void io_record_init(void) {
+}
+
+static inline void io_record_poll(void) {
+}
+
+#endif
+
+#endif //COMMON_IO_RECORD_H
@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+
+#include "isr_trace.h"
+
+#if ISR_TRACE
+
+static void addRecord(isr_trace_site_t *site, const isr_trace_record_t *record);
+static void addValue(isr_trace_stat_t *stat, uint32_t value);
+static uint bucketOf(uint32_t value);
+static uint32_t bucketTop(uint bucket);
+static uint32_t percentile(const isr_trace_stat_t *stat, uint32_t permille);
+static void copySite(const isr_trace_site_t *site, isr_trace_site_t *copy);
+static void printSite(const isr_trace_site_t *site, uint32_t cycles_per_us);
+static void printCycles(uint32_t cycles, uint32_t cycles_per_us);
+
+isr_trace_ring_t isr_trace_rings[ISR_TRACE_CORES];
+
+/* Linked by isr_trace_poll() on the core of the sites, in the order they first ran; only appended to. */
+static isr_trace_site_t *sites[ISR_TRACE_CORES];
+static isr_trace_site_t *last_sites[ISR_TRACE_CORES];
+
+/* Starts the SysTick counter of the calling core on clk_sys, free running over its 24 bits without an interrupt. Both
+ * cores that run traced handlers call it. */
+void isr_trace_init(void) {
+    systick_hw->csr = 0;
+    systick_hw->rvr = ISR_TRACE_CYCLE_MASK;
+    systick_hw->cvr = 0;
+    systick_hw->csr = M0PLUS_SYST_CSR_CLKSOURCE_BITS | M0PLUS_SYST_CSR_ENABLE_BITS;
+}
+
+void isr_trace_poll(void) {
+    uint core = get_core_num();
+    isr_trace_ring_t *ring = &isr_trace_rings[core];
+    uint32_t tail = ring->tail;
+    while (tail != ring->head) {
+        __mem_fence_acquire();
+        const isr_trace_record_t *record = &ring->records[tail & (ISR_TRACE_RING_SIZE - 1)];
+        isr_trace_site_t *site = record->site;
+        if (false == site->linked) {
+            site->linked = true;
+            site->core = (uint8_t) core;
+            __mem_fence_release();
+            if (NULL == sites[core]) {
+                sites[core] = site;
+            } else {
+                last_sites[core]->next = site;
+            }
+            last_sites[core] = site;
+        }
+        addRecord(site, record);
+        ring->tail = ++tail;
+    }
+
+#if ISR_TRACE_REPORT_MS
+    static uint64_t report_us = 0;
+    if (0 == core && time_us_64() - report_us >= ISR_TRACE_REPORT_MS * 1000ull) {
+        report_us = time_us_64();
+        isr_trace_print();
+    }
+#endif
+}
+
+/* Latency and duration from the ring of each core; a site that has not run yet is not listed. */
+void isr_trace_print(void) {
+    uint32_t cycles_per_us = clock_get_hz(clk_sys) / MHZ;
+    for (uint core = 0; core < ISR_TRACE_CORES; core++) {
+        for (const isr_trace_site_t *site = sites[core]; NULL != site; site = site->next) {
+            printSite(site, cycles_per_us);
+        }
+        uint32_t lost = isr_trace_rings[core].lost;
+        if (lost > 0) {
+            printf("Core %u: %lu records lost\n", core, (unsigned long) lost);
+        }
+    }
+}
+
+static void addRecord(isr_trace_site_t *site, const isr_trace_record_t *record) {
+    site->sequence++;
+    __mem_fence_release();
+    if (ISR_TRACE_NO_LATENCY != record->latency_us) {
+        addValue(&site->latency_us, record->latency_us);
+    }
+    addValue(&site->cycles, record->cycles);
+    __mem_fence_release();
+    site->sequence++;
+}
+
+static void addValue(isr_trace_stat_t *stat, uint32_t value) {
+    if (0 == stat->count || value < stat->min) {
+        stat->min = value;
+    }
+    if (value > stat->max) {
+        stat->max = value;
+    }
+    stat->count++;
+    stat->sum += value;
+    stat->histogram[bucketOf(value)]++;
+}
+
+/* 0-3 have a bucket each, above that every power of two is split in four. */
+static uint bucketOf(uint32_t value) {
+    if (value < 4) {
+        return value;
+    }
+    uint octave = 31 - __builtin_clz(value);
+    uint bucket = 4 * (octave - 1) + ((value >> (octave - 2)) & 3);
+    return (bucket < ISR_TRACE_BUCKETS) ? bucket : ISR_TRACE_BUCKETS - 1;
+}
+
+static uint32_t bucketTop(uint bucket) {
+    if (bucket < 4) {
+        return bucket;
+    }
+    uint octave = bucket / 4 + 1;
+    uint32_t low = (4u + bucket % 4) << (octave - 2);
+    return low + (1u << (octave - 2)) - 1;
+}
+
+/* The top of the bucket that holds the value at permille, but never more than the largest value seen; the last bucket
+ * is open ended. */
+static uint32_t percentile(const isr_trace_stat_t *stat, uint32_t permille) {
+    uint32_t rank = (uint32_t) (((uint64_t) stat->count * permille + 999) / 1000);
+    uint32_t seen = 0;
+    for (uint bucket = 0; bucket < ISR_TRACE_BUCKETS - 1; bucket++) {
+        seen += stat->histogram[bucket];
+        if (seen >= rank) {
+            uint32_t top = bucketTop(bucket);
+            return (top < stat->max) ? top : stat->max;
+        }
+    }
+    return stat->max;
+}
+
+/* The statistics of the other core may change while they are copied; the copy is repeated until it falls between two
+ * updates. */
+static void copySite(const isr_trace_site_t *site, isr_trace_site_t *copy) {
+    uint32_t sequence;
+    do {
+        do {
+            sequence = site->sequence;
+        } while (sequence & 1);
+        __mem_fence_acquire();
+        memcpy(&copy->latency_us, &site->latency_us, sizeof(copy->latency_us));
+        memcpy(&copy->cycles, &site->cycles, sizeof(copy->cycles));
+        __mem_fence_acquire();
+    } while (sequence != site->sequence);
+    copy->name = site->name;
+    copy->core = site->core;
+}
+
+static void printSite(const isr_trace_site_t *site, uint32_t cycles_per_us) {
+    static isr_trace_site_t copy; // too large for the stack of a command handler
+    copySite(site, &copy);
+    const isr_trace_stat_t *latency = &copy.latency_us;
+    const isr_trace_stat_t *cycles = &copy.cycles;
+
+    printf("%s (core %u): %lu calls\n", copy.name, copy.core, (unsigned long) cycles->count);
+    if (latency->count > 0) {
+        printf("  latency  min %lu us, avg %lu us, p99 %lu us, max %lu us\n", (unsigned long) latency->min,
+               (unsigned long) (latency->sum / latency->count), (unsigned long) percentile(latency, 990),
+               (unsigned long) latency->max);
+    }
+    printf("  duration min ");
+    printCycles(cycles->min, cycles_per_us);
+    printf(", avg ");
+    printCycles((uint32_t) (cycles->sum / cycles->count), cycles_per_us);
+    printf(", p99 ");
+    printCycles(percentile(cycles, 990), cycles_per_us);
+    printf(", max ");
+    printCycles(cycles->max, cycles_per_us);
+    printf("\n");
+}
+
+static void printCycles(uint32_t cycles, uint32_t cycles_per_us) {
+    uint32_t hundredths = (uint32_t) ((uint64_t) cycles * 100 / cycles_per_us);
+    printf("%lu.%02lu us", (unsigned long) (hundredths / 100), (unsigned long) (hundredths % 100));
+}
+
+#else
+
+void isr_trace_print(void) {
+    printf("ISR tracing is not built in (build with ISR_TRACE=1).\n");
+}
+
+#endif
@@ -0,0 +1,149 @@
+#ifndef COMMON_ISR_TRACE_H
+#define COMMON_ISR_TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pico.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+#include "hardware/structs/systick.h"
+
+/* Interrupt handler latency and duration tracer. A traced handler is a site:
+ *
+ *     ISR_TRACE_SITE(uart_trace, "uart1");
+ *     void uart1_handler(void) {
+ *         ISR_TRACE_ENTER(uart_trace);
+ *         ...
+ *         ISR_TRACE_EXIT(uart_trace);
+ *     }
+ *
+ * Entry and exit are timed with the SysTick counter of the core (clk_sys cycles, started by isr_trace_init()), so the
+ * duration is that of the handler body. A handler that knows when it should have run, like a timer callback, uses
+ * ISR_TRACE_ENTER_DUE() with that time in us since boot; the latency is then the time from there to the entry.
+ *
+ * Exit pushes one record into a ring of the core the handler runs on and does nothing else. The ring has a single
+ * writer, the handlers of its core (all at the default priority, so they do not preempt each other), and a single
+ * reader, isr_trace_poll() on the same core, which folds the records into the statistics of the sites. idle_wait()
+ * calls it before every sleep; a loop that does not use idle.h, like the motor loop of Exercise 5 on core 1, calls it
+ * itself. A site belongs to the core its handler runs on. Records that find the ring full are counted as lost.
+ *
+ * isr_trace_print() reports count, min/avg/p99/max latency and duration per site, for both cores. The percentile
+ * comes from a histogram with four buckets per power of two, so it is the upper edge of its bucket, at most 25 % high.
+ *
+ * Build options:
+ *  ISR_TRACE             1 compiles the tracer in. Off by default: the macros are then empty and isr_trace_init()
+ *                        and isr_trace_poll() are empty inline functions, so an untraced build has no cost at all.
+ *  ISR_TRACE_REPORT_MS   print the report with this period from isr_trace_poll() on core 0, for the projects without
+ *                        a command line. 0 (the default) turns the report off. */
+
+#ifndef ISR_TRACE
+#define ISR_TRACE 0
+#endif
+
+#ifndef ISR_TRACE_REPORT_MS
+#define ISR_TRACE_REPORT_MS 0
+#endif
+
+#define ISR_TRACE_CORES 2
+#define ISR_TRACE_RING_SIZE 64 // records per core, a power of two
+#define ISR_TRACE_BUCKETS 64   // values up to 2^17, i.e. 1 ms of cycles at 125 MHz
+#define ISR_TRACE_CYCLE_MASK 0x00ffffffu // SysTick is a 24 bit down counter
+#define ISR_TRACE_NO_LATENCY UINT32_MAX
+
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t histogram[ISR_TRACE_BUCKETS];
+} isr_trace_stat_t;
+
+/* The statistics are written by isr_trace_poll() on the core of the site; sequence is odd while they change, so that
+ * the other core can take a consistent copy without a lock. */
+typedef struct isr_trace_site {
+    const char *name;
+    struct isr_trace_site *next;
+    bool linked;
+    uint8_t core;
+    volatile uint32_t sequence;
+    isr_trace_stat_t latency_us;
+    isr_trace_stat_t cycles;
+} isr_trace_site_t;
+
+typedef struct {
+    isr_trace_site_t *site;
+    uint32_t latency_us;
+    uint32_t cycles;
+} isr_trace_record_t;
+
+typedef struct {
+    isr_trace_record_t records[ISR_TRACE_RING_SIZE];
+    volatile uint32_t head; // written by the handlers
+    volatile uint32_t tail; // written by isr_trace_poll()
+    volatile uint32_t lost;
+} isr_trace_ring_t;
+
+typedef struct {
+    uint32_t cycles;
+    uint32_t latency_us;
+} isr_trace_mark_t;
+
+#if ISR_TRACE
+
+#define ISR_TRACE_SITE(site, label) static isr_trace_site_t site = {.name = (label)}
+#define ISR_TRACE_ENTER(site) const isr_trace_mark_t site##_mark = isr_trace_enter()
+#define ISR_TRACE_ENTER_DUE(site, due_us) const isr_trace_mark_t site##_mark = isr_trace_enter_due(due_us)
+#define ISR_TRACE_EXIT(site) isr_trace_exit(&(site), site##_mark)
+
+extern isr_trace_ring_t isr_trace_rings[ISR_TRACE_CORES];
+
+void isr_trace_init(void);
+void isr_trace_poll(void);
+
+static inline isr_trace_mark_t isr_trace_enter(void) {
+    isr_trace_mark_t mark = {.cycles = systick_hw->cvr, .latency_us = ISR_TRACE_NO_LATENCY};
+    return mark;
+}
+
+/* A handler that runs before its due time (a target rounded down by the caller) counts as on time. */
+static inline isr_trace_mark_t isr_trace_enter_due(uint64_t due_us) {
+    isr_trace_mark_t mark = {.cycles = systick_hw->cvr};
+    int32_t late = (int32_t) (time_us_32() - (uint32_t) due_us);
+    mark.latency_us = (late > 0) ? (uint32_t) late : 0;
+    return mark;
+}
+
+static inline void isr_trace_exit(isr_trace_site_t *site, isr_trace_mark_t mark) {
+    uint32_t cycles = (mark.cycles - systick_hw->cvr) & ISR_TRACE_CYCLE_MASK;
+    isr_trace_ring_t *ring = &isr_trace_rings[get_core_num()];
+    uint32_t head = ring->head;
+    if (ISR_TRACE_RING_SIZE == head - ring->tail) {
+        ring->lost++;
+        return;
+    }
+    isr_trace_record_t *record = &ring->records[head & (ISR_TRACE_RING_SIZE - 1)];
+    record->site = site;
+    record->latency_us = mark.latency_us;
+    record->cycles = cycles;
+    __mem_fence_release();
+    ring->head = head + 1;
+}
+
+#else
+
+#define ISR_TRACE_SITE(site, label) extern isr_trace_site_t site // takes the semicolon, never defined
+#define ISR_TRACE_ENTER(site)
+#define ISR_TRACE_ENTER_DUE(site, due_us)
+#define ISR_TRACE_EXIT(site)
+
+static inline void isr_trace_init(void) {
+}
+
+static inline void isr_trace_poll(void) {
+}
+
+#endif
+
+void isr_trace_print(void);
+
+#endif //COMMON_ISR_TRACE_H
@@ -0,0 +1,86 @@
+#include "log_index.h"
+
+void log_index_reset(log_index_t *index) {
+    index->block_count = 0;
+}
+
+/* Records must be added in log order. */
+void log_index_add(log_index_t *index, uint16_t address, uint16_t record, uint32_t time_ms, uint32_t boot_ms,
+                   uint8_t type) {
+    size_t number = address / LOG_INDEX_BLOCK_SIZE;
+    if (number >= LOG_INDEX_MAX_BLOCKS) {
+        return;
+    }
+    while (index->block_count <= number) {
+        log_block_t *empty = &index->blocks[index->block_count++];
+        empty->address = LOG_INDEX_EMPTY;
+        for (int i = 0; i < LOG_INDEX_TYPES; i++) {
+            empty->count[i] = 0;
+        }
+    }
+
+    log_block_t *block = &index->blocks[number];
+    if (LOG_INDEX_EMPTY == block->address) {
+        block->address = address;
+        block->index = record;
+        block->first_ms = time_ms;
+        block->boot_ms = boot_ms;
+    }
+    block->last_ms = time_ms;
+    if (block->count[type < LOG_INDEX_TYPES ? type : 0] < UINT8_MAX) {
+        block->count[type < LOG_INDEX_TYPES ? type : 0]++;
+    }
+}
+
+/* True if no record in the block can match; type is a record type or LOG_INDEX_ANY_TYPE. */
+bool log_index_skip(const log_block_t *block, uint32_t since_ms, int type) {
+    if (LOG_INDEX_EMPTY == block->address || block->last_ms < since_ms) {
+        return true;
+    }
+    return type >= 0 && 0 == block->count[type < LOG_INDEX_TYPES ? type : 0];
+}
+
+/* First block a query has to read. With last > 0 it walks back from the end until the blocks that lie wholly after
+ * since_ms hold at least last matching records; a block straddling since_ms is never counted, so the result is never
+ * too late. */
+size_t log_index_start(const log_index_t *index, uint32_t since_ms, int type, uint32_t last) {
+    size_t start = index->block_count;
+    uint32_t matches = 0;
+
+    while (start > 0) {
+        const log_block_t *block = &index->blocks[start - 1];
+        if (LOG_INDEX_EMPTY != block->address && block->last_ms < since_ms) {
+            break;
+        }
+        start--;
+        if (0 == last || LOG_INDEX_EMPTY == block->address || block->first_ms < since_ms) {
+            continue;
+        }
+        if (type < 0) {
+            for (int i = 0; i < LOG_INDEX_TYPES; i++) {
+                matches += block->count[i];
+            }
+        } else {
+            matches += block->count[type < LOG_INDEX_TYPES ? type : 0];
+        }
+        if (matches >= last) {
+            break;
+        }
+    }
+    return start;
+}
+
+/* Block holding record number record, or block_count if there is none. */
+size_t log_index_find(const log_index_t *index, uint16_t record) {
+    size_t found = index->block_count;
+    for (size_t i = 0; i < index->block_count; i++) {
+        const log_block_t *block = &index->blocks[i];
+        if (LOG_INDEX_EMPTY != block->address) {
+            if (block->index > record) {
+                break;
+            }
+            found = i;
+        }
+    }
+    return found;
+}
@@ -0,0 +1,43 @@
+#ifndef COMMON_LOG_INDEX_H
+#define COMMON_LOG_INDEX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* In-RAM summary of a log of log_record.h records, one entry per block of LOG_INDEX_BLOCK_SIZE bytes. A record belongs
+ * to the block it starts in. Queries use the summary to skip blocks without reading them from the EEPROM. The default
+ * covers the 2 KB log area; a log over the whole 32 KB device needs LOG_INDEX_MAX_BLOCKS 512. */
+
+#ifndef LOG_INDEX_BLOCK_SIZE
+#define LOG_INDEX_BLOCK_SIZE 64
+#endif
+#ifndef LOG_INDEX_MAX_BLOCKS
+#define LOG_INDEX_MAX_BLOCKS 32
+#endif
+#define LOG_INDEX_TYPES 4 // record types above this are counted in slot 0
+#define LOG_INDEX_ANY_TYPE (-1)
+#define LOG_INDEX_EMPTY 0xFFFF
+
+typedef struct {
+    uint16_t address;   // first record starting in the block, LOG_INDEX_EMPTY if none
+    uint16_t index;     // its record number
+    uint32_t first_ms;  // its log time
+    uint32_t boot_ms;   // log time of the boot in effect at that record
+    uint32_t last_ms;   // log time of the last record starting in the block
+    uint8_t count[LOG_INDEX_TYPES];
+} log_block_t;
+
+typedef struct {
+    log_block_t blocks[LOG_INDEX_MAX_BLOCKS];
+    uint16_t block_count;
+} log_index_t;
+
+void log_index_reset(log_index_t *index);
+void log_index_add(log_index_t *index, uint16_t address, uint16_t record, uint32_t time_ms, uint32_t boot_ms,
+                   uint8_t type);
+bool log_index_skip(const log_block_t *block, uint32_t since_ms, int type);
+size_t log_index_start(const log_index_t *index, uint32_t since_ms, int type, uint32_t last);
+size_t log_index_find(const log_index_t *index, uint16_t record);
+
+#endif //COMMON_LOG_INDEX_H
@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "crc16.h"
+#include "log_record.h"
+
+// Returns the encoded size, at most LOG_RECORD_MAX_SIZE.
+size_t log_record_encode(const log_record_t *record, uint8_t *output) {
+    size_t length = record->length > LOG_RECORD_MAX_PAYLOAD ? LOG_RECORD_MAX_PAYLOAD : record->length;
+    size_t index = 0;
+    uint32_t delta = record->delta_ms;
+
+    output[index++] = (uint8_t) ((record->type << 4) | length);
+    do {
+        uint8_t byte = delta & 0x7F;
+        delta >>= 7;
+        output[index++] = byte | (delta ? 0x80 : 0);
+    } while (delta);
+    memcpy(&output[index], record->payload, length);
+    index += length;
+
+    uint16_t crc = crc16(output, index);
+    output[index++] = (uint8_t) (crc >> 8);
+    output[index++] = (uint8_t) crc;
+    return index;
+}
+
+/* Returns the number of bytes the record takes, or 0 at the end of the log or if the record is damaged. */
+size_t log_record_decode(const uint8_t *input, size_t available, log_record_t *record) {
+    if (available < 4 || LOG_RECORD_END == input[0] || 0xFF == input[0]) {
+        return 0;
+    }
+    size_t index = 1;
+    uint32_t delta = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (index >= available) {
+            return 0;
+        }
+        uint8_t byte = input[index++];
+        delta |= (uint32_t) (byte & 0x7F) << shift;
+        if (0 == (byte & 0x80)) {
+            break;
+        }
+        if (shift == 28) {
+            return 0;
+        }
+    }
+
+    size_t length = input[0] & 0x0F;
+    if (index + length + 2 > available || 0 != crc16(input, index + length + 2)) {
+        return 0;
+    }
+    record->type = input[0] >> 4;
+    record->length = (uint8_t) length;
+    record->delta_ms = delta;
+    memcpy(record->payload, &input[index], length);
+    return index + length + 2;
+}
+
+/* Text form of a record, only built when the log is read. */
+int log_record_render(const log_record_t *record, uint32_t uptime_ms, char *text, size_t size) {
+    switch (record->type) {
+        case LOG_TYPE_BOOT:
+            return snprintf(text, size, "Boot");
+        case LOG_TYPE_STATE: {
+            uint8_t state = record->length ? record->payload[0] : 0;
+            return snprintf(text, size, "%lus since power up.\nD1: %d\nD2: %d\nD3: %d", (unsigned long) (uptime_ms / 1000),
+                            state & 1, (state >> 1) & 1, (state >> 2) & 1);
+        }
+        case LOG_TYPE_TEXT:
+            return snprintf(text, size, "%.*s", record->length, (const char *) record->payload);
+        default:
+            return snprintf(text, size, "Unknown record type %d", record->type);
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef COMMON_LOG_RECORD_H
+#define COMMON_LOG_RECORD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Binary log record, packed back to back in the EEPROM log area:
+ *
+ *     header: type << 4 | payload length
+ *     delta:  milliseconds since the previous record, unsigned LEB128 varint (1-5 bytes)
+ *     payload
+ *     CRC16 over header, delta and payload, MSB first
+ *
+ * A header of 0x00 (erased log) or 0xFF (blank EEPROM) ends the log. Time is "log time": the sum of all deltas. It
+ * resumes at power up from the last record, so the delta of a boot record is the time from power up to the record and
+ * the time the board was off is not counted. A state change takes 5-7 bytes. */
+
+#define LOG_RECORD_MAX_PAYLOAD 15
+#define LOG_RECORD_MAX_SIZE (1 + 5 + LOG_RECORD_MAX_PAYLOAD + 2)
+#define LOG_RECORD_END 0x00
+
+enum log_type {
+    LOG_TYPE_BOOT = 1,  // no payload
+    LOG_TYPE_STATE = 2, // u8 LED bitmask D1..D3
+    LOG_TYPE_TEXT = 3   // up to 15 characters, no terminator
+};
+
+typedef struct {
+    uint8_t type;
+    uint8_t length;
+    uint32_t delta_ms;
+    uint8_t payload[LOG_RECORD_MAX_PAYLOAD];
+} log_record_t;
+
+size_t log_record_encode(const log_record_t *record, uint8_t *output);
+size_t log_record_decode(const uint8_t *input, size_t available, log_record_t *record);
+int log_record_render(const log_record_t *record, uint32_t uptime_ms, char *text, size_t size);
+
+#endif //COMMON_LOG_RECORD_H
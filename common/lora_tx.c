@@ -0,0 +1,254 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "lora_tx.h"
+
+#define BANDWIDTH_KHZ 125
+#define PREAMBLE_SYMBOLS 8
+#define CODING_RATE 1 // 4/5
+
+// times the off-time of the regulation a message waits for after a frame on the band, by priority
+static const uint8_t off_time_factors[LORA_TX_PRIORITIES] = {1, 2, 4};
+static const char *const priority_names[LORA_TX_PRIORITIES] = {"urgent", "normal", "low"};
+
+static bool insert(lora_tx_t *tx, const lora_tx_message_t *message);
+static void promote(lora_tx_t *tx, uint32_t now_ms);
+static uint32_t readyMs(const lora_tx_band_t *band, uint8_t priority);
+static int bestBand(const lora_tx_t *tx, uint8_t priority, uint32_t now_ms, uint32_t *ready_ms);
+static bool before(const lora_tx_message_t *a, const lora_tx_message_t *b);
+static void swap(lora_tx_t *tx, uint8_t a, uint8_t b);
+static void siftUp(lora_tx_t *tx, uint8_t index);
+static void siftDown(lora_tx_t *tx, uint8_t index);
+static void removeAt(lora_tx_t *tx, uint8_t index);
+
+void lora_tx_init(lora_tx_t *tx, uint8_t spreading_factor, lora_tx_send_t send, void *context) {
+    memset(tx, 0, sizeof(lora_tx_t));
+    tx->spreading_factor = spreading_factor;
+    tx->send = send;
+    tx->context = context;
+}
+
+void lora_tx_add_band(lora_tx_t *tx, uint16_t duty_permille, uint32_t now_ms) {
+    if (tx->band_count < LORA_TX_MAX_BANDS && duty_permille > 0) {
+        lora_tx_band_t *band = &tx->bands[tx->band_count++];
+        band->duty_permille = duty_permille;
+        band->since_ms = now_ms;
+    }
+}
+
+bool lora_tx_enqueue(lora_tx_t *tx, uint32_t now_ms, lora_tx_priority_t priority, uint8_t kind, const uint8_t *payload,
+                     size_t length) {
+    if (0 == length || length > LORA_TX_MAX_PAYLOAD || priority >= LORA_TX_PRIORITIES) {
+        return false;
+    }
+    if (LORA_TX_LOW == priority) {
+        for (uint8_t i = 0; i < tx->depth; i++) {
+            lora_tx_message_t *message = &tx->heap[i];
+            if (LORA_TX_LOW == message->priority && kind == message->kind) {
+                // keeps its place in the queue and its time, only the content is newer
+                memcpy(message->payload, payload, length);
+                message->length = (uint8_t) length;
+                tx->merged++;
+                return true;
+            }
+        }
+    }
+
+    lora_tx_message_t message;
+    message.priority = (uint8_t) priority;
+    message.queued_priority = (uint8_t) priority;
+    message.kind = kind;
+    message.length = (uint8_t) length;
+    message.seq = tx->seq++;
+    message.queued_ms = now_ms;
+    memcpy(message.payload, payload, length);
+    return insert(tx, &message);
+}
+
+/* Sends the first message once a band is free for it. The ones behind it wait even if they are smaller: they would
+ * not find a band free any sooner. */
+void lora_tx_poll(lora_tx_t *tx, uint32_t now_ms) {
+    uint32_t ready_ms;
+    if (0 == tx->depth) {
+        return;
+    }
+    promote(tx, now_ms);
+    lora_tx_message_t *message = &tx->heap[0];
+    int index = bestBand(tx, message->priority, now_ms, &ready_ms);
+    if (index < 0 || (int32_t) (now_ms - ready_ms) < 0 ||
+        false == tx->send(tx->context, (uint8_t) index, message->payload, message->length)) {
+        return;
+    }
+
+    lora_tx_band_t *band = &tx->bands[index];
+    band->last_ms = now_ms;
+    band->last_airtime_us = lora_tx_airtime_us(tx->spreading_factor, message->length);
+    band->frames++;
+    band->airtime_us += band->last_airtime_us;
+    uint32_t wait_ms = now_ms - message->queued_ms;
+    if (wait_ms > tx->max_wait_ms[message->queued_priority]) {
+        tx->max_wait_ms[message->queued_priority] = wait_ms;
+    }
+    tx->sent[message->queued_priority]++;
+    tx->last = *message;
+    tx->sending = true;
+    removeAt(tx, 0);
+}
+
+bool lora_tx_refused(lora_tx_t *tx) {
+    if (false == tx->sending) {
+        return false;
+    }
+    tx->sending = false;
+    tx->sent[tx->last.queued_priority]--;
+    tx->refused++;
+    return insert(tx, &tx->last);
+}
+
+uint32_t lora_tx_wait_ms(const lora_tx_t *tx, uint32_t now_ms) {
+    uint32_t ready_ms;
+    if (0 == tx->depth || bestBand(tx, tx->heap[0].priority, now_ms, &ready_ms) < 0) {
+        return UINT32_MAX;
+    }
+    return ((int32_t) (now_ms - ready_ms) >= 0) ? 0 : ready_ms - now_ms;
+}
+
+/* Time on air of a frame with length bytes of payload (SX1276 datasheet, 4.1.1.7), in whole symbols of 2^SF / 125 kHz:
+ * the preamble and 4.25 symbols of sync word, then 8 symbols and the coded payload. Low data rate optimisation is on
+ * from SF11 at 125 kHz as LoRaWAN requires. */
+uint32_t lora_tx_airtime_us(uint8_t spreading_factor, size_t length) {
+    int32_t sf = spreading_factor;
+    int32_t ldro = (sf >= 11) ? 1 : 0;
+    int32_t bits = 8 * (int32_t) (length + LORA_TX_OVERHEAD) - 4 * sf + 28 + 16;
+    int32_t per_block = 4 * (sf - 2 * ldro);
+    int32_t blocks = (bits > 0) ? (bits + per_block - 1) / per_block : 0;
+    uint32_t quarter_symbols = 4 * (PREAMBLE_SYMBOLS + 8 + (uint32_t) blocks * (CODING_RATE + 4)) + 17;
+    uint32_t symbol_us = (1000u << sf) / BANDWIDTH_KHZ;
+    return quarter_symbols * symbol_us / 4;
+}
+
+void lora_tx_print_stats(const lora_tx_t *tx, uint32_t now_ms) {
+    printf("LoRa TX: SF%u, queue %u/%u (max %u), sent %lu urgent, %lu normal, %lu low, %lu merged, %lu evicted, "
+           "%lu rejected, %lu promoted, %lu refused\n", tx->spreading_factor, tx->depth, LORA_TX_QUEUE, tx->max_depth,
+           (unsigned long) tx->sent[LORA_TX_URGENT], (unsigned long) tx->sent[LORA_TX_NORMAL],
+           (unsigned long) tx->sent[LORA_TX_LOW], (unsigned long) tx->merged, (unsigned long) tx->evicted,
+           (unsigned long) tx->rejected, (unsigned long) tx->promoted, (unsigned long) tx->refused);
+    for (uint8_t i = 0; i < tx->band_count; i++) {
+        const lora_tx_band_t *band = &tx->bands[i];
+        uint32_t elapsed_ms = now_ms - band->since_ms;
+        // hundredths of a percent of the time since the band was added
+        unsigned long used = (elapsed_ms > 0) ? (unsigned long) (band->airtime_us * 10 / elapsed_ms) : 0;
+        uint32_t ready_ms = readyMs(band, LORA_TX_URGENT);
+        uint32_t free_ms = (0 == band->frames || (int32_t) (now_ms - ready_ms) >= 0) ? 0 : ready_ms - now_ms;
+        printf("LoRa TX: band %u at %u.%u%%: %lu frames, %lu ms airtime, %lu.%02lu%% of the time, free in %lu ms\n", i,
+               band->duty_permille / 10, band->duty_permille % 10, (unsigned long) band->frames,
+               (unsigned long) (band->airtime_us / 1000), used / 100, used % 100, (unsigned long) free_ms);
+    }
+    printf("LoRa TX: longest wait");
+    for (uint8_t i = 0; i < LORA_TX_PRIORITIES; i++) {
+        printf("%s %lu ms %s", (0 == i) ? "" : ",", (unsigned long) tx->max_wait_ms[i], priority_names[i]);
+    }
+    printf("\n");
+}
+
+/* Into the heap; when it is full the newest message of the lowest priority makes room if it is less urgent. */
+static bool insert(lora_tx_t *tx, const lora_tx_message_t *message) {
+    if (LORA_TX_QUEUE == tx->depth) {
+        uint8_t last = 0;
+        for (uint8_t i = 1; i < tx->depth; i++) {
+            if (before(&tx->heap[last], &tx->heap[i])) {
+                last = i;
+            }
+        }
+        if (tx->heap[last].priority <= message->priority) {
+            tx->rejected++;
+            return false;
+        }
+        removeAt(tx, last);
+        tx->evicted++;
+    }
+    tx->heap[tx->depth] = *message;
+    siftUp(tx, tx->depth++);
+    if (tx->depth > tx->max_depth) {
+        tx->max_depth = tx->depth;
+    }
+    return true;
+}
+
+/* Low priority messages waiting LORA_TX_AGING_MS go on as normal ones, ahead of the normal ones queued after them. A
+ * parent moved down by siftUp was looked at already. */
+static void promote(lora_tx_t *tx, uint32_t now_ms) {
+    for (uint8_t i = 0; i < tx->depth; i++) {
+        lora_tx_message_t *message = &tx->heap[i];
+        if (LORA_TX_LOW == message->priority && now_ms - message->queued_ms >= LORA_TX_AGING_MS) {
+            message->priority = LORA_TX_NORMAL;
+            tx->promoted++;
+            siftUp(tx, i);
+        }
+    }
+}
+
+/* End of the airtime of the last frame and of the off-time after it, stretched for the lower priorities. */
+static uint32_t readyMs(const lora_tx_band_t *band, uint8_t priority) {
+    uint64_t off_us = (uint64_t) band->last_airtime_us * (1000u - band->duty_permille) / band->duty_permille;
+    return band->last_ms + (uint32_t) ((band->last_airtime_us + off_us * off_time_factors[priority]) / 1000);
+}
+
+/* The band free soonest for the priority, -1 without bands. */
+static int bestBand(const lora_tx_t *tx, uint8_t priority, uint32_t now_ms, uint32_t *ready_ms) {
+    int best = -1;
+    for (uint8_t i = 0; i < tx->band_count; i++) {
+        uint32_t ready = (0 == tx->bands[i].frames) ? now_ms : readyMs(&tx->bands[i], priority);
+        if (best < 0 || (int32_t) (ready - *ready_ms) < 0) {
+            best = i;
+            *ready_ms = ready;
+        }
+    }
+    return best;
+}
+
+/* Higher priority first, then the older message. */
+static bool before(const lora_tx_message_t *a, const lora_tx_message_t *b) {
+    return a->priority < b->priority || (a->priority == b->priority && (int32_t) (a->seq - b->seq) < 0);
+}
+
+static void swap(lora_tx_t *tx, uint8_t a, uint8_t b) {
+    lora_tx_message_t message = tx->heap[a];
+    tx->heap[a] = tx->heap[b];
+    tx->heap[b] = message;
+}
+
+static void siftUp(lora_tx_t *tx, uint8_t index) {
+    while (index > 0 && before(&tx->heap[index], &tx->heap[(index - 1) / 2])) {
+        swap(tx, index, (uint8_t) ((index - 1) / 2));
+        index = (uint8_t) ((index - 1) / 2);
+    }
+}
+
+static void siftDown(lora_tx_t *tx, uint8_t index) {
+    for (;;) {
+        uint8_t first = index;
+        uint8_t left = (uint8_t) (2 * index + 1);
+        uint8_t right = (uint8_t) (2 * index + 2);
+        if (left < tx->depth && before(&tx->heap[left], &tx->heap[first])) {
+            first = left;
+        }
+        if (right < tx->depth && before(&tx->heap[right], &tx->heap[first])) {
+            first = right;
+        }
+        if (first == index) {
+            return;
+        }
+        swap(tx, index, first);
+        index = first;
+    }
+}
+
+static void removeAt(lora_tx_t *tx, uint8_t index) {
+    tx->depth--;
+    if (index < tx->depth) {
+        tx->heap[index] = tx->heap[tx->depth];
+        siftDown(tx, index);
+        siftUp(tx, index);
+    }
+}
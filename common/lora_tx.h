@@ -0,0 +1,109 @@
+#ifndef COMMON_LORA_TX_H
+#define COMMON_LORA_TX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Transmit scheduler of the uplinks: keeps every sub-band within its duty cycle and sends the most urgent message
+ * first. After a frame of airtime T a sub-band of duty cycle d is off for T * (1 / d - 1), as LoRaWAN requires of
+ * the device and as the LoRa-E5 enforces itself (its "No band" error). The scheduler only hands a frame to the radio
+ * once a sub-band can take it, so the frames wait in its queue instead of failing in the module:
+ *
+ *  LORA_TX_URGENT  alarms: only the off-time of the regulation stands in their way
+ *  LORA_TX_NORMAL  waits for twice the off-time, which leaves half of the duty cycle to the alarms
+ *  LORA_TX_LOW     waits for four times the off-time; a message of the same kind still waiting is replaced by the new
+ *                  one, as a newer status makes the older one useless. The replacement keeps the place and the time of
+ *                  the first one, and LORA_TX_AGING_MS after that time it goes on as a normal message, so a status
+ *                  replaced over and over still goes out
+ *
+ * A frame the radio refuses after it took it (the "No band" of the LoRa-E5, whose own bookkeeping may differ from this
+ * one) goes back in with lora_tx_refused(), in its old place; the band stays charged with it, so that it waits for the
+ * off-time before it is tried again.
+ *
+ * The messages wait in a binary heap by priority and then age. When it is full a message of higher priority pushes out
+ * the newest one of the lowest priority. Airtime follows the SX1276 formula for 125 kHz, coding rate 4/5, explicit
+ * header and CRC, with the 13 bytes LoRaWAN adds to the payload. Time comes from the caller in milliseconds, so the
+ * scheduler also runs in virtual time (tools/lora_schedule.c). */
+
+#define LORA_TX_MAX_BANDS 4
+#define LORA_TX_QUEUE 8
+#define LORA_TX_MAX_PAYLOAD 51
+#define LORA_TX_OVERHEAD 13 // MHDR, FHDR without options, FPort and MIC
+#define LORA_TX_AGING_MS (30u * 60 * 1000)
+
+typedef enum {
+    LORA_TX_URGENT,
+    LORA_TX_NORMAL,
+    LORA_TX_LOW,
+    LORA_TX_PRIORITIES
+} lora_tx_priority_t;
+
+/* Hands a frame to the radio on a channel of the sub-band; false if the radio cannot take it now, it is then offered
+ * again at the next poll. */
+typedef bool (*lora_tx_send_t)(void *context, uint8_t band, const uint8_t *payload, size_t length);
+
+typedef struct {
+    uint16_t duty_permille;
+    uint32_t since_ms;       // when the band was added, for the share of the time it was used
+    uint32_t last_ms;        // start of the last frame
+    uint32_t last_airtime_us;
+    uint32_t frames;
+    uint64_t airtime_us;
+} lora_tx_band_t;
+
+typedef struct {
+    uint8_t priority;
+    uint8_t queued_priority; // before aging, what the statistics count it as
+    uint8_t kind;
+    uint8_t length;
+    uint32_t seq;
+    uint32_t queued_ms;
+    uint8_t payload[LORA_TX_MAX_PAYLOAD];
+} lora_tx_message_t;
+
+typedef struct {
+    uint8_t spreading_factor;
+    lora_tx_send_t send;
+    void *context;
+    lora_tx_band_t bands[LORA_TX_MAX_BANDS];
+    uint8_t band_count;
+    lora_tx_message_t heap[LORA_TX_QUEUE];
+    uint8_t depth;
+    uint8_t max_depth;
+    uint32_t seq;
+    uint32_t sent[LORA_TX_PRIORITIES];
+    uint32_t max_wait_ms[LORA_TX_PRIORITIES]; // from the first message of those that replaced each other
+    uint32_t merged;
+    uint32_t promoted; // low priority ones sent on as normal after LORA_TX_AGING_MS
+    uint32_t evicted;  // pushed out by a message of higher priority
+    uint32_t rejected; // queue full of messages as urgent or more
+    uint32_t refused;  // given back by the radio
+    lora_tx_message_t last; // handed to the radio last
+    bool sending;           // last may still be given back
+} lora_tx_t;
+
+/* spreading_factor 7-12 of the data rate the uplinks go out at, e.g. 12 for DR0 in EU868. */
+void lora_tx_init(lora_tx_t *tx, uint8_t spreading_factor, lora_tx_send_t send, void *context);
+
+/* Sub-bands in the order the callback numbers them, e.g. 10 for g1 of EU868 (868.0-868.6 MHz, 1%) where the default
+ * channels are. */
+void lora_tx_add_band(lora_tx_t *tx, uint16_t duty_permille, uint32_t now_ms);
+
+/* Queues a message of up to LORA_TX_MAX_PAYLOAD bytes; false if there is no room for it. kind tells the low priority
+ * messages apart that replace each other. */
+bool lora_tx_enqueue(lora_tx_t *tx, uint32_t now_ms, lora_tx_priority_t priority, uint8_t kind, const uint8_t *payload,
+                     size_t length);
+void lora_tx_poll(lora_tx_t *tx, uint32_t now_ms);
+
+/* The radio did not send the frame handed to it last: it is queued again as it was, unless the queue is full of more
+ * urgent ones. */
+bool lora_tx_refused(lora_tx_t *tx);
+
+/* Milliseconds until the first message in the queue may go out, 0 if it may now, UINT32_MAX if the queue is empty. */
+uint32_t lora_tx_wait_ms(const lora_tx_t *tx, uint32_t now_ms);
+
+uint32_t lora_tx_airtime_us(uint8_t spreading_factor, size_t length);
+void lora_tx_print_stats(const lora_tx_t *tx, uint32_t now_ms);
+
+#endif //COMMON_LORA_TX_H
@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+
+#include "lorawan.h"
+#include "uart.h"
+
+#define MAX_COMMAND (16 + 2 * LORAWAN_MAX_PAYLOAD)
+
+static const char *const state_names[] = {"configuring", "joining", "waiting to join", "joined", "sending"};
+// the echo of each configuration command, "+MODE: LWOTAA" and the like; the module answers "+MODE: ERROR(-1)" if it
+// does not take one
+static const char *const configure_echoes[] = {"+MODE: ", "+KEY: ", "+CLASS: ", "+PORT: "};
+
+static uint32_t nowMs(void);
+static void sendCommand(lorawan_t *lorawan, const char *command, uint32_t timeout_ms);
+static void configure(lorawan_t *lorawan);
+static void retryJoin(lorawan_t *lorawan);
+static void handleConfigure(lorawan_t *lorawan, const at_response_t *response);
+static void handleResponse(lorawan_t *lorawan, const at_response_t *response);
+static void handleTimeout(lorawan_t *lorawan);
+
+void lorawan_init(lorawan_t *lorawan, int uart_nr, int tx_pin, int rx_pin, const char *app_key, uint8_t port) {
+    memset(lorawan, 0, sizeof(lorawan_t));
+    lorawan->uart_nr = uart_nr;
+    lorawan->app_key = app_key;
+    lorawan->port = port;
+    lorawan->retry_ms = LORAWAN_RETRY_MS;
+    at_parser_init(&lorawan->parser);
+    uart_setup(uart_nr, tx_pin, rx_pin, LORAWAN_BAUD_RATE);
+    configure(lorawan);
+}
+
+/* Takes the response lines that came in and acts on a timeout, never blocks. */
+void lorawan_poll(lorawan_t *lorawan) {
+    uint8_t chunk[LORAWAN_MAX_POLL_CHARS];
+    int count = uart_read(lorawan->uart_nr, chunk, sizeof(chunk));
+    for (int i = 0; i < count;) {
+        const at_response_t *response;
+        i += (int) at_parser_feed_bytes(&lorawan->parser, &chunk[i], (size_t) (count - i), &response);
+        if (NULL != response) {
+            handleResponse(lorawan, response);
+        }
+    }
+    if (LORAWAN_JOINED != lorawan->state && (int32_t) (nowMs() - lorawan->deadline_ms) >= 0) {
+        handleTimeout(lorawan);
+    }
+}
+
+bool lorawan_send(lorawan_t *lorawan, const uint8_t *payload, size_t length) {
+    static const char digits[] = "0123456789ABCDEF";
+    char command[MAX_COMMAND];
+
+    if (LORAWAN_JOINED != lorawan->state || 0 == length || length > LORAWAN_MAX_PAYLOAD) {
+        return false;
+    }
+    size_t n = (size_t) snprintf(command, sizeof(command), "AT+MSGHEX=\"");
+    for (size_t i = 0; i < length; i++) {
+        command[n++] = digits[payload[i] >> 4];
+        command[n++] = digits[payload[i] & 0x0F];
+    }
+    snprintf(&command[n], sizeof(command) - n, "\"");
+    lorawan->uplink_length = length;
+    lorawan->state = LORAWAN_SENDING;
+    sendCommand(lorawan, command, LORAWAN_UPLINK_MS);
+    return true;
+}
+
+void lorawan_on_refused(lorawan_t *lorawan, lorawan_refused_t refused, void *context) {
+    lorawan->refused = refused;
+    lorawan->refused_context = context;
+}
+
+bool lorawan_joined(const lorawan_t *lorawan) {
+    return LORAWAN_JOINED == lorawan->state || LORAWAN_SENDING == lorawan->state;
+}
+
+void lorawan_print_stats(const lorawan_t *lorawan) {
+    printf("LoRaWAN: %s, %lu joins (%lu failed), %lu uplinks of %lu bytes (%lu failed, %lu refused)\n",
+           state_names[lorawan->state], (unsigned long) lorawan->joins, (unsigned long) lorawan->join_failures,
+           (unsigned long) lorawan->uplinks, (unsigned long) lorawan->uplink_bytes,
+           (unsigned long) lorawan->uplink_failures, (unsigned long) lorawan->uplink_refusals);
+}
+
+static uint32_t nowMs(void) {
+    return to_ms_since_boot(get_absolute_time());
+}
+
+static void sendCommand(lorawan_t *lorawan, const char *command, uint32_t timeout_ms) {
+    uart_send(lorawan->uart_nr, command);
+    uart_send(lorawan->uart_nr, "\r\n");
+    lorawan->deadline_ms = nowMs() + timeout_ms;
+}
+
+/* Sends the configuration command of the current step, or the join after the last one. */
+static void configure(lorawan_t *lorawan) {
+    char command[64];
+    lorawan->state = LORAWAN_CONFIGURE;
+    switch (lorawan->step) {
+        case 0:
+            sendCommand(lorawan, "AT+MODE=LWOTAA", LORAWAN_COMMAND_MS);
+            break;
+        case 1:
+            snprintf(command, sizeof(command), "AT+KEY=APPKEY,\"%s\"", lorawan->app_key);
+            sendCommand(lorawan, command, LORAWAN_COMMAND_MS);
+            break;
+        case 2:
+            sendCommand(lorawan, "AT+CLASS=A", LORAWAN_COMMAND_MS);
+            break;
+        case 3:
+            snprintf(command, sizeof(command), "AT+PORT=%u", lorawan->port);
+            sendCommand(lorawan, command, LORAWAN_COMMAND_MS);
+            break;
+        default:
+            lorawan->state = LORAWAN_JOINING;
+            lorawan->accepted = false;
+            sendCommand(lorawan, "AT+JOIN", LORAWAN_JOIN_MS);
+            break;
+    }
+}
+
+/* Waits before the next attempt, twice as long after every failure. */
+static void retryJoin(lorawan_t *lorawan) {
+    lorawan->join_failures++;
+    lorawan->state = LORAWAN_RETRY;
+    lorawan->deadline_ms = nowMs() + lorawan->retry_ms;
+    lorawan->retry_ms = (2 * lorawan->retry_ms < LORAWAN_MAX_RETRY_MS) ? 2 * lorawan->retry_ms : LORAWAN_MAX_RETRY_MS;
+}
+
+static void handleResponse(lorawan_t *lorawan, const at_response_t *response) {
+    switch (lorawan->state) {
+        case LORAWAN_CONFIGURE:
+            handleConfigure(lorawan, response);
+            break;
+        case LORAWAN_JOINING:
+            if (AT_RESPONSE_JOIN != response->type) {
+                break;
+            }
+            if (AT_JOIN_JOINED == response->join) {
+                lorawan->accepted = true;
+            } else if (AT_JOIN_DONE == response->join || AT_JOIN_ALREADY == response->join) {
+                if (true == lorawan->accepted || AT_JOIN_ALREADY == response->join) {
+                    lorawan->joins++;
+                    lorawan->retry_ms = LORAWAN_RETRY_MS;
+                    lorawan->state = LORAWAN_JOINED;
+                } else {
+                    retryJoin(lorawan);
+                }
+            }
+            break;
+        case LORAWAN_SENDING:
+            if (AT_RESPONSE_MSGHEX != response->type) {
+                break;
+            }
+            if (0 == strcmp("Done", response->value)) {
+                lorawan->uplinks++;
+                lorawan->uplink_bytes += lorawan->uplink_length;
+                lorawan->state = LORAWAN_JOINED;
+            } else if (0 == strncmp("Please join", response->value, 11)) {
+                // the network has forgotten the session
+                lorawan->uplink_failures++;
+                lorawan->step = 0;
+                configure(lorawan);
+            } else if (0 == strncmp("No band", response->value, 7) ||
+                       0 == strcmp("LoRaWAN modem is busy", response->value)) {
+                // nothing went out: the message goes back to the caller to be sent again
+                lorawan->uplink_refusals++;
+                lorawan->state = LORAWAN_JOINED;
+                if (NULL != lorawan->refused) {
+                    lorawan->refused(lorawan->refused_context);
+                }
+            } else if (0 != strcmp("Start", response->value) && 0 != strncmp("RXWIN", response->value, 5) &&
+                       0 != strcmp("FPENDING", response->value) && 0 != strcmp("ACK Received", response->value)) {
+                // "Length error ..." and the like
+                lorawan->uplink_failures++;
+                lorawan->state = LORAWAN_JOINED;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/* Goes on with the next command once the module echoes the setting; an error takes the path of a timeout, other lines
+ * (an unsolicited "+EVENT" or the tail of an earlier response) are left alone. */
+static void handleConfigure(lorawan_t *lorawan, const at_response_t *response) {
+    const char *echo = configure_echoes[lorawan->step];
+    size_t length = strlen(echo);
+    if (0 != strncmp(echo, response->line, length)) {
+        return;
+    }
+    if (0 == strncmp("ERROR", &response->line[length], 5)) {
+        retryJoin(lorawan);
+        return;
+    }
+    lorawan->step++;
+    configure(lorawan);
+}
+
+static void handleTimeout(lorawan_t *lorawan) {
+    switch (lorawan->state) {
+        case LORAWAN_CONFIGURE:
+        case LORAWAN_JOINING:
+            retryJoin(lorawan);
+            break;
+        case LORAWAN_RETRY:
+            // from the configuration on: the module may have been reset in between
+            lorawan->step = 0;
+            configure(lorawan);
+            break;
+        case LORAWAN_SENDING:
+            lorawan->uplink_failures++;
+            lorawan->state = LORAWAN_JOINED;
+            break;
+        default:
+            break;
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef COMMON_LORAWAN_H
+#define COMMON_LORAWAN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "at_response.h"
+
+/* LoRaWAN through a LoRa-E5 module on one of the UARTs of uart.h. lorawan_poll() from the main loop configures the
+ * module for OTAA (AT+MODE, AT+KEY, AT+CLASS, AT+PORT), joins the network with AT+JOIN and sends the uplinks with
+ * AT+MSGHEX; it never waits for the module, the responses are parsed as they come (at_response.h). A join that fails
+ * is tried again after LORAWAN_RETRY_MS, doubling up to LORAWAN_MAX_RETRY_MS, and so is a join the network asks for.
+ *
+ * Build option:
+ *  LORAWAN    Exercise 4 Task 2 sends its state changes as uplinks, batched by uplink.h. Off by default. */
+
+#ifndef LORAWAN
+#define LORAWAN 0
+#endif
+
+#define LORAWAN_BAUD_RATE 9600
+#define LORAWAN_MAX_PAYLOAD 115 // the AT+MSGHEX line has to fit into the transmit buffer of uart.c
+#define LORAWAN_COMMAND_MS 500
+#define LORAWAN_JOIN_MS 20000   // join request and the receive windows of the accept, on every channel tried
+#define LORAWAN_UPLINK_MS 10000 // an uplink at the slowest data rate and its receive windows
+#define LORAWAN_RETRY_MS 10000
+#define LORAWAN_MAX_RETRY_MS 600000
+#define LORAWAN_MAX_POLL_CHARS 64 // bounds the time one lorawan_poll() can take from the main loop
+
+/* The module did not send the uplink, "No band" of its own duty cycle or busy; the caller queues it again. */
+typedef void (*lorawan_refused_t)(void *context);
+
+typedef enum {
+    LORAWAN_CONFIGURE, // the commands before the join
+    LORAWAN_JOINING,
+    LORAWAN_RETRY,     // waiting to join again
+    LORAWAN_JOINED,    // ready for an uplink
+    LORAWAN_SENDING
+} lorawan_state_t;
+
+typedef struct {
+    int uart_nr;
+    const char *app_key;
+    uint8_t port;
+    lorawan_state_t state;
+    uint8_t step;         // LORAWAN_CONFIGURE: the command sent
+    uint32_t deadline_ms; // of the response waited for, or of the next join
+    uint32_t retry_ms;
+    bool accepted;        // "+JOIN: Network joined" before the "Done"
+    size_t uplink_length;
+    at_parser_t parser;
+    uint32_t joins;
+    uint32_t join_failures;
+    uint32_t uplinks;
+    uint32_t uplink_bytes;
+    uint32_t uplink_failures;
+    uint32_t uplink_refusals;
+    lorawan_refused_t refused;
+    void *refused_context;
+} lorawan_t;
+
+/* app_key: the 32 hex digits of the AppKey the device was registered with; port: the FPort of the uplinks. */
+void lorawan_init(lorawan_t *lorawan, int uart_nr, int tx_pin, int rx_pin, const char *app_key, uint8_t port);
+void lorawan_poll(lorawan_t *lorawan);
+
+/* Starts an uplink of up to LORAWAN_MAX_PAYLOAD bytes. Returns false if the module is not joined or still busy with
+ * the previous one; the result of the uplink only shows in the statistics, but for a refusal of the module. */
+bool lorawan_send(lorawan_t *lorawan, const uint8_t *payload, size_t length);
+/* Called when the module refuses the uplink started last. */
+void lorawan_on_refused(lorawan_t *lorawan, lorawan_refused_t refused, void *context);
+bool lorawan_joined(const lorawan_t *lorawan);
+void lorawan_print_stats(const lorawan_t *lorawan);
+
+#endif //COMMON_LORAWAN_H
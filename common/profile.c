@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+
+#include "profile.h"
+#include "proto.h"
+
+#if PROFILE
+
+static uint bucketOf(uint32_t us);
+static void putU32(uint8_t *buffer, uint32_t value);
+
+static profile_zone_t *zones;
+static profile_zone_t *last_zone;
+
+void profile_end(profile_zone_t *zone) {
+    uint32_t us = time_us_32() - zone->start_us;
+    if (false == zone->linked) {
+        zone->linked = true;
+        if (NULL == zones) {
+            zones = zone;
+        } else {
+            last_zone->next = zone;
+        }
+        last_zone = zone;
+    }
+    zone->count++;
+    zone->total_us += us;
+    if (us > zone->max_us) {
+        zone->max_us = us;
+    }
+    zone->histogram[bucketOf(us)]++;
+}
+
+void profile_print(void) {
+    for (const profile_zone_t *zone = zones; NULL != zone; zone = zone->next) {
+        printf("%s: %lu calls, avg %lu us, max %lu us\n", zone->name, (unsigned long) zone->count,
+               (unsigned long) (zone->count ? zone->total_us / zone->count : 0), (unsigned long) zone->max_us);
+        for (int bucket = 0; bucket < PROFILE_BUCKETS; bucket++) {
+            if (0 == zone->histogram[bucket]) {
+                continue;
+            }
+            uint32_t low = bucket ? 1u << (bucket - 1) : 0;
+            if (bucket < PROFILE_BUCKETS - 1) {
+                printf("  %6lu - %6lu us: %lu\n", (unsigned long) low, (unsigned long) (1u << bucket),
+                       (unsigned long) zone->histogram[bucket]);
+            } else {
+                printf("  %6lu us and more: %lu\n", (unsigned long) low, (unsigned long) zone->histogram[bucket]);
+            }
+        }
+    }
+}
+
+/* The zones stay listed, with their counters cleared. */
+void profile_reset(void) {
+    for (profile_zone_t *zone = zones; NULL != zone; zone = zone->next) {
+        zone->count = 0;
+        zone->max_us = 0;
+        zone->total_us = 0;
+        memset(zone->histogram, 0, sizeof(zone->histogram));
+    }
+}
+
+/* u8 zone index -> u32 count, u32 avg us, u32 max us, u16 histogram[PROFILE_BUCKETS] (saturated), name. */
+uint8_t profile_frame_read(const uint8_t *payload, size_t length, uint8_t *reply, size_t *reply_length) {
+    if (1 != length) {
+        return PROTO_ERR_ARGS;
+    }
+    const profile_zone_t *zone = zones;
+    for (uint index = 0; NULL != zone && index < payload[0]; index++) {
+        zone = zone->next;
+    }
+    if (NULL == zone) {
+        return PROTO_ERR_ARGS;
+    }
+    putU32(&reply[0], zone->count);
+    putU32(&reply[4], zone->count ? (uint32_t) (zone->total_us / zone->count) : 0);
+    putU32(&reply[8], zone->max_us);
+    size_t n = 12;
+    for (int bucket = 0; bucket < PROFILE_BUCKETS; bucket++) {
+        uint32_t count = (zone->histogram[bucket] < UINT16_MAX) ? zone->histogram[bucket] : UINT16_MAX;
+        reply[n++] = (uint8_t) (count >> 8);
+        reply[n++] = (uint8_t) count;
+    }
+    size_t name_length = strlen(zone->name);
+    if (name_length > PROFILE_MAX_NAME) {
+        name_length = PROFILE_MAX_NAME;
+    }
+    memcpy(&reply[n], zone->name, name_length);
+    *reply_length = n + name_length;
+    return PROTO_OK;
+}
+
+static uint bucketOf(uint32_t us) {
+    uint bucket = us ? 32 - __builtin_clz(us) : 0;
+    return (bucket < PROFILE_BUCKETS) ? bucket : PROFILE_BUCKETS - 1;
+}
+
+static void putU32(uint8_t *buffer, uint32_t value) {
+    buffer[0] = (uint8_t) (value >> 24);
+    buffer[1] = (uint8_t) (value >> 16);
+    buffer[2] = (uint8_t) (value >> 8);
+    buffer[3] = (uint8_t) value;
+}
+
+#else
+
+void profile_print(void) {
+    printf("Profiling is not built in (build with PROFILE=1).\n");
+}
+
+void profile_reset(void) {
+}
+
+uint8_t profile_frame_read(const uint8_t *payload, size_t length, uint8_t *reply, size_t *reply_length) {
+    return PROTO_ERR_FAILED;
+}
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef COMMON_PROFILE_H
+#define COMMON_PROFILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Main loop profiler. A zone is a stretch of the loop that is timed every time it runs:
+ *
+ *     PROFILE_ZONE(button_zone, "button");
+ *     ...
+ *         PROFILE_BEGIN(button_zone);
+ *         handle the button
+ *         PROFILE_END(button_zone);
+ *
+ * Each zone counts its runs and keeps the total, the maximum and a histogram of the durations in us with
+ * power-of-two buckets: bucket 0 is below 1 us, bucket b from 2^(b-1) up to 2^b us, the last bucket is open ended.
+ * Zones may nest and the same zone may be used in several places, but a zone must be ended before it begins again.
+ * Time is time_us_32(), so a zone measures what the loop spends on the wall clock, interrupts included.
+ *
+ * Zones belong to the main loop of core 0; they are listed in the order they were first ended. profile_print()
+ * writes them to stdio and profile_frame_read() serves them over the binary protocol (PROTO_PROFILE_READ in proto.h).
+ *
+ * Build options:
+ *  PROFILE   1 compiles the zones in. Off by default: the macros are then empty, so an unprofiled build has no cost at
+ *            all; the report only says that profiling is off. */
+
+#ifndef PROFILE
+#define PROFILE 0
+#endif
+
+#define PROFILE_BUCKETS 16   // the last bucket starts at 16384 us
+#define PROFILE_MAX_NAME 20  // longest name sent over the protocol
+
+typedef struct profile_zone {
+    const char *name;
+    struct profile_zone *next;
+    bool linked;
+    uint32_t start_us;
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t total_us;
+    uint32_t histogram[PROFILE_BUCKETS];
+} profile_zone_t;
+
+#if PROFILE
+
+#include "hardware/timer.h"
+
+#define PROFILE_ZONE(zone, label) static profile_zone_t zone = {.name = (label)}
+#define PROFILE_BEGIN(zone) ((zone).start_us = time_us_32())
+#define PROFILE_END(zone) profile_end(&(zone))
+
+void profile_end(profile_zone_t *zone);
+
+#else
+
+#define PROFILE_ZONE(zone, label) extern profile_zone_t zone // takes the semicolon, never defined
+#define PROFILE_BEGIN(zone) ((void) 0)
+#define PROFILE_END(zone) ((void) 0)
+
+#endif
+
+void profile_print(void);
+void profile_reset(void);
+uint8_t profile_frame_read(const uint8_t *payload, size_t length, uint8_t *reply, size_t *reply_length);
+
+#endif //COMMON_PROFILE_H
@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+
+#include "crc16.h"
+#include "proto.h"
+
+static void handlePacket(proto_t *proto, const uint8_t *packet, size_t length);
+
+void proto_init(proto_t *proto, const proto_command_t *commands, size_t command_count) {
+    memset(proto, 0, sizeof(proto_t));
+    proto->commands = commands;
+    proto->command_count = command_count;
+}
+
+/* Byte sink for the command line (see cli_set_frame_sink). Called with the opening zero and everything after it;
+ * returns false once the closing zero has been handled. */
+bool proto_feed(void *context, uint8_t byte) {
+    proto_t *proto = context;
+
+    if (0 != byte) {
+        if (proto->length < sizeof(proto->buffer)) {
+            proto->buffer[proto->length++] = byte;
+        } else {
+            proto->overflow = true;
+        }
+        return true;
+    }
+
+    // zero: either the opening delimiter (nothing collected yet) or the closing one
+    if (0 == proto->length && false == proto->overflow) {
+        return true;
+    }
+
+    // a frame that fits the buffer can decode to more than a request may be: handlePacket rejects those
+    uint8_t packet[PROTO_MAX_ENCODED];
+    size_t length = 0;
+    if (false == proto->overflow) {
+        length = cobs_decode(proto->buffer, proto->length, packet);
+    }
+    if (length >= 4 && 0 == crc16(packet, length)) {
+        proto->frames++;
+        handlePacket(proto, packet, length - 2);
+    } else {
+        proto->errors++;
+    }
+    proto->length = 0;
+    proto->overflow = false;
+    return false;
+}
+
+/* length without the CRC. A payload longer than PROTO_MAX_PAYLOAD is answered with PROTO_ERR_ARGS before any handler
+ * sees it, so neither the handlers nor the echo of a ping have to check it. */
+static void handlePacket(proto_t *proto, const uint8_t *packet, size_t length) {
+    uint8_t seq = packet[0];
+    uint8_t type = packet[1];
+    uint8_t reply[PROTO_MAX_PAYLOAD];
+    size_t reply_length = 0;
+    uint8_t status = PROTO_ERR_TYPE;
+
+    if (length - 2 > PROTO_MAX_PAYLOAD) {
+        status = PROTO_ERR_ARGS;
+    } else if (PROTO_PING == type) {
+        reply_length = length - 2;
+        memcpy(reply, &packet[2], reply_length);
+        status = PROTO_OK;
+    }
+    for (size_t i = 0; i < proto->command_count && PROTO_ERR_TYPE == status; i++) {
+        if (proto->commands[i].type == type) {
+            status = proto->commands[i].handler(&packet[2], length - 2, reply, &reply_length);
+            break;
+        }
+    }
+    if (PROTO_OK != status) {
+        reply_length = 0;
+    }
+    proto_send(seq, type | PROTO_RESPONSE, status, reply, reply_length);
+}
+
+/* Payloads longer than PROTO_MAX_PAYLOAD are cut to it. */
+void proto_send(uint8_t seq, uint8_t type, uint8_t status, const uint8_t *payload, size_t length) {
+    uint8_t packet[PROTO_MAX_PACKET];
+    uint8_t encoded[PROTO_MAX_ENCODED];
+
+    if (length > PROTO_MAX_PAYLOAD) {
+        length = PROTO_MAX_PAYLOAD;
+    }
+
+    packet[0] = seq;
+    packet[1] = type;
+    packet[2] = status;
+    memcpy(&packet[3], payload, length);
+    uint16_t crc = crc16(packet, length + 3);
+    packet[length + 3] = (uint8_t) (crc >> 8);
+    packet[length + 4] = (uint8_t) crc;
+
+    size_t encoded_length = cobs_encode(packet, length + 5, encoded);
+
+    // raw output: the CR/LF translation of printf/putchar would corrupt the frame
+    putchar_raw(0);
+    for (size_t i = 0; i < encoded_length; i++) {
+        putchar_raw(encoded[i]);
+    }
+    putchar_raw(0);
+}
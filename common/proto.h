@@ -0,0 +1,68 @@
+#ifndef COMMON_PROTO_H
+#define COMMON_PROTO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "cobs.h"
+
+/* Binary request/response protocol sharing stdio with the text command line.
+ *
+ * A frame on the wire is 0x00, the COBS encoded packet, 0x00. Text lines never contain a zero byte, so the leading
+ * zero switches the command line to frame mode until the closing zero. Packet:
+ *
+ *     request:  seq, type, payload..., CRC16 (MSB first)
+ *     response: seq, type | PROTO_RESPONSE, status, payload..., CRC16 (MSB first)
+ *
+ * Requests are answered in arrival order and every response echoes the sequence number, so a client may keep several
+ * requests in flight. Multibyte payload fields are big-endian. */
+
+#define PROTO_MAX_PAYLOAD 64
+#define PROTO_MAX_PACKET (PROTO_MAX_PAYLOAD + 5)
+#define PROTO_MAX_ENCODED (PROTO_MAX_PACKET + PROTO_MAX_PACKET / 254 + 1)
+#define PROTO_RESPONSE 0x80
+
+enum proto_type {
+    PROTO_PING = 0x01,         // echoes the payload
+    PROTO_MOTOR_MOVE = 0x10,   // u32 eighths
+    PROTO_MOTOR_GOTO = 0x11,   // u8 eighth
+    PROTO_MOTOR_STATUS = 0x12, // -> u8 calibrated, u8 busy, u32 position, u32 steps/rev, u32 errors
+    PROTO_LED_GET = 0x20,      // -> u8 bitmask D1..D3
+    PROTO_LED_SET = 0x21,      // u8 bitmask D1..D3
+    PROTO_LOG_READ = 0x30,     // u8 or u16 index -> record text
+    PROTO_EEPROM_READ = 0x40,  // u16 address, u8 length -> bytes
+    PROTO_LOG_EVENT = 0x50,    // sent by the board, never requested: see dlog.h
+    PROTO_PROFILE_READ = 0x60  // u8 zone index -> main loop profile zone, see profile.h
+};
+
+enum proto_status {
+    PROTO_OK = 0,
+    PROTO_ERR_TYPE,
+    PROTO_ERR_ARGS,
+    PROTO_ERR_BUSY,
+    PROTO_ERR_FAILED
+};
+
+/* Handles one request. Writes up to PROTO_MAX_PAYLOAD bytes to reply, sets *reply_length and returns a status. */
+typedef uint8_t (*proto_handler_t)(const uint8_t *payload, size_t length, uint8_t *reply, size_t *reply_length);
+
+typedef struct {
+    uint8_t type;
+    proto_handler_t handler;
+} proto_command_t;
+
+typedef struct {
+    const proto_command_t *commands;
+    size_t command_count;
+    uint8_t buffer[PROTO_MAX_ENCODED];
+    size_t length;
+    bool overflow;
+    uint32_t frames;
+    uint32_t errors;
+} proto_t;
+
+void proto_init(proto_t *proto, const proto_command_t *commands, size_t command_count);
+bool proto_feed(void *context, uint8_t byte);
+void proto_send(uint8_t seq, uint8_t type, uint8_t status, const uint8_t *payload, size_t length);
+
+#endif //COMMON_PROTO_H
@@ -0,0 +1,30 @@
+#ifndef COMMON_RAM_FUNC_H
+#define COMMON_RAM_FUNC_H
+
+#include "pico.h"
+
+/* Placement of the interrupt handlers and of the code they call. From XIP flash a handler stalls on every cache miss
+ * of its code (8 byte lines, refilled over QSPI), so its latency and duration depend on what ran before it. A function
+ * defined with RAM_FUNC() goes to SRAM in a hot path build:
+ *
+ *     void RAM_FUNC(uart0_handler)(void) {
+ *
+ * The SDK functions the handlers call are mostly inline or in SRAM already (the interrupt dispatch of gpio and the
+ * alarms). tools/map_report.c lists where each function ended up and what it takes.
+ *
+ * Build options:
+ *  RAM_HOT_PATH   1 places the RAM_FUNC() functions in SRAM (__not_in_flash_func). Off by default: they run from flash
+ *                 like the rest of the code. A copy_to_ram binary (PICOW_COPY_TO_RAM in common/CMakeLists.txt) runs
+ *                 all of its code from SRAM either way. */
+
+#ifndef RAM_HOT_PATH
+#define RAM_HOT_PATH 0
+#endif
+
+#if RAM_HOT_PATH
+#define RAM_FUNC(func_name) __not_in_flash_func(func_name)
+#else
+#define RAM_FUNC(func_name) func_name
+#endif
+
+#endif //COMMON_RAM_FUNC_H
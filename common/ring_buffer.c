@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include "ram_func.h"
 #include "ring_buffer.h"
 
 void rb_init(ring_buffer *rb, uint8_t *buffer, int size)
@@ -9,17 +10,17 @@ void rb_init(ring_buffer *rb, uint8_t *buffer, int size)
     rb->buffer = buffer;
 }
 
-bool rb_empty(ring_buffer *rb)
+bool RAM_FUNC(rb_empty)(ring_buffer *rb)
 {
     return rb->head == rb->tail;
 }
 
-bool rb_full(ring_buffer *rb)
+bool RAM_FUNC(rb_full)(ring_buffer *rb)
 {
     return (rb->head + 1) % rb->size == rb->tail;
 }
 
-bool rb_put(ring_buffer *rb, uint8_t data)
+bool RAM_FUNC(rb_put)(ring_buffer *rb, uint8_t data)
 {
     // calculate new head (position where to store the value)
     int nh = (rb->head + 1) % rb->size;
@@ -31,7 +32,7 @@ bool rb_put(ring_buffer *rb, uint8_t data)
     return true;
 }
 
-uint8_t rb_get(ring_buffer *rb)
+uint8_t RAM_FUNC(rb_get)(ring_buffer *rb)
 {
     uint8_t value = rb->buffer[rb->tail];
     if(rb->head != rb->tail) {
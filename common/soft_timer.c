@@ -0,0 +1,100 @@
+#include "pico/stdlib.h"
+#include "hardware/timer.h"
+#include "hardware/sync.h"
+
+#include "isr_trace.h"
+#include "ram_func.h"
+#include "soft_timer.h"
+
+#define US_PER_TICK 1000
+
+static void schedule(void);
+static void alarmCallback(uint alarm_num);
+static void ignoreTimer(soft_timer_t *timer, void *context);
+
+static timer_wheel_t wheel;
+static uint alarm;
+static uint64_t alarm_target_us; // what the alarm was last set for
+
+ISR_TRACE_SITE(alarm_trace, "soft_timer");
+
+/* Claims a free hardware alarm; its interrupt is enabled on the calling core. */
+void soft_timer_init(void) {
+    timer_wheel_init(&wheel, soft_timer_now_ms());
+    alarm = hardware_alarm_claim_unused(true);
+    hardware_alarm_set_callback(alarm, alarmCallback);
+}
+
+void soft_timer_start(soft_timer_t *timer, uint32_t delay_ms, uint32_t period_ms, soft_timer_callback_t callback,
+                      void *context) {
+    uint32_t irq_state = save_and_disable_interrupts();
+    timer_wheel_remove(&wheel, timer);
+    timer->expires = soft_timer_now_ms() + delay_ms;
+    timer->period = period_ms;
+    timer->callback = (NULL != callback) ? callback : ignoreTimer;
+    timer->context = context;
+    timer_wheel_add(&wheel, timer);
+    schedule();
+    restore_interrupts(irq_state);
+}
+
+void soft_timer_start_at(soft_timer_t *timer, uint64_t deadline_ms, soft_timer_callback_t callback, void *context) {
+    uint32_t irq_state = save_and_disable_interrupts();
+    timer_wheel_remove(&wheel, timer);
+    timer->expires = deadline_ms;
+    timer->period = 0;
+    timer->callback = (NULL != callback) ? callback : ignoreTimer;
+    timer->context = context;
+    timer_wheel_add(&wheel, timer);
+    schedule();
+    restore_interrupts(irq_state);
+}
+
+/* Safe to call for a timer that has already expired or was never started. */
+void soft_timer_cancel(soft_timer_t *timer) {
+    uint32_t irq_state = save_and_disable_interrupts();
+    timer_wheel_remove(&wheel, timer);
+    restore_interrupts(irq_state);
+}
+
+bool soft_timer_pending(const soft_timer_t *timer) {
+    return *(volatile const bool *) &timer->pending;
+}
+
+uint64_t soft_timer_now_ms(void) {
+    return time_us_64() / US_PER_TICK;
+}
+
+/* The tick of the next alarm in ms since boot, TIMER_WHEEL_NEVER if no timer is pending. */
+uint64_t soft_timer_next_ms(void) {
+    uint32_t irq_state = save_and_disable_interrupts();
+    uint64_t next = timer_wheel_next(&wheel);
+    restore_interrupts(irq_state);
+    return next;
+}
+
+/* Called with interrupts disabled. hardware_alarm_set_target() refuses a target that has already passed; time is then
+ * advanced by hand until the alarm is set for a tick still ahead. */
+static void RAM_FUNC(schedule)(void) {
+    uint64_t next;
+    while (TIMER_WHEEL_NEVER != (next = timer_wheel_next(&wheel))) {
+        if (false == hardware_alarm_set_target(alarm, from_us_since_boot(next * US_PER_TICK))) {
+            alarm_target_us = next * US_PER_TICK;
+            return;
+        }
+        timer_wheel_advance(&wheel, soft_timer_now_ms());
+    }
+    hardware_alarm_cancel(alarm);
+}
+
+static void RAM_FUNC(alarmCallback)(uint alarm_num) {
+    ISR_TRACE_ENTER_DUE(alarm_trace, alarm_target_us);
+    uint32_t irq_state = save_and_disable_interrupts();
+    timer_wheel_advance(&wheel, soft_timer_now_ms());
+    schedule();
+    restore_interrupts(irq_state);
+    ISR_TRACE_EXIT(alarm_trace);
+}
+
+static void ignoreTimer(soft_timer_t *timer, void *context) {
+}
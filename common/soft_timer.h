@@ -0,0 +1,26 @@
+#ifndef COMMON_SOFT_TIMER_H
+#define COMMON_SOFT_TIMER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "timer_wheel.h"
+
+/* Software timers with 1 ms resolution on a single hardware alarm. The timers live in a timer wheel (timer_wheel.h)
+ * and the alarm is only programmed for the next tick that has work, so there is no periodic tick interrupt.
+ *
+ * A timer is one-shot (period 0) or periodic; periodic timers keep their phase, so a late callback does not move the
+ * later ones. soft_timer_start_at() takes an absolute deadline in ms since boot. Callbacks run in the alarm interrupt
+ * with interrupts disabled, so they must be short; they may start or cancel any timer, including their own. The
+ * callback may be NULL for a timeout that is only polled with soft_timer_pending(). Timers are owned by the caller, must
+ * be zero initialised before their first start and must stay in place while pending. */
+
+void soft_timer_init(void);
+void soft_timer_start(soft_timer_t *timer, uint32_t delay_ms, uint32_t period_ms, soft_timer_callback_t callback,
+                      void *context);
+void soft_timer_start_at(soft_timer_t *timer, uint64_t deadline_ms, soft_timer_callback_t callback, void *context);
+void soft_timer_cancel(soft_timer_t *timer);
+bool soft_timer_pending(const soft_timer_t *timer);
+uint64_t soft_timer_now_ms(void);
+uint64_t soft_timer_next_ms(void);
+
+#endif //COMMON_SOFT_TIMER_H
@@ -0,0 +1,137 @@
+#include <string.h>
+
+#include "ram_func.h"
+#include "timer_wheel.h"
+
+static void insert(timer_wheel_t *wheel, soft_timer_t *timer);
+static void cascade(timer_wheel_t *wheel, int level, int slot);
+static void expire(timer_wheel_t *wheel, int slot);
+
+void timer_wheel_init(timer_wheel_t *wheel, uint64_t now) {
+    memset(wheel, 0, sizeof(*wheel));
+    wheel->now = now;
+}
+
+/* timer->expires, period, callback and context must be set. A timer that is already due fires on the next tick. */
+void RAM_FUNC(timer_wheel_add)(timer_wheel_t *wheel, soft_timer_t *timer) {
+    if (true == timer->pending) {
+        timer_wheel_remove(wheel, timer);
+    }
+    if (timer->expires <= wheel->now) {
+        timer->expires = wheel->now + 1;
+    }
+    insert(wheel, timer);
+}
+
+void RAM_FUNC(timer_wheel_remove)(timer_wheel_t *wheel, soft_timer_t *timer) {
+    if (false == timer->pending) {
+        return;
+    }
+    if (NULL == timer->previous) {
+        wheel->slots[timer->level][timer->slot] = timer->next;
+        if (NULL == timer->next) {
+            wheel->occupied[timer->level] &= ~(1ull << timer->slot);
+        }
+    } else {
+        timer->previous->next = timer->next;
+    }
+    if (NULL != timer->next) {
+        timer->next->previous = timer->previous;
+    }
+    timer->pending = false;
+}
+
+/* The next tick at which timer_wheel_advance() has work to do: a timer on level 0 or a slot of a higher level to
+ * spread out. TIMER_WHEEL_NEVER if the wheel is empty. */
+uint64_t RAM_FUNC(timer_wheel_next)(const timer_wheel_t *wheel) {
+    uint64_t next = TIMER_WHEEL_NEVER;
+
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        uint64_t occupied = wheel->occupied[level];
+        if (0 == occupied) {
+            continue;
+        }
+        int shift = level * TIMER_WHEEL_BITS;
+        uint64_t block = wheel->now >> shift;
+        int start = (int) ((block + 1) & (TIMER_WHEEL_SLOTS - 1));
+        // rotate so that bit 0 is the slot after the current one
+        uint64_t rotated = start ? (occupied >> start) | (occupied << (TIMER_WHEEL_SLOTS - start)) : occupied;
+        uint64_t tick = (block + 1 + __builtin_ctzll(rotated)) << shift;
+        if (tick < next) {
+            next = tick;
+        }
+    }
+    return next;
+}
+
+/* Runs the callbacks of every timer due up to and including tick now, jumping over ticks with nothing to do. Periodic
+ * timers are re-inserted one period after their previous expiry, skipping periods that have already passed. */
+void RAM_FUNC(timer_wheel_advance)(timer_wheel_t *wheel, uint64_t now) {
+    while (wheel->now < now) {
+        uint64_t next = timer_wheel_next(wheel);
+        if (next > now) {
+            wheel->now = now;
+            break;
+        }
+        wheel->now = next;
+        for (int level = TIMER_WHEEL_LEVELS - 1; level > 0; level--) {
+            int shift = level * TIMER_WHEEL_BITS;
+            if (0 == (next & ((1ull << shift) - 1))) {
+                cascade(wheel, level, (int) ((next >> shift) & (TIMER_WHEEL_SLOTS - 1)));
+            }
+        }
+        expire(wheel, (int) (next & (TIMER_WHEEL_SLOTS - 1)));
+    }
+}
+
+static void RAM_FUNC(insert)(timer_wheel_t *wheel, soft_timer_t *timer) {
+    uint64_t delta = timer->expires - wheel->now;
+    uint64_t expires = timer->expires;
+    int level = 0;
+
+    while (level < TIMER_WHEEL_LEVELS - 1 && delta >= (1ull << (TIMER_WHEEL_BITS * (level + 1)))) {
+        level++;
+    }
+    if (delta >= (1ull << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))) {
+        // out of range: park in the last slot the top level can reach, re-inserted from there
+        expires = wheel->now + (1ull << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1;
+    }
+    int slot = (int) ((expires >> (level * TIMER_WHEEL_BITS)) & (TIMER_WHEEL_SLOTS - 1));
+
+    timer->level = (uint8_t) level;
+    timer->slot = (uint8_t) slot;
+    timer->previous = NULL;
+    timer->next = wheel->slots[level][slot];
+    if (NULL != timer->next) {
+        timer->next->previous = timer;
+    }
+    wheel->slots[level][slot] = timer;
+    wheel->occupied[level] |= 1ull << slot;
+    timer->pending = true;
+}
+
+static void RAM_FUNC(cascade)(timer_wheel_t *wheel, int level, int slot) {
+    soft_timer_t *timer = wheel->slots[level][slot];
+    wheel->slots[level][slot] = NULL;
+    wheel->occupied[level] &= ~(1ull << slot);
+    while (NULL != timer) {
+        soft_timer_t *next = timer->next;
+        insert(wheel, timer);
+        timer = next;
+    }
+}
+
+/* Timers are taken off the slot one at a time, so a callback may add or remove any timer. */
+static void RAM_FUNC(expire)(timer_wheel_t *wheel, int slot) {
+    soft_timer_t *timer;
+    while (NULL != (timer = wheel->slots[0][slot])) {
+        timer_wheel_remove(wheel, timer);
+        if (timer->period > 0) {
+            do {
+                timer->expires += timer->period;
+            } while (timer->expires <= wheel->now);
+            insert(wheel, timer);
+        }
+        timer->callback(timer, timer->context);
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef COMMON_TIMER_WHEEL_H
+#define COMMON_TIMER_WHEEL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Hierarchical timer wheel: TIMER_WHEEL_LEVELS levels of 64 slots. Level 0 holds the timers due within 64 ticks, level
+ * 1 those due within 64 * 64 ticks and so on; a slot of a higher level is spread over the lower levels when time
+ * reaches it. Adding, removing and expiring a timer are O(1), and timer_wheel_next() finds the next tick with work from
+ * one occupancy bitmap per level, so time can jump straight to it. Timers further out than the top level are parked in
+ * it and re-inserted until they are in range.
+ *
+ * The wheel knows nothing about real time: the caller passes the current tick to timer_wheel_advance(). */
+
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_NEVER UINT64_MAX
+
+typedef struct soft_timer soft_timer_t;
+typedef void (*soft_timer_callback_t)(soft_timer_t *timer, void *context);
+
+struct soft_timer {
+    soft_timer_t *next;
+    soft_timer_t *previous;
+    uint64_t expires;  // tick
+    uint32_t period;   // ticks, 0 for a one-shot timer
+    soft_timer_callback_t callback;
+    void *context;
+    uint8_t level;
+    uint8_t slot;
+    bool pending;
+};
+
+typedef struct {
+    uint64_t now;
+    uint64_t occupied[TIMER_WHEEL_LEVELS];
+    soft_timer_t *slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+} timer_wheel_t;
+
+void timer_wheel_init(timer_wheel_t *wheel, uint64_t now);
+void timer_wheel_add(timer_wheel_t *wheel, soft_timer_t *timer);
+void timer_wheel_remove(timer_wheel_t *wheel, soft_timer_t *timer);
+uint64_t timer_wheel_next(const timer_wheel_t *wheel);
+void timer_wheel_advance(timer_wheel_t *wheel, uint64_t now);
+
+#endif //COMMON_TIMER_WHEEL_H
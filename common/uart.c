@@ -1,6 +1,9 @@
 #include <string.h>
 #include "pico/stdlib.h"
 #include "hardware/uart.h"
+#include "io_record.h"
+#include "isr_trace.h"
+#include "ram_func.h"
 #include "ring_buffer.h"
 
 #include "uart.h"
@@ -11,6 +14,7 @@ typedef struct {
     uart_inst_t *uart;
     int irqn;
     irq_handler_t handler;
+    volatile bool tx_irq; // transmit interrupt enabled
 } uart_t;
 
 void uart_irq_rx(uart_t *u);
@@ -23,6 +27,9 @@ static uart_t *uart_get_handle(int uart_nr);
 static uart_t u0 = { .uart = uart0, .irqn = UART0_IRQ, .handler = uart0_handler };
 static uart_t u1 = { .uart = uart1, .irqn = UART1_IRQ, .handler = uart1_handler };
 
+ISR_TRACE_SITE(uart0_trace, "uart0");
+ISR_TRACE_SITE(uart1_trace, "uart1");
+
 static uart_t *uart_get_handle(int uart_nr) {
     return uart_nr ? &u1 : &u0;
 }
@@ -79,8 +86,9 @@ int uart_write(int uart_nr, const uint8_t *buffer, int size)
     irq_set_enabled(u->irqn, false);
 
     // if transmit interrupt is not enabled we need to enable it and give fifo an initial filling
-    if(!(uart_get_hw(u->uart)->imsc & (1 << UART_UARTIMSC_TXIM_LSB))) {
+    if(!u->tx_irq) {
         // enable transmit interrupt
+        u->tx_irq = true;
         uart_set_irq_enables(u->uart, true, true);
         // fifo requires initial filling
         uart_irq_tx(u);
@@ -98,35 +106,41 @@ int uart_send(int uart_nr, const char *str)
 }
 
 
-void uart_irq_rx(uart_t *u)
+void RAM_FUNC(uart_irq_rx)(uart_t *u)
 {
     while(uart_is_readable(u->uart)) {
         uint8_t c = uart_getc(u->uart);
+        IO_RECORD_UART(uart_get_index(u->uart), c);
         // ignoring return value for now
         rb_put(&u->rx, c);
     }
 }
 
-void uart_irq_tx(uart_t *u)
+void RAM_FUNC(uart_irq_tx)(uart_t *u)
 {
     while(!rb_empty(&u->tx) && uart_is_writable(u->uart)) {
-        uart_get_hw(u->uart)->dr = rb_get((&u->tx));
+        uart_putc_raw(u->uart, rb_get(&u->tx));
     }
 
     if (rb_empty(&u->tx)) {
         // disable tx interrupt if transmit buffer is empty
+        u->tx_irq = false;
         uart_set_irq_enables(u->uart, true, false);
     }
 }
 
-void uart0_handler(void)
+void RAM_FUNC(uart0_handler)(void)
 {
+    ISR_TRACE_ENTER(uart0_trace);
     uart_irq_rx(&u0);
     uart_irq_tx(&u0);
+    ISR_TRACE_EXIT(uart0_trace);
 }
 
-void uart1_handler(void)
+void RAM_FUNC(uart1_handler)(void)
 {
+    ISR_TRACE_ENTER(uart1_trace);
     uart_irq_rx(&u1);
     uart_irq_tx(&u1);
+    ISR_TRACE_EXIT(uart1_trace);
 }
@@ -0,0 +1,136 @@
+#include <string.h>
+
+#include "uplink.h"
+
+#define MAX_AGE_TICKS ((1u << 21) - 1)
+
+static uint32_t tick(const uplink_t *uplink, uint32_t time_ms);
+static size_t batchSize(const uplink_t *uplink, uint32_t now_ms, bool with_event);
+static bool fits(const uplink_t *uplink, uint32_t now_ms);
+static void dropOldest(uplink_t *uplink);
+static size_t varintSize(uint32_t value);
+static size_t putVarint(uint8_t *output, uint32_t value);
+
+void uplink_init(uplink_t *uplink, uint8_t state_bits, uint8_t max_payload, uint32_t deadline_ms, uplink_send_t send,
+                 void *context) {
+    memset(uplink, 0, sizeof(uplink_t));
+    uplink->state_bits = state_bits;
+    uplink->max_payload = max_payload;
+    uplink->deadline_ms = deadline_ms;
+    uplink->send = send;
+    uplink->context = context;
+}
+
+/* A batch that is full after the event goes out right away rather than at the next event. */
+void uplink_add(uplink_t *uplink, uint32_t now_ms, uint8_t state) {
+    uplink->events++;
+    if (false == fits(uplink, now_ms) && false == uplink_flush(uplink, now_ms)) {
+        // the radio has not taken the full batch yet: the oldest events make room
+        while (uplink->count > 0 && false == fits(uplink, now_ms)) {
+            dropOldest(uplink);
+        }
+    }
+    uplink->states[uplink->count] = state & (uint8_t) ((1u << uplink->state_bits) - 1);
+    uplink->times_ms[uplink->count++] = now_ms;
+    if (false == fits(uplink, now_ms)) {
+        uplink_flush(uplink, now_ms);
+    }
+}
+
+/* Sends the batch at its deadline, and one the radio could not take before as soon as it can. */
+void uplink_poll(uplink_t *uplink, uint32_t now_ms) {
+    if (uplink->count > 0 && (now_ms - uplink->times_ms[0] >= uplink->deadline_ms || false == fits(uplink, now_ms))) {
+        uplink_flush(uplink, now_ms);
+    }
+}
+
+bool uplink_flush(uplink_t *uplink, uint32_t now_ms) {
+    uint8_t payload[UINT8_MAX];
+    if (0 == uplink->count) {
+        return true;
+    }
+    size_t length = uplink_encode(uplink, now_ms, payload);
+    if (false == uplink->send(uplink->context, payload, length)) {
+        return false;
+    }
+    uplink->uplinks++;
+    uplink->bytes += length;
+    uplink->count = 0;
+    return true;
+}
+
+size_t uplink_encode(const uplink_t *uplink, uint32_t now_ms, uint8_t *payload) {
+    size_t index = 0;
+    uint8_t count = uplink->count;
+
+    payload[index++] = count;
+    if (0 == count) {
+        return index;
+    }
+    uint32_t age = tick(uplink, now_ms) - tick(uplink, uplink->times_ms[count - 1]);
+    index += putVarint(&payload[index], (age > MAX_AGE_TICKS) ? MAX_AGE_TICKS : age);
+    for (uint8_t i = 1; i < count; i++) {
+        index += putVarint(&payload[index], tick(uplink, uplink->times_ms[i]) - tick(uplink, uplink->times_ms[i - 1]));
+    }
+
+    size_t state_bytes = (count * uplink->state_bits + 7) / 8;
+    memset(&payload[index], 0, state_bytes);
+    for (uint8_t i = 0; i < count; i++) {
+        size_t bit = i * uplink->state_bits;
+        uint8_t *byte = &payload[index + bit / 8];
+        byte[0] |= (uint8_t) (uplink->states[i] << (bit % 8));
+        if (bit % 8 + uplink->state_bits > 8) {
+            byte[1] |= (uint8_t) (uplink->states[i] >> (8 - bit % 8));
+        }
+    }
+    return index + state_bytes;
+}
+
+/* Ticks since the oldest event waiting, so that the deltas do not add up rounding errors and the millisecond counter
+ * may wrap. */
+static uint32_t tick(const uplink_t *uplink, uint32_t time_ms) {
+    return (time_ms - uplink->times_ms[0]) / UPLINK_TICK_MS;
+}
+
+static size_t batchSize(const uplink_t *uplink, uint32_t now_ms, bool with_event) {
+    size_t count = uplink->count + (with_event ? 1 : 0);
+    size_t size = 1 + UPLINK_MAX_AGE_SIZE + (count * uplink->state_bits + 7) / 8;
+    for (uint8_t i = 1; i < uplink->count; i++) {
+        size += varintSize(tick(uplink, uplink->times_ms[i]) - tick(uplink, uplink->times_ms[i - 1]));
+    }
+    if (true == with_event && uplink->count > 0) {
+        size += varintSize(tick(uplink, now_ms) - tick(uplink, uplink->times_ms[uplink->count - 1]));
+    }
+    return size;
+}
+
+/* Whether one more event at now_ms goes into the batch. */
+static bool fits(const uplink_t *uplink, uint32_t now_ms) {
+    return uplink->count < UPLINK_MAX_EVENTS && batchSize(uplink, now_ms, true) <= uplink->max_payload;
+}
+
+static void dropOldest(uplink_t *uplink) {
+    uplink->count--;
+    memmove(&uplink->states[0], &uplink->states[1], uplink->count * sizeof(uplink->states[0]));
+    memmove(&uplink->times_ms[0], &uplink->times_ms[1], uplink->count * sizeof(uplink->times_ms[0]));
+    uplink->dropped++;
+}
+
+static size_t varintSize(uint32_t value) {
+    size_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+static size_t putVarint(uint8_t *output, uint32_t value) {
+    size_t index = 0;
+    do {
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        output[index++] = byte | (value ? 0x80 : 0);
+    } while (value);
+    return index;
+}
@@ -0,0 +1,52 @@
+#ifndef COMMON_UPLINK_H
+#define COMMON_UPLINK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Batches state changes into as few LoRaWAN uplinks as possible. Every uplink costs airtime and counts against the
+ * duty cycle whatever its size, so the events are collected and sent together, packed as:
+ *
+ *     count:  number of events
+ *     age:    UPLINK_TICK_MS ticks from the last event to the flush, unsigned LEB128 varint
+ *     deltas: count - 1 varints, ticks from each event to the next, oldest first
+ *     states: count states of state_bits bits each, oldest first, LSB first from the first state byte on
+ *
+ * The server counts back from the time it received the uplink. A batch goes out when the next event would not fit
+ * into max_payload or when its oldest event is deadline_ms old. Three LED states with a press every few seconds take
+ * about 1.4 bytes an event, against 5-7 bytes for a log record (log_record.h) and a whole uplink each unbatched. */
+
+#define UPLINK_MAX_EVENTS 64
+#define UPLINK_TICK_MS 100
+#define UPLINK_MAX_AGE_SIZE 3 // varint of an age up to 2^21 ticks (58 h)
+
+/* Hands a payload to the radio; false if it cannot take it now, the batch is then kept and offered again. */
+typedef bool (*uplink_send_t)(void *context, const uint8_t *payload, size_t length);
+
+typedef struct {
+    uint8_t state_bits;
+    uint8_t max_payload;
+    uint32_t deadline_ms;
+    uplink_send_t send;
+    void *context;
+    uint8_t states[UPLINK_MAX_EVENTS];
+    uint32_t times_ms[UPLINK_MAX_EVENTS];
+    uint8_t count;
+    uint32_t events;
+    uint32_t dropped; // oldest events given up while the radio could not send
+    uint32_t uplinks;
+    uint32_t bytes;
+} uplink_t;
+
+/* max_payload is that of the slowest data rate the network may use, e.g. 51 bytes for DR0-DR2 in EU868. */
+void uplink_init(uplink_t *uplink, uint8_t state_bits, uint8_t max_payload, uint32_t deadline_ms, uplink_send_t send,
+                 void *context);
+void uplink_add(uplink_t *uplink, uint32_t now_ms, uint8_t state);
+void uplink_poll(uplink_t *uplink, uint32_t now_ms);
+bool uplink_flush(uplink_t *uplink, uint32_t now_ms);
+
+/* The payload of the events waiting, at most max_payload bytes. */
+size_t uplink_encode(const uplink_t *uplink, uint32_t now_ms, uint8_t *payload);
+
+#endif //COMMON_UPLINK_H
@@ -0,0 +1,21 @@
+#ifndef HOST_HARDWARE_ADDRESS_MAPPED_H
+#define HOST_HARDWARE_ADDRESS_MAPPED_H
+
+#include "pico.h"
+
+typedef volatile uint32_t io_rw_32;
+typedef const volatile uint32_t io_ro_32;
+
+static inline void hw_set_bits(io_rw_32 *addr, uint32_t mask) {
+    *addr |= mask;
+}
+
+static inline void hw_clear_bits(io_rw_32 *addr, uint32_t mask) {
+    *addr &= ~mask;
+}
+
+static inline void hw_write_masked(io_rw_32 *addr, uint32_t values, uint32_t write_mask) {
+    *addr = (*addr & ~write_mask) | (values & write_mask);
+}
+
+#endif //HOST_HARDWARE_ADDRESS_MAPPED_H
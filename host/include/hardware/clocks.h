@@ -0,0 +1,66 @@
+#ifndef HOST_HARDWARE_CLOCKS_H
+#define HOST_HARDWARE_CLOCKS_H
+
+#include "pico.h"
+#include "hardware/address_mapped.h"
+
+/* The clock registers are plain memory on the host: writes are kept but change nothing. */
+
+#define KHZ 1000
+#define MHZ 1000000
+
+enum clock_index {
+    clk_gpout0 = 0,
+    clk_gpout1,
+    clk_gpout2,
+    clk_gpout3,
+    clk_ref,
+    clk_sys,
+    clk_peri,
+    clk_usb,
+    clk_adc,
+    clk_rtc,
+    CLK_COUNT
+};
+
+typedef struct {
+    io_rw_32 ctrl;
+    io_rw_32 div;
+    io_rw_32 selected;
+} clock_hw_t;
+
+typedef struct {
+    clock_hw_t clk[CLK_COUNT];
+    io_rw_32 sleep_en0;
+    io_rw_32 sleep_en1;
+} clocks_hw_t;
+
+extern clocks_hw_t *const clocks_hw;
+
+#define CLOCKS_SLEEP_EN0_CLK_ADC_ADC_BITS 0x00000002u
+#define CLOCKS_SLEEP_EN0_CLK_SYS_ADC_BITS 0x00000004u
+#define CLOCKS_SLEEP_EN0_CLK_SYS_JTAG_BITS 0x00000800u
+#define CLOCKS_SLEEP_EN0_CLK_SYS_PIO0_BITS 0x00002000u
+#define CLOCKS_SLEEP_EN0_CLK_SYS_PIO1_BITS 0x00004000u
+#define CLOCKS_SLEEP_EN0_CLK_RTC_RTC_BITS 0x00100000u
+#define CLOCKS_SLEEP_EN0_CLK_SYS_RTC_BITS 0x00200000u
+#define CLOCKS_SLEEP_EN1_CLK_PERI_SPI0_BITS 0x00010000u
+#define CLOCKS_SLEEP_EN1_CLK_SYS_SPI0_BITS 0x00020000u
+#define CLOCKS_SLEEP_EN1_CLK_PERI_SPI1_BITS 0x00040000u
+#define CLOCKS_SLEEP_EN1_CLK_SYS_SPI1_BITS 0x00080000u
+
+#define CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB 0x2u
+#define CLOCKS_CLK_SYS_CTRL_SRC_BITS 0x00000001u
+#define CLOCKS_CLK_SYS_CTRL_SRC_LSB 0
+#define CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLK_REF 0x0u
+#define CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLKSRC_CLK_SYS_AUX 0x1u
+#define CLOCKS_CLK_SYS_CTRL_AUXSRC_BITS 0x000000e0u
+#define CLOCKS_CLK_SYS_CTRL_AUXSRC_LSB 5
+#define CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_CLKSRC_PLL_SYS 0x0u
+#define CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB 0x1u
+
+bool clock_configure(enum clock_index clk_index, uint32_t src, uint32_t auxsrc, uint32_t src_freq, uint32_t freq);
+uint32_t clock_get_hz(enum clock_index clk_index);
+bool set_sys_clock_khz(uint32_t freq_khz, bool required);
+
+#endif //HOST_HARDWARE_CLOCKS_H
@@ -0,0 +1,30 @@
+#ifndef HOST_HARDWARE_IRQ_H
+#define HOST_HARDWARE_IRQ_H
+
+#include "pico.h"
+
+enum irq_num_rp2040 {
+    TIMER_IRQ_0 = 0,
+    TIMER_IRQ_1 = 1,
+    TIMER_IRQ_2 = 2,
+    TIMER_IRQ_3 = 3,
+    PWM_IRQ_WRAP = 4,
+    USBCTRL_IRQ = 5,
+    IO_IRQ_BANK0 = 13,
+    SIO_IRQ_PROC0 = 15,
+    SIO_IRQ_PROC1 = 16,
+    UART0_IRQ = 20,
+    UART1_IRQ = 21,
+    I2C0_IRQ = 23,
+    I2C1_IRQ = 24,
+    NUM_IRQS = 32
+};
+
+typedef void (*irq_handler_t)(void);
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler);
+irq_handler_t irq_get_exclusive_handler(uint num);
+void irq_set_enabled(uint num, bool enabled);
+bool irq_is_enabled(uint num);
+
+#endif //HOST_HARDWARE_IRQ_H
@@ -0,0 +1,18 @@
+#ifndef HOST_HARDWARE_STRUCTS_SCB_H
+#define HOST_HARDWARE_STRUCTS_SCB_H
+
+#include "hardware/address_mapped.h"
+
+typedef struct {
+    io_ro_32 cpuid;
+    io_rw_32 icsr;
+    io_rw_32 vtor;
+    io_rw_32 aircr;
+    io_rw_32 scr;
+} armv6m_scb_t;
+
+extern armv6m_scb_t *const scb_hw;
+
+#define M0PLUS_SCR_SLEEPDEEP_BITS 0x00000004u
+
+#endif //HOST_HARDWARE_STRUCTS_SCB_H
@@ -0,0 +1,22 @@
+#ifndef HOST_HARDWARE_STRUCTS_SYSTICK_H
+#define HOST_HARDWARE_STRUCTS_SYSTICK_H
+
+#include "hardware/address_mapped.h"
+
+typedef struct {
+    io_rw_32 csr;
+    io_rw_32 rvr;
+    io_rw_32 cvr;
+    io_ro_32 calib;
+} systick_hw_t;
+
+/* SysTick of the calling core. Once enabled it counts down at clk_sys from virtual time: every access through
+ * systick_hw brings cvr up to date, writes to cvr are ignored. */
+systick_hw_t *sim_systick_hw(void);
+#define systick_hw (sim_systick_hw())
+
+#define M0PLUS_SYST_CSR_ENABLE_BITS 0x00000001u
+#define M0PLUS_SYST_CSR_TICKINT_BITS 0x00000002u
+#define M0PLUS_SYST_CSR_CLKSOURCE_BITS 0x00000004u
+
+#endif //HOST_HARDWARE_STRUCTS_SYSTICK_H
@@ -0,0 +1,24 @@
+#ifndef HOST_HARDWARE_SYNC_H
+#define HOST_HARDWARE_SYNC_H
+
+#include "pico.h"
+
+/* WFE and WFI let the other core run and advance virtual time to the next event; SEV sets the event register of both
+ * cores. PRIMASK is kept per core, masked interrupts stay pending until restore_interrupts(). */
+void __wfe(void);
+void __wfi(void);
+void __sev(void);
+
+static inline void __dmb(void) {
+}
+
+static inline void __mem_fence_acquire(void) {
+}
+
+static inline void __mem_fence_release(void) {
+}
+
+uint32_t save_and_disable_interrupts(void);
+void restore_interrupts(uint32_t status);
+
+#endif //HOST_HARDWARE_SYNC_H
@@ -0,0 +1,33 @@
+#ifndef HOST_PICO_H
+#define HOST_PICO_H
+
+/* Host build of the subset of the Pico SDK the projects use (see host/sim.h). The declarations follow the SDK; the
+ * implementations drive the peripheral models of the simulation. */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define PICO_ON_DEVICE 0
+
+typedef unsigned int uint;
+
+/* Code the board runs from SRAM is kept in a section of its own, so that the simulation can tell it from the code in
+ * flash (SIM_XIP_MISS_NS in sim.h). */
+#define __not_in_flash(group)
+#define __not_in_flash_func(func_name) __attribute__((section("sim_ram_func"))) func_name
+#define __time_critical_func(func_name) __not_in_flash_func(func_name)
+#define __no_inline_not_in_flash_func(func_name) __attribute__((noinline)) __not_in_flash_func(func_name)
+
+#define PICO_OK 0
+#define PICO_ERROR_NONE 0
+#define PICO_ERROR_TIMEOUT (-1)
+#define PICO_ERROR_GENERIC (-2)
+#define PICO_ERROR_NO_DATA (-3)
+
+static inline void tight_loop_contents(void) {
+}
+
+uint get_core_num(void);
+
+#endif //HOST_PICO_H
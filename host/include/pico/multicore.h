@@ -0,0 +1,17 @@
+#ifndef HOST_PICO_MULTICORE_H
+#define HOST_PICO_MULTICORE_H
+
+#include "pico.h"
+
+/* Core 1 runs as a coroutine of the simulation: it only gets the CPU while core 0 waits (WFE, a blocking FIFO
+ * operation or a sleep), which is how both cores spend most of their time. The FIFOs are 8 words deep. */
+
+void multicore_launch_core1(void (*entry)(void));
+void multicore_reset_core1(void);
+bool multicore_fifo_rvalid(void);
+bool multicore_fifo_wready(void);
+void multicore_fifo_push_blocking(uint32_t data);
+uint32_t multicore_fifo_pop_blocking(void);
+void multicore_fifo_drain(void);
+
+#endif //HOST_PICO_MULTICORE_H
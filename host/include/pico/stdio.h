@@ -0,0 +1,13 @@
+#ifndef HOST_PICO_STDIO_H
+#define HOST_PICO_STDIO_H
+
+#include "pico.h"
+
+bool stdio_init_all(void);
+int getchar_timeout_us(uint32_t timeout_us);
+int putchar_raw(int c);
+int puts_raw(const char *s);
+void stdio_flush(void);
+void stdio_set_chars_available_callback(void (*fn)(void *), void *param);
+
+#endif //HOST_PICO_STDIO_H
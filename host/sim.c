@@ -0,0 +1,1168 @@
+#include <ctype.h>
+#include <regex.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "hardware/clocks.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "hardware/structs/scb.h"
+#include "hardware/structs/systick.h"
+
+#include "io_record.h"
+#include "sim.h"
+
+#define DEFAULT_UNTIL_MS 10000
+#define CORE1_STACK_SIZE (256 * 1024)
+#define FIFO_DEPTH 8
+#define STDIN_SIZE 4096
+#define MAX_ARGS 16
+#define MAX_LINE 512
+#define CONSOLE_CAPTURE 65536 // console output kept for the next expect line
+#define PRINTF_BUFFER 512
+#define MAX_PATH 4096
+
+#if SIM_STDIO_USB
+#define STDIO_FIFO_DEPTH 256
+#define STDIO_CHAR_NS 15625ull // 64 byte packets, one per 1 ms frame
+#else
+#define STDIO_FIFO_DEPTH 32
+#define STDIO_CHAR_NS (10000000000ull / SIM_STDIO_BAUD)
+#endif
+
+typedef struct event {
+    uint64_t at;
+    sim_event_t handler;
+    void *context;
+    struct event *next;
+} event_t;
+
+typedef struct {
+    ucontext_t context;
+    bool launched;
+    bool ready;       // switched away from without waiting
+    bool event;       // event register
+    bool masked;      // PRIMASK
+    bool in_handler;
+    bool enabled[NUM_IRQS];
+    bool pending[NUM_IRQS];
+    uint32_t fifo[FIFO_DEPTH]; // words sent to this core
+    uint fifo_head;
+    uint fifo_count;
+} core_t;
+
+typedef struct {
+    bool claimed;
+    uint core;
+    hardware_alarm_callback_t callback;
+} alarm_t;
+
+struct alarm_pool {
+    uint alarm_num;
+    repeating_timer_t *timers;
+};
+
+typedef struct {
+    int argc;
+    char *argv[MAX_ARGS];
+    size_t length[MAX_ARGS];
+} command_t;
+
+static const char *const channels[] = {"gpio", "pwm", "i2c", "uart", "irq", "script"};
+
+static core_t cores[SIM_CORES];
+static uint running;
+static uint64_t now;
+static uint64_t until = DEFAULT_UNTIL_MS * 1000000ull;
+static event_t *events;
+static irq_handler_t handlers[NUM_IRQS];
+static uint32_t traced;
+static bool finishing;
+static uint64_t xip_miss_ns;
+
+static alarm_t alarms[NUM_TIMERS];
+static alarm_pool_t *pools[NUM_TIMERS];
+static alarm_pool_t *default_pool;
+
+static uint8_t stdin_buffer[STDIN_SIZE];
+static size_t stdin_head;
+static size_t stdin_count;
+static void (*chars_available)(void *);
+static void *chars_available_param;
+static uint64_t stdout_free_ns;
+static char console[CONSOLE_CAPTURE];
+static size_t console_length;
+static bool console_expected; // the capture goes with the next output, the expect lines of the same time share it
+static int expect_count;
+static int expect_failures;
+
+static clocks_hw_t clocks_registers;
+static armv6m_scb_t scb_registers;
+static systick_hw_t systick_registers[SIM_CORES];
+clocks_hw_t *const clocks_hw = &clocks_registers;
+armv6m_scb_t *const scb_hw = &scb_registers;
+
+static void runDue(uint64_t limit);
+static void finish(const char *reason, bool failed);
+static void deliverInterrupts(void);
+static void runHandler(uint core, uint irq);
+static void switchTo(uint core);
+static void core1Main(void);
+static void wakeCore(void *context);
+static void alarmExpired(void *context);
+static void alarmIrq(uint alarm_num);
+static void alarm0Irq(void);
+static void alarm1Irq(void);
+static void alarm2Irq(void);
+static void alarm3Irq(void);
+static void poolAlarm(uint alarm_num);
+static void poolSchedule(alarm_pool_t *pool);
+static void stdoutChars(size_t count);
+static void stdoutWrite(const char *data, size_t count);
+static void expectOutput(const char *pattern);
+static void setTrace(const char *list);
+static const char *besideTwin(const char *file_name, char *path, size_t size);
+static void loadScript(const char *path);
+static int splitLine(char *line, char *argv[], size_t length[]);
+static void runCommand(void *context);
+static void unescape(char *text, size_t *length);
+
+static void (*core1_entry)(void);
+static void *core1_stack;
+
+/////////////////////////////////////////////////////
+//                  SIMULATION CORE                //
+/////////////////////////////////////////////////////
+
+__attribute__((constructor)) static void simStart(void) {
+    const char *value = getenv("SIM_UNTIL_MS");
+    if (NULL != value) {
+        until = strtoull(value, NULL, 0) * 1000000ull;
+    }
+    value = getenv("SIM_TRACE");
+    if (NULL != value) {
+        setTrace(value);
+    }
+    value = getenv("SIM_XIP_MISS_NS");
+    if (NULL != value) {
+        xip_miss_ns = strtoull(value, NULL, 0);
+    }
+    cores[0].launched = true;
+    handlers[TIMER_IRQ_0] = alarm0Irq;
+    handlers[TIMER_IRQ_1] = alarm1Irq;
+    handlers[TIMER_IRQ_2] = alarm2Irq;
+    handlers[TIMER_IRQ_3] = alarm3Irq;
+    sim_board_init();
+    value = getenv("SIM_SCRIPT");
+    if (NULL != value) {
+        loadScript(value);
+    }
+    value = getenv("SIM_RECORD");
+    if (NULL != value) {
+        sim_record_open(value);
+    }
+    value = getenv("SIM_REPLAY");
+    if (NULL != value) {
+        const char *gap = getenv("SIM_REPLAY_GAP_MS");
+        sim_replay_load(value, (NULL != gap) ? strtoul(gap, NULL, 0) : 0);
+    }
+}
+
+uint64_t sim_time_ns(void) {
+    return now;
+}
+
+void sim_spend_ns(uint64_t ns) {
+    runDue(now + ns);
+}
+
+/* Events run in time order, events at the same time in the order they were added. */
+void sim_at(uint64_t at_ns, sim_event_t event, void *context) {
+    event_t *e = malloc(sizeof(event_t));
+    e->at = (at_ns < now) ? now : at_ns;
+    e->handler = event;
+    e->context = context;
+
+    event_t **link = &events;
+    while (NULL != *link && (*link)->at <= e->at) {
+        link = &(*link)->next;
+    }
+    e->next = *link;
+    *link = e;
+}
+
+void sim_cancel(sim_event_t event, void *context) {
+    for (event_t **link = &events; NULL != *link; link = &(*link)->next) {
+        if ((*link)->handler == event && (*link)->context == context) {
+            event_t *e = *link;
+            *link = e->next;
+            free(e);
+            return;
+        }
+    }
+}
+
+/* WFE of the running core: the other core gets the CPU if it has something to do, otherwise time moves on to the next
+ * event until this core's event register is set. */
+void sim_wait(void) {
+    core_t *core = &cores[running];
+    while (false == core->event) {
+        core_t *other = &cores[running ^ 1u];
+        if (false == core->in_handler && other->launched && (other->ready || other->event)) {
+            switchTo(running ^ 1u);
+            continue;
+        }
+        if (NULL == events && false == sim_pty_active()) {
+            sim_finish("both cores wait and nothing is scheduled");
+        }
+        runDue((NULL != events) ? events->at : until);
+    }
+    core->event = false;
+}
+
+void sim_wait_until(uint64_t at_ns) {
+    void *context = (void *) (uintptr_t) running;
+    sim_at(at_ns, wakeCore, context);
+    while (now < at_ns) {
+        sim_wait();
+    }
+    sim_cancel(wakeCore, context);
+}
+
+void sim_signal(uint core) {
+    cores[core].event = true;
+}
+
+void sim_irq_raise(uint core, uint irq) {
+    cores[core].pending[irq] = true;
+    deliverInterrupts();
+}
+
+/* Raises the interrupt on every core that has it enabled; it stays pending on core 0 if none has. */
+void sim_irq_raise_enabled(uint irq) {
+    bool raised = false;
+    for (uint core = 0; core < SIM_CORES; core++) {
+        if (cores[core].enabled[irq]) {
+            cores[core].pending[irq] = true;
+            raised = true;
+        }
+    }
+    if (false == raised) {
+        cores[0].pending[irq] = true;
+    }
+    deliverInterrupts();
+}
+
+void sim_finish(const char *reason) {
+    finish(reason, false);
+}
+
+/* Ends the run with exit status 1, e.g. when the program on the pty failed. */
+void sim_fail(const char *reason) {
+    finish(reason, true);
+}
+
+/* Charges an interrupt handler or callback about to run for the flash fetches of a cold XIP cache (SIM_XIP_MISS_NS).
+ * The functions the firmware placed in SRAM are those in the sim_ram_func section (host/include/pico.h). */
+void sim_fetch_code(const void *code) {
+#if !PICO_COPY_TO_RAM
+    extern const char __start_sim_ram_func[] __attribute__((weak));
+    extern const char __stop_sim_ram_func[] __attribute__((weak));
+    uintptr_t address = (uintptr_t) code;
+    bool in_ram = address >= (uintptr_t) __start_sim_ram_func && address < (uintptr_t) __stop_sim_ram_func;
+    if (0 != xip_miss_ns && false == in_ram) {
+        sim_spend_ns(xip_miss_ns);
+    }
+#endif
+}
+
+bool sim_traced(const char *channel) {
+    for (size_t i = 0; i < sizeof(channels) / sizeof(channels[0]); i++) {
+        if (0 == strcmp(channel, channels[i])) {
+            return traced & (1u << i);
+        }
+    }
+    return false;
+}
+
+void sim_log(const char *channel, const char *format, ...) {
+    if (false == sim_traced(channel)) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    fflush(stdout);
+    fprintf(stderr, "[%10.6f] %s: ", now / 1e9, channel);
+    vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+    va_end(args);
+}
+
+static void finish(const char *reason, bool failed) {
+    if (true == finishing) {
+        return;
+    }
+    finishing = true;
+    fflush(stdout);
+    fprintf(stderr, "[%10.6f] sim: %s\n", now / 1e9, reason);
+    if (expect_count > 0) {
+        fprintf(stderr, "[%10.6f] sim: %d of %d expect lines failed\n", now / 1e9, expect_failures, expect_count);
+    }
+    exit((failed || expect_failures > 0) ? 1 : 0);
+}
+
+static void runDue(uint64_t limit) {
+    deliverInterrupts();
+    if (limit >= until) {
+        limit = until;
+    }
+    while (true) {
+        sim_pty_pace((NULL != events && events->at <= limit) ? events->at : limit);
+        if (NULL == events || events->at > limit) {
+            break;
+        }
+        event_t *e = events;
+        events = e->next;
+        if (e->at > now) {
+            now = e->at;
+        }
+        e->handler(e->context);
+        free(e);
+        deliverInterrupts();
+    }
+    if (limit > now) {
+        now = limit;
+    }
+    if (now >= until) {
+        sim_finish("time limit");
+    }
+}
+
+/* Same priority for all interrupts: the lowest number goes first and handlers do not nest on a core. */
+static void deliverInterrupts(void) {
+    bool delivered = true;
+    while (true == delivered) {
+        delivered = false;
+        for (uint core = 0; core < SIM_CORES; core++) {
+            core_t *c = &cores[core];
+            if (true == c->masked || true == c->in_handler) {
+                continue;
+            }
+            for (uint irq = 0; irq < NUM_IRQS; irq++) {
+                if (c->pending[irq] && c->enabled[irq]) {
+                    c->pending[irq] = false;
+                    runHandler(core, irq);
+                    delivered = true;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+static void runHandler(uint core, uint irq) {
+    uint previous = running;
+    running = core;
+    cores[core].in_handler = true;
+    sim_log("irq", "core %u irq %u", core, irq);
+    if (NULL != handlers[irq]) {
+        sim_fetch_code((const void *) handlers[irq]);
+        handlers[irq]();
+    }
+    cores[core].in_handler = false;
+    cores[core].event = true; // exception return sets the event register
+    running = previous;
+}
+
+static void switchTo(uint core) {
+    uint self = running;
+    running = core;
+    cores[core].ready = false;
+    swapcontext(&cores[self].context, &cores[core].context);
+}
+
+static void wakeCore(void *context) {
+    sim_signal((uint) (uintptr_t) context);
+}
+
+/////////////////////////////////////////////////////
+//                 SYNC AND INTERRUPTS             //
+/////////////////////////////////////////////////////
+
+uint get_core_num(void) {
+    return running;
+}
+
+void __wfe(void) {
+    sim_wait();
+}
+
+void __wfi(void) {
+    sim_wait();
+}
+
+void __sev(void) {
+    for (uint core = 0; core < SIM_CORES; core++) {
+        cores[core].event = true;
+    }
+}
+
+uint32_t save_and_disable_interrupts(void) {
+    uint32_t status = cores[running].masked ? 1 : 0;
+    cores[running].masked = true;
+    return status;
+}
+
+void restore_interrupts(uint32_t status) {
+    cores[running].masked = status & 1u;
+    deliverInterrupts();
+}
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler) {
+    handlers[num] = handler;
+}
+
+irq_handler_t irq_get_exclusive_handler(uint num) {
+    return handlers[num];
+}
+
+void irq_set_enabled(uint num, bool enabled) {
+    cores[running].enabled[num] = enabled;
+    deliverInterrupts();
+}
+
+bool irq_is_enabled(uint num) {
+    return cores[running].enabled[num];
+}
+
+/////////////////////////////////////////////////////
+//                       TIME                      //
+/////////////////////////////////////////////////////
+
+uint64_t time_us_64(void) {
+    sim_spend_ns(SIM_POLL_NS);
+    return now / 1000;
+}
+
+uint32_t time_us_32(void) {
+    return (uint32_t) time_us_64();
+}
+
+void busy_wait_us_32(uint32_t delay_us) {
+    sim_spend_ns(delay_us * 1000ull);
+}
+
+void busy_wait_us(uint64_t delay_us) {
+    sim_spend_ns(delay_us * 1000ull);
+}
+
+void busy_wait_ms(uint32_t delay_ms) {
+    sim_spend_ns(delay_ms * 1000000ull);
+}
+
+void sleep_until(absolute_time_t target) {
+    sim_wait_until(target * 1000ull);
+}
+
+void sleep_us(uint64_t us) {
+    sim_wait_until(now + us * 1000ull);
+}
+
+void sleep_ms(uint32_t ms) {
+    sleep_us(ms * 1000ull);
+}
+
+void hardware_alarm_claim(uint alarm_num) {
+    alarms[alarm_num].claimed = true;
+}
+
+int hardware_alarm_claim_unused(bool required) {
+    for (uint alarm_num = 0; alarm_num < NUM_TIMERS; alarm_num++) {
+        if (false == alarms[alarm_num].claimed) {
+            alarms[alarm_num].claimed = true;
+            return (int) alarm_num;
+        }
+    }
+    if (true == required) {
+        fprintf(stderr, "sim: no free hardware alarm\n");
+        abort();
+    }
+    return -1;
+}
+
+void hardware_alarm_unclaim(uint alarm_num) {
+    hardware_alarm_cancel(alarm_num);
+    alarms[alarm_num].claimed = false;
+}
+
+/* The interrupt is enabled on the calling core, as the SDK does. */
+void hardware_alarm_set_callback(uint alarm_num, hardware_alarm_callback_t callback) {
+    alarms[alarm_num].callback = callback;
+    alarms[alarm_num].core = running;
+    irq_set_enabled(TIMER_IRQ_0 + alarm_num, NULL != callback);
+}
+
+/* Returns true when the target has already passed; the alarm does not fire then. */
+bool hardware_alarm_set_target(uint alarm_num, absolute_time_t t) {
+    void *context = (void *) (uintptr_t) alarm_num;
+    sim_cancel(alarmExpired, context);
+    if (t * 1000ull <= now) {
+        return true;
+    }
+    sim_at(t * 1000ull, alarmExpired, context);
+    return false;
+}
+
+void hardware_alarm_cancel(uint alarm_num) {
+    sim_cancel(alarmExpired, (void *) (uintptr_t) alarm_num);
+    cores[alarms[alarm_num].core].pending[TIMER_IRQ_0 + alarm_num] = false;
+}
+
+static void alarmExpired(void *context) {
+    uint alarm_num = (uint) (uintptr_t) context;
+    sim_irq_raise(alarms[alarm_num].core, TIMER_IRQ_0 + alarm_num);
+}
+
+/* The interrupt dispatch of the SDK runs from SRAM, so only the callbacks are fetched. */
+static void __not_in_flash_func(alarmIrq)(uint alarm_num) {
+    if (NULL != alarms[alarm_num].callback) {
+        sim_fetch_code((const void *) alarms[alarm_num].callback);
+        alarms[alarm_num].callback(alarm_num);
+    }
+}
+
+static void __not_in_flash_func(alarm0Irq)(void) {
+    alarmIrq(0);
+}
+
+static void __not_in_flash_func(alarm1Irq)(void) {
+    alarmIrq(1);
+}
+
+static void __not_in_flash_func(alarm2Irq)(void) {
+    alarmIrq(2);
+}
+
+static void __not_in_flash_func(alarm3Irq)(void) {
+    alarmIrq(3);
+}
+
+alarm_pool_t *alarm_pool_create(uint hardware_alarm_num, uint max_timers) {
+    alarm_pool_t *pool = calloc(1, sizeof(alarm_pool_t));
+    pool->alarm_num = hardware_alarm_num;
+    pools[hardware_alarm_num] = pool;
+    hardware_alarm_claim(hardware_alarm_num);
+    hardware_alarm_set_callback(hardware_alarm_num, poolAlarm);
+    return pool;
+}
+
+alarm_pool_t *alarm_pool_get_default(void) {
+    if (NULL == default_pool) {
+        default_pool = alarm_pool_create(3, 16);
+    }
+    return default_pool;
+}
+
+/* A negative delay is the time between the starts of two callbacks, a positive one the time from the end of one to
+ * the start of the next. */
+bool alarm_pool_add_repeating_timer_us(alarm_pool_t *pool, int64_t delay_us, repeating_timer_callback_t callback,
+                                       void *user_data, repeating_timer_t *out) {
+    out->delay_us = delay_us;
+    out->pool = pool;
+    out->callback = callback;
+    out->user_data = user_data;
+    out->target_us = now / 1000 + (uint64_t) (delay_us < 0 ? -delay_us : delay_us);
+    out->active = true;
+    out->next = pool->timers;
+    pool->timers = out;
+    poolSchedule(pool);
+    return true;
+}
+
+bool add_repeating_timer_us(int64_t delay_us, repeating_timer_callback_t callback, void *user_data,
+                            repeating_timer_t *out) {
+    return alarm_pool_add_repeating_timer_us(alarm_pool_get_default(), delay_us, callback, user_data, out);
+}
+
+bool add_repeating_timer_ms(int32_t delay_ms, repeating_timer_callback_t callback, void *user_data,
+                            repeating_timer_t *out) {
+    return add_repeating_timer_us(delay_ms * 1000ll, callback, user_data, out);
+}
+
+bool cancel_repeating_timer(repeating_timer_t *timer) {
+    alarm_pool_t *pool = timer->pool;
+    for (repeating_timer_t **link = &pool->timers; NULL != *link; link = &(*link)->next) {
+        if (*link == timer) {
+            *link = timer->next;
+            timer->active = false;
+            poolSchedule(pool);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void __not_in_flash_func(poolAlarm)(uint alarm_num) {
+    alarm_pool_t *pool = pools[alarm_num];
+    uint64_t now_us = now / 1000;
+    for (repeating_timer_t **link = &pool->timers; NULL != *link;) {
+        repeating_timer_t *timer = *link;
+        if (timer->target_us > now_us) {
+            link = &timer->next;
+            continue;
+        }
+        sim_fetch_code((const void *) timer->callback);
+        if (true == timer->callback(timer) && true == timer->active) {
+            if (timer->delay_us < 0) {
+                timer->target_us += (uint64_t) -timer->delay_us;
+            } else {
+                timer->target_us = now / 1000 + (uint64_t) timer->delay_us;
+            }
+            link = &timer->next;
+        } else if (*link == timer) {
+            *link = timer->next;
+            timer->active = false;
+        }
+    }
+    poolSchedule(pool);
+}
+
+static void poolSchedule(alarm_pool_t *pool) {
+    uint64_t earliest = UINT64_MAX;
+    for (repeating_timer_t *timer = pool->timers; NULL != timer; timer = timer->next) {
+        if (timer->target_us < earliest) {
+            earliest = timer->target_us;
+        }
+    }
+    if (UINT64_MAX == earliest) {
+        hardware_alarm_cancel(pool->alarm_num);
+    } else if (true == hardware_alarm_set_target(pool->alarm_num, earliest)) {
+        sim_irq_raise(alarms[pool->alarm_num].core, TIMER_IRQ_0 + pool->alarm_num);
+    }
+}
+
+/////////////////////////////////////////////////////
+//                     MULTICORE                   //
+/////////////////////////////////////////////////////
+
+/* Core 1 starts right away and runs until it first waits. */
+void multicore_launch_core1(void (*entry)(void)) {
+    core1_entry = entry;
+    if (NULL == core1_stack) {
+        core1_stack = malloc(CORE1_STACK_SIZE);
+    }
+    getcontext(&cores[1].context);
+    cores[1].context.uc_stack.ss_sp = core1_stack;
+    cores[1].context.uc_stack.ss_size = CORE1_STACK_SIZE;
+    cores[1].context.uc_link = NULL;
+    makecontext(&cores[1].context, core1Main, 0);
+    cores[1].launched = true;
+    cores[0].ready = true;
+    switchTo(1);
+}
+
+void multicore_reset_core1(void) {
+    cores[1].launched = false;
+    cores[1].fifo_count = 0;
+}
+
+bool multicore_fifo_rvalid(void) {
+    sim_spend_ns(SIM_POLL_NS);
+    return cores[running].fifo_count > 0;
+}
+
+bool multicore_fifo_wready(void) {
+    sim_spend_ns(SIM_POLL_NS);
+    return cores[running ^ 1u].fifo_count < FIFO_DEPTH;
+}
+
+void multicore_fifo_push_blocking(uint32_t data) {
+    core_t *target = &cores[running ^ 1u];
+    while (target->fifo_count == FIFO_DEPTH) {
+        sim_wait();
+    }
+    target->fifo[(target->fifo_head + target->fifo_count) % FIFO_DEPTH] = data;
+    target->fifo_count++;
+    __sev();
+}
+
+uint32_t multicore_fifo_pop_blocking(void) {
+    core_t *self = &cores[running];
+    while (0 == self->fifo_count) {
+        sim_wait();
+    }
+    uint32_t data = self->fifo[self->fifo_head];
+    self->fifo_head = (self->fifo_head + 1) % FIFO_DEPTH;
+    self->fifo_count--;
+    __sev();
+    return data;
+}
+
+void multicore_fifo_drain(void) {
+    cores[running].fifo_count = 0;
+}
+
+/* Core 1 sleeps for good if its entry returns. */
+static void core1Main(void) {
+    core1_entry();
+    cores[1].launched = false;
+    running = 0;
+    setcontext(&cores[0].context);
+}
+
+/////////////////////////////////////////////////////
+//                       STDIO                     //
+/////////////////////////////////////////////////////
+
+int __real_printf(const char *format, ...);
+
+bool stdio_init_all(void) {
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    return true;
+}
+
+void stdio_set_chars_available_callback(void (*fn)(void *), void *param) {
+    chars_available = fn;
+    chars_available_param = param;
+}
+
+void stdio_flush(void) {
+    fflush(stdout);
+    if (stdout_free_ns > now) {
+        sim_spend_ns(stdout_free_ns - now);
+    }
+}
+
+int getchar_timeout_us(uint32_t timeout_us) {
+    uint64_t deadline = now + timeout_us * 1000ull;
+    void *context = (void *) (uintptr_t) running;
+    sim_spend_ns(SIM_POLL_NS);
+    if (0 == stdin_count && now < deadline) {
+        sim_at(deadline, wakeCore, context);
+        while (0 == stdin_count && now < deadline) {
+            sim_wait();
+        }
+        sim_cancel(wakeCore, context);
+    }
+    if (0 == stdin_count) {
+        return PICO_ERROR_TIMEOUT;
+    }
+    uint8_t c = stdin_buffer[stdin_head];
+    stdin_head = (stdin_head + 1) % STDIN_SIZE;
+    stdin_count--;
+    return c;
+}
+
+void sim_stdin_push(const uint8_t *data, size_t length) {
+    sim_record(IO_KIND_STDIN, data, length);
+    for (size_t i = 0; i < length && stdin_count < STDIN_SIZE; i++) {
+        stdin_buffer[(stdin_head + stdin_count++) % STDIN_SIZE] = data[i];
+    }
+    sim_signal(0);
+    if (NULL != chars_available) {
+        chars_available(chars_available_param);
+    }
+}
+
+/* printf, puts and putchar are wrapped at link time so that console output takes its time on the line. */
+int __wrap_printf(const char *format, ...) {
+    char buffer[PRINTF_BUFFER];
+    char *text = buffer;
+    va_list args;
+    va_start(args, format);
+    int count = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (count >= (int) sizeof(buffer)) {
+        text = malloc(count + 1);
+        va_start(args, format);
+        vsnprintf(text, count + 1, format, args);
+        va_end(args);
+    }
+    if (count > 0) {
+        stdoutWrite(text, count);
+    }
+    if (text != buffer) {
+        free(text);
+    }
+    return count;
+}
+
+int __wrap_puts(const char *s) {
+    stdoutWrite(s, strlen(s));
+    stdoutWrite("\n", 1);
+    return 0;
+}
+
+int __wrap_putchar(int c) {
+    char byte = (char) c;
+    stdoutWrite(&byte, 1);
+    return c;
+}
+
+int putchar_raw(int c) {
+    return __wrap_putchar(c);
+}
+
+int puts_raw(const char *s) {
+    return __wrap_puts(s);
+}
+
+/* To stdout and into the capture the expect lines of the script search; zero bytes of binary frames are kept as line
+ * breaks there. The older half of the capture goes when it is full. */
+static void stdoutWrite(const char *data, size_t count) {
+    fwrite(data, 1, count, stdout);
+    if (console_expected) {
+        console_expected = false;
+        console_length = 0;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (console_length == sizeof(console) - 1) {
+            size_t keep = sizeof(console) / 2;
+            memmove(console, &console[console_length - keep], keep);
+            console_length = keep;
+        }
+        console[console_length++] = ('\0' == data[i]) ? '\n' : data[i];
+    }
+    stdoutChars(count);
+    sim_pty_write(stdout_free_ns, data, count);
+}
+
+/* A write blocks while the TX FIFO (or the USB buffer) is full. */
+static void stdoutChars(size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (stdout_free_ns < now) {
+            stdout_free_ns = now;
+        }
+        uint64_t queued = stdout_free_ns - now;
+        if (queued > STDIO_FIFO_DEPTH * STDIO_CHAR_NS) {
+            sim_spend_ns(queued - STDIO_FIFO_DEPTH * STDIO_CHAR_NS);
+        }
+        stdout_free_ns += STDIO_CHAR_NS;
+    }
+}
+
+/////////////////////////////////////////////////////
+//                       CLOCKS                    //
+/////////////////////////////////////////////////////
+
+bool clock_configure(enum clock_index clk_index, uint32_t src, uint32_t auxsrc, uint32_t src_freq, uint32_t freq) {
+    return true;
+}
+
+uint32_t clock_get_hz(enum clock_index clk_index) {
+    return (clk_usb == clk_index || clk_adc == clk_index) ? 48 * MHZ : 125 * MHZ;
+}
+
+bool set_sys_clock_khz(uint32_t freq_khz, bool required) {
+    return true;
+}
+
+/* Counts from boot rather than from the enable, which only moves the phase of a free running counter. */
+systick_hw_t *sim_systick_hw(void) {
+    systick_hw_t *systick = &systick_registers[get_core_num()];
+    if (systick->csr & M0PLUS_SYST_CSR_ENABLE_BITS) {
+        uint64_t cycles = now * (clock_get_hz(clk_sys) / MHZ) / 1000;
+        systick->cvr = systick->rvr - (uint32_t) (cycles % ((uint64_t) systick->rvr + 1));
+    }
+    return systick;
+}
+
+/////////////////////////////////////////////////////
+//                       BOARD                     //
+/////////////////////////////////////////////////////
+
+/* What the course board has wired up; the script can change or remove it. */
+void sim_board_init(void) {
+    static const uint motor[4] = {13, 6, 3, 2};
+    sim_stepper_attach(motor, 28, 4096, 16);
+    sim_eeprom_attach(0x50, 32768, 1000, NULL);
+    sim_uart_respond(1, "AT", "+AT: OK\r\n", 5);
+    sim_uart_respond(1, "AT+VER", "+VER: 4.0.11\r\n", 5);
+    sim_uart_respond(1, "AT+ID=DevEui", "+ID: DevEui, 2C:F7:F1:20:32:30:A5:70\r\n", 5);
+    sim_uart_respond(1, "AT+MODE=LWOTAA", "+MODE: LWOTAA\r\n", 5);
+    sim_uart_respond(1, "AT+KEY=APPKEY,*", "+KEY: APPKEY\r\n", 5);
+    sim_uart_respond(1, "AT+CLASS=A", "+CLASS: A\r\n", 5);
+    sim_uart_respond(1, "AT+PORT=*", "+PORT: 8\r\n", 5);
+    // a join accepted in the second receive window, and unconfirmed uplinks at DR0 with nothing received
+    sim_uart_respond(1, "AT+JOIN", "+JOIN: Start\r\n+JOIN: NORMAL\r\n+JOIN: Network joined\r\n"
+                                   "+JOIN: NetID 000013 DevAddr 26:0B:D9:5A\r\n+JOIN: Done\r\n", 6500);
+    sim_uart_respond(1, "AT+MSGHEX=*", "+MSGHEX: Start\r\n+MSGHEX: Done\r\n", 3500);
+}
+
+/////////////////////////////////////////////////////
+//                       SCRIPT                    //
+/////////////////////////////////////////////////////
+
+static void setTrace(const char *list) {
+    char buffer[MAX_LINE];
+    snprintf(buffer, sizeof(buffer), "%s", list);
+    for (char *name = strtok(buffer, ", "); NULL != name; name = strtok(NULL, ", ")) {
+        for (size_t i = 0; i < sizeof(channels) / sizeof(channels[0]); i++) {
+            if (0 == strcmp("all", name) || 0 == strcmp(channels[i], name)) {
+                traced |= 1u << i;
+            }
+        }
+    }
+}
+
+/* A relative file name of the script is taken from the directory of the twin, the build directory, so that a run
+ * leaves nothing in the working directory or the source tree. */
+static const char *besideTwin(const char *file_name, char *path, size_t size) {
+    char exe[MAX_PATH];
+    ssize_t length = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+    if ('/' == file_name[0] || length <= 0) {
+        return file_name;
+    }
+    exe[length] = 0;
+    char *slash = strrchr(exe, '/');
+    *slash = 0;
+    snprintf(path, size, "%s/%s", exe, file_name);
+    return path;
+}
+
+static void loadScript(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (NULL == file) {
+        perror(path);
+        exit(2);
+    }
+    char line[MAX_LINE];
+    int number = 0;
+    while (NULL != fgets(line, sizeof(line), file)) {
+        number++;
+        char *argv[MAX_ARGS];
+        size_t length[MAX_ARGS];
+        int argc = splitLine(line, argv, length);
+        if (argc <= 0) {
+            if (argc < 0) {
+                fprintf(stderr, "%s:%d: bad line\n", path, number);
+                exit(2);
+            }
+            continue;
+        }
+
+        bool ok = true;
+        if (isdigit((unsigned char) argv[0][0]) && argc > 1) {
+            command_t *command = calloc(1, sizeof(command_t));
+            command->argc = argc - 1;
+            for (int i = 1; i < argc; i++) {
+                command->argv[i - 1] = malloc(length[i] + 1);
+                memcpy(command->argv[i - 1], argv[i], length[i] + 1);
+                command->length[i - 1] = length[i];
+            }
+            // <ms>+<period_ms>x<count> repeats the command
+            char *end;
+            uint64_t at_ms = strtoull(argv[0], &end, 0);
+            uint64_t period_ms = 0;
+            unsigned long count = 1;
+            if ('+' == *end) {
+                period_ms = strtoull(end + 1, &end, 0);
+                ok = ('x' == *end);
+                count = ok ? strtoul(end + 1, &end, 0) : 0;
+            }
+            ok = ok && '\0' == *end;
+            for (unsigned long i = 0; ok && i < count; i++) {
+                sim_at((at_ms + i * period_ms) * 1000000ull, runCommand, command);
+            }
+        } else if (0 == strcmp("until", argv[0]) && 2 == argc) {
+            until = strtoull(argv[1], NULL, 0) * 1000000ull;
+        } else if (0 == strcmp("trace", argv[0])) {
+            for (int i = 1; i < argc; i++) {
+                setTrace(argv[i]);
+            }
+        } else if (0 == strcmp("eeprom", argv[0]) && argc >= 2) {
+            size_t size = 32768;
+            uint32_t max_khz = 1000;
+            const char *file_name = NULL;
+            char path[MAX_PATH];
+            for (int i = 2; i < argc; i++) {
+                if (0 == strncmp("size=", argv[i], 5)) {
+                    size = strtoul(argv[i] + 5, NULL, 0);
+                } else if (0 == strncmp("max_khz=", argv[i], 8)) {
+                    max_khz = strtoul(argv[i] + 8, NULL, 0);
+                } else if (0 == strncmp("file=", argv[i], 5)) {
+                    file_name = besideTwin(argv[i] + 5, path, sizeof(path));
+                } else {
+                    ok = false;
+                }
+            }
+            if (0 == strcmp("off", argv[1])) {
+                sim_eeprom_detach();
+            } else if (true == ok) {
+                sim_eeprom_attach(strtoul(argv[1], NULL, 0), size, max_khz, file_name);
+            }
+        } else if (0 == strcmp("respond", argv[0]) && argc >= 4) {
+            sim_uart_respond(strtoul(argv[1], NULL, 0), argv[2], argv[3], (argc > 4) ? strtoul(argv[4], NULL, 0) : 0);
+        } else if (0 == strcmp("lora", argv[0]) && 2 == argc && 0 == strcmp("off", argv[1])) {
+            sim_uart_clear_responses(1);
+        } else if (0 == strcmp("record", argv[0]) && 2 == argc) {
+            sim_record_open(argv[1]);
+        } else if (0 == strcmp("replay", argv[0]) && argc >= 2 && argc <= 3) {
+            uint32_t gap_ms = 0;
+            if (3 == argc) {
+                if (0 == strncmp("gap=", argv[2], 4)) {
+                    gap_ms = strtoul(argv[2] + 4, NULL, 0);
+                } else {
+                    ok = false;
+                }
+            }
+            if (true == ok) {
+                sim_replay_load(argv[1], gap_ms);
+            }
+        } else if (0 == strcmp("stepper", argv[0]) && argc >= 5) {
+            uint pins[4];
+            int opto = -1;
+            uint32_t steps = 4096;
+            uint32_t window = 16;
+            for (int i = 0; i < 4; i++) {
+                pins[i] = strtoul(argv[i + 1], NULL, 0);
+            }
+            for (int i = 5; i < argc; i++) {
+                if (0 == strncmp("opto=", argv[i], 5)) {
+                    opto = (int) strtol(argv[i] + 5, NULL, 0);
+                } else if (0 == strncmp("steps=", argv[i], 6)) {
+                    steps = strtoul(argv[i] + 6, NULL, 0);
+                } else if (0 == strncmp("window=", argv[i], 7)) {
+                    window = strtoul(argv[i] + 7, NULL, 0);
+                } else {
+                    ok = false;
+                }
+            }
+            if (true == ok) {
+                sim_stepper_attach(pins, opto, steps, window);
+            }
+        } else {
+            ok = false;
+        }
+        if (false == ok) {
+            fprintf(stderr, "%s:%d: unknown command %s\n", path, number, argv[0]);
+            exit(2);
+        }
+    }
+    fclose(file);
+}
+
+/* Splits at white space; double quoted strings keep their spaces and take C escapes (\x00 included, hence the
+ * lengths). Returns the number of words, or -1 for an unterminated string. */
+static int splitLine(char *line, char *argv[], size_t length[]) {
+    int argc = 0;
+    char *p = line;
+    while (argc < MAX_ARGS) {
+        while (isspace((unsigned char) *p)) {
+            p++;
+        }
+        if ('\0' == *p || '#' == *p) {
+            break;
+        }
+        if ('"' == *p) {
+            char *start = ++p;
+            while ('\0' != *p && '"' != *p) {
+                p += ('\\' == *p && '\0' != p[1]) ? 2 : 1;
+            }
+            if ('"' != *p) {
+                return -1;
+            }
+            *p++ = '\0';
+            unescape(start, &length[argc]);
+            argv[argc++] = start;
+        } else {
+            argv[argc] = p;
+            while ('\0' != *p && false == isspace((unsigned char) *p)) {
+                p++;
+            }
+            length[argc] = p - argv[argc];
+            argc++;
+            if ('\0' != *p) {
+                *p++ = '\0';
+            }
+        }
+    }
+    return argc;
+}
+
+static void unescape(char *text, size_t *length) {
+    char *out = text;
+    for (char *in = text; '\0' != *in; in++) {
+        if ('\\' != *in || '\0' == in[1]) {
+            *out++ = *in;
+            continue;
+        }
+        in++;
+        switch (*in) {
+            case 'r': *out++ = '\r'; break;
+            case 'n': *out++ = '\n'; break;
+            case 't': *out++ = '\t'; break;
+            case '0': *out++ = '\0'; break;
+            case 'x': {
+                char digits[3] = {in[1], in[1] ? in[2] : '\0', '\0'};
+                *out++ = (char) strtoul(digits, NULL, 16);
+                in += strlen(digits);
+                break;
+            }
+            default: *out++ = *in; break;
+        }
+    }
+    *length = out - text;
+    *out = '\0';
+}
+
+static void runCommand(void *context) {
+    command_t *command = context;
+    int argc = command->argc;
+    char **argv = command->argv;
+
+    sim_log("script", "%s%s%s", argv[0], argc > 1 ? " " : "", argc > 1 ? argv[1] : "");
+    if (0 == strcmp("press", argv[0]) && argc >= 2) {
+        sim_gpio_press(strtoul(argv[1], NULL, 0), (argc > 2) ? strtoul(argv[2], NULL, 0) : 100);
+    } else if (0 == strcmp("turn", argv[0]) && argc >= 4) {
+        sim_gpio_turn(strtoul(argv[1], NULL, 0), strtoul(argv[2], NULL, 0), atoi(argv[3]),
+                      (argc > 4) ? strtoul(argv[4], NULL, 0) : 20);
+    } else if (0 == strcmp("drive", argv[0]) && 3 == argc) {
+        sim_gpio_drive(strtoul(argv[1], NULL, 0), ('z' == argv[2][0]) ? -1 : atoi(argv[2]));
+    } else if (0 == strcmp("input", argv[0]) && 2 == argc) {
+        sim_stdin_push((const uint8_t *) argv[1], command->length[1]);
+    } else if (0 == strcmp("uart", argv[0]) && 3 == argc) {
+        sim_uart_inject(strtoul(argv[1], NULL, 0), (const uint8_t *) argv[2], command->length[2]);
+    } else if (0 == strcmp("respond", argv[0]) && argc >= 4) {
+        sim_uart_respond(strtoul(argv[1], NULL, 0), argv[2], argv[3], (argc > 4) ? strtoul(argv[4], NULL, 0) : 0);
+    } else if (0 == strcmp("lora", argv[0]) && 2 == argc && 0 == strcmp("off", argv[1])) {
+        sim_uart_clear_responses(1);
+    } else if (0 == strcmp("slip", argv[0]) && 3 == argc) {
+        sim_stepper_slip(strtoul(argv[1], NULL, 0), atoi(argv[2]));
+    } else if (0 == strcmp("expect", argv[0]) && 2 == argc) {
+        expectOutput(argv[1]);
+    } else if (0 == strcmp("pty", argv[0]) && argc >= 2) {
+        char path[MAX_PATH];
+        char *program[MAX_ARGS];
+        memcpy(program, &argv[1], (argc - 1) * sizeof(char *));
+        program[0] = (char *) besideTwin(argv[1], path, sizeof(path));
+        sim_pty_start(argc - 1, program);
+    } else if (0 == strcmp("quit", argv[0])) {
+        sim_finish("script quit");
+    } else {
+        fprintf(stderr, "sim: unknown timed command %s\n", argv[0]);
+        exit(2);
+    }
+}
+
+/* The console output since the previous expect line has to match the extended regular expression, ^ and $ at line
+ * breaks; expect lines of the same time all search the same output. A mismatch fails the run with exit status 1 but lets it go on. */
+static void expectOutput(const char *pattern) {
+    regex_t regex;
+    expect_count++;
+    if (0 != regcomp(&regex, pattern, REG_EXTENDED | REG_NEWLINE | REG_NOSUB)) {
+        fprintf(stderr, "sim: bad expect pattern %s\n", pattern);
+        exit(2);
+    }
+    console[console_length] = '\0';
+    if (0 != regexec(&regex, console, 0, NULL, 0)) {
+        fprintf(stderr, "[%10.6f] sim: expected \"%s\", not seen in the output since the last expect\n", now / 1e9,
+                pattern);
+        expect_failures++;
+    }
+    regfree(&regex);
+    console_expected = true;
+}
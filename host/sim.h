@@ -0,0 +1,137 @@
+#ifndef HOST_SIM_H
+#define HOST_SIM_H
+
+/*
+Simulation backend of the Pico SDK subset in host/include, used by the host twins of the projects (host/CMakeLists.txt).
+
+The firmware runs unchanged on top of a virtual clock. Time only moves when the code waits (WFE, sleep, a blocking FIFO
+or peripheral call) or polls (every time read and peripheral status read costs SIM_POLL_NS); the code in between takes
+no time. Peripherals are models driven by events on the clock:
+    GPIO   levels, pulls, edge interrupts; inputs can be driven by the script or by a model
+    PWM    slice and channel levels
+    I2C    blocking transfers timed from the baud rate, a 24LC256 EEPROM at 0x50 on i2c0
+    UART   32 byte FIFOs paced at the baud rate with RX/TX interrupts, a LoRa-E5 answering AT commands on uart1,
+           OTAA join and uplinks included; the uplinks sent and their payload bytes are reported at the end
+    stepper  a 28BYJ-48 on IN1..IN4 = 13, 6, 3, 2 with the opto fork on GPIO 28
+    stdio  printf goes to stdout, paced like stdio over UART; input comes from the script, or from a program on a
+           pseudo terminal (pty line)
+
+Core 1 is a coroutine that runs while core 0 waits. Interrupts are delivered between calls, on the core that enabled
+them, unless that core has them disabled or is already in a handler.
+
+Environment:
+    SIM_SCRIPT=<file>     stimulus script, see below
+    SIM_UNTIL_MS=<ms>     end of the run (default 10000)
+    SIM_TRACE=<list>      comma separated channels logged to stderr: gpio, pwm, i2c, uart, irq, script, or all
+    SIM_RECORD=<file>     record the traffic into the device, as the record line below
+    SIM_REPLAY=<file>     replay a trace, as the replay line below
+    SIM_REPLAY_GAP_MS=<ms>  gap option of SIM_REPLAY
+    SIM_XIP_MISS_NS=<ns>  time an interrupt handler or callback in flash loses before it runs, as if none of its code
+                          were in the XIP cache (default 0: the cache always hits). Functions placed in SRAM
+                          (__not_in_flash_func, common/ram_func.h) and the whole of a PICO_COPY_TO_RAM twin run at
+                          once, so the latencies of isr_trace compare the placements. A handler of a few hundred bytes
+                          is some 30 cache lines of 8 bytes, at about 0.4 us each with the QSPI flash at 62.5 MHz.
+
+Script lines (# starts a comment, strings take C escapes); a time of <ms>+<period_ms>x<count> repeats the line count
+times, period_ms apart:
+    <ms> press <gpio> [hold_ms]             pull the input low for hold_ms (default 100) with 1 ms of contact bounce
+    <ms> drive <gpio> 0|1|z                 drive an input or release it
+    <ms> turn <a> <b> <detents> [period_ms] turn a rotary encoder, clockwise for positive detents (20 ms each)
+    <ms> input "<text>"                     type on the stdio console
+    <ms> uart <n> "<text>"                  bytes from the device on uart n
+    <ms> respond <n> "<line>" "<reply>" [delay_ms]  answer the line from now on as the respond line below
+    <ms> lora off                           unplug the LoRa-E5
+    <ms> slip <in1> <steps>                 the stepper on in1 misses the next steps it is driven, or is turned forward
+                                            by hand for negative steps
+    <ms> expect "<regex>"                   the console output since the expect lines of an earlier time has to match
+                                            the extended regular expression (^ and $ at line breaks); the run ends with
+                                            exit status 1 if one does not
+    <ms> pty <program> [arg ...]            start a program on the host (relative paths are in the directory of the
+                                            twin) with a pseudo terminal on the console, its path in place of {} in
+                                            the arguments; from then on virtual time keeps to the wall clock, and the
+                                            run ends when the program does, with exit status 1 if it fails
+    <ms> quit                               end the run
+    until <ms>                              end of the run
+    trace <channel> ...                     as SIM_TRACE
+    eeprom <address> [size=<bytes>] [max_khz=<khz>] [file=<path>]   replace the EEPROM; file keeps the contents, a
+                                            relative path is in the directory of the twin (the build directory)
+    respond <n> "<line>" "<reply>" [delay_ms]   answer a line sent on uart n (the LoRa-E5 model uses these); a line
+                                            ending in * stands for all lines that start with the text before it
+    lora off                                no LoRa-E5 on uart1
+    stepper <in1> <in2> <in3> <in4> [opto=<gpio>] [steps=<n>] [window=<n>]
+    record <file>                           write the UART bytes, console input, input edges and I2C transactions that
+                                            come into the device to a trace (common/io_record.h)
+    replay <file> [gap=<ms>]                feed a trace in, recorded here or on the board (its console capture will
+                                            do); gaps longer than gap_ms are shortened to it. I2C devices of the trace
+                                            answer in place of the models, the UARTs of the trace get no LoRa-E5 answers
+*/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include "pico.h"
+#include "hardware/i2c.h"
+
+#define SIM_CORES 2
+#define SIM_POLL_NS 100 // cost of a time or status read
+#define SIM_STDIO_BAUD 115200
+
+typedef void (*sim_event_t)(void *context);
+
+/* Virtual time and events */
+uint64_t sim_time_ns(void);
+void sim_spend_ns(uint64_t ns);
+void sim_at(uint64_t at_ns, sim_event_t event, void *context);
+void sim_cancel(sim_event_t event, void *context);
+void sim_wait(void);
+void sim_wait_until(uint64_t at_ns);
+void sim_signal(uint core);
+void sim_irq_raise(uint core, uint irq);
+void sim_irq_raise_enabled(uint irq);
+void sim_finish(const char *reason);
+void sim_fail(const char *reason);
+void sim_fetch_code(const void *code);
+
+/* Tracing */
+bool sim_traced(const char *channel);
+void sim_log(const char *channel, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+/* Models, configured from the script */
+void sim_gpio_drive(uint gpio, int level);
+void sim_gpio_edge(uint gpio, bool level);
+void sim_gpio_press(uint gpio, uint32_t hold_ms);
+void sim_gpio_turn(uint a, uint b, int detents, uint32_t period_ms);
+bool sim_gpio_output(uint gpio, bool *level);
+void sim_stepper_attach(const uint pins[4], int opto, uint32_t steps, uint32_t window);
+void sim_stepper_slip(uint in1, int32_t steps);
+void sim_eeprom_attach(uint8_t address, size_t size, uint32_t max_khz, const char *file);
+void sim_eeprom_detach(void);
+/* I2C device side, shared by the blocking calls and the transaction scheduler backend (sim_i2c_bus.c) */
+uint64_t sim_i2c_time_ns(i2c_inst_t *i2c, size_t bytes);
+bool sim_i2c_acknowledges(i2c_inst_t *i2c, uint8_t addr);
+void sim_i2c_device_write(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop);
+void sim_i2c_device_read(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len);
+void sim_uart_inject(uint index, const uint8_t *data, size_t length);
+void sim_uart_respond(uint index, const char *line, const char *reply, uint32_t delay_ms);
+void sim_uart_clear_responses(uint index);
+void sim_stdin_push(const uint8_t *data, size_t length);
+
+/* Console on a pseudo terminal for a program on the host, paced to the wall clock (sim_pty.c) */
+void sim_pty_start(int argc, char **argv);
+bool sim_pty_active(void);
+void sim_pty_pace(uint64_t at_ns);
+void sim_pty_write(uint64_t at_ns, const char *data, size_t count);
+
+/* Record and replay of the traffic into the device (sim_record.c, format in common/io_record.h) */
+void sim_record_open(const char *path);
+void sim_record(uint8_t kind, const uint8_t *data, size_t length);
+void sim_record_i2c(uint8_t kind, uint index, uint8_t addr, const uint8_t *data, size_t length);
+void sim_replay_load(const char *path, uint32_t gap_ms);
+bool sim_replay_i2c_owns(uint index, uint8_t addr);
+bool sim_replay_i2c_acknowledges(uint index, uint8_t addr);
+void sim_replay_i2c_write(uint index, uint8_t addr, const uint8_t *src, size_t len);
+void sim_replay_i2c_read(uint index, uint8_t addr, uint8_t *dst, size_t len);
+
+/* Board defaults, called before the script is read */
+void sim_board_init(void);
+
+#endif //HOST_SIM_H
@@ -0,0 +1,374 @@
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/pwm.h"
+
+#include "io_record.h"
+#include "sim.h"
+
+#define BOUNCE_NS 200000 // contact bounce of a press or release
+#define MAX_STEPPERS 2
+
+typedef struct {
+    enum gpio_function function;
+    bool out;
+    bool value;
+    bool pull_up;
+    bool pull_down;
+    bool driven; // from outside
+    bool drive;
+    bool level;  // input level, for the edges
+    uint32_t irq_mask[SIM_CORES];
+    uint32_t irq_status[SIM_CORES];
+} pin_t;
+
+typedef struct {
+    bool enabled;
+    uint16_t top;
+    uint32_t div;
+    uint16_t level[2];
+} slice_t;
+
+/* 28BYJ-48 with the opto fork: the half step phase is decoded from IN1..IN4 and the fork is driven low while the
+ * position is within the window. A slip makes the shaft miss the next steps it is driven. */
+typedef struct {
+    uint pins[4];
+    int opto;
+    uint32_t steps;
+    uint32_t window;
+    int phase;
+    int64_t position;
+    uint32_t slip; // steps still to be missed
+    bool blocked;
+} stepper_t;
+
+/* IN4..IN1 in bits 3..0, the order used by the projects */
+static const uint8_t half_steps[8] = {0x1, 0x3, 0x2, 0x6, 0x4, 0xC, 0x8, 0x9};
+
+static pin_t pins[NUM_BANK0_GPIOS];
+static slice_t slices[NUM_PWM_SLICES];
+static gpio_irq_callback_t callbacks[SIM_CORES];
+static stepper_t steppers[MAX_STEPPERS];
+static int stepper_count;
+
+static bool padLevel(uint gpio);
+static void update(uint gpio);
+static void gpioIrq(void);
+static void driveEvent(void *context);
+static void stepperUpdate(stepper_t *stepper);
+static void stepperOpto(stepper_t *stepper);
+
+/////////////////////////////////////////////////////
+//                        GPIO                     //
+/////////////////////////////////////////////////////
+
+void gpio_init(uint gpio) {
+    pins[gpio].function = GPIO_FUNC_SIO;
+    pins[gpio].out = false;
+    pins[gpio].value = false;
+    update(gpio);
+}
+
+void gpio_set_function(uint gpio, enum gpio_function fn) {
+    pins[gpio].function = fn;
+    update(gpio);
+}
+
+void gpio_set_dir(uint gpio, bool out) {
+    pins[gpio].out = out;
+    update(gpio);
+}
+
+void gpio_put(uint gpio, bool value) {
+    if (pins[gpio].value != value) {
+        pins[gpio].value = value;
+        update(gpio);
+        for (int i = 0; i < stepper_count; i++) {
+            stepperUpdate(&steppers[i]);
+        }
+    }
+}
+
+bool gpio_get(uint gpio) {
+    sim_spend_ns(SIM_POLL_NS);
+    return padLevel(gpio);
+}
+
+void gpio_set_pulls(uint gpio, bool up, bool down) {
+    pins[gpio].pull_up = up;
+    pins[gpio].pull_down = down;
+    update(gpio);
+}
+
+void gpio_pull_up(uint gpio) {
+    gpio_set_pulls(gpio, true, false);
+}
+
+void gpio_pull_down(uint gpio) {
+    gpio_set_pulls(gpio, false, true);
+}
+
+void gpio_disable_pulls(uint gpio) {
+    gpio_set_pulls(gpio, false, false);
+}
+
+/* Per core, like the SDK: the events are enabled for the calling core. Latched edges are cleared first. */
+void gpio_set_irq_enabled(uint gpio, uint32_t event_mask, bool enabled) {
+    uint core = get_core_num();
+    pins[gpio].irq_status[core] &= ~event_mask;
+    if (true == enabled) {
+        pins[gpio].irq_mask[core] |= event_mask;
+    } else {
+        pins[gpio].irq_mask[core] &= ~event_mask;
+    }
+}
+
+void gpio_set_irq_callback(gpio_irq_callback_t callback) {
+    callbacks[get_core_num()] = callback;
+}
+
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t event_mask, bool enabled, gpio_irq_callback_t callback) {
+    gpio_set_irq_enabled(gpio, event_mask, enabled);
+    gpio_set_irq_callback(callback);
+    irq_set_exclusive_handler(IO_IRQ_BANK0, gpioIrq);
+    if (true == enabled) {
+        irq_set_enabled(IO_IRQ_BANK0, true);
+    }
+}
+
+/* An output reads back what it drives; an undriven input reads its pull, or low when floating. */
+static bool padLevel(uint gpio) {
+    const pin_t *pin = &pins[gpio];
+    if (GPIO_FUNC_SIO == pin->function && true == pin->out) {
+        return pin->value;
+    }
+    if (true == pin->driven) {
+        return pin->drive;
+    }
+    return pin->pull_up;
+}
+
+static void update(uint gpio) {
+    pin_t *pin = &pins[gpio];
+    bool level = padLevel(gpio);
+    if (level == pin->level) {
+        return;
+    }
+    pin->level = level;
+    sim_log("gpio", "%u %s %d", gpio, (GPIO_FUNC_SIO == pin->function && pin->out) ? "out" : "in", level);
+
+    uint32_t events = level ? (GPIO_IRQ_EDGE_RISE | GPIO_IRQ_LEVEL_HIGH) : (GPIO_IRQ_EDGE_FALL | GPIO_IRQ_LEVEL_LOW);
+    for (uint core = 0; core < SIM_CORES; core++) {
+        if (pin->irq_mask[core] & events) {
+            pin->irq_status[core] |= pin->irq_mask[core] & events;
+            sim_irq_raise(core, IO_IRQ_BANK0);
+        }
+    }
+}
+
+static void __not_in_flash_func(gpioIrq)(void) {
+    uint core = get_core_num();
+    for (uint gpio = 0; gpio < NUM_BANK0_GPIOS; gpio++) {
+        uint32_t events = pins[gpio].irq_status[core];
+        if (0 != events) {
+            pins[gpio].irq_status[core] = 0;
+            if (NULL != callbacks[core]) {
+                sim_fetch_code((const void *) callbacks[core]);
+                callbacks[core](gpio, events);
+            }
+        }
+    }
+}
+
+/////////////////////////////////////////////////////
+//                        PWM                      //
+/////////////////////////////////////////////////////
+
+pwm_config pwm_get_default_config(void) {
+    pwm_config config = {.csr = 0, .div = 1u << 4, .top = 0xffff};
+    return config;
+}
+
+void pwm_init(uint slice_num, pwm_config *c, bool start) {
+    slices[slice_num].top = (uint16_t) c->top;
+    slices[slice_num].div = c->div;
+    slices[slice_num].level[0] = 0;
+    slices[slice_num].level[1] = 0;
+    pwm_set_enabled(slice_num, start);
+}
+
+void pwm_set_wrap(uint slice_num, uint16_t wrap) {
+    slices[slice_num].top = wrap;
+}
+
+void pwm_set_chan_level(uint slice_num, uint chan, uint16_t level) {
+    slice_t *slice = &slices[slice_num];
+    if (slice->level[chan] != level) {
+        slice->level[chan] = level;
+        sim_log("pwm", "gpio %u level %u/%u", slice_num * 2 + chan, level, slice->top + 1);
+    }
+}
+
+void pwm_set_gpio_level(uint gpio, uint16_t level) {
+    pwm_set_chan_level(pwm_gpio_to_slice_num(gpio), pwm_gpio_to_channel(gpio), level);
+}
+
+void pwm_set_enabled(uint slice_num, bool enabled) {
+    if (slices[slice_num].enabled != enabled) {
+        slices[slice_num].enabled = enabled;
+        sim_log("pwm", "slice %u %s", slice_num, enabled ? "on" : "off");
+    }
+}
+
+/////////////////////////////////////////////////////
+//                       MODELS                    //
+/////////////////////////////////////////////////////
+
+/* A negative level releases the input. A change of the level is recorded (sim_record.c). */
+void sim_gpio_drive(uint gpio, int level) {
+    bool before = pins[gpio].level;
+    pins[gpio].driven = level >= 0;
+    pins[gpio].drive = level > 0;
+    update(gpio);
+    if (pins[gpio].level != before) {
+        uint8_t data = (uint8_t) (gpio | (pins[gpio].level ? 0x80 : 0));
+        sim_record(IO_KIND_GPIO, &data, 1);
+    }
+}
+
+/* Drives the input to level with an edge: an input that is at that level already goes to the other one first. */
+void sim_gpio_edge(uint gpio, bool level) {
+    if (padLevel(gpio) == level) {
+        sim_gpio_drive(gpio, !level);
+    }
+    sim_gpio_drive(gpio, level);
+}
+
+/* Low for hold_ms, with a bounce at both edges. */
+void sim_gpio_press(uint gpio, uint32_t hold_ms) {
+    uint64_t t = sim_time_ns();
+    uint64_t release = t + hold_ms * 1000000ull;
+    static const int pattern[3] = {0, 1, 0};
+    for (int i = 0; i < 3; i++) {
+        sim_at(t + i * BOUNCE_NS, driveEvent, (void *) (uintptr_t) ((gpio << 2) | pattern[i]));
+        sim_at(release + i * BOUNCE_NS, driveEvent, (void *) (uintptr_t) ((gpio << 2) | (pattern[i] ? 0 : 2)));
+    }
+}
+
+/* Quadrature: clockwise A leads B, so B is low when A rises; counter-clockwise the other way round. */
+void sim_gpio_turn(uint a, uint b, int detents, uint32_t period_ms) {
+    uint64_t t = sim_time_ns();
+    uint64_t quarter = period_ms * 1000000ull / 4;
+    uint first = (detents >= 0) ? a : b;
+    uint second = (detents >= 0) ? b : a;
+    for (int i = 0; i < abs(detents); i++) {
+        sim_at(t, driveEvent, (void *) (uintptr_t) ((first << 2) | 1));
+        sim_at(t + quarter, driveEvent, (void *) (uintptr_t) ((second << 2) | 1));
+        sim_at(t + 2 * quarter, driveEvent, (void *) (uintptr_t) (first << 2));
+        sim_at(t + 3 * quarter, driveEvent, (void *) (uintptr_t) (second << 2));
+        t += 4 * quarter;
+    }
+}
+
+/* The level of an output: a PWM output counts as high when its level is not zero. */
+bool sim_gpio_output(uint gpio, bool *level) {
+    const pin_t *pin = &pins[gpio];
+    if (GPIO_FUNC_PWM == pin->function) {
+        const slice_t *slice = &slices[pwm_gpio_to_slice_num(gpio)];
+        *level = slice->enabled && slice->level[pwm_gpio_to_channel(gpio)] > 0;
+        return true;
+    }
+    *level = pin->value;
+    return GPIO_FUNC_SIO == pin->function && true == pin->out;
+}
+
+void sim_stepper_attach(const uint stepper_pins[4], int opto, uint32_t steps, uint32_t window) {
+    stepper_t *stepper = NULL;
+    for (int i = 0; i < stepper_count; i++) {
+        if (steppers[i].pins[0] == stepper_pins[0]) {
+            stepper = &steppers[i]; // the script replaces the board's motor
+        }
+    }
+    if (NULL == stepper) {
+        if (stepper_count == MAX_STEPPERS) {
+            return;
+        }
+        stepper = &steppers[stepper_count++];
+    }
+    memcpy(stepper->pins, stepper_pins, sizeof(stepper->pins));
+    stepper->opto = opto;
+    stepper->steps = steps ? steps : 1;
+    stepper->window = window;
+    stepper->phase = -1;
+    stepper->position = steps / 2; // away from the fork, so that calibration has to turn
+    stepper->slip = 0;
+    stepper->blocked = false;
+    stepperUpdate(stepper);
+}
+
+/* Positive steps: the motor misses that many of the steps it is driven next, as a stall under load does. Negative: the
+ * shaft is turned that many steps forward at once, by hand. */
+void sim_stepper_slip(uint in1, int32_t steps) {
+    for (int i = 0; i < stepper_count; i++) {
+        stepper_t *stepper = &steppers[i];
+        if (stepper->pins[0] != in1) {
+            continue;
+        }
+        sim_log("gpio", "stepper %u slips %d steps", in1, (int) steps);
+        if (steps >= 0) {
+            stepper->slip += (uint32_t) steps;
+        } else {
+            stepper->position -= steps;
+            stepperOpto(stepper);
+        }
+    }
+}
+
+/* Context: gpio << 2 | level, with 2 for released. */
+static void driveEvent(void *context) {
+    uintptr_t value = (uintptr_t) context;
+    sim_gpio_drive(value >> 2, (2 == (value & 3)) ? -1 : (int) (value & 1));
+}
+
+static void stepperUpdate(stepper_t *stepper) {
+    uint8_t bits = 0;
+    for (int i = 0; i < 4; i++) {
+        bits |= pins[stepper->pins[i]].value << i;
+    }
+    int phase = -1;
+    for (int i = 0; i < 8; i++) {
+        if (half_steps[i] == bits) {
+            phase = i;
+        }
+    }
+    if (phase < 0) {
+        return;
+    }
+    if (stepper->phase >= 0) {
+        int delta = (phase - stepper->phase + 8) % 8;
+        int move = (delta <= 2) ? delta : ((delta >= 6) ? delta - 8 : 0);
+        if (0 != move && stepper->slip > 0) {
+            stepper->slip--;
+            move = 0;
+        }
+        stepper->position += move;
+    }
+    stepper->phase = phase;
+    stepperOpto(stepper);
+}
+
+static void stepperOpto(stepper_t *stepper) {
+    if (stepper->opto >= 0) {
+        int64_t angle = stepper->position % stepper->steps;
+        if (angle < 0) {
+            angle += stepper->steps;
+        }
+        bool blocked = angle < stepper->window;
+        if (blocked != stepper->blocked) {
+            stepper->blocked = blocked;
+            sim_gpio_drive(stepper->opto, blocked ? 0 : -1);
+        }
+    }
+}
@@ -0,0 +1,190 @@
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+#include "hardware/irq.h"
+
+#include "io_record.h"
+#include "sim.h"
+
+#define EEPROM_PAGE_SIZE 64
+#define EEPROM_WRITE_NS 5000000 // write cycle, the device does not acknowledge its address meanwhile
+#define BUS_OVERHEAD_BITS 2     // start and stop
+
+struct i2c_inst {
+    uint index;
+    uint baudrate;
+};
+
+/* 24LC256: two address bytes, writes wrap within a 64 byte page, reads run on through the whole memory. Above
+ * max_khz the reads return noise. */
+typedef struct {
+    bool attached;
+    uint8_t address;
+    uint8_t *memory;
+    size_t size;
+    uint32_t max_khz;
+    char *file;
+    size_t pointer;
+    uint64_t busy_until;
+} eeprom_model_t;
+
+i2c_inst_t i2c0_inst = {.index = 0, .baudrate = 100000};
+i2c_inst_t i2c1_inst = {.index = 1, .baudrate = 100000};
+
+static eeprom_model_t eeprom;
+
+static void saveEeprom(void);
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate) {
+    return i2c_set_baudrate(i2c, baudrate);
+}
+
+void i2c_deinit(i2c_inst_t *i2c) {
+}
+
+uint i2c_set_baudrate(i2c_inst_t *i2c, uint baudrate) {
+    i2c->baudrate = baudrate;
+    sim_log("i2c", "%u at %u kHz", i2c->index, baudrate / 1000);
+    return baudrate;
+}
+
+uint i2c_hw_index(i2c_inst_t *i2c) {
+    return i2c->index;
+}
+
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop) {
+    if (false == sim_i2c_acknowledges(i2c, addr)) {
+        sim_spend_ns(sim_i2c_time_ns(i2c, 1));
+        sim_log("i2c", "%u 0x%02x write nack", i2c->index, addr);
+        return PICO_ERROR_GENERIC;
+    }
+    sim_spend_ns(sim_i2c_time_ns(i2c, 1 + len));
+    sim_i2c_device_write(i2c, addr, src, len, nostop);
+    sim_log("i2c", "%u 0x%02x write %u", i2c->index, addr, (unsigned) len);
+    return (int) len;
+}
+
+int i2c_read_blocking(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop) {
+    if (false == sim_i2c_acknowledges(i2c, addr)) {
+        sim_spend_ns(sim_i2c_time_ns(i2c, 1));
+        sim_log("i2c", "%u 0x%02x read nack", i2c->index, addr);
+        return PICO_ERROR_GENERIC;
+    }
+    sim_spend_ns(sim_i2c_time_ns(i2c, 1 + len));
+    sim_i2c_device_read(i2c, addr, dst, len);
+    sim_log("i2c", "%u 0x%02x read %u", i2c->index, addr, (unsigned) len);
+    return (int) len;
+}
+
+int i2c_write_timeout_us(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop, uint timeout_us) {
+    if (sim_i2c_time_ns(i2c, 1 + len) > timeout_us * 1000ull) {
+        sim_spend_ns(timeout_us * 1000ull);
+        return PICO_ERROR_TIMEOUT;
+    }
+    return i2c_write_blocking(i2c, addr, src, len, nostop);
+}
+
+int i2c_read_timeout_us(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop, uint timeout_us) {
+    if (sim_i2c_time_ns(i2c, 1 + len) > timeout_us * 1000ull) {
+        sim_spend_ns(timeout_us * 1000ull);
+        return PICO_ERROR_TIMEOUT;
+    }
+    return i2c_read_blocking(i2c, addr, dst, len, nostop);
+}
+
+void sim_eeprom_attach(uint8_t address, size_t size, uint32_t max_khz, const char *file) {
+    static bool registered = false;
+    sim_eeprom_detach();
+    eeprom.attached = true;
+    eeprom.address = address;
+    eeprom.size = size;
+    eeprom.max_khz = max_khz;
+    eeprom.memory = malloc(size);
+    memset(eeprom.memory, 0xff, size);
+    eeprom.pointer = 0;
+    eeprom.busy_until = 0;
+    if (NULL != file) {
+        eeprom.file = strdup(file);
+        FILE *f = fopen(file, "rb");
+        if (NULL != f) {
+            size_t loaded = fread(eeprom.memory, 1, size, f);
+            (void) loaded;
+            fclose(f);
+        }
+        if (false == registered) {
+            atexit(saveEeprom);
+            registered = true;
+        }
+    }
+}
+
+void sim_eeprom_detach(void) {
+    saveEeprom();
+    free(eeprom.memory);
+    free(eeprom.file);
+    memset(&eeprom, 0, sizeof(eeprom));
+}
+
+uint64_t sim_i2c_time_ns(i2c_inst_t *i2c, size_t bytes) {
+    return (bytes * 9 + BUS_OVERHEAD_BITS) * 1000000000ull / i2c->baudrate;
+}
+
+/* A device of a replayed trace answers in place of the model; either way the transaction is recorded. */
+bool sim_i2c_acknowledges(i2c_inst_t *i2c, uint8_t addr) {
+    bool ack;
+    if (true == sim_replay_i2c_owns(i2c->index, addr)) {
+        ack = sim_replay_i2c_acknowledges(i2c->index, addr);
+    } else {
+        ack = 0 == i2c->index && true == eeprom.attached && addr == eeprom.address &&
+              sim_time_ns() >= eeprom.busy_until;
+    }
+    if (false == ack) {
+        sim_record_i2c(IO_KIND_I2C_NACK, i2c->index, addr, NULL, 0);
+    }
+    return ack;
+}
+
+/* The first two bytes set the address; the write cycle starts at the stop. */
+void sim_i2c_device_write(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop) {
+    sim_record_i2c(IO_KIND_I2C_WRITE, i2c->index, addr, src, len);
+    if (true == sim_replay_i2c_owns(i2c->index, addr)) {
+        sim_replay_i2c_write(i2c->index, addr, src, len);
+        return;
+    }
+    if (len < 2) {
+        return;
+    }
+    eeprom.pointer = (((size_t) src[0] << 8) | src[1]) % eeprom.size;
+    size_t page = eeprom.pointer & ~(size_t) (EEPROM_PAGE_SIZE - 1);
+    for (size_t i = 2; i < len; i++) {
+        eeprom.memory[page | ((eeprom.pointer + i - 2) & (EEPROM_PAGE_SIZE - 1))] = src[i];
+    }
+    if (len > 2 && false == nostop) {
+        eeprom.busy_until = sim_time_ns() + EEPROM_WRITE_NS;
+    }
+}
+
+void sim_i2c_device_read(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len) {
+    if (true == sim_replay_i2c_owns(i2c->index, addr)) {
+        sim_replay_i2c_read(i2c->index, addr, dst, len);
+    } else {
+        bool noise = i2c->baudrate > eeprom.max_khz * 1000;
+        for (size_t i = 0; i < len; i++) {
+            dst[i] = noise ? (uint8_t) rand() : eeprom.memory[eeprom.pointer];
+            eeprom.pointer = (eeprom.pointer + 1) % eeprom.size;
+        }
+    }
+    sim_record_i2c(IO_KIND_I2C_READ, i2c->index, addr, dst, len);
+}
+
+static void saveEeprom(void) {
+    if (NULL == eeprom.file) {
+        return;
+    }
+    FILE *f = fopen(eeprom.file, "wb");
+    if (NULL != f) {
+        fwrite(eeprom.memory, 1, eeprom.size, f);
+        fclose(f);
+    }
+}
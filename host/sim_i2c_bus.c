@@ -0,0 +1,70 @@
+#include "pico/stdlib.h"
+#include "hardware/irq.h"
+
+#include "i2c_bus.h"
+#include "sim.h"
+
+typedef struct {
+    i2c_bus_t *bus;
+    uint8_t status;
+} backend_t;
+
+static backend_t backends[2];
+
+static void startTransfer(i2c_bus_t *bus, i2c_txn_t *txn);
+static void transferDone(void *context);
+static void i2c0Handler(void);
+static void i2c1Handler(void);
+
+/* Host backend of the transaction scheduler: the transfer takes its bus time and completes from the I2C interrupt. */
+void i2c_bus_init(i2c_bus_t *bus, i2c_inst_t *i2c) {
+    i2c_bus_init_backend(bus, startTransfer);
+    bus->i2c = i2c;
+    uint index = i2c_hw_index(i2c);
+    backends[index].bus = bus;
+    irq_set_exclusive_handler(index ? I2C1_IRQ : I2C0_IRQ, index ? i2c1Handler : i2c0Handler);
+    irq_set_enabled(index ? I2C1_IRQ : I2C0_IRQ, true);
+}
+
+/* The exchange with the device happens when the transfer ends, so the write cycle starts at the right time. The end of
+ * a transfer that i2c_bus_transfer() gave up on is dropped. */
+static void startTransfer(i2c_bus_t *bus, i2c_txn_t *txn) {
+    size_t bytes = (txn->write_length ? 1 + txn->write_length : 0) + (txn->read_length ? 1 + txn->read_length : 0);
+    backend_t *backend = &backends[i2c_hw_index(bus->i2c)];
+    sim_cancel(transferDone, backend);
+    sim_at(sim_time_ns() + sim_i2c_time_ns(bus->i2c, bytes), transferDone, backend);
+}
+
+static void transferDone(void *context) {
+    backend_t *backend = context;
+    i2c_bus_t *bus = backend->bus;
+    i2c_txn_t *txn = bus->active;
+    if (NULL == txn) {
+        return;
+    }
+    backend->status = I2C_STATUS_OK;
+    if (0 == txn->write_length + txn->read_length) {
+        backend->status = I2C_STATUS_ERROR;
+    } else if (false == sim_i2c_acknowledges(bus->i2c, txn->device)) {
+        backend->status = I2C_STATUS_NACK;
+    } else {
+        if (txn->write_length > 0) {
+            sim_i2c_device_write(bus->i2c, txn->device, txn->write, txn->write_length, txn->read_length > 0);
+        }
+        if (txn->read_length > 0) {
+            sim_i2c_device_read(bus->i2c, txn->device, txn->read, txn->read_length);
+        }
+    }
+    uint index = i2c_hw_index(bus->i2c);
+    sim_log("i2c", "%u 0x%02x txn write %u read %u status %u", index, txn->device, (unsigned) txn->write_length,
+            (unsigned) txn->read_length, backend->status);
+    sim_irq_raise_enabled(index ? I2C1_IRQ : I2C0_IRQ);
+}
+
+static void i2c0Handler(void) {
+    i2c_bus_complete(backends[0].bus, backends[0].status);
+}
+
+static void i2c1Handler(void) {
+    i2c_bus_complete(backends[1].bus, backends[1].status);
+}
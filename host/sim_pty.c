@@ -0,0 +1,174 @@
+#define _GNU_SOURCE // posix_openpt and ppoll
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "pico/stdlib.h"
+
+#include "sim.h"
+
+#define INPUT_CHUNK 64
+
+/* A program on the host talks to the console over a pseudo terminal (script line pty): what it writes comes in as
+ * console input, the console output goes back to it as each byte leaves the line. From the start of the program on,
+ * virtual time does not run ahead of the wall clock, so that the program sees the twin answer at the pace the board
+ * would. */
+typedef struct {
+    size_t count;
+    char data[];
+} output_t;
+
+static int master = -1;
+static int slave = -1;
+static pid_t child;
+static uint64_t start_ns;
+static uint64_t start_wall_ns;
+static bool input_due;
+
+static uint64_t wallNs(void);
+static void readInput(void *context);
+static void writeOutput(void *context);
+static void checkChild(void);
+
+/////////////////////////////////////////////////////
+//                      START                      //
+/////////////////////////////////////////////////////
+
+/* Starts the program with {} in its arguments replaced by the path of the terminal. */
+void sim_pty_start(int argc, char **argv) {
+    if (master >= 0) {
+        fprintf(stderr, "sim: one pty per run\n");
+        exit(2);
+    }
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || 0 != grantpt(master) || 0 != unlockpt(master)) {
+        perror("sim: pty");
+        exit(2);
+    }
+    const char *path = ptsname(master);
+    // The terminal stays open here as well: raw, so that nothing is echoed before the program sets it up, and the
+    // master never sees a hang up between two opens of the program
+    slave = open(path, O_RDWR | O_NOCTTY);
+    struct termios tty;
+    if (slave < 0 || 0 != tcgetattr(slave, &tty)) {
+        perror(path);
+        exit(2);
+    }
+    cfmakeraw(&tty);
+    tcsetattr(slave, TCSANOW, &tty);
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+    char *args[argc + 1];
+    for (int i = 0; i < argc; i++) {
+        args[i] = (0 == strcmp("{}", argv[i])) ? (char *) path : argv[i];
+    }
+    args[argc] = NULL;
+    fflush(stdout);
+    child = fork();
+    if (child < 0) {
+        perror("sim: fork");
+        exit(2);
+    }
+    if (0 == child) {
+        execv(args[0], args);
+        perror(args[0]);
+        _exit(127);
+    }
+    start_ns = sim_time_ns();
+    start_wall_ns = wallNs();
+}
+
+bool sim_pty_active(void) {
+    return master >= 0;
+}
+
+/////////////////////////////////////////////////////
+//                      PACE                       //
+/////////////////////////////////////////////////////
+
+/* Called before the events up to at_ns run: waits for the wall clock to catch up with them. Input that comes in
+ * meanwhile becomes an event at the virtual time it arrived, so that it runs before them; the run ends when the
+ * program does. */
+void sim_pty_pace(uint64_t at_ns) {
+    if (master < 0) {
+        return;
+    }
+    uint64_t wall_at = start_wall_ns + (at_ns - start_ns);
+    while (true) {
+        checkChild();
+        uint64_t wall = wallNs();
+        uint64_t left = (wall_at > wall) ? wall_at - wall : 0;
+        struct pollfd fd = {.fd = master, .events = POLLIN};
+        struct timespec timeout = {.tv_sec = left / 1000000000u, .tv_nsec = left % 1000000000u};
+        int ready = ppoll(&fd, input_due ? 0 : 1, &timeout, NULL);
+        if (ready > 0 && false == input_due) {
+            uint64_t arrived = start_ns + (wallNs() - start_wall_ns);
+            sim_at((arrived < at_ns) ? arrived : at_ns, readInput, NULL);
+            input_due = true;
+            return;
+        }
+        if (ready < 0 && EINTR != errno) {
+            perror("sim: pty");
+            exit(2);
+        }
+        if (0 == left) {
+            return;
+        }
+    }
+}
+
+/* Console output, delivered when its last byte is out at at_ns. A program that does not read loses what does not fit
+ * in the terminal. */
+void sim_pty_write(uint64_t at_ns, const char *data, size_t count) {
+    if (master < 0) {
+        return;
+    }
+    output_t *output = malloc(sizeof(output_t) + count);
+    output->count = count;
+    memcpy(output->data, data, count);
+    sim_at(at_ns, writeOutput, output);
+}
+
+static uint64_t wallNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void readInput(void *context) {
+    uint8_t data[INPUT_CHUNK];
+    input_due = false;
+    ssize_t count = read(master, data, sizeof(data));
+    if (count > 0) {
+        sim_stdin_push(data, count);
+    }
+}
+
+static void writeOutput(void *context) {
+    output_t *output = context;
+    if (write(master, output->data, output->count) < 0 && EAGAIN != errno) {
+        perror("sim: pty");
+    }
+    free(output);
+}
+
+static void checkChild(void) {
+    int status;
+    if (child != waitpid(child, &status, WNOHANG)) {
+        return;
+    }
+    master = -1;
+    if (WIFEXITED(status) && 0 == WEXITSTATUS(status)) {
+        sim_finish("pty program done");
+    }
+    char reason[64];
+    snprintf(reason, sizeof(reason), "pty program failed with status %d",
+             WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status));
+    sim_fail(reason);
+}
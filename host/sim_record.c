@@ -0,0 +1,274 @@
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+
+#include "io_record.h"
+#include "sim.h"
+
+#define MAX_DEVICES 4
+#define HEX_TAG "ior: "
+
+/* An I2C device of the trace: the transactions addressed to it are answered with the recorded ones, in their order
+ * and whenever they come, since the firmware decides when it talks to the device. */
+typedef struct {
+    uint index;
+    uint8_t addr;
+    io_record_t *records;
+    size_t count;
+    size_t next;
+} device_t;
+
+typedef struct {
+    uint64_t at_ns;
+    io_record_t record;
+} timed_t;
+
+static FILE *record_file;
+static uint64_t record_last_us;
+
+static uint8_t *trace;
+static timed_t *timed;
+static device_t devices[MAX_DEVICES];
+static int device_count;
+static uint32_t diverged;
+
+static void closeRecord(void);
+static bool readTrace(const char *path, size_t *length);
+static device_t *device(uint index, uint8_t addr, bool add);
+static const io_record_t *nextRecord(uint index, uint8_t addr, uint8_t type);
+static void replayEvent(void *context);
+static void reportDivergence(void);
+
+/////////////////////////////////////////////////////
+//                      RECORD                     //
+/////////////////////////////////////////////////////
+
+void sim_record_open(const char *path) {
+    closeRecord();
+    record_file = fopen(path, "wb");
+    if (NULL == record_file) {
+        perror(path);
+        exit(2);
+    }
+    fwrite(IO_RECORD_MAGIC, 1, 4, record_file);
+    record_last_us = 0;
+    static bool registered = false;
+    if (false == registered) {
+        atexit(closeRecord);
+        registered = true;
+    }
+}
+
+void sim_record(uint8_t kind, const uint8_t *data, size_t length) {
+    if (NULL == record_file) {
+        return;
+    }
+    uint8_t *buffer = malloc(IO_RECORD_MAX_HEADER + length);
+    uint64_t now_us = sim_time_ns() / 1000;
+    fwrite(buffer, 1, io_record_encode(buffer, kind, (uint32_t) (now_us - record_last_us), data, length), record_file);
+    free(buffer);
+    record_last_us = now_us;
+}
+
+void sim_record_i2c(uint8_t kind, uint index, uint8_t addr, const uint8_t *data, size_t length) {
+    if (NULL == record_file) {
+        return;
+    }
+    uint8_t *buffer = malloc(1 + length);
+    buffer[0] = addr;
+    memcpy(&buffer[1], data, length);
+    sim_record(kind | index, buffer, 1 + length);
+    free(buffer);
+}
+
+static void closeRecord(void) {
+    if (NULL != record_file) {
+        fclose(record_file);
+        record_file = NULL;
+    }
+}
+
+/////////////////////////////////////////////////////
+//                      REPLAY                     //
+/////////////////////////////////////////////////////
+
+/* UART bytes, console input and GPIO edges are scheduled at their times; the gaps between records are shortened to gap_ms when that
+ * is not 0, so long quiet stretches of a session go by quicker. The LoRa-E5 answers of a UART in the trace are
+ * dropped, the trace brings them. */
+void sim_replay_load(const char *path, uint32_t gap_ms) {
+    size_t length;
+    if (false == readTrace(path, &length)) {
+        fprintf(stderr, "%s: not a trace\n", path);
+        exit(2);
+    }
+
+    size_t capacity = 64;
+    size_t count = 0;
+    timed = malloc(capacity * sizeof(timed_t));
+    uint64_t t_us = sim_time_ns() / 1000;
+    uint32_t cleared = 0;
+    size_t records = 0;
+    size_t offset = 4;
+    while (offset < length) {
+        io_record_t record;
+        size_t used = io_record_decode(&trace[offset], length - offset, &record);
+        if (0 == used) {
+            fprintf(stderr, "%s: cut off at byte %zu\n", path, offset);
+            break;
+        }
+        offset += used;
+        records++;
+        t_us += (0 != gap_ms && record.delta_us > gap_ms * 1000) ? gap_ms * 1000 : record.delta_us;
+
+        uint8_t type = IO_KIND_TYPE(record.kind);
+        uint index = IO_KIND_INSTANCE(record.kind);
+        if (IO_KIND_UART_RX == type || IO_KIND_GPIO == type || IO_KIND_STDIN == type) {
+            if (IO_KIND_UART_RX == type && 0 == (cleared & (1u << index))) {
+                sim_uart_clear_responses(index);
+                cleared |= 1u << index;
+            }
+            if (count == capacity) {
+                capacity *= 2;
+                timed = realloc(timed, capacity * sizeof(timed_t));
+            }
+            timed[count].at_ns = t_us * 1000;
+            timed[count++].record = record;
+        } else if (record.length > 0) {
+            device_t *d = device(index, record.data[0], true);
+            if (NULL != d) {
+                d->records = realloc(d->records, (d->count + 1) * sizeof(io_record_t));
+                d->records[d->count++] = record;
+            }
+        }
+    }
+    // scheduled once the array has its final place
+    for (size_t i = 0; i < count; i++) {
+        sim_at(timed[i].at_ns, replayEvent, &timed[i].record);
+    }
+    atexit(reportDivergence);
+    fprintf(stderr, "sim: replay %s: %zu records up to %.3f s\n", path, records, t_us / 1e6);
+}
+
+bool sim_replay_i2c_owns(uint index, uint8_t addr) {
+    return NULL != device(index, addr, false);
+}
+
+/* The next transaction of the device in the trace is a NACK, or there is none left. */
+bool sim_replay_i2c_acknowledges(uint index, uint8_t addr) {
+    device_t *d = device(index, addr, false);
+    if (d->next == d->count) {
+        return false;
+    }
+    if (IO_KIND_I2C_NACK == IO_KIND_TYPE(d->records[d->next].kind)) {
+        d->next++;
+        return false;
+    }
+    return true;
+}
+
+void sim_replay_i2c_write(uint index, uint8_t addr, const uint8_t *src, size_t len) {
+    const io_record_t *record = nextRecord(index, addr, IO_KIND_I2C_WRITE);
+    if (NULL != record && (record->length - 1 != len || 0 != memcmp(&record->data[1], src, len))) {
+        diverged++;
+        sim_log("i2c", "replay %u 0x%02x: write differs from the trace", index, addr);
+    }
+}
+
+/* Bytes the trace does not have read as 0xff, as from an erased EEPROM. */
+void sim_replay_i2c_read(uint index, uint8_t addr, uint8_t *dst, size_t len) {
+    const io_record_t *record = nextRecord(index, addr, IO_KIND_I2C_READ);
+    size_t available = (NULL != record) ? record->length - 1 : 0;
+    if (NULL != record && available != len) {
+        diverged++;
+        sim_log("i2c", "replay %u 0x%02x: read of %zu bytes, %zu in the trace", index, addr, len, available);
+    }
+    for (size_t i = 0; i < len; i++) {
+        dst[i] = (i < available) ? record->data[1 + i] : 0xff;
+    }
+}
+
+/* A binary trace, or a console capture with the "ior: <hex>" lines of the recorder on the board. */
+static bool readTrace(const char *path, size_t *length) {
+    FILE *file = fopen(path, "rb");
+    if (NULL == file) {
+        perror(path);
+        exit(2);
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *text = malloc(size + 1);
+    size_t read = fread(text, 1, size, file);
+    fclose(file);
+    text[read] = '\0';
+
+    if (read >= 4 && 0 == memcmp(text, IO_RECORD_MAGIC, 4)) {
+        trace = (uint8_t *) text;
+        *length = read;
+        return true;
+    }
+    trace = malloc(read / 2 + 1);
+    *length = 0;
+    // the capture may hold binary frames as well, even in front of a line, so the tag is searched for byte by byte
+    size_t tag = strlen(HEX_TAG);
+    for (size_t start = 0; start < read;) {
+        const char *newline = memchr(&text[start], '\n', read - start);
+        size_t end = (NULL != newline) ? (size_t) (newline - text) : read;
+        size_t i = start;
+        while (i + tag <= end && 0 != memcmp(HEX_TAG, &text[i], tag)) {
+            i++;
+        }
+        for (i += tag; i + 1 < end && isxdigit((unsigned char) text[i]) && isxdigit((unsigned char) text[i + 1]); i += 2) {
+            char digits[3] = {text[i], text[i + 1], '\0'};
+            trace[(*length)++] = (uint8_t) strtoul(digits, NULL, 16);
+        }
+        start = end + 1;
+    }
+    free(text);
+    return *length >= 4 && 0 == memcmp(trace, IO_RECORD_MAGIC, 4);
+}
+
+static device_t *device(uint index, uint8_t addr, bool add) {
+    for (int i = 0; i < device_count; i++) {
+        if (devices[i].index == index && devices[i].addr == addr) {
+            return &devices[i];
+        }
+    }
+    if (false == add || MAX_DEVICES == device_count) {
+        return NULL;
+    }
+    device_t *d = &devices[device_count++];
+    d->index = index;
+    d->addr = addr;
+    return d;
+}
+
+/* Takes the next transaction of the device if it is of the type the firmware does now; the firmware has gone its own
+ * way otherwise, which is counted. */
+static const io_record_t *nextRecord(uint index, uint8_t addr, uint8_t type) {
+    device_t *d = device(index, addr, false);
+    if (d->next < d->count && type == IO_KIND_TYPE(d->records[d->next].kind)) {
+        return &d->records[d->next++];
+    }
+    diverged++;
+    sim_log("i2c", "replay %u 0x%02x: transaction not in the trace", index, addr);
+    return NULL;
+}
+
+static void replayEvent(void *context) {
+    const io_record_t *record = context;
+    if (IO_KIND_UART_RX == IO_KIND_TYPE(record->kind)) {
+        sim_uart_inject(IO_KIND_INSTANCE(record->kind), record->data, record->length);
+    } else if (IO_KIND_STDIN == record->kind) {
+        sim_stdin_push(record->data, record->length);
+    } else if (record->length > 0) {
+        sim_gpio_edge(record->data[0] & 0x3F, record->data[0] >> 7);
+    }
+}
+
+static void reportDivergence(void) {
+    if (diverged > 0) {
+        fprintf(stderr, "sim: replay: %lu I2C transactions differ from the trace\n", (unsigned long) diverged);
+    }
+}
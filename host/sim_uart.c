@@ -0,0 +1,311 @@
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/irq.h"
+#include "hardware/uart.h"
+
+#include "io_record.h"
+#include "sim.h"
+
+#define UART_FIFO_DEPTH 32
+#define UART_IRQ_LEVEL 4 // the SDK sets both FIFO interrupt levels to 1/8 when enabling them
+#define WIRE_SIZE 4096
+#define LINE_SIZE 256
+#define MAX_RESPONSES 32
+#define UPLINK_COMMAND "AT+MSGHEX=\""
+
+/* A device on the other end of the line: bytes it sends wait on the wire and arrive one character time apart, lines
+ * sent to it are matched against the responses. */
+struct uart_inst {
+    uint index;
+    uint baudrate;
+    uint64_t char_ns;
+    bool rx_irq;
+    bool tx_irq;
+    uint8_t rx[UART_FIFO_DEPTH];
+    uint rx_head;
+    uint rx_count;
+    uint8_t tx[UART_FIFO_DEPTH];
+    uint tx_head;
+    uint tx_count;
+    uint8_t wire[WIRE_SIZE];
+    size_t wire_head;
+    size_t wire_count;
+    char line[LINE_SIZE];
+    size_t line_length;
+    uint32_t overruns;
+};
+
+typedef struct {
+    uint index;
+    char *line;
+    char *reply;
+    uint32_t delay_ms;
+} response_t;
+
+uart_inst_t uart0_inst = {.index = 0, .baudrate = 115200};
+uart_inst_t uart1_inst = {.index = 1, .baudrate = 115200};
+
+static response_t responses[MAX_RESPONSES];
+static int response_count;
+static uint32_t uplinks;
+static uint32_t uplink_bytes;
+
+static uart_inst_t *instance(uint index);
+static void rxArrive(void *context);
+static void rxTimeout(void *context);
+static void txDrain(void *context);
+static void peerReceive(uart_inst_t *uart, uint8_t byte);
+static bool matches(const char *pattern, const char *line);
+static void countUplink(const char *line);
+static void reportUplinks(void);
+static void respond(void *context);
+static void logLine(uart_inst_t *uart, const char *direction, const uint8_t *data, size_t length);
+
+uint uart_init(uart_inst_t *uart, uint baudrate) {
+    uart->baudrate = baudrate;
+    uart->char_ns = 10000000000ull / baudrate;
+    uart->rx_count = 0;
+    uart->tx_count = 0;
+    uart->rx_irq = false;
+    uart->tx_irq = false;
+    return baudrate;
+}
+
+void uart_deinit(uart_inst_t *uart) {
+    uart_set_irq_enables(uart, false, false);
+}
+
+uint uart_get_index(uart_inst_t *uart) {
+    return uart->index;
+}
+
+/* Enabling the TX interrupt with room in the FIFO raises it right away, as on the board. */
+void uart_set_irq_enables(uart_inst_t *uart, bool rx_has_data, bool tx_needs_data) {
+    uart->rx_irq = rx_has_data;
+    uart->tx_irq = tx_needs_data;
+    if ((true == tx_needs_data && uart->tx_count <= UART_IRQ_LEVEL) ||
+        (true == rx_has_data && uart->rx_count >= UART_IRQ_LEVEL)) {
+        sim_irq_raise_enabled(UART0_IRQ + uart->index);
+    }
+}
+
+bool uart_is_readable(uart_inst_t *uart) {
+    sim_spend_ns(SIM_POLL_NS);
+    return uart->rx_count > 0;
+}
+
+bool uart_is_writable(uart_inst_t *uart) {
+    sim_spend_ns(SIM_POLL_NS);
+    return uart->tx_count < UART_FIFO_DEPTH;
+}
+
+bool uart_is_readable_within_us(uart_inst_t *uart, uint32_t us) {
+    uint64_t deadline = sim_time_ns() + us * 1000ull;
+    while (false == uart_is_readable(uart)) {
+        if (sim_time_ns() >= deadline) {
+            return false;
+        }
+    }
+    return true;
+}
+
+char uart_getc(uart_inst_t *uart) {
+    while (0 == uart->rx_count) {
+        sim_wait_until(sim_time_ns() + uart->char_ns);
+    }
+    uint8_t c = uart->rx[uart->rx_head];
+    uart->rx_head = (uart->rx_head + 1) % UART_FIFO_DEPTH;
+    uart->rx_count--;
+    return (char) c;
+}
+
+void uart_putc_raw(uart_inst_t *uart, char c) {
+    while (UART_FIFO_DEPTH == uart->tx_count) {
+        sim_wait_until(sim_time_ns() + uart->char_ns);
+    }
+    uart->tx[(uart->tx_head + uart->tx_count) % UART_FIFO_DEPTH] = (uint8_t) c;
+    if (0 == uart->tx_count++) {
+        sim_at(sim_time_ns() + uart->char_ns, txDrain, uart);
+    }
+}
+
+void uart_putc(uart_inst_t *uart, char c) {
+    uart_putc_raw(uart, c);
+}
+
+void uart_puts(uart_inst_t *uart, const char *s) {
+    while ('\0' != *s) {
+        uart_putc(uart, *s++);
+    }
+}
+
+void sim_uart_inject(uint index, const uint8_t *data, size_t length) {
+    uart_inst_t *uart = instance(index);
+    logLine(uart, "<", data, length);
+    sim_record(IO_KIND_UART_RX | index, data, length);
+    bool idle = (0 == uart->wire_count);
+    for (size_t i = 0; i < length && uart->wire_count < WIRE_SIZE; i++) {
+        uart->wire[(uart->wire_head + uart->wire_count++) % WIRE_SIZE] = data[i];
+    }
+    if (true == idle && uart->wire_count > 0) {
+        sim_at(sim_time_ns() + uart->char_ns, rxArrive, uart);
+    }
+}
+
+/* A later response for the same line replaces the earlier one. */
+void sim_uart_respond(uint index, const char *line, const char *reply, uint32_t delay_ms) {
+    response_t *response = NULL;
+    for (int i = 0; i < response_count; i++) {
+        if (responses[i].index == index && 0 == strcmp(responses[i].line, line)) {
+            response = &responses[i];
+            free(response->line);
+            free(response->reply);
+        }
+    }
+    if (NULL == response) {
+        if (MAX_RESPONSES == response_count) {
+            return;
+        }
+        response = &responses[response_count++];
+    }
+    response->index = index;
+    response->line = strdup(line);
+    response->reply = strdup(reply);
+    response->delay_ms = delay_ms;
+}
+
+void sim_uart_clear_responses(uint index) {
+    int kept = 0;
+    for (int i = 0; i < response_count; i++) {
+        if (responses[i].index == index) {
+            free(responses[i].line);
+            free(responses[i].reply);
+        } else {
+            responses[kept++] = responses[i];
+        }
+    }
+    response_count = kept;
+}
+
+static uart_inst_t *instance(uint index) {
+    return index ? &uart1_inst : &uart0_inst;
+}
+
+/* The RX interrupt is raised at the FIFO level, or after 32 bit times without a new byte (receive timeout). */
+static void rxArrive(void *context) {
+    uart_inst_t *uart = context;
+    uint8_t byte = uart->wire[uart->wire_head];
+    uart->wire_head = (uart->wire_head + 1) % WIRE_SIZE;
+    uart->wire_count--;
+
+    if (UART_FIFO_DEPTH == uart->rx_count) {
+        uart->overruns++;
+    } else {
+        uart->rx[(uart->rx_head + uart->rx_count++) % UART_FIFO_DEPTH] = byte;
+    }
+    if (uart->wire_count > 0) {
+        sim_at(sim_time_ns() + uart->char_ns, rxArrive, uart);
+    }
+    if (true == uart->rx_irq) {
+        sim_cancel(rxTimeout, uart);
+        if (uart->rx_count >= UART_IRQ_LEVEL) {
+            sim_irq_raise_enabled(UART0_IRQ + uart->index);
+        } else {
+            sim_at(sim_time_ns() + uart->char_ns * 32 / 10, rxTimeout, uart);
+        }
+    }
+}
+
+static void rxTimeout(void *context) {
+    uart_inst_t *uart = context;
+    if (true == uart->rx_irq && uart->rx_count > 0) {
+        sim_irq_raise_enabled(UART0_IRQ + uart->index);
+    }
+}
+
+static void txDrain(void *context) {
+    uart_inst_t *uart = context;
+    uint8_t byte = uart->tx[uart->tx_head];
+    uart->tx_head = (uart->tx_head + 1) % UART_FIFO_DEPTH;
+    uart->tx_count--;
+    if (uart->tx_count > 0) {
+        sim_at(sim_time_ns() + uart->char_ns, txDrain, uart);
+    }
+    peerReceive(uart, byte);
+    if (true == uart->tx_irq && uart->tx_count <= UART_IRQ_LEVEL) {
+        sim_irq_raise_enabled(UART0_IRQ + uart->index);
+    }
+}
+
+static void peerReceive(uart_inst_t *uart, uint8_t byte) {
+    if ('\n' != byte) {
+        if (uart->line_length < LINE_SIZE - 1) {
+            uart->line[uart->line_length++] = (char) byte;
+        }
+        return;
+    }
+    if (uart->line_length > 0 && '\r' == uart->line[uart->line_length - 1]) {
+        uart->line_length--;
+    }
+    uart->line[uart->line_length] = '\0';
+    uart->line_length = 0;
+    logLine(uart, ">", (const uint8_t *) uart->line, strlen(uart->line));
+    countUplink(uart->line);
+
+    for (int i = 0; i < response_count; i++) {
+        if (responses[i].index == uart->index && true == matches(responses[i].line, uart->line)) {
+            sim_at(sim_time_ns() + responses[i].delay_ms * 1000000ull, respond, &responses[i]);
+            return;
+        }
+    }
+}
+
+/* A pattern ending in '*' matches every line that starts with the text before it. */
+static bool matches(const char *pattern, const char *line) {
+    size_t length = strlen(pattern);
+    if (length > 0 && '*' == pattern[length - 1]) {
+        return 0 == strncmp(pattern, line, length - 1);
+    }
+    return 0 == strcmp(pattern, line);
+}
+
+/* The uplinks the LoRa-E5 is asked to send and their payload bytes, reported at the end of the run. */
+static void countUplink(const char *line) {
+    size_t tag = strlen(UPLINK_COMMAND);
+    if (0 != strncmp(UPLINK_COMMAND, line, tag)) {
+        return;
+    }
+    if (0 == uplinks++) {
+        atexit(reportUplinks);
+    }
+    const char *end = strchr(&line[tag], '"');
+    uplink_bytes += ((NULL != end) ? (size_t) (end - &line[tag]) : strlen(&line[tag])) / 2;
+}
+
+static void reportUplinks(void) {
+    fprintf(stderr, "sim: lora: %lu uplinks, %lu bytes of payload\n", (unsigned long) uplinks,
+            (unsigned long) uplink_bytes);
+}
+
+static void respond(void *context) {
+    const response_t *response = context;
+    sim_uart_inject(response->index, (const uint8_t *) response->reply, strlen(response->reply));
+}
+
+static void logLine(uart_inst_t *uart, const char *direction, const uint8_t *data, size_t length) {
+    if (false == sim_traced("uart")) {
+        return;
+    }
+    char text[LINE_SIZE * 4];
+    size_t n = 0;
+    for (size_t i = 0; i < length && n < sizeof(text) - 5; i++) {
+        if (data[i] >= ' ' && data[i] < 0x7f) {
+            text[n++] = (char) data[i];
+        } else {
+            n += snprintf(&text[n], sizeof(text) - n, "\\x%02x", data[i]);
+        }
+    }
+    text[n] = '\0';
+    sim_log("uart", "%u %s %s", uart->index, direction, text);
+}
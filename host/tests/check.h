@@ -0,0 +1,40 @@
+#ifndef HOST_TESTS_CHECK_H
+#define HOST_TESTS_CHECK_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/* Checks of the host tests (host/CMakeLists.txt). A failed check prints where it is and what it found, the test goes on
+ * and check_result() gives the exit status ctest reads. */
+
+#define CHECK(condition) checkCondition((condition), #condition, __FILE__, __LINE__)
+#define CHECK_EQUAL(actual, expected) checkEqual((long long) (actual), (long long) (expected), #actual, __FILE__, __LINE__)
+
+static int check_count;
+static int check_failures;
+
+static inline bool checkCondition(bool ok, const char *text, const char *file, int line) {
+    check_count++;
+    if (false == ok) {
+        fprintf(stderr, "%s:%d: failed: %s\n", file, line, text);
+        check_failures++;
+    }
+    return ok;
+}
+
+static inline bool checkEqual(long long actual, long long expected, const char *text, const char *file, int line) {
+    check_count++;
+    if (actual != expected) {
+        fprintf(stderr, "%s:%d: failed: %s is %lld, expected %lld\n", file, line, text, actual, expected);
+        check_failures++;
+        return false;
+    }
+    return true;
+}
+
+static inline int check_result(const char *name) {
+    printf("%s: %d checks, %d failed\n", name, check_count, check_failures);
+    return (check_failures > 0) ? 1 : 0;
+}
+
+#endif //HOST_TESTS_CHECK_H
@@ -0,0 +1,274 @@
+/*
+I2C transaction scheduler (common/i2c_bus.h) on a simulated bus: an EEPROM at 0x50 with its write cycle, a temperature
+sensor at 0x48, a device that is not there and one that holds the bus. Transactions start highest priority first and
+in submission order within a priority, callbacks see the final status, a cancelled transaction never runs, a missing
+device gives I2C_STATUS_NACK, the NACKs of acknowledge polling are not counted as errors, the latencies land in their
+histogram buckets, and a transfer that never ends is failed once i2c_bus_transfer() gives up on it.
+*/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "check.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+#include "i2c_bus.h"
+
+#define BYTE_US 90 // a byte and its acknowledge at 100 kHz
+#define WRITE_CYCLE_US 5000
+#define EEPROM_DEVICE 0x50
+#define SENSOR_DEVICE 0x48
+#define MISSING_DEVICE 0x33
+#define STUCK_DEVICE 0x30 // holds SCL low: its transfers never end
+#define MAX_EVENTS 16
+
+static i2c_bus_t bus;
+static uint32_t now_us;
+static uint32_t primask;
+static bool in_interrupt;
+static bool transfer_running;
+static uint32_t transfer_end_us;
+static uint32_t eeprom_busy_until_us;
+static uint8_t eeprom_memory[256];
+
+static const uint8_t temperature_register = 0;
+static const uint8_t temperature[2] = {0x19, 0x80};
+
+static int completed[MAX_EVENTS]; // the contexts of the callbacks, in order
+static uint8_t completed_status[MAX_EVENTS];
+static int completed_count;
+
+static void endTransfer(void);
+
+/* The clock of the scheduler: every read is a microsecond, and the bus interrupt comes in between when it is due and
+ * interrupts are enabled. */
+uint32_t time_us_32(void) {
+    uint32_t time = now_us++;
+    if (0 == primask && false == in_interrupt && true == transfer_running && now_us >= transfer_end_us) {
+        endTransfer();
+    }
+    return time;
+}
+
+uint32_t save_and_disable_interrupts(void) {
+    uint32_t status = primask;
+    primask = 1;
+    return status;
+}
+
+void restore_interrupts(uint32_t status) {
+    primask = status;
+}
+
+static void startTransfer(i2c_bus_t *bus, i2c_txn_t *txn) {
+    size_t bytes = (txn->write_length ? 1 + txn->write_length : 0) + (txn->read_length ? 1 + txn->read_length : 0);
+    transfer_end_us = now_us + bytes * BYTE_US;
+    transfer_running = (STUCK_DEVICE != txn->device);
+}
+
+/* The devices answer the active transaction from the interrupt. */
+static void endTransfer(void) {
+    i2c_txn_t *txn = bus.active;
+    uint8_t status = I2C_STATUS_NACK;
+    if (EEPROM_DEVICE == txn->device && now_us >= eeprom_busy_until_us) {
+        // two address bytes, the low one used; data after them starts a write cycle
+        uint8_t address = (txn->write_length >= 2) ? txn->write[1] : 0;
+        if (txn->write_length > 2) {
+            memcpy(&eeprom_memory[address], &txn->write[2], txn->write_length - 2);
+            eeprom_busy_until_us = now_us + WRITE_CYCLE_US;
+        }
+        if (txn->read_length > 0) {
+            memcpy(txn->read, &eeprom_memory[address], txn->read_length);
+        }
+        status = I2C_STATUS_OK;
+    } else if (SENSOR_DEVICE == txn->device) {
+        memcpy(txn->read, temperature, txn->read_length);
+        status = I2C_STATUS_OK;
+    }
+    transfer_running = false;
+    in_interrupt = true;
+    i2c_bus_complete(&bus, status);
+    in_interrupt = false;
+}
+
+static void recordCompletion(i2c_txn_t *txn, void *context) {
+    if (completed_count < MAX_EVENTS) {
+        completed_status[completed_count] = txn->status;
+        completed[completed_count++] = (int) (intptr_t) context;
+    }
+}
+
+static void resetBus(void) {
+    i2c_bus_init_backend(&bus, startTransfer);
+    transfer_running = false;
+    completed_count = 0;
+}
+
+static void runBus(void) {
+    for (int i = 0; i < 1000000 && NULL != bus.active; i++) {
+        time_us_32();
+    }
+}
+
+static i2c_txn_t sensorRead(uint8_t priority, uint8_t *data, int context) {
+    return (i2c_txn_t) {.device = SENSOR_DEVICE, .priority = priority, .write = &temperature_register,
+                        .write_length = 1, .read = data, .read_length = 2, .callback = recordCompletion,
+                        .context = (void *) (intptr_t) context};
+}
+
+static const i2c_device_stats_t *statsOf(uint8_t device) {
+    for (int i = 0; i < I2C_BUS_MAX_DEVICES; i++) {
+        if (device == bus.devices[i].device) {
+            return &bus.devices[i];
+        }
+    }
+    static const i2c_device_stats_t none;
+    return &none;
+}
+
+static void testPriorities(void) {
+    uint8_t data[5][2];
+    i2c_txn_t txns[5] = {
+            sensorRead(I2C_PRIORITY_LOW, data[0], 0),
+            sensorRead(I2C_PRIORITY_LOW, data[1], 1),
+            sensorRead(I2C_PRIORITY_NORMAL, data[2], 2),
+            sensorRead(I2C_PRIORITY_HIGH, data[3], 3),
+            sensorRead(I2C_PRIORITY_NORMAL, data[4], 4),
+    };
+    resetBus();
+    for (int i = 0; i < 5; i++) {
+        i2c_bus_submit(&bus, &txns[i]);
+    }
+    CHECK(bus.active == &txns[0]);
+    CHECK_EQUAL(txns[1].status, I2C_STATUS_PENDING);
+    runBus();
+
+    static const int order[] = {0, 3, 2, 4, 1};
+    CHECK_EQUAL(completed_count, 5);
+    for (int i = 0; i < 5; i++) {
+        CHECK_EQUAL(completed[i], order[i]);
+        CHECK_EQUAL(completed_status[i], I2C_STATUS_OK);
+        CHECK(0 == memcmp(data[i], temperature, sizeof(temperature)));
+    }
+}
+
+/* The head and the tail of a queue, then a transaction queued behind what is left. The active one is not cancelled. */
+static void testCancel(void) {
+    uint8_t data[5][2];
+    i2c_txn_t txns[5];
+    for (int i = 0; i < 5; i++) {
+        txns[i] = sensorRead(I2C_PRIORITY_NORMAL, data[i], i);
+    }
+    resetBus();
+    for (int i = 0; i < 4; i++) {
+        i2c_bus_submit(&bus, &txns[i]);
+    }
+    CHECK(i2c_bus_cancel(&bus, &txns[1]));
+    CHECK(i2c_bus_cancel(&bus, &txns[3]));
+    CHECK(false == i2c_bus_cancel(&bus, &txns[3]));
+    CHECK(false == i2c_bus_cancel(&bus, &txns[0]));
+    CHECK_EQUAL(txns[1].status, I2C_STATUS_CANCELLED);
+    CHECK(i2c_bus_done(&txns[1]));
+    i2c_bus_submit(&bus, &txns[4]);
+    runBus();
+
+    CHECK_EQUAL(completed_count, 3);
+    CHECK_EQUAL(completed[0], 0);
+    CHECK_EQUAL(completed[1], 2);
+    CHECK_EQUAL(completed[2], 4);
+    CHECK_EQUAL(txns[3].status, I2C_STATUS_CANCELLED);
+    CHECK_EQUAL(statsOf(SENSOR_DEVICE)->count, 3);
+}
+
+static void testNack(void) {
+    uint8_t data[2];
+    i2c_txn_t txn = sensorRead(I2C_PRIORITY_NORMAL, data, 7);
+    txn.device = MISSING_DEVICE;
+    resetBus();
+    CHECK_EQUAL(i2c_bus_transfer(&bus, &txn, 10000), I2C_STATUS_NACK);
+    CHECK_EQUAL(completed_count, 1);
+    CHECK_EQUAL(completed_status[0], I2C_STATUS_NACK);
+    CHECK_EQUAL(statsOf(MISSING_DEVICE)->count, 1);
+    CHECK_EQUAL(statsOf(MISSING_DEVICE)->nacks, 1);
+    CHECK_EQUAL(statsOf(MISSING_DEVICE)->errors, 0);
+}
+
+/* A write, acknowledge polling until the write cycle is over, and the read back, as common/eeprom.c does them. */
+static void testAckPolling(void) {
+    static const uint8_t write[] = {0, 0x20, 'a', 'b', 'c'};
+    uint8_t read[3];
+    i2c_txn_t txn = {.device = EEPROM_DEVICE, .write = write, .write_length = sizeof(write)};
+    resetBus();
+    CHECK_EQUAL(i2c_bus_transfer(&bus, &txn, 10000), I2C_STATUS_OK);
+
+    int polls = 0;
+    txn.write_length = 2;
+    do {
+        polls++;
+    } while (polls < 100 && I2C_STATUS_NACK == i2c_bus_transfer(&bus, &txn, 10000));
+    CHECK(polls > 1 && polls < 100);
+    CHECK(now_us >= eeprom_busy_until_us);
+
+    txn.read = read;
+    txn.read_length = sizeof(read);
+    CHECK_EQUAL(i2c_bus_transfer(&bus, &txn, 10000), I2C_STATUS_OK);
+    CHECK(0 == memcmp(read, &write[2], sizeof(read)));
+
+    const i2c_device_stats_t *stats = statsOf(EEPROM_DEVICE);
+    CHECK_EQUAL(stats->count, 2 + polls);
+    CHECK_EQUAL(stats->nacks, polls - 1);
+    CHECK_EQUAL(stats->errors, 0);
+}
+
+/* A sensor read alone takes 5 bytes, 450 us: 256 - 512 us. One queued behind another waits for it: 512 - 1024 us. */
+static void testHistogram(void) {
+    uint8_t data[2][2];
+    resetBus();
+    for (int i = 0; i < 10; i++) {
+        i2c_txn_t txn = sensorRead(I2C_PRIORITY_NORMAL, data[0], i);
+        CHECK_EQUAL(i2c_bus_transfer(&bus, &txn, 10000), I2C_STATUS_OK);
+    }
+    i2c_txn_t first = sensorRead(I2C_PRIORITY_NORMAL, data[0], 10);
+    i2c_txn_t second = sensorRead(I2C_PRIORITY_NORMAL, data[1], 11);
+    i2c_bus_submit(&bus, &first);
+    i2c_bus_submit(&bus, &second);
+    runBus();
+
+    const i2c_device_stats_t *stats = statsOf(SENSOR_DEVICE);
+    CHECK_EQUAL(stats->count, 12);
+    CHECK_EQUAL(stats->histogram[4], 11);
+    CHECK_EQUAL(stats->histogram[5], 1);
+    CHECK(stats->max_us >= 2 * 5 * BYTE_US && stats->max_us < 2 * 5 * BYTE_US + 10);
+    CHECK_EQUAL(stats->errors, 0);
+}
+
+/* The abort of a transfer that never ends cannot complete it either: i2c_bus_transfer() fails it I2C_BUS_ABORT_US
+ * after its timeout, and the bus goes on with the next one. */
+static void testStuck(void) {
+    uint8_t data[2];
+    static const uint8_t write = 0;
+    i2c_txn_t txn = {.device = STUCK_DEVICE, .write = &write, .write_length = 1, .callback = recordCompletion,
+                     .context = (void *) 20};
+    resetBus();
+    uint32_t start = now_us;
+    CHECK_EQUAL(i2c_bus_transfer(&bus, &txn, 500), I2C_STATUS_TIMEOUT);
+    CHECK(now_us - start <= 500 + I2C_BUS_ABORT_US + 10);
+    CHECK(NULL == bus.active);
+    CHECK_EQUAL(completed_count, 1);
+    CHECK_EQUAL(completed_status[0], I2C_STATUS_TIMEOUT);
+    CHECK_EQUAL(statsOf(STUCK_DEVICE)->errors, 1);
+
+    i2c_txn_t next = sensorRead(I2C_PRIORITY_NORMAL, data, 21);
+    CHECK_EQUAL(i2c_bus_transfer(&bus, &next, 10000), I2C_STATUS_OK);
+    CHECK_EQUAL(completed_count, 2);
+}
+
+int main(void) {
+    testPriorities();
+    testCancel();
+    testNack();
+    testAckPolling();
+    testHistogram();
+    testStuck();
+    return check_result("test_i2c_bus");
+}
@@ -0,0 +1,127 @@
+/*
+Block summary of the log (common/log_index.h) against a plain scan of the records: random logs of records of 5 to 23
+bytes with reboots in between, and random queries since a log time, by type and for the last N records. The blocks a
+query reads (from log_index_start on, less the ones log_index_skip leaves out) must hold every record the scan finds,
+and log_index_find must give the block each record starts in.
+*/
+
+#include "check.h"
+#include "log_index.h"
+#include "log_record.h"
+
+#define LOGS 200
+#define QUERIES 200
+#define MAX_RECORDS (LOG_INDEX_MAX_BLOCKS * LOG_INDEX_BLOCK_SIZE / 5)
+
+typedef struct {
+    uint16_t address;
+    uint32_t time_ms;
+    uint8_t type;
+} entry_t;
+
+static entry_t entries[MAX_RECORDS];
+static size_t entry_count;
+static uint32_t seed = 1;
+
+/* xorshift32, the same logs in every run */
+static uint32_t random32(void) {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+/* A log filling the area, built the way Exercise4/Task2/main.c indexes it; also a type the index counts in slot 0. */
+static void buildLog(log_index_t *index) {
+    uint32_t address = 0;
+    uint32_t time_ms = 0;
+    uint32_t boot_ms = 0;
+    log_index_reset(index);
+    entry_count = 0;
+    while (entry_count < MAX_RECORDS) {
+        uint32_t size = 5 + random32() % (LOG_RECORD_MAX_SIZE - 4);
+        if (address + size > LOG_INDEX_MAX_BLOCKS * LOG_INDEX_BLOCK_SIZE) {
+            break;
+        }
+        uint32_t pick = random32() % 16;
+        uint8_t type = (0 == pick) ? LOG_TYPE_BOOT : ((pick < 12) ? LOG_TYPE_STATE : ((pick < 15) ? LOG_TYPE_TEXT : 7));
+        time_ms += (random32() % 4) ? random32() % 5000 : random32() % 3600000;
+        if (LOG_TYPE_BOOT == type) {
+            boot_ms = time_ms;
+        }
+        log_index_add(index, (uint16_t) address, (uint16_t) entry_count, time_ms, boot_ms, type);
+        entries[entry_count++] = (entry_t) {(uint16_t) address, time_ms, type};
+        address += size;
+    }
+}
+
+static bool matches(const entry_t *entry, uint32_t since_ms, int type) {
+    return entry->time_ms >= since_ms && (LOG_INDEX_ANY_TYPE == type || entry->type == type);
+}
+
+/* Whether the blocks a query reads hold the record. */
+static bool scanned(const log_index_t *index, size_t start, uint32_t since_ms, int type, const entry_t *entry) {
+    size_t block = entry->address / LOG_INDEX_BLOCK_SIZE;
+    return block >= start && block < index->block_count &&
+           false == log_index_skip(&index->blocks[block], since_ms, type);
+}
+
+static void testQueries(const log_index_t *index) {
+    static const int types[] = {LOG_INDEX_ANY_TYPE, LOG_TYPE_BOOT, LOG_TYPE_STATE, LOG_TYPE_TEXT, 7};
+    uint32_t end_ms = entries[entry_count - 1].time_ms;
+    for (int q = 0; q < QUERIES; q++) {
+        uint32_t since_ms = (q % 4) ? random32() % (end_ms + 1) : 0;
+        int type = types[random32() % (sizeof(types) / sizeof(types[0]))];
+        uint32_t last = (q % 3) ? random32() % 20 : 0;
+
+        size_t start = log_index_start(index, since_ms, type, last);
+        uint32_t wanted = 0;
+        for (size_t i = entry_count; i-- > 0;) {
+            if (false == matches(&entries[i], since_ms, type) || (last > 0 && wanted == last)) {
+                continue;
+            }
+            wanted++;
+            if (false == CHECK(scanned(index, start, since_ms, type, &entries[i]))) {
+                fprintf(stderr, "  record %zu at %u, %u ms, type %u; since %u ms, type %d, last %u: start %zu\n", i,
+                        entries[i].address, entries[i].time_ms, entries[i].type, since_ms, type, last, start);
+                return;
+            }
+        }
+    }
+}
+
+static void testFind(const log_index_t *index) {
+    for (size_t i = 0; i < entry_count; i++) {
+        CHECK_EQUAL(log_index_find(index, (uint16_t) i), entries[i].address / LOG_INDEX_BLOCK_SIZE);
+    }
+    CHECK_EQUAL(log_index_find(index, (uint16_t) entry_count), index->block_count - 1);
+}
+
+/* Blocks the records skip over stay empty; records past the summary are not counted. */
+static void testGaps(void) {
+    static log_index_t index;
+    log_index_reset(&index);
+    log_index_add(&index, 10, 0, 100, 100, LOG_TYPE_BOOT);
+    log_index_add(&index, 3 * LOG_INDEX_BLOCK_SIZE + 2, 1, 200, 100, LOG_TYPE_STATE);
+    log_index_add(&index, LOG_INDEX_MAX_BLOCKS * LOG_INDEX_BLOCK_SIZE, 2, 300, 100, LOG_TYPE_STATE);
+    CHECK_EQUAL(index.block_count, 4);
+    CHECK_EQUAL(index.blocks[1].address, LOG_INDEX_EMPTY);
+    CHECK(log_index_skip(&index.blocks[2], 0, LOG_INDEX_ANY_TYPE));
+    CHECK_EQUAL(index.blocks[3].first_ms, 200);
+    CHECK_EQUAL(index.blocks[3].boot_ms, 100);
+    CHECK_EQUAL(index.blocks[3].count[LOG_TYPE_STATE], 1);
+    CHECK_EQUAL(log_index_find(&index, 1), 3);
+    CHECK_EQUAL(log_index_start(&index, 150, LOG_TYPE_STATE, 1), 3);
+    CHECK_EQUAL(log_index_start(&index, 0, LOG_TYPE_BOOT, 1), 0);
+}
+
+int main(void) {
+    static log_index_t index;
+    for (int log = 0; log < LOGS; log++) {
+        buildLog(&index);
+        testQueries(&index);
+        testFind(&index);
+    }
+    testGaps();
+    return check_result("test_log_index");
+}
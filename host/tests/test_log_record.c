@@ -0,0 +1,134 @@
+/*
+Log records (common/log_record.h): every type and payload length with deltas at the edges of the varint bytes round trip
+with the size the format gives. A record cut short anywhere, with any one bit flipped, ending in a varint of more than
+five bytes, or starting with an end marker decodes as nothing.
+*/
+
+#include <string.h>
+
+#include "check.h"
+#include "log_record.h"
+
+static const uint32_t deltas[] = {
+        0, 1, 127, 128, 16383, 16384, 2097151, 2097152, 268435455, 268435456, UINT32_MAX
+};
+
+static size_t varintSize(uint32_t value) {
+    size_t size = 1;
+    while (value >= 128) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+static log_record_t makeRecord(uint8_t type, uint8_t length, uint32_t delta_ms) {
+    log_record_t record = {.type = type, .length = length, .delta_ms = delta_ms};
+    for (uint8_t i = 0; i < length; i++) {
+        record.payload[i] = (uint8_t) ('a' + i + type);
+    }
+    return record;
+}
+
+static void testRoundTrip(void) {
+    for (uint8_t type = LOG_TYPE_BOOT; type <= LOG_TYPE_TEXT; type++) {
+        for (uint8_t length = 0; length <= LOG_RECORD_MAX_PAYLOAD; length++) {
+            for (size_t d = 0; d < sizeof(deltas) / sizeof(deltas[0]); d++) {
+                log_record_t record = makeRecord(type, length, deltas[d]);
+                log_record_t decoded;
+                uint8_t encoded[LOG_RECORD_MAX_SIZE + 1];
+                size_t size = log_record_encode(&record, encoded);
+                CHECK_EQUAL(size, 1 + varintSize(deltas[d]) + length + 2);
+                CHECK(size <= LOG_RECORD_MAX_SIZE);
+                memset(&decoded, 0xA5, sizeof(decoded));
+                // the byte after the record is the end of the log, or the next record
+                encoded[size] = LOG_RECORD_END;
+                CHECK_EQUAL(log_record_decode(encoded, size + 1, &decoded), size);
+                CHECK_EQUAL(decoded.type, type);
+                CHECK_EQUAL(decoded.length, length);
+                CHECK_EQUAL(decoded.delta_ms, deltas[d]);
+                CHECK(0 == memcmp(decoded.payload, record.payload, length));
+            }
+        }
+    }
+}
+
+/* A payload over LOG_RECORD_MAX_PAYLOAD is cut to it. */
+static void testLongPayload(void) {
+    log_record_t record = makeRecord(LOG_TYPE_TEXT, LOG_RECORD_MAX_PAYLOAD, 5);
+    log_record_t decoded;
+    uint8_t encoded[LOG_RECORD_MAX_SIZE];
+    record.length = LOG_RECORD_MAX_PAYLOAD + 3;
+    size_t size = log_record_encode(&record, encoded);
+    CHECK_EQUAL(log_record_decode(encoded, size, &decoded), size);
+    CHECK_EQUAL(decoded.length, LOG_RECORD_MAX_PAYLOAD);
+}
+
+static void testTruncated(void) {
+    for (size_t d = 0; d < sizeof(deltas) / sizeof(deltas[0]); d++) {
+        log_record_t record = makeRecord(LOG_TYPE_TEXT, 7, deltas[d]);
+        log_record_t decoded;
+        uint8_t encoded[LOG_RECORD_MAX_SIZE];
+        size_t size = log_record_encode(&record, encoded);
+        for (size_t available = 0; available < size; available++) {
+            CHECK_EQUAL(log_record_decode(encoded, available, &decoded), 0);
+        }
+    }
+}
+
+static void testCorrupt(void) {
+    for (uint8_t length = 0; length <= LOG_RECORD_MAX_PAYLOAD; length += 5) {
+        log_record_t record = makeRecord(LOG_TYPE_STATE, length, 300000);
+        log_record_t decoded;
+        uint8_t encoded[LOG_RECORD_MAX_SIZE];
+        uint8_t damaged[LOG_RECORD_MAX_SIZE + 16];
+        size_t size = log_record_encode(&record, encoded);
+        for (size_t bit = 0; bit < 8 * size; bit++) {
+            // what follows the record is blank EEPROM, so a header that grew still finds bytes to check
+            memset(damaged, 0xFF, sizeof(damaged));
+            memcpy(damaged, encoded, size);
+            damaged[bit / 8] ^= (uint8_t) (1 << (bit % 8));
+            CHECK_EQUAL(log_record_decode(damaged, sizeof(damaged), &decoded), 0);
+        }
+    }
+}
+
+static void testEnd(void) {
+    log_record_t decoded;
+    uint8_t erased[LOG_RECORD_MAX_SIZE] = {LOG_RECORD_END};
+    uint8_t blank[LOG_RECORD_MAX_SIZE];
+    memset(blank, 0xFF, sizeof(blank));
+    CHECK_EQUAL(log_record_decode(erased, sizeof(erased), &decoded), 0);
+    CHECK_EQUAL(log_record_decode(blank, sizeof(blank), &decoded), 0);
+
+    // a varint that goes on past five bytes, CRC included
+    uint8_t overlong[] = {LOG_TYPE_BOOT << 4, 0x80, 0x80, 0x80, 0x80, 0x80, 0x01, 0, 0};
+    CHECK_EQUAL(log_record_decode(overlong, sizeof(overlong), &decoded), 0);
+}
+
+static void testRender(void) {
+    char text[64];
+    log_record_t boot = makeRecord(LOG_TYPE_BOOT, 0, 1234);
+    log_record_t state = {.type = LOG_TYPE_STATE, .length = 1, .payload = {5}};
+    log_record_t message = {.type = LOG_TYPE_TEXT, .length = 5, .payload = "hello world"};
+    log_record_t unknown = {.type = 9};
+
+    log_record_render(&boot, 0, text, sizeof(text));
+    CHECK(0 == strcmp("Boot", text));
+    log_record_render(&state, 61999, text, sizeof(text));
+    CHECK(0 == strcmp("61s since power up.\nD1: 1\nD2: 0\nD3: 1", text));
+    log_record_render(&message, 0, text, sizeof(text));
+    CHECK(0 == strcmp("hello", text));
+    log_record_render(&unknown, 0, text, sizeof(text));
+    CHECK(0 == strcmp("Unknown record type 9", text));
+}
+
+int main(void) {
+    testRoundTrip();
+    testLongPayload();
+    testTruncated();
+    testCorrupt();
+    testEnd();
+    testRender();
+    return check_result("test_log_record");
+}
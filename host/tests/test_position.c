@@ -0,0 +1,86 @@
+/*
+Carry of the fractional steps in Exercise 5 (Exercise5/position.h): thousands of random run and goto moves for several
+numbers of steps per revolution. The steps of all moves together must be exactly those of one move over all their
+eighths, every move must end on the step of its target eighth, and none may take a revolution more than it is worth.
+A stop in the middle of a move leaves the motor between eighths; the next move has to bring it back onto them.
+*/
+
+#include <stdlib.h>
+
+#include "check.h"
+#include "position.h"
+
+#define MOVES 5000
+#define MAX_RUN 20 // run N takes any N, several revolutions included
+
+static const uint32_t counts[] = {8, 509, 4076, 4095, 4096, 4097, 4103, 4111};
+
+static uint32_t seed = 1;
+
+/* xorshift32, the same moves in every run */
+static uint32_t random32(void) {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+/* The eighths of a run or of a goto from target, as Exercise5/main.c converts them. */
+static uint32_t randomMove(uint32_t target) {
+    if (random32() % 2) {
+        return random32() % (MAX_RUN + 1);
+    }
+    return (random32() % POSITIONS_PER_REVOLUTION + POSITIONS_PER_REVOLUTION - target) % POSITIONS_PER_REVOLUTION;
+}
+
+static void testNoDrift(uint32_t count) {
+    uint32_t position = 0;
+    uint32_t target = 0;
+    uint64_t eighths_total = 0;
+    uint64_t steps_total = 0;
+
+    for (int i = 0; i < MOVES; i++) {
+        uint32_t eighths = randomMove(target);
+        uint32_t steps = position_steps_to(count, position, target + eighths);
+        CHECK(steps <= (uint64_t) eighths * count / POSITIONS_PER_REVOLUTION + 1);
+        position = (position + steps) % count;
+        target = (target + eighths) % POSITIONS_PER_REVOLUTION;
+        eighths_total += eighths;
+        steps_total += steps;
+        if (false == CHECK_EQUAL(position, (uint64_t) target * count / POSITIONS_PER_REVOLUTION)) {
+            fprintf(stderr, "  %u steps per revolution, move %d\n", count, i);
+            return;
+        }
+    }
+    CHECK_EQUAL(steps_total, eighths_total * count / POSITIONS_PER_REVOLUTION);
+}
+
+/* stop: the target becomes the eighth the motor stopped in (commandStop) */
+static void testStops(uint32_t count) {
+    uint32_t position = 0;
+    uint32_t target = 0;
+
+    for (int i = 0; i < MOVES; i++) {
+        uint32_t eighths = randomMove(target);
+        uint32_t steps = position_steps_to(count, position, target + eighths);
+        if (steps > 0 && 0 == random32() % 8) {
+            position = (position + random32() % steps) % count;
+            target = position * POSITIONS_PER_REVOLUTION / count;
+            continue;
+        }
+        position = (position + steps) % count;
+        target = (target + eighths) % POSITIONS_PER_REVOLUTION;
+        if (false == CHECK_EQUAL(position, (uint64_t) target * count / POSITIONS_PER_REVOLUTION)) {
+            fprintf(stderr, "  %u steps per revolution, move %d\n", count, i);
+            return;
+        }
+    }
+}
+
+int main(void) {
+    for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+        testNoDrift(counts[i]);
+        testStops(counts[i]);
+    }
+    return check_result("test_position");
+}
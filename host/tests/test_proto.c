@@ -0,0 +1,112 @@
+/*
+Binary request/response protocol (common/proto.h) fed frame by frame as the command line passes them on: pings of the
+longest payload and one byte more, a frame as long as the receive buffer takes, one longer than that, and a bad CRC.
+Every request with a good CRC gets exactly one response; a payload over PROTO_MAX_PAYLOAD gets PROTO_ERR_ARGS without
+reaching a handler.
+*/
+
+#include <string.h>
+
+#include "check.h"
+#include "cobs.h"
+#include "crc16.h"
+#include "proto.h"
+
+#define PROTO_TEST 0x70 // a command of the test, counts its calls
+
+static uint8_t output[4 * PROTO_MAX_ENCODED];
+static size_t output_length;
+static int handler_calls;
+
+/* The console of the board, raw */
+int putchar_raw(int c) {
+    if (output_length < sizeof(output)) {
+        output[output_length++] = (uint8_t) c;
+    }
+    return c;
+}
+
+static uint8_t testHandler(const uint8_t *payload, size_t length, uint8_t *reply, size_t *reply_length) {
+    handler_calls++;
+    *reply_length = 0;
+    return PROTO_OK;
+}
+
+static const proto_command_t commands[] = {
+        {PROTO_TEST, testHandler},
+};
+
+/* The frame of a request of payload_length bytes, between its zeros, into proto. */
+static void sendRequest(proto_t *proto, uint8_t seq, uint8_t type, size_t payload_length, bool bad_crc) {
+    uint8_t packet[PROTO_MAX_ENCODED + 8];
+    uint8_t encoded[PROTO_MAX_ENCODED + 8];
+    packet[0] = seq;
+    packet[1] = type;
+    for (size_t i = 0; i < payload_length; i++) {
+        packet[2 + i] = (uint8_t) (i + 1);
+    }
+    uint16_t crc = crc16(packet, payload_length + 2) ^ (bad_crc ? 1 : 0);
+    packet[payload_length + 2] = (uint8_t) (crc >> 8);
+    packet[payload_length + 3] = (uint8_t) crc;
+    size_t length = cobs_encode(packet, payload_length + 4, encoded);
+
+    output_length = 0;
+    proto_feed(proto, 0);
+    for (size_t i = 0; i < length; i++) {
+        proto_feed(proto, encoded[i]);
+    }
+    proto_feed(proto, 0);
+}
+
+/* The response sent for the last request, decoded and checked; its payload length, -1 if there is none. */
+static int response(uint8_t seq, uint8_t type, uint8_t status) {
+    uint8_t packet[sizeof(output)];
+    if (0 == output_length) {
+        return -1;
+    }
+    CHECK(output_length >= 2 && 0 == output[0] && 0 == output[output_length - 1]);
+    size_t length = cobs_decode(&output[1], output_length - 2, packet);
+    if (false == CHECK(length >= 5 && 0 == crc16(packet, length))) {
+        return -1;
+    }
+    CHECK_EQUAL(packet[0], seq);
+    CHECK_EQUAL(packet[1], type | PROTO_RESPONSE);
+    CHECK_EQUAL(packet[2], status);
+    for (size_t i = 3; i < length - 2; i++) {
+        CHECK_EQUAL(packet[i], i - 2);
+    }
+    return (int) length - 5;
+}
+
+int main(void) {
+    proto_t proto;
+    proto_init(&proto, commands, sizeof(commands) / sizeof(commands[0]));
+
+    sendRequest(&proto, 1, PROTO_PING, PROTO_MAX_PAYLOAD, false);
+    CHECK_EQUAL(response(1, PROTO_PING, PROTO_OK), PROTO_MAX_PAYLOAD);
+
+    sendRequest(&proto, 2, PROTO_PING, PROTO_MAX_PAYLOAD + 1, false);
+    CHECK_EQUAL(response(2, PROTO_PING, PROTO_ERR_ARGS), 0);
+
+    // the longest frame the buffer takes, PROTO_MAX_ENCODED bytes, decodes to the longest request there can be
+    sendRequest(&proto, 3, PROTO_TEST, PROTO_MAX_ENCODED - 5, false);
+    CHECK_EQUAL(response(3, PROTO_TEST, PROTO_ERR_ARGS), 0);
+    CHECK_EQUAL(handler_calls, 0);
+
+    sendRequest(&proto, 4, PROTO_TEST, PROTO_MAX_PAYLOAD, false);
+    CHECK_EQUAL(response(4, PROTO_TEST, PROTO_OK), 0);
+    CHECK_EQUAL(handler_calls, 1);
+
+    uint32_t errors = proto.errors;
+    sendRequest(&proto, 5, PROTO_PING, PROTO_MAX_ENCODED, false);
+    CHECK_EQUAL(response(5, PROTO_PING, PROTO_ERR_ARGS), -1);
+    sendRequest(&proto, 6, PROTO_PING, 4, true);
+    CHECK_EQUAL(response(6, PROTO_PING, PROTO_OK), -1);
+    CHECK_EQUAL(proto.errors, errors + 2);
+
+    sendRequest(&proto, 7, PROTO_PING, 0, false);
+    CHECK_EQUAL(response(7, PROTO_PING, PROTO_OK), 0);
+    CHECK_EQUAL(proto.frames, 5);
+
+    return check_result("test_proto");
+}
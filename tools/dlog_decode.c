@@ -0,0 +1,239 @@
+/*
+Host decoder for the deferred log (common/dlog.h).
+
+Built by host/CMakeLists.txt (no Pico SDK needed), or on its own:
+    cc -O2 -I../common -o dlog_decode dlog_decode.c ../common/cobs.c ../common/crc16.c
+
+Usage:
+    dlog_decode <firmware.elf> [tty or capture file]
+
+Reads frames from the tty/file (stdin if omitted), looks up the format string of every PROTO_LOG_EVENT frame in the
+dlog_formats section of the ELF file and prints the formatted text with the board timestamp. Text between frames is
+passed through unchanged. The firmware has to be built with DLOG_DEFERRED=1; the ELF file may be 32-bit (the board) or
+64-bit (a host twin, where %s arguments are not looked up).
+*/
+
+#include <elf.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "cobs.h"
+#include "crc16.h"
+#include "proto.h"
+
+#define MAX_SECTIONS 64
+#define MAX_FORMAT_OUTPUT 512
+
+typedef struct {
+    uint64_t address;
+    uint64_t size;
+    const uint8_t *data;
+} section_t;
+
+static section_t sections[MAX_SECTIONS];
+static int section_count = 0;
+static section_t formats;
+
+static int loadElf(const char *path);
+static void addSection(const uint8_t *image, long size, const char *names, uint32_t name, uint32_t type,
+                       uint64_t flags, uint64_t address, uint64_t offset, uint64_t length);
+static const char *sectionString(const section_t *section, uint64_t offset);
+static const char *lookupString(uint32_t address);
+static void printRecord(const uint8_t *payload, size_t length);
+static uint32_t getU32(const uint8_t *buffer);
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <firmware.elf> [tty or capture file]\n", argv[0]);
+        return 2;
+    }
+    if (0 != loadElf(argv[1])) {
+        return 1;
+    }
+
+    int fd = STDIN_FILENO;
+    if (argc > 2) {
+        fd = open(argv[2], O_RDONLY | O_NOCTTY);
+        if (fd < 0) {
+            perror(argv[2]);
+            return 1;
+        }
+        struct termios tty;
+        if (0 == tcgetattr(fd, &tty)) {
+            cfmakeraw(&tty);
+            tcsetattr(fd, TCSANOW, &tty);
+        }
+    }
+
+    uint8_t encoded[PROTO_MAX_ENCODED];
+    uint8_t packet[PROTO_MAX_PACKET];
+    size_t count = 0;
+    int in_frame = 0;
+    uint8_t byte;
+
+    while (1 == read(fd, &byte, 1)) {
+        if (!in_frame) {
+            if (0 == byte) {
+                in_frame = 1;
+                count = 0;
+            } else {
+                putchar(byte);
+            }
+        } else if (0 != byte) {
+            if (count < sizeof(encoded)) {
+                encoded[count++] = byte;
+            }
+        } else if (count > 0) {
+            size_t length = cobs_decode(encoded, count, packet);
+            if (length >= 5 && 0 == crc16(packet, length) && PROTO_LOG_EVENT == packet[1]) {
+                printRecord(&packet[3], length - 5);
+            }
+            in_frame = 0;
+        }
+        fflush(stdout);
+    }
+    return 0;
+}
+
+/* Keeps the whole file in memory and remembers where each allocated section lives in the target address space, and
+ * the dlog_formats section in particular. */
+static int loadElf(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (NULL == file) {
+        perror(path);
+        return -1;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t *image = malloc(size);
+    if (NULL == image || 1 != fread(image, size, 1, file)) {
+        fprintf(stderr, "%s: read failed\n", path);
+        fclose(file);
+        return -1;
+    }
+    fclose(file);
+
+    if (size < (long) sizeof(Elf64_Ehdr) || 0 != memcmp(image, ELFMAG, SELFMAG)) {
+        fprintf(stderr, "%s: not an ELF file\n", path);
+        return -1;
+    }
+    if (ELFCLASS32 == image[EI_CLASS]) {
+        const Elf32_Ehdr *header = (const Elf32_Ehdr *) image;
+        const Elf32_Shdr *section_headers = (const Elf32_Shdr *) (image + header->e_shoff);
+        const char *names = (const char *) image + section_headers[header->e_shstrndx].sh_offset;
+        for (int i = 0; i < header->e_shnum; i++) {
+            const Elf32_Shdr *sh = &section_headers[i];
+            addSection(image, size, names, sh->sh_name, sh->sh_type, sh->sh_flags, sh->sh_addr, sh->sh_offset,
+                       sh->sh_size);
+        }
+    } else {
+        const Elf64_Ehdr *header = (const Elf64_Ehdr *) image;
+        const Elf64_Shdr *section_headers = (const Elf64_Shdr *) (image + header->e_shoff);
+        const char *names = (const char *) image + section_headers[header->e_shstrndx].sh_offset;
+        for (int i = 0; i < header->e_shnum; i++) {
+            const Elf64_Shdr *sh = &section_headers[i];
+            addSection(image, size, names, sh->sh_name, sh->sh_type, sh->sh_flags, sh->sh_addr, sh->sh_offset,
+                       sh->sh_size);
+        }
+    }
+    if (NULL == formats.data) {
+        fprintf(stderr, "%s: no dlog_formats section (built with DLOG_DEFERRED=1?)\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+static void addSection(const uint8_t *image, long size, const char *names, uint32_t name, uint32_t type,
+                       uint64_t flags, uint64_t address, uint64_t offset, uint64_t length) {
+    if (0 == (flags & SHF_ALLOC) || SHT_PROGBITS != type || offset + length > (uint64_t) size) {
+        return;
+    }
+    section_t section = {.address = address, .size = length, .data = image + offset};
+    if (0 == strcmp("dlog_formats", &names[name])) {
+        formats = section;
+    }
+    if (section_count < MAX_SECTIONS) {
+        sections[section_count++] = section;
+    }
+}
+
+/* The string at offset in the section, if it ends in there. */
+static const char *sectionString(const section_t *section, uint64_t offset) {
+    if (offset >= section->size || NULL == memchr(section->data + offset, 0, section->size - offset)) {
+        return NULL;
+    }
+    return (const char *) section->data + offset;
+}
+
+static const char *lookupString(uint32_t address) {
+    for (int i = 0; i < section_count; i++) {
+        if (address >= sections[i].address && address < sections[i].address + sections[i].size) {
+            return sectionString(&sections[i], address - sections[i].address);
+        }
+    }
+    return NULL;
+}
+
+/* Formats one conversion at a time with the host printf; length modifiers are dropped since every argument is a
+ * 32-bit value on the board. */
+static void printRecord(const uint8_t *payload, size_t length) {
+    if (length < 8) {
+        return;
+    }
+    uint32_t timestamp = getU32(payload);
+    const char *format = sectionString(&formats, getU32(&payload[4]));
+    size_t argc = (length - 8) / 4;
+    size_t arg = 0;
+
+    printf("[%10.6f] ", timestamp / 1e6);
+    if (NULL == format) {
+        printf("<unknown format 0x%08x>\n", getU32(&payload[4]));
+        return;
+    }
+
+    for (const char *p = format; *p; p++) {
+        if ('%' != *p) {
+            putchar(*p);
+            continue;
+        }
+        char spec[32];
+        size_t n = 0;
+        spec[n++] = *p++;
+        while (*p && strchr("-+ #0123456789.", *p) && n < sizeof(spec) - 3) {
+            spec[n++] = *p++;
+        }
+        while (*p && strchr("hlzjt", *p)) {
+            p++;
+        }
+        if ('\0' == *p) {
+            break;
+        }
+        char conversion = *p;
+        if ('%' == conversion) {
+            putchar('%');
+            continue;
+        }
+        uint32_t value = (arg < argc) ? getU32(&payload[8 + 4 * arg++]) : 0;
+        spec[n++] = conversion;
+        spec[n] = '\0';
+        if ('s' == conversion) {
+            const char *string = lookupString(value);
+            printf(spec, string ? string : "<?>");
+        } else if (strchr("di", conversion)) {
+            printf(spec, (int32_t) value);
+        } else if (strchr("uxXoc", conversion)) {
+            printf(spec, value);
+        } else {
+            printf("<%%%c?>", conversion);
+        }
+    }
+}
+
+static uint32_t getU32(const uint8_t *buffer) {
+    return ((uint32_t) buffer[0] << 24) | (buffer[1] << 16) | (buffer[2] << 8) | buffer[3];
+}
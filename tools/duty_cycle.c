@@ -0,0 +1,127 @@
+/*
+Duty cycle harness for the idle reports of common/idle.h.
+
+Build the firmware with the report turned on, e.g. for Exercise1:
+    cmake -DIDLE_REPORT_MS=1000 .. && make
+
+Built by host/CMakeLists.txt (no Pico SDK needed), or on its own:
+    cc -O2 -o duty_cycle duty_cycle.c
+
+Usage:
+    duty_cycle <tty or capture file> [seconds] [label] [results.csv]
+
+Collects the "idle: busy <percent>%, <n> wakeups/s" lines for the given time (default 10 s, 0 reads a capture file to
+its end) and prints the minimum, average and maximum busy share and the average wakeup rate. With a results file one
+CSV line (label, reports, busy min/avg/max %, wakeups/s) is appended, so runs of several project builds can be
+compared. Binary frames (see proto.h) and other text are skipped.
+*/
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_LINE 128
+
+static int openInput(const char *path);
+static double nowSeconds(void);
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <tty or capture file> [seconds] [label] [results.csv]\n", argv[0]);
+        return 2;
+    }
+    double seconds = (argc > 2) ? atof(argv[2]) : 10.0;
+    const char *label = (argc > 3) ? argv[3] : argv[1];
+    int fd = openInput(argv[1]);
+    if (fd < 0) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    char line[MAX_LINE];
+    size_t length = 0;
+    int in_frame = 0;
+    int reports = 0;
+    double busy_min = 100.0, busy_max = 0.0, busy_sum = 0.0, wakeup_sum = 0.0;
+    double end = nowSeconds() + seconds;
+    uint8_t byte;
+
+    while ((seconds <= 0 || nowSeconds() < end) && 1 == read(fd, &byte, 1)) {
+        if (0 == byte) {
+            in_frame = !in_frame;
+            length = 0;
+            continue;
+        }
+        if (in_frame) {
+            continue;
+        }
+        if ('\n' != byte) {
+            if (length < sizeof(line) - 1) {
+                line[length++] = (char) byte;
+            }
+            continue;
+        }
+        line[length] = '\0';
+        length = 0;
+
+        double busy;
+        unsigned long wakeups;
+        const char *report = strstr(line, "idle: busy ");
+        if (NULL != report && 2 == sscanf(report, "idle: busy %lf%%, %lu wakeups/s", &busy, &wakeups)) {
+            printf("busy %5.1f %%  %6lu wakeups/s\n", busy, wakeups);
+            busy_sum += busy;
+            wakeup_sum += wakeups;
+            busy_min = (busy < busy_min) ? busy : busy_min;
+            busy_max = (busy > busy_max) ? busy : busy_max;
+            reports++;
+        }
+    }
+    close(fd);
+
+    if (0 == reports) {
+        fprintf(stderr, "no idle reports; was the firmware built with IDLE_REPORT_MS?\n");
+        return 1;
+    }
+    printf("%s: %d reports, busy min %.1f %% avg %.1f %% max %.1f %%, %.0f wakeups/s\n", label, reports, busy_min,
+           busy_sum / reports, busy_max, wakeup_sum / reports);
+
+    if (argc > 4) {
+        FILE *results = fopen(argv[4], "a");
+        if (NULL == results) {
+            perror(argv[4]);
+            return 1;
+        }
+        fprintf(results, "%s,%d,%.1f,%.1f,%.1f,%.0f\n", label, reports, busy_min, busy_sum / reports, busy_max,
+                wakeup_sum / reports);
+        fclose(results);
+    }
+    return 0;
+}
+
+/* A tty is switched to raw mode with a read timeout, so the time limit also ends a silent board. */
+static int openInput(const char *path) {
+    int fd = open(path, O_RDONLY | O_NOCTTY);
+    if (fd < 0) {
+        return fd;
+    }
+    struct termios tty;
+    if (0 == tcgetattr(fd, &tty)) {
+        cfmakeraw(&tty);
+        cfsetspeed(&tty, B115200);
+        tty.c_cc[VMIN] = 0;
+        tty.c_cc[VTIME] = 5;
+        tcsetattr(fd, TCSANOW, &tty);
+    }
+    return fd;
+}
+
+static double nowSeconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
@@ -0,0 +1,67 @@
+/*
+Bus speed table of the EEPROM driver (common/eeprom.h), in the virtual time of the host simulation.
+
+Built as a twin with the host twins (host/CMakeLists.txt) and run by ctest with host/scripts/eeprom_bus.sim:
+    cmake -S host -B build-host && cmake --build build-host
+    SIM_SCRIPT=host/scripts/eeprom_bus.sim build-host/eeprom_bus_sim
+
+For a probe limit of 100 kHz, 400 kHz and 1 MHz against the simulated 24LC256 (1 MHz capable, 5 ms write cycle) it
+prints the speed the probe picks, the time to read all 32 KB through a one line cache (a page transaction each) and
+the time of one page write, write cycle included. The expect lines of the script are the baseline of the table.
+*/
+
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+
+#include "eeprom.h"
+
+#define I2C0_SDA_PIN 16
+#define I2C0_SCL_PIN 17
+#define DEVADDR 0x50
+#define TEST_PAGE 256
+
+static eeprom_t eeprom;
+static eeprom_line_t line;
+
+static void measure(uint max_baudrate) {
+    uint8_t page[EEPROM_PAGE_SIZE];
+
+    eeprom_init(&eeprom, i2c0, DEVADDR, &line, 1);
+    uint baudrate = eeprom_probe(&eeprom, max_baudrate);
+
+    uint64_t start = time_us_64();
+    for (uint32_t address = 0; address < EEPROM_SIZE; address += EEPROM_PAGE_SIZE) {
+        eeprom_read(&eeprom, (uint16_t) address, page, sizeof(page));
+    }
+    uint64_t dump_us = time_us_64() - start;
+
+    for (uint i = 0; i < sizeof(page); i++) {
+        page[i] = (uint8_t) i;
+    }
+    start = time_us_64();
+    eeprom_write(&eeprom, TEST_PAGE * EEPROM_PAGE_SIZE, page, sizeof(page));
+    uint64_t write_us = time_us_64() - start;
+
+    printf("%4u kHz  %4u kHz  %lu.%02lu s  %5lu.%lu ms  %lu failed\n", max_baudrate / 1000, baudrate / 1000,
+           (unsigned long) (dump_us / 1000000), (unsigned long) (dump_us % 1000000 / 10000),
+           (unsigned long) (write_us / 1000), (unsigned long) (write_us % 1000 / 100),
+           (unsigned long) eeprom.stats.failures);
+}
+
+int main() {
+    static const uint limits[] = {100000, 400000, 1000000};
+
+    stdio_init_all();
+    i2c_init(i2c0, 100000);
+    gpio_set_function(I2C0_SDA_PIN, GPIO_FUNC_I2C);
+    gpio_set_function(I2C0_SCL_PIN, GPIO_FUNC_I2C);
+
+    printf("limit     bus       32 KB   page write\n");
+    for (uint i = 0; i < sizeof(limits) / sizeof(limits[0]); i++) {
+        measure(limits[i]);
+    }
+    while (true) {
+        sleep_ms(1000);
+    }
+}
@@ -0,0 +1,271 @@
+/*
+A day of uplinks through the transmit scheduler (common/lora_tx.h), in virtual time.
+
+Build on the host (no Pico SDK needed):
+    cc -O2 -I../common -o lora_schedule lora_schedule.c ../common/lora_tx.c
+The host build (host/CMakeLists.txt) makes it the lora_schedule test, run with the defaults.
+
+Usage:
+    lora_schedule [spreading factor] [hours] [seed]
+
+Runs hours (default 24) of synthetic traffic at the spreading factor (default 12) over the two sub-bands of 1% that
+the eight channels of EU868 are in (865-868 MHz and 868-868.6 MHz), polling the scheduler every 100 ms of virtual time:
+batches of state changes as normal messages, every 5 minutes by day and every 30 minutes at night; a status as a low
+priority message every 10 minutes; and 8 alarms of a few bytes as urgent messages at random times. The radio takes a
+frame when it is done with the previous one and its receive windows.
+
+The same traffic then runs once more with every message queued as normal, as a queue without priorities would send
+it. Both print per class the messages sent, merged or lost and their mean and longest wait, and the first run the
+statistics of the scheduler. Every frame sent is checked against the off-time of its sub-band after the frame before
+and against the airtime of 1% in any hour. The longest waits by priority must be the ones the scheduler counted, and
+the status, which a newer one keeps replacing, must not wait longer than LORA_TX_AGING_MS and then as long as a normal
+message can. The exit status is 1 if one of them fails.
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lora_tx.h"
+
+#define STEP_MS 100
+#define HOUR_MS (60u * 60 * 1000)
+#define RECEIVE_WINDOWS_MS 2000 // RX1 and RX2 after the frame, the radio is busy until they are over
+#define DUTY_PERMILLE 10
+#define BANDS 2
+#define ALARMS_PER_DAY 8
+#define MAX_ALARMS 64
+#define MAX_FRAMES 4096
+#define MAX_MESSAGES 1024 // waiting at once, far more than the queue holds with the ones merged into them
+
+typedef enum {
+    CLASS_ALARM,
+    CLASS_BATCH,
+    CLASS_STATUS,
+    CLASS_COUNT
+} class_t;
+
+typedef struct {
+    uint32_t start_ms;
+    uint32_t airtime_us;
+    uint8_t band;
+} frame_t;
+
+typedef struct {
+    uint32_t queued[CLASS_COUNT];
+    uint32_t sent[CLASS_COUNT];
+    uint32_t merged[CLASS_COUNT];
+    uint32_t lost[CLASS_COUNT];
+    uint64_t wait_ms[CLASS_COUNT];
+    uint32_t max_wait_ms[CLASS_COUNT];
+    uint32_t first_ms[MAX_MESSAGES]; // by message number, when the first of the messages merged into it was queued
+    uint16_t last_message[CLASS_COUNT];
+    uint32_t message_count;
+    frame_t frames[MAX_FRAMES];
+    uint32_t frame_count;
+    uint32_t now_ms;
+    uint32_t busy_until_ms;
+    uint8_t spreading_factor;
+} run_t;
+
+static const char *const class_names[CLASS_COUNT] = {"alarm", "batch", "status"};
+static const lora_tx_priority_t class_priorities[CLASS_COUNT] = {LORA_TX_URGENT, LORA_TX_NORMAL, LORA_TX_LOW};
+
+static uint32_t seed;
+
+static uint32_t random32(void);
+static bool sendFrame(void *context, uint8_t band, const uint8_t *payload, size_t length);
+static void queue(run_t *run, lora_tx_t *tx, class_t class, size_t length, bool priorities);
+static void simulate(run_t *run, lora_tx_t *tx, uint8_t spreading_factor, uint32_t hours, bool priorities,
+                     uint32_t run_seed);
+static void printRun(const run_t *run, const char *title);
+static int checkDutyCycle(const run_t *run);
+static int checkWaits(const run_t *run, const lora_tx_t *tx);
+
+int main(int argc, char **argv) {
+    uint8_t spreading_factor = (argc > 1) ? (uint8_t) atoi(argv[1]) : 12;
+    uint32_t hours = (argc > 2) ? (uint32_t) atoi(argv[2]) : 24;
+    uint32_t run_seed = (argc > 3) ? (uint32_t) strtoul(argv[3], NULL, 0) : 1;
+    static run_t run;
+    static lora_tx_t tx;
+
+    if (spreading_factor < 7 || spreading_factor > 12 || 0 == hours) {
+        fprintf(stderr, "usage: %s [spreading factor 7-12] [hours] [seed]\n", argv[0]);
+        return 2;
+    }
+    printf("%u h at SF%u, %u sub-bands of %u.%u%%, airtime of a full frame %u ms\n", hours, spreading_factor, BANDS,
+           DUTY_PERMILLE / 10, DUTY_PERMILLE % 10, lora_tx_airtime_us(spreading_factor, LORA_TX_MAX_PAYLOAD) / 1000);
+
+    simulate(&run, &tx, spreading_factor, hours, true, run_seed);
+    printRun(&run, "by priority");
+    lora_tx_print_stats(&tx, run.now_ms);
+    int violations = checkDutyCycle(&run) + checkWaits(&run, &tx);
+
+    simulate(&run, &tx, spreading_factor, hours, false, run_seed);
+    printRun(&run, "first come first served");
+    violations += checkDutyCycle(&run);
+    return (violations > 0) ? 1 : 0;
+}
+
+/* xorshift32, the same traffic for the same seed */
+static uint32_t random32(void) {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+/* The radio of the LoRa-E5: one frame at a time, with its receive windows. */
+static bool sendFrame(void *context, uint8_t band, const uint8_t *payload, size_t length) {
+    run_t *run = context;
+    if ((int32_t) (run->now_ms - run->busy_until_ms) < 0 || run->frame_count == MAX_FRAMES) {
+        return false;
+    }
+    frame_t *frame = &run->frames[run->frame_count++];
+    frame->start_ms = run->now_ms;
+    frame->airtime_us = lora_tx_airtime_us(run->spreading_factor, length);
+    frame->band = band;
+    run->busy_until_ms = run->now_ms + frame->airtime_us / 1000 + RECEIVE_WINDOWS_MS;
+
+    uint16_t number;
+    memcpy(&number, &payload[1], sizeof(number));
+    uint32_t wait_ms = run->now_ms - run->first_ms[number];
+    run->sent[payload[0]]++;
+    run->wait_ms[payload[0]] += wait_ms;
+    if (wait_ms > run->max_wait_ms[payload[0]]) {
+        run->max_wait_ms[payload[0]] = wait_ms;
+    }
+    return true;
+}
+
+/* The payload starts with the class and the number of the message, so the wait is known when it goes out. A status
+ * that replaces another one waits from the time of the first one it replaced on, as the scheduler counts it: the one
+ * it replaced is the last one of its class queued. */
+static void queue(run_t *run, lora_tx_t *tx, class_t class, size_t length, bool priorities) {
+    uint8_t payload[LORA_TX_MAX_PAYLOAD] = {0};
+    uint16_t number = (uint16_t) (run->message_count++ % MAX_MESSAGES);
+    payload[0] = (uint8_t) class;
+    memcpy(&payload[1], &number, sizeof(number));
+    uint32_t merged = tx->merged;
+    run->queued[class]++;
+    lora_tx_priority_t priority = priorities ? class_priorities[class] : LORA_TX_NORMAL;
+    if (false == lora_tx_enqueue(tx, run->now_ms, priority, (uint8_t) class, payload, length)) {
+        run->lost[class]++;
+    }
+    if (tx->merged != merged) {
+        run->first_ms[number] = run->first_ms[run->last_message[class]];
+        run->merged[class]++;
+    } else {
+        run->first_ms[number] = run->now_ms;
+        run->last_message[class] = number;
+    }
+}
+
+static void simulate(run_t *run, lora_tx_t *tx, uint8_t spreading_factor, uint32_t hours, bool priorities,
+                     uint32_t run_seed) {
+    uint32_t alarms_ms[MAX_ALARMS];
+    uint32_t alarm_count = (ALARMS_PER_DAY * hours + 23) / 24;
+    uint32_t end_ms = hours * HOUR_MS;
+
+    memset(run, 0, sizeof(run_t));
+    run->spreading_factor = spreading_factor;
+    seed = run_seed;
+    alarm_count = (alarm_count > MAX_ALARMS) ? MAX_ALARMS : alarm_count;
+    for (uint32_t i = 0; i < alarm_count; i++) {
+        alarms_ms[i] = random32() % (end_ms / STEP_MS) * STEP_MS;
+    }
+
+    lora_tx_init(tx, spreading_factor, sendFrame, run);
+    for (uint8_t i = 0; i < BANDS; i++) {
+        lora_tx_add_band(tx, DUTY_PERMILLE, 0);
+    }
+    uint32_t next_batch_ms = 0;
+    for (run->now_ms = 0; run->now_ms < end_ms; run->now_ms += STEP_MS) {
+        uint32_t hour = run->now_ms / HOUR_MS % 24;
+        if (run->now_ms == next_batch_ms) {
+            queue(run, tx, CLASS_BATCH, 10 + random32() % (LORA_TX_MAX_PAYLOAD - 9), priorities);
+            next_batch_ms += (hour >= 7 && hour < 22) ? 5 * 60 * 1000 : 30 * 60 * 1000;
+        }
+        if (0 == run->now_ms % (10 * 60 * 1000)) {
+            queue(run, tx, CLASS_STATUS, 8, priorities);
+        }
+        for (uint32_t i = 0; i < alarm_count; i++) {
+            if (run->now_ms == alarms_ms[i]) {
+                queue(run, tx, CLASS_ALARM, 6, priorities);
+            }
+        }
+        lora_tx_poll(tx, run->now_ms);
+    }
+}
+
+static void printRun(const run_t *run, const char *title) {
+    printf("%s:\n", title);
+    for (int i = 0; i < CLASS_COUNT; i++) {
+        printf("  %-6s %4u queued, %4u sent, %3u merged, %3u lost, wait mean %7.1f s, longest %7.1f s\n",
+               class_names[i], run->queued[i], run->sent[i], run->merged[i], run->lost[i],
+               run->sent[i] ? (double) run->wait_ms[i] / run->sent[i] / 1000 : 0.0, run->max_wait_ms[i] / 1000.0);
+    }
+}
+
+/* Off-time after each frame and airtime in the hour before each frame, per sub-band. */
+static int checkDutyCycle(const run_t *run) {
+    int violations = 0;
+    for (uint8_t band = 0; band < BANDS; band++) {
+        const frame_t *previous = NULL;
+        uint64_t max_hour_us = 0;
+        for (uint32_t i = 0; i < run->frame_count; i++) {
+            const frame_t *frame = &run->frames[i];
+            if (frame->band != band) {
+                continue;
+            }
+            if (NULL != previous) {
+                uint64_t off_us = (uint64_t) previous->airtime_us * (1000 - DUTY_PERMILLE) / DUTY_PERMILLE;
+                // the scheduler rounds down to the millisecond
+                if ((uint64_t) (frame->start_ms - previous->start_ms) * 1000 + 1000 <
+                    previous->airtime_us + off_us) {
+                    printf("  band %u: frame at %u ms within the off-time of the one at %u ms\n", band,
+                           frame->start_ms, previous->start_ms);
+                    violations++;
+                }
+            }
+            previous = frame;
+            uint64_t hour_us = 0;
+            for (uint32_t j = 0; j <= i; j++) {
+                if (run->frames[j].band == band && frame->start_ms - run->frames[j].start_ms < HOUR_MS) {
+                    hour_us += run->frames[j].airtime_us;
+                }
+            }
+            max_hour_us = (hour_us > max_hour_us) ? hour_us : max_hour_us;
+        }
+        uint64_t limit_us = (uint64_t) HOUR_MS * DUTY_PERMILLE;
+        printf("  band %u: at most %.1f s of airtime in an hour, %.1f s allowed\n", band, max_hour_us / 1e6,
+               limit_us / 1e6);
+        if (max_hour_us > limit_us) {
+            violations++;
+        }
+    }
+    return violations;
+}
+
+/* A promoted status waits behind at most the rest of a full queue, each message taking a frame of the longest airtime
+ * and the off-time of a normal message after it on a single band. */
+static int checkWaits(const run_t *run, const lora_tx_t *tx) {
+    int violations = 0;
+    for (int i = 0; i < CLASS_COUNT; i++) {
+        if (run->max_wait_ms[i] != tx->max_wait_ms[class_priorities[i]]) {
+            printf("  %s: longest wait %u ms, the scheduler counted %u ms\n", class_names[i], run->max_wait_ms[i],
+                   tx->max_wait_ms[class_priorities[i]]);
+            violations++;
+        }
+    }
+    uint64_t airtime_us = lora_tx_airtime_us(run->spreading_factor, LORA_TX_MAX_PAYLOAD);
+    uint64_t frame_us = airtime_us + 2 * airtime_us * (1000 - DUTY_PERMILLE) / DUTY_PERMILLE;
+    uint32_t bound_ms = LORA_TX_AGING_MS + (uint32_t) (LORA_TX_QUEUE * frame_us / 1000);
+    printf("  status: longest wait %.1f s, at most %.1f s\n", run->max_wait_ms[CLASS_STATUS] / 1000.0,
+           bound_ms / 1000.0);
+    if (run->max_wait_ms[CLASS_STATUS] > bound_ms) {
+        violations++;
+    }
+    return violations;
+}
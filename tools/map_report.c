@@ -0,0 +1,248 @@
+/*
+Placement and size of the functions of a firmware, from the map file of the link (<target>.elf.map next to the ELF).
+
+Build on the host (no Pico SDK needed):
+    cc -O2 -o map_report map_report.c
+
+Usage:
+    map_report <firmware.elf.map> [function ...]
+
+Lists every code section the linker kept with its region (flash for XIP, sram, or other), address, size and the
+object it came from, largest first per region, and the totals per region. The sections are those of one function each
+as the projects are compiled (-ffunction-sections): .text.<name>, or .time_critical.<name> for the functions placed
+in SRAM (__not_in_flash_func, common/ram_func.h); a copy_to_ram binary has its .text in SRAM as a whole.
+
+With function names only those are listed, and the exit status is 1 if one of them is not in SRAM or not in the map,
+so a hot path build can check that its handlers got there, e.g.
+    map_report exercise3.elf.map uart0_handler uart1_handler uart_irq_rx rb_put
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_LINE 1024
+#define MAX_NAME 128
+
+typedef enum {
+    REGION_FLASH,
+    REGION_SRAM,
+    REGION_OTHER,
+    REGION_COUNT
+} region_t;
+
+typedef struct {
+    char name[MAX_NAME];
+    char object[MAX_NAME];
+    uint32_t address;
+    uint32_t size;
+    region_t region;
+} function_t;
+
+static const char *const region_names[REGION_COUNT] = {"flash", "sram", "other"};
+
+static function_t *functions;
+static size_t function_count;
+
+static int loadMap(const char *path);
+static void addSection(const char *section, const char *first_symbol, uint32_t address, uint32_t size,
+                       const char *object);
+static region_t regionOf(uint32_t address);
+static const char *baseName(const char *path);
+static int compareFunctions(const void *a, const void *b);
+static const function_t *findFunction(const char *name);
+static void printFunction(const function_t *function);
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <firmware.elf.map> [function ...]\n", argv[0]);
+        return 2;
+    }
+    if (0 != loadMap(argv[1])) {
+        return 1;
+    }
+    if (0 == function_count) {
+        fprintf(stderr, "%s: no code sections; is it the map file of a link?\n", argv[1]);
+        return 1;
+    }
+    qsort(functions, function_count, sizeof(function_t), compareFunctions);
+
+    printf("%-6s %-10s %7s  %-40s  %s\n", "region", "address", "size", "function", "object");
+    if (argc > 2) {
+        int missing = 0;
+        for (int i = 2; i < argc; i++) {
+            const function_t *function = findFunction(argv[i]);
+            if (NULL == function) {
+                printf("%-26s %s: not in the map (inlined or discarded)\n", "", argv[i]);
+                missing++;
+                continue;
+            }
+            printFunction(function);
+            if (REGION_SRAM != function->region) {
+                missing++;
+            }
+        }
+        if (missing > 0) {
+            printf("%d of %d not in SRAM\n", missing, argc - 2);
+        }
+        return (missing > 0) ? 1 : 0;
+    }
+
+    uint32_t totals[REGION_COUNT] = {0};
+    size_t counts[REGION_COUNT] = {0};
+    for (size_t i = 0; i < function_count; i++) {
+        printFunction(&functions[i]);
+        totals[functions[i].region] += functions[i].size;
+        counts[functions[i].region]++;
+    }
+    for (int region = 0; region < REGION_COUNT; region++) {
+        if (counts[region] > 0) {
+            printf("%s: %lu bytes of code in %zu sections\n", region_names[region], (unsigned long) totals[region],
+                   counts[region]);
+        }
+    }
+    return 0;
+}
+
+/* An input section of the memory map is " <name> <address> <size> <object>", the name on a line of its own when it is
+ * long; the symbols it defines follow as "<address> <symbol>". */
+static int loadMap(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (NULL == file) {
+        perror(path);
+        return 1;
+    }
+    char line[MAX_LINE];
+    char pending[MAX_NAME] = "";  // a section name waiting for its address line
+    char section[MAX_NAME] = "";  // the section the symbol lines belong to
+    char object[MAX_NAME] = "";
+    uint32_t address = 0;
+    uint32_t size = 0;
+    char first_symbol[MAX_NAME] = "";
+    int in_map = 0;
+
+    while (NULL != fgets(line, sizeof(line), file)) {
+        if (0 == strncmp(line, "Linker script and memory map", 28)) {
+            in_map = 1;
+            continue;
+        }
+        if (!in_map) {
+            continue;
+        }
+        char name[MAX_NAME];
+        unsigned long a, s;
+        char rest[MAX_LINE];
+        int fields;
+
+        if (' ' == line[0] && '.' == line[1]) {
+            // a new input section: the previous one is complete
+            if ('\0' != section[0]) {
+                addSection(section, first_symbol, address, size, object);
+                section[0] = '\0';
+            }
+            fields = sscanf(line, " %127s 0x%lx 0x%lx %1023s", name, &a, &s, rest);
+            if (1 == fields) {
+                strcpy(pending, name);
+            } else if (4 == fields) {
+                strcpy(section, name);
+                address = (uint32_t) a;
+                size = (uint32_t) s;
+                snprintf(object, sizeof(object), "%.127s", baseName(rest));
+                first_symbol[0] = '\0';
+            }
+            continue;
+        }
+        if ('\0' != pending[0]) {
+            if (3 == sscanf(line, " 0x%lx 0x%lx %1023s", &a, &s, rest)) {
+                strcpy(section, pending);
+                address = (uint32_t) a;
+                size = (uint32_t) s;
+                snprintf(object, sizeof(object), "%.127s", baseName(rest));
+                first_symbol[0] = '\0';
+            }
+            pending[0] = '\0';
+            continue;
+        }
+        if ('\0' != section[0]) {
+            if (2 == sscanf(line, " 0x%lx %127s", &a, name) && '\0' == first_symbol[0] && '=' != name[0]) {
+                strcpy(first_symbol, name);
+            } else if (' ' != line[0]) {
+                // an output section or the end of the map
+                addSection(section, first_symbol, address, size, object);
+                section[0] = '\0';
+            }
+        }
+    }
+    if ('\0' != section[0]) {
+        addSection(section, first_symbol, address, size, object);
+    }
+    fclose(file);
+    return 0;
+}
+
+/* Only code that takes space: .text.<function>, .time_critical.<function>, or a whole .text named after its first
+ * symbol. */
+static void addSection(const char *section, const char *first_symbol, uint32_t address, uint32_t size,
+                       const char *object) {
+    const char *name;
+    if (0 == size) {
+        return;
+    }
+    if (0 == strncmp(section, ".text.", 6)) {
+        name = section + 6;
+    } else if (0 == strncmp(section, ".time_critical.", 15)) {
+        name = section + 15;
+    } else if (0 == strcmp(section, ".text") && '\0' != first_symbol[0]) {
+        name = first_symbol;
+    } else {
+        return;
+    }
+    functions = realloc(functions, (function_count + 1) * sizeof(function_t));
+    function_t *function = &functions[function_count++];
+    snprintf(function->name, sizeof(function->name), "%s", name);
+    snprintf(function->object, sizeof(function->object), "%s", object);
+    function->address = address;
+    function->size = size;
+    function->region = regionOf(address);
+}
+
+/* RP2040: XIP flash and its cache aliases from 0x10000000, the striped and the bank SRAM from 0x20000000. */
+static region_t regionOf(uint32_t address) {
+    if (address >= 0x10000000u && address < 0x14000000u) {
+        return REGION_FLASH;
+    }
+    if (address >= 0x20000000u && address < 0x20042000u) {
+        return REGION_SRAM;
+    }
+    return REGION_OTHER;
+}
+
+static const char *baseName(const char *path) {
+    const char *slash = strrchr(path, '/');
+    return (NULL != slash) ? slash + 1 : path;
+}
+
+/* By region, then largest first */
+static int compareFunctions(const void *a, const void *b) {
+    const function_t *fa = a;
+    const function_t *fb = b;
+    if (fa->region != fb->region) {
+        return (int) fa->region - (int) fb->region;
+    }
+    return (fa->size < fb->size) - (fa->size > fb->size);
+}
+
+static const function_t *findFunction(const char *name) {
+    for (size_t i = 0; i < function_count; i++) {
+        if (0 == strcmp(name, functions[i].name)) {
+            return &functions[i];
+        }
+    }
+    return NULL;
+}
+
+static void printFunction(const function_t *function) {
+    printf("%-6s 0x%08lx %7lu  %-40s  %s\n", region_names[function->region], (unsigned long) function->address,
+           (unsigned long) function->size, function->name, function->object);
+}
@@ -0,0 +1,277 @@
+/*
+Reference host client for the binary protocol in common/proto.h.
+
+Build on the host (no Pico SDK needed):
+    cc -O2 -I../common -o proto_client proto_client.c ../common/cobs.c ../common/crc16.c
+
+Usage:
+    proto_client <tty> ping
+    proto_client <tty> status
+    proto_client <tty> move <eighths>
+    proto_client <tty> goto <eighth>
+    proto_client <tty> leds [mask]
+    proto_client <tty> log <index>
+    proto_client <tty> dump <address> <length>
+    proto_client <tty> profile
+    proto_client <tty> bench <count> [depth]
+
+profile reads the main loop profile zones (common/profile.h) one by one until the board refuses the index.
+bench sends <count> pings keeping up to <depth> requests in flight, checks the echoes and prints round trips per
+second; the host twins build the client and run it against Exercise 5 (host/scripts/proto_loopback.sim).
+Text printed by the board between frames is skipped.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cobs.h"
+#include "crc16.h"
+#include "profile.h"
+#include "proto.h"
+
+#define TIMEOUT_MS 1000
+
+static int openPort(const char *path);
+static void sendRequest(int fd, uint8_t seq, uint8_t type, const uint8_t *payload, size_t length);
+static int readResponse(int fd, uint8_t *packet, size_t *length);
+static int transact(int fd, uint8_t type, const uint8_t *payload, size_t length, uint8_t *reply, size_t *reply_length);
+static int bench(int fd, long count, int depth);
+static double nowSeconds(void);
+
+static uint8_t next_seq = 0;
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <tty> ping|status|move N|goto N|leds [mask]|log N|dump A L|profile|bench N [depth]\n", argv[0]);
+        return 2;
+    }
+    int fd = openPort(argv[1]);
+    if (fd < 0) {
+        fprintf(stderr, "%s: %s\n", argv[1], strerror(errno));
+        return 1;
+    }
+
+    const char *command = argv[2];
+    uint8_t payload[PROTO_MAX_PAYLOAD];
+    uint8_t reply[PROTO_MAX_PAYLOAD];
+    size_t reply_length = 0;
+    int status;
+
+    if (0 == strcmp("ping", command)) {
+        memcpy(payload, "ping", 4);
+        status = transact(fd, PROTO_PING, payload, 4, reply, &reply_length);
+        if (PROTO_OK == status) {
+            printf("%.*s\n", (int) reply_length, (char *) reply);
+        }
+    } else if (0 == strcmp("status", command)) {
+        status = transact(fd, PROTO_MOTOR_STATUS, NULL, 0, reply, &reply_length);
+        if (PROTO_OK == status && 14 == reply_length) {
+            printf("calibrated %u busy %u position %u steps/rev %u errors %u\n", reply[0], reply[1],
+                   (reply[2] << 24) | (reply[3] << 16) | (reply[4] << 8) | reply[5],
+                   (reply[6] << 24) | (reply[7] << 16) | (reply[8] << 8) | reply[9],
+                   (reply[10] << 24) | (reply[11] << 16) | (reply[12] << 8) | reply[13]);
+        }
+    } else if (0 == strcmp("move", command) && argc > 3) {
+        uint32_t eighths = strtoul(argv[3], NULL, 0);
+        payload[0] = eighths >> 24; payload[1] = eighths >> 16; payload[2] = eighths >> 8; payload[3] = eighths;
+        status = transact(fd, PROTO_MOTOR_MOVE, payload, 4, reply, &reply_length);
+    } else if (0 == strcmp("goto", command) && argc > 3) {
+        payload[0] = strtoul(argv[3], NULL, 0);
+        status = transact(fd, PROTO_MOTOR_GOTO, payload, 1, reply, &reply_length);
+    } else if (0 == strcmp("leds", command)) {
+        if (argc > 3) {
+            payload[0] = strtoul(argv[3], NULL, 0);
+            status = transact(fd, PROTO_LED_SET, payload, 1, reply, &reply_length);
+        } else {
+            status = transact(fd, PROTO_LED_GET, NULL, 0, reply, &reply_length);
+            if (PROTO_OK == status) {
+                printf("D1 %d D2 %d D3 %d\n", reply[0] & 1, (reply[0] >> 1) & 1, (reply[0] >> 2) & 1);
+            }
+        }
+    } else if (0 == strcmp("log", command) && argc > 3) {
+        payload[0] = strtoul(argv[3], NULL, 0);
+        status = transact(fd, PROTO_LOG_READ, payload, 1, reply, &reply_length);
+        if (PROTO_OK == status) {
+            printf("%.*s\n", (int) reply_length, (char *) reply);
+        }
+    } else if (0 == strcmp("dump", command) && argc > 4) {
+        unsigned long address = strtoul(argv[3], NULL, 0);
+        unsigned long end = address + strtoul(argv[4], NULL, 0);
+        status = PROTO_OK;
+        while (address < end && PROTO_OK == status) {
+            size_t chunk = (end - address < PROTO_MAX_PAYLOAD) ? end - address : PROTO_MAX_PAYLOAD;
+            payload[0] = address >> 8; payload[1] = address; payload[2] = chunk;
+            status = transact(fd, PROTO_EEPROM_READ, payload, 3, reply, &reply_length);
+            for (size_t i = 0; PROTO_OK == status && i < reply_length; i++) {
+                printf("%s%02x", (0 == i % 16) ? (i ? "\n" : "") : " ", reply[i]);
+            }
+            if (PROTO_OK == status) {
+                printf("\n");
+            }
+            address += chunk;
+        }
+    } else if (0 == strcmp("profile", command)) {
+        payload[0] = 0;
+        status = transact(fd, PROTO_PROFILE_READ, payload, 1, reply, &reply_length);
+        while (PROTO_OK == status && reply_length >= 12 + 2 * PROFILE_BUCKETS) {
+            printf("%.*s: %u calls, avg %u us, max %u us\n", (int) (reply_length - 12 - 2 * PROFILE_BUCKETS),
+                   (char *) &reply[12 + 2 * PROFILE_BUCKETS],
+                   (reply[0] << 24) | (reply[1] << 16) | (reply[2] << 8) | reply[3],
+                   (reply[4] << 24) | (reply[5] << 16) | (reply[6] << 8) | reply[7],
+                   (reply[8] << 24) | (reply[9] << 16) | (reply[10] << 8) | reply[11]);
+            for (int bucket = 0; bucket < PROFILE_BUCKETS; bucket++) {
+                unsigned count = (reply[12 + 2 * bucket] << 8) | reply[13 + 2 * bucket];
+                if (count > 0) {
+                    printf("  %6u us and more: %u\n", bucket ? 1u << (bucket - 1) : 0, count);
+                }
+            }
+            payload[0]++;
+            status = transact(fd, PROTO_PROFILE_READ, payload, 1, reply, &reply_length);
+        }
+        if (PROTO_ERR_ARGS == status && payload[0] > 0) {
+            status = PROTO_OK; // past the last zone
+        }
+    } else if (0 == strcmp("bench", command) && argc > 3) {
+        status = bench(fd, strtol(argv[3], NULL, 0), (argc > 4) ? atoi(argv[4]) : 1);
+    } else {
+        fprintf(stderr, "unknown command %s\n", command);
+        status = -2;
+    }
+
+    if (0 != status) {
+        fprintf(stderr, "failed: %d\n", status);
+    }
+    close(fd);
+    return 0 == status ? 0 : 1;
+}
+
+static int openPort(const char *path) {
+    int fd = open(path, O_RDWR | O_NOCTTY);
+    if (fd < 0) {
+        return fd;
+    }
+    struct termios tty;
+    if (0 == tcgetattr(fd, &tty)) {
+        cfmakeraw(&tty);
+        cfsetspeed(&tty, B115200);
+        tty.c_cc[VMIN] = 0;
+        tty.c_cc[VTIME] = TIMEOUT_MS / 100;
+        tcsetattr(fd, TCSANOW, &tty);
+    }
+    return fd;
+}
+
+static void sendRequest(int fd, uint8_t seq, uint8_t type, const uint8_t *payload, size_t length) {
+    uint8_t packet[PROTO_MAX_PACKET];
+    uint8_t frame[PROTO_MAX_ENCODED + 2];
+
+    packet[0] = seq;
+    packet[1] = type;
+    if (length > 0) {
+        memcpy(&packet[2], payload, length);
+    }
+    uint16_t crc = crc16(packet, length + 2);
+    packet[length + 2] = (uint8_t) (crc >> 8);
+    packet[length + 3] = (uint8_t) crc;
+
+    frame[0] = 0;
+    size_t encoded = cobs_encode(packet, length + 4, &frame[1]);
+    frame[encoded + 1] = 0;
+    if (write(fd, frame, encoded + 2) < 0) {
+        perror("write");
+    }
+}
+
+/* Reads the next valid response packet (seq, type, status, payload) without its CRC. Returns 0, or -1 on timeout. */
+static int readResponse(int fd, uint8_t *packet, size_t *length) {
+    uint8_t encoded[PROTO_MAX_ENCODED];
+    size_t count = 0;
+    bool in_frame = false;
+    uint8_t byte;
+
+    while (true) {
+        ssize_t n = read(fd, &byte, 1);
+        if (n <= 0) {
+            return -1;
+        }
+        if (false == in_frame) {
+            in_frame = (0 == byte);
+            count = 0;
+        } else if (0 != byte) {
+            if (count < sizeof(encoded)) {
+                encoded[count++] = byte;
+            }
+        } else if (0 == count) {
+            // two zeros in a row: the first closed an empty or lost frame, this one opens the next
+        } else {
+            size_t decoded = cobs_decode(encoded, count, packet);
+            if (decoded >= 5 && 0 == crc16(packet, decoded)) {
+                *length = decoded - 2;
+                return 0;
+            }
+            in_frame = false;
+        }
+    }
+}
+
+static int transact(int fd, uint8_t type, const uint8_t *payload, size_t length, uint8_t *reply, size_t *reply_length) {
+    uint8_t packet[PROTO_MAX_PACKET];
+    size_t packet_length;
+    uint8_t seq = next_seq++;
+
+    sendRequest(fd, seq, type, payload, length);
+    do {
+        if (0 != readResponse(fd, packet, &packet_length)) {
+            return -1;
+        }
+    } while (packet[0] != seq);
+
+    *reply_length = packet_length - 3;
+    memcpy(reply, &packet[3], *reply_length);
+    return packet[2];
+}
+
+static int bench(int fd, long count, int depth) {
+    uint8_t packet[PROTO_MAX_PACKET];
+    size_t packet_length;
+    long sent = 0, received = 0;
+    const uint8_t payload[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+
+    if (depth < 1 || depth > 128) {
+        depth = 1;
+    }
+    double start = nowSeconds();
+    while (received < count) {
+        while (sent < count && sent - received < depth) {
+            sendRequest(fd, (uint8_t) sent++, PROTO_PING, payload, sizeof(payload));
+        }
+        if (0 != readResponse(fd, packet, &packet_length)) {
+            fprintf(stderr, "timeout after %ld responses\n", received);
+            return -1;
+        }
+        if (packet[0] != (uint8_t) received || PROTO_OK != packet[2]) {
+            fprintf(stderr, "unexpected response seq %u status %u\n", packet[0], packet[2]);
+            return -1;
+        }
+        if (packet_length != 3 + sizeof(payload) || 0 != memcmp(&packet[3], payload, sizeof(payload))) {
+            fprintf(stderr, "wrong echo in response seq %u\n", packet[0]);
+            return -1;
+        }
+        received++;
+    }
+    double elapsed = nowSeconds() - start;
+    printf("%ld round trips, depth %d: %.3f s, %.0f round trips/s\n", count, depth, elapsed, count / elapsed);
+    return 0;
+}
+
+static double nowSeconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
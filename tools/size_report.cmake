@@ -0,0 +1,50 @@
+# Flash and RAM use of the firmware, run by the size_report target of the superbuild (../CMakeLists.txt):
+#     cmake -DSIZE=<arm-none-eabi-size> -DFILES="<elf>;..." -DOUTPUT=sizes.csv [-DBASELINE=<sizes.csv>] -P size_report.cmake
+#
+# flash is text + data (the initial values of data are stored in flash), RAM is data + bss; the stacks and the heap come
+# on top. The table is written to OUTPUT as CSV (target,flash,ram). With the CSV of another build as BASELINE, e.g. one
+# from before a change or of the other PICOW_PROFILE, the difference is printed next to each target.
+
+if(DEFINED BASELINE AND EXISTS "${BASELINE}")
+    file(STRINGS "${BASELINE}" baseline_lines)
+    foreach(line IN LISTS baseline_lines)
+        string(REPLACE "," ";" fields "${line}")
+        list(GET fields 0 name)
+        list(GET fields 1 flash)
+        list(GET fields 2 ram)
+        set(baseline_${name} ${flash} ${ram})
+    endforeach()
+endif()
+
+set(csv "")
+foreach(file IN LISTS FILES)
+    get_filename_component(name "${file}" NAME_WE)
+    execute_process(COMMAND "${SIZE}" -B "${file}" OUTPUT_VARIABLE output RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "${SIZE} ${file} failed")
+    endif()
+    # second line: text data bss dec hex filename
+    string(REGEX MATCH "\n *([0-9]+)[ \t]+([0-9]+)[ \t]+([0-9]+)" numbers "${output}")
+    math(EXPR flash "${CMAKE_MATCH_1} + ${CMAKE_MATCH_2}")
+    math(EXPR ram "${CMAKE_MATCH_2} + ${CMAKE_MATCH_3}")
+    string(APPEND csv "${name},${flash},${ram}\n")
+
+    set(line "${name}: flash ${flash} B, RAM ${ram} B")
+    if(DEFINED baseline_${name})
+        list(GET baseline_${name} 0 flash_before)
+        list(GET baseline_${name} 1 ram_before)
+        math(EXPR flash_delta "${flash} - ${flash_before}")
+        math(EXPR ram_delta "${ram} - ${ram_before}")
+        foreach(delta flash_delta ram_delta)
+            if(${delta} GREATER_EQUAL 0)
+                set(${delta} "+${${delta}}")
+            endif()
+        endforeach()
+        string(APPEND line " (was ${flash_before} B and ${ram_before} B: ${flash_delta} B, ${ram_delta} B)")
+    endif()
+    message("${line}")
+endforeach()
+
+if(DEFINED OUTPUT)
+    file(WRITE "${OUTPUT}" "${csv}")
+endif()